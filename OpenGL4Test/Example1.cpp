@@ -18,12 +18,14 @@
 #include "common/CCamera.h"
 #include "common/CShaderPool.h"
 #include "models/CQuad.h"
+#include "models/CTiledFloor.h"
 #include "models/CBottle.h"
 #include "models/CTeapot.h"
 #include "models/CSphere.h"
 
 #include "common/CLight.h"
 #include "common/CMaterial.h"
+#include "common/CMaterialTable.h"
 
 #define SCREEN_WIDTH  800
 #define SCREEN_HEIGHT 800 
@@ -33,7 +35,7 @@ CBottle  g_bottle(18, 8, 4);
 CTeapot  g_teapot(5);
 glm::vec3 g_eyeloc(8.0f, 8.0f, 8.0f); // 鏡頭位置, 預設在 (8,8,8) 
 CCube g_centerloc; // view center預設在 (0,0,0)，不做任何描繪操作
-CQuad g_floor[ROW_NUM][ROW_NUM]; // 64 個四邊形組成的地板
+CTiledFloor g_floor(ROW_NUM, ROW_NUM); // 196 個磁磚，一次 instanced draw call
 CSphere  g_sphere;
 
 GLuint g_shadingProg;
@@ -65,20 +67,9 @@ void loadScene(void)
     g_light.setAttenuation(1.0f, 0.25f, 0.25f);
 #endif
 
-    int k = 0;
-    for (int i = 0; i < ROW_NUM; i++)
-    {
-        k++;
-        for (int j = 0; j < ROW_NUM; j++) {
-            g_floor[i][j].setupVertexAttributes();
-            g_floor[i][j].setShaderID(g_shadingProg, 3);
-            g_floor[i][j].setPos(glm::vec3((ROW_NUM / 2) - 0.5f - (float)i, 0.0f, (float)j - (ROW_NUM / 2) + 0.5f));
-            g_floor[i][j].setRotate(-90.0f, glm::vec3(1.0f, 0.0f, 0.0f));
-            if (k % 2) g_floor[i][j].setMaterial(g_matBeige);
-            else g_floor[i][j].setMaterial(g_matGray);
-            k++;
-        }
-    }
+    g_floor.setupVertexAttributes();
+    g_floor.setShaderID(g_shadingProg, 3);
+    g_floor.setCheckerMaterials(g_matBeige, g_matGray);
 
     g_bottle.setupVertexAttributes();
     g_bottle.setShaderID(g_shadingProg, 3);
@@ -94,14 +85,7 @@ void loadScene(void)
 
 	CCamera::getInstance().updateView(g_eyeloc); // 設定 eye 位置
 	CCamera::getInstance().updatePerspective(45.0f, (float)SCREEN_WIDTH / SCREEN_HEIGHT, 0.1f, 100.0f);
-    glm::mat4 mxView = CCamera::getInstance().getViewMatrix();
-	glm::mat4 mxProj = CCamera::getInstance().getProjectionMatrix();
-
-    GLint viewLoc = glGetUniformLocation(g_shadingProg, "mxView"); 	// 取得 view matrix 變數的位置
-    glUniformMatrix4fv(viewLoc, 1, GL_FALSE, glm::value_ptr(mxView));
-
-    GLint projLoc = glGetUniformLocation(g_shadingProg, "mxProj"); 	// 取得投影矩陣變數的位置
-    glUniformMatrix4fv(projLoc, 1, GL_FALSE, glm::value_ptr(mxProj));
+    // view/proj 由 render() 每個 frame 寫入 FrameBlock
 
     glClearColor(0.0f, 0.0f, 0.0f, 1.0f); // 設定清除 back buffer 背景的顏色
     glEnable(GL_DEPTH_TEST); // 啟動深度測試
@@ -111,17 +95,14 @@ void loadScene(void)
 void render(void)
 {
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT); // 設定 back buffer 的背景顏色
+    CCamera::getInstance().uploadFrameBlock((float)glfwGetTime());
+    CMaterialTable::getInstance().flush(); // 只上傳這個 frame 有變動的材質
     glUseProgram(g_shadingProg);
 
     //上傳光源與相機位置
     g_light.updateToShader();
-    glUniform3fv(glGetUniformLocation(g_shadingProg, "viewPos"), 1, glm::value_ptr(g_eyeloc));
 
-    for (int i = 0; i < ROW_NUM; i++)
-        for (int j = 0; j < ROW_NUM; j++) {
-            g_floor[i][j].uploadMaterial();
-            g_floor[i][j].drawRaw();
-        }
+    g_floor.drawRaw();
 
     g_light.drawRaw();
     g_bottle.uploadMaterial();
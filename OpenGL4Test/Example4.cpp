@@ -26,6 +26,7 @@
 
 #include "common/CLight.h"
 #include "common/CMaterial.h"
+#include "common/CMaterialTable.h"
 
 #define SCREEN_WIDTH  800
 #define SCREEN_HEIGHT 800 
@@ -39,7 +40,7 @@ CSphere g_sphere;
 
 glm::vec3 g_eyeloc(6.0f, 6.0f, 6.0f); // 鏡頭位置, 預設在 (8,8,8) 
 CCube g_centerloc; // view center預設在 (0,0,0)，不做任何描繪操作
-CQuad g_floor[ROW_NUM][ROW_NUM]; 
+CQuad g_floor[ROW_NUM][ROW_NUM]; // v_npr 沒有 instancing 輸入，無法使用 CTiledFloor
 
 GLuint g_shadingProg;
 
@@ -111,14 +112,7 @@ void loadScene(void)
 	CCamera::getInstance().updateView(g_eyeloc); // 設定 eye 位置
     CCamera::getInstance().updateCenter(glm::vec3(0,4,0));
 	CCamera::getInstance().updatePerspective(45.0f, (float)SCREEN_WIDTH / SCREEN_HEIGHT, 0.1f, 100.0f);
-    glm::mat4 mxView = CCamera::getInstance().getViewMatrix();
-	glm::mat4 mxProj = CCamera::getInstance().getProjectionMatrix();
-
-    GLint viewLoc = glGetUniformLocation(g_shadingProg, "mxView"); 	// 取得 view matrix 變數的位置
-    glUniformMatrix4fv(viewLoc, 1, GL_FALSE, glm::value_ptr(mxView));
-
-    GLint projLoc = glGetUniformLocation(g_shadingProg, "mxProj"); 	// 取得投影矩陣變數的位置
-    glUniformMatrix4fv(projLoc, 1, GL_FALSE, glm::value_ptr(mxProj));
+    // view/proj 由 render() 每個 frame 寫入 FrameBlock
 
     glClearColor(0.0f, 0.0f, 0.0f, 1.0f); // 設定清除 back buffer 背景的顏色
     glEnable(GL_DEPTH_TEST); // 啟動深度測試
@@ -128,11 +122,12 @@ void loadScene(void)
 void render(void)
 {
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT); // 設定 back buffer 的背景顏色
+    CCamera::getInstance().uploadFrameBlock((float)glfwGetTime());
+    CMaterialTable::getInstance().flush(); // 只上傳這個 frame 有變動的材質
     glUseProgram(g_shadingProg);
 
     //上傳光源與相機位置
     g_light.updateToShader();
-    glUniform3fv(glGetUniformLocation(g_shadingProg, "viewPos"), 1, glm::value_ptr(g_eyeloc));
     glUniform3fv(glGetUniformLocation(g_shadingProg, "lightPos"), 1, glm::value_ptr(g_light.getPos()));
 
     for (int i = 0; i < ROW_NUM; i++)
@@ -26,6 +26,8 @@
 #include <iostream>
 #include <fstream>
 #include <sstream>
+#include <algorithm>
+#include <chrono>
 
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
@@ -40,8 +42,10 @@
 #include "common/wmhandler.h"
 #include "common/CCamera.h"
 #include "common/CShaderPool.h"
+#include "common/CUniform.h"
 #include "common/CButton.h"
 #include "models/CQuad.h"
+#include "models/CTiledFloor.h"
 #include "models/CBottle.h"
 #include "models/CTeapot.h"
 #include "models/CTorusKnot.h"
@@ -55,10 +59,23 @@
 
 #include "common/CLight.h"
 #include "common/CMaterial.h"
+#include "common/CMaterialTable.h"
+#include "common/CHotReload.h"
+#include "common/CGLState.h"
+#include "common/CRenderQueue.h"
+#include "common/CStaticBatch.h"
+#include "common/CCuller.h"
+#include "common/CSceneBVH.h"
+#include "common/COcclusionCuller.h"
+#include "common/CShadowMaps.h"
+#include "common/CTransformGraph.h"
+#include "common/CTransformStore.h"
+#include "common/CSceneFile.h"
 
 #define SCREEN_WIDTH  800
 #define SCREEN_HEIGHT 800 
 #define ROW_NUM 30
+#define NODE_VERSION_NONE 0xFFFFFFFFu // 尚未記錄版本：從未重算的節點版本為 0，必須與之區分
 
 CollisionManager g_collisionManager;
 
@@ -68,10 +85,12 @@ CSphere g_sphere;
 
 glm::vec3 g_eyeloc(5.0f, 5.0f, 5.0f); // 鏡頭位置, 預設在 (8,8,8)
 CCube g_centerloc; // view center預設在 (0,0,0)，不做任何描繪操作
-CQuad g_floor[ROW_NUM][ROW_NUM]; 
+CTiledFloor g_floor(ROW_NUM, ROW_NUM); // 尚未加入場景，使用時只需一次 instanced draw call
 
 GLuint g_shadingProg;
 GLuint g_uiShader;
+// 每個 frame 都會用到的 uniform，於 loadScene 時解析一次
+CUniform<glm::vec3> g_lightPosUniform;
 GLuint g_modelVAO;
 int g_modelVertexCount;
 
@@ -89,90 +108,95 @@ GLint g_2dviewLoc, g_2dProjLoc;
 
 
 CLightManager lightManager;
-// 全域光源 (位置在 5,5,0)
-CLight* g_light = new CLight(
-       glm::vec3(3.5f, 5.5f, 0.0f),           // 位置
-       glm::vec4(0.3f, 0.3f, 0.3f, 1.0f),     // 環境光 - 較高比例
-       glm::vec4(0.6f, 0.6f, 0.6f, 1.0f),     // 漫反射 - 中等強度
-       glm::vec4(0.2f, 0.2f, 0.2f, 1.0f),     // 鏡面反射 - 較低
-       1.0f, 0.09f, 0.032f                    // 衰減參數
-   );
-//
-//// 創建第一個點光源
-CLight* pointLight1 = new CLight(
-     glm::vec3(0.0f, 10.0f, 0.0f),           // 位置
-     glm::vec4(0.3f, 0.3f, 0.3f, 1.0f),     // 環境光
-     glm::vec4(0.8f, 0.8f, 0.8f, 1.0f),     // 漫反射
-     glm::vec4(0.2f, 0.2f, 0.2f, 1.0f),     // 鏡面反射 - 較低
-    1.0f, 0.09f, 0.032f                    // 衰減參數            // attenuation
-);
-
-// 創建聚光燈
-CLight* spotLight1 = new CLight(
-    glm::vec3(-4.0f, 10.0f, 4.0f),        // position
-    glm::vec3(-3.8f, 0.0f, 3.8f),        // target
-    12.5f, 20.5f, 2.5f,                 // inner/outer cutoff, exponent
-    glm::vec4(0.1f, 0.0f, 0.0f, 1.0f),  // ambient
-    glm::vec4(0.6f, 0.6f, 0.6f, 1.0f),  // diffuse
-    glm::vec4(1.0f, 0.8f, 0.8f, 1.0f),  // specular
-    1.0f, 0.09f, 0.032f                  // attenuation
-);
-CLight* spotLight2 = new CLight(
-    glm::vec3(0.0f, 10.0f, -5.0f),        // position
-    glm::vec3(0.0f, 0.0f, -5.0f),        // target
-    12.5f, 17.5f, 2.0f,                 // inner/outer cutoff, exponent
-    glm::vec4(0.1f, 0.0f, 0.0f, 1.0f),  // ambient
-    glm::vec4(0.6f, 0.6f, 0.6f, 1.0f),  // diffuse
-    glm::vec4(1.0f, 0.8f, 0.8f, 1.0f),  // specular
-    1.0f, 0.09f, 0.032f                  // attenuation
-);
-CLight* spotLight3 = new CLight(
-    glm::vec3(4.0f, 10.0f, 0.0f),        // position
-    glm::vec3(4.0f, 0.0f, 4.0f),        // target
-    12.5f, 17.5f, 2.0f,                 // inner/outer cutoff, exponent
-    glm::vec4(0.1f, 0.0f, 0.0f, 1.0f),  // ambient
-    glm::vec4(0.6f, 0.6f, 0.6f, 1.0f),  // diffuse
-    glm::vec4(1.0f, 0.8f, 0.8f, 1.0f),  // specular
-    1.0f, 0.09f, 0.032f                  // attenuation
-);
+// scene.txt 中的光源，依名稱取得供鍵盤控制使用 (main 位置在 3.5,5.5,0，提供環境光)
+CLight* g_light = nullptr;
+CLight* pointLight1 = nullptr;
+CLight* spotLight1 = nullptr;
+CLight* spotLight2 = nullptr;
+CLight* spotLight3 = nullptr;
+std::vector<std::unique_ptr<CLight>> g_sceneLights;
+std::vector<CMaterial> g_sceneMaterials;
 
 
 std::vector<std::unique_ptr<Model>> models;
-std::vector<glm::mat4> modelMatrices;
-std::vector<std::string> modelPaths = {
-//    "models/woodCube.obj",
-    "models/Elephant_Toy.obj",
-    "models/Elephant_Toy.obj",
-    "models/House.obj",
-    "models/Truck.obj",
-    "models/Light.obj",
-    "models/Light.obj",
-    "models/Light.obj",
-//    "models/Light.obj",
-    "models/Rocket.obj",
-    "models/Bear.obj",
-    "models/Robot.obj",
-    "models/Teddy.obj",
-    
+float g_statTimer = 0.0f; // 繪製統計的輸出間隔
+CHotReload g_hotReload; // 修改 shader / 模型 / 貼圖後不需要重新啟動
+CRenderQueue g_renderQueue; // 3D 物件先送進佇列，排序後再一次繪製
+CStaticBatch g_staticBatch; // 不會移動的模型與物件合併成少數幾個 draw call
+CSceneFile g_scene; // scene.txt 編譯後的二進位檔，以 mmap 讀取
+std::vector<Model*> g_sceneModels; // 場景檔第 i 筆模型，載入失敗時為 nullptr
+std::vector<Model*> g_renderableModels; // 場景中的第 i 個 instance，模型載入失敗的 instance 不列入
+std::vector<uint32_t> g_renderableFlags; // SCENE_INSTANCE_*
+Model* g_truck = nullptr; // 依名稱取得，由遊戲邏輯驅動的模型
+Model* g_robot = nullptr;
+std::vector<int> g_sceneProxies; // 第 i 個 instance 在場景 BVH 中的 proxy，已合批的為 -1
+int g_tknotProxy = -1; // g_tknot 沒有合批時才登記在場景 BVH
+std::vector<glm::mat4> g_modelPlacements; // 本 frame 各 instance 的 model matrix
+std::vector<int> g_visibleProxies; // 視錐查詢的結果
+int g_culledCount = 0; // 上一個 frame 在視錐外的網格與物件數
+COcclusionCuller g_occlusion; // House 畫進 CPU 深度 buffer，擋住的物件不送出
+CShadowMaps g_shadows; // 三盞聚光燈的 shadow map，靜態物件只在改變時重畫
+std::vector<int> g_sceneNodes; // 場景檔第 i 個節點在 transform graph 中的節點
+std::vector<int> g_modelNodes; // 第 i 個 instance 在 transform graph 中的節點 (world matrix 即為 model matrix)
+std::vector<uint32_t> g_modelNodeVersions; // 上一次更新 BVH 邊界時的節點版本，沒有改變的模型略過
+int g_truckMotionNode = TRANSFORM_NULL_NODE; // Truck 的移動，接在擺放位置的節點下
+int g_robotFollowNode = TRANSFORM_NULL_NODE; // Robot 跟隨鏡頭的位置，縮放與旋轉在子節點
+glm::mat4 g_robotRestPlacement = glm::mat4(1.0f); // 不跟隨鏡頭時 robotFollow 的 local (場景檔中的位置)
+int g_tknotNode = TRANSFORM_NULL_NODE;
+uint32_t g_tknotNodeVersion = NODE_VERSION_NONE;
+// 場景檔中有 parent 的光源 (聚光燈接在燈具下)，燈具移動時光源的位置與照射的目標點跟著移動
+struct LightAttachment {
+    CLight*   light;
+    int       node;
+    glm::vec3 localTarget; // 燈具座標系中的目標點
+    uint32_t  version;
 };
+std::vector<LightAttachment> g_lightAttachments;
 void renderModel(const std::string& modelName, const glm::mat4& modelMatrix);
+glm::mat4 getModelPlacement(size_t i);
+void loadSceneModels();
+void loadSceneLights();
+void setupTransformGraph();
+void attachLight(CLight* light, int parentNode);
+void updateTransformGraph();
+void runTransformBenchmark();
+void setupOccluders();
+void setupShadowCasters();
 void adjustShaderEffects(float normalStrength, float specularStrength, float specularPower);
 
 //----------------------------------------------------------------------------
 void loadScene(void)
 {
+    // 先一次送出所有 shader 的編譯，driver 編譯的同時 CPU 載入模型與貼圖
+    CShaderPool::getInstance().precompile({
+        { "v_phong.glsl", "f_phong.glsl" },
+        { "v_depth.glsl", "f_depth.glsl" },
+        { "v_shadow.glsl", "f_depth.glsl" },
+        { "ui_vtxshader.glsl", "ui_fragshader.glsl" }
+    });
+
+    // 場景檔：scene.txt 比 scene.bin 新時先重新編譯，之後只以 mmap 讀取二進位檔
+    if (!g_scene.load("scene.txt", "scene.bin")) std::cerr << "loadScene: no scene loaded" << std::endl;
+    loadSceneModels();
+
+    // 模型材質用到的 f_phong 變體也先送出，第一次繪製時才確認結果
+    std::vector<unsigned int> featureMasks;
+    for (const auto& model : models) model->CollectShaderFeatures(featureMasks);
+    CShaderPool::getInstance().precompileVariants("v_phong.glsl", "f_phong.glsl", featureMasks);
+
     g_shadingProg = CShaderPool::getInstance().getShader("v_phong.glsl", "f_phong.glsl");
     g_uiShader = CShaderPool::getInstance().getShader("ui_vtxshader.glsl", "ui_fragshader.glsl");
+    // f_phong 的不透明物件先只畫深度，光照 shader 每個可見像素只執行一次 (Z 鍵切換)
+    g_renderQueue.setDepthPrepass(CShaderPool::getInstance().getShader("v_depth.glsl", "f_depth.glsl"), g_shadingProg);
+    g_renderQueue.setOverdrawCounterEnabled(true);
+    g_lightPosUniform.bind(g_shadingProg, "lightPos");
     
     adjustShaderEffects(3.0f, 4.0f, 2.0f);
     
-    lightManager.addLight(g_light);
-    lightManager.addLight(pointLight1);
-    lightManager.addLight(spotLight1);
-    lightManager.addLight(spotLight2);
-    lightManager.addLight(spotLight3);
+    loadSceneLights();
     
     lightManager.setShaderID(g_shadingProg);
+    g_renderQueue.setObjectLights(&lightManager, g_shadingProg);  // 每個 draw 只計算照得到它的光源
 //    g_light.setShaderID(g_shadingProg, "uLight");
     for (int i = 0; i < lightManager.getLightCount(); i++) {
         CLight* light = lightManager.getLight(i);
@@ -188,31 +212,40 @@ void loadScene(void)
     g_tknot.setShaderID(g_shadingProg, 3);
     g_tknot.setScale(glm::vec3(0.4f, 0.4f, 0.4f));
     g_tknot.setPos(glm::vec3(-2.0f, 0.5f, 2.0f));
+    int knotMaterial = g_scene.findMaterial("torusKnot");
+    if (knotMaterial != SCENE_NULL_INDEX) g_tknot.setMaterial(g_sceneMaterials[knotMaterial]);
+    setupTransformGraph(); // 合批與 BVH 都以節點的 world matrix 擺放模型
     
-    // 載入模型 - 只需要傳入模型路徑！
-    for (const auto& path : modelPaths) {
-        auto model = std::make_unique<Model>();
-        if (model->LoadModel(path)) {
-            models.push_back(std::move(model));
-            modelMatrices.push_back(glm::mat4(1.0f)); // 初始化為單位矩陣
-            std::cout << "Successfully loaded: " << path << std::endl;
-        } else {
-            std::cout << "Failed to load: " << path << std::endl;
-        }
+    // 場景檔中標記為 dynamic 的模型 (Truck 自動移動、Robot 跟隨鏡頭) 之外，所有 instance 與 g_tknot 合批成世界座標的大 buffer
+    // 沒有合批的 instance 與物件登記在場景 BVH，邊界於每個 frame 更新，視錐剔除與碰撞查詢共用
+    CSceneBVH& sceneBVH = CSceneBVH::getInstance();
+    g_sceneProxies.assign(g_renderableModels.size(), -1);
+    g_modelPlacements.assign(g_renderableModels.size(), glm::mat4(1.0f));
+    for (size_t i = 0; i < g_renderableModels.size(); ++i) {
+        if (!g_staticBatch.addModel(g_renderableModels[i], g_shadingProg, getModelPlacement(i)))
+            g_sceneProxies[i] = sceneBVH.insert(glm::vec3(0.0f), glm::vec3(0.0f), static_cast<int>(i), SCENE_RENDERABLE);
     }
+    g_staticBatch.addShape(&g_tknot);
+    g_staticBatch.bake();
+    if (!g_staticBatch.contains(&g_tknot))
+        g_tknotProxy = sceneBVH.insert(glm::vec3(0.0f), glm::vec3(0.0f), -1, SCENE_RENDERABLE);
+    g_occlusion.startWorkers();
+    setupOccluders();
+    
+    // 聚光燈的陰影：靜態物件畫一次後快取，Truck 與 Robot 每個 frame 疊在複本上
+    g_shadows.create(CShaderPool::getInstance().getShader("v_shadow.glsl", "f_depth.glsl"));
+    for (int i = 0; i < g_scene.getLightCount(); ++i) {
+        if (g_scene.getLight(i).flags & SCENE_LIGHT_SHADOW) g_shadows.addLight(g_sceneLights[i].get());
+    }
+    lightManager.setShadowMaps(&g_shadows);
+    setupShadowCasters();
+    
 //    models[10]->setFollowCamera(true, glm::vec3(2.0f, 0.5f, 5.0f));
 
 	CCamera::getInstance().updateView(g_eyeloc); // 設定 eye 位置
     CCamera::getInstance().updateCenter(glm::vec3(0,4,0));
 	CCamera::getInstance().updatePerspective(45.0f, (float)SCREEN_WIDTH / SCREEN_HEIGHT, 0.1f, 100.0f);
-    glm::mat4 mxView = CCamera::getInstance().getViewMatrix();
-	glm::mat4 mxProj = CCamera::getInstance().getProjectionMatrix();
-
-    GLint viewLoc = glGetUniformLocation(g_shadingProg, "mxView"); 	// 取得 view matrix 變數的位置
-    glUniformMatrix4fv(viewLoc, 1, GL_FALSE, glm::value_ptr(mxView));
-
-    GLint projLoc = glGetUniformLocation(g_shadingProg, "mxProj"); 	// 取得投影矩陣變數的位置
-    glUniformMatrix4fv(projLoc, 1, GL_FALSE, glm::value_ptr(mxProj));
+    // view/proj 由 render() 每個 frame 寫入 FrameBlock
     
     
     // 產生  UI 所需的相關資源
@@ -224,17 +257,210 @@ void loadScene(void)
     g_button[2].init(g_uiShader);
     g_button[3].setScreenPos(710.0f, 80.0f);
     g_button[3].init(g_uiShader);
-    g_2dviewLoc = glGetUniformLocation(g_uiShader, "mxView");     // 取得 view matrix 變數位置
+    g_2dviewLoc = CShaderPool::getInstance().getUniformLocation(g_uiShader, "mxView");     // 取得 view matrix 變數位置
     glUniformMatrix4fv(g_2dviewLoc, 1, GL_FALSE, glm::value_ptr(g_2dmxView));
 
-    g_2dProjLoc = glGetUniformLocation(g_uiShader, "mxProj");     // 取得 proj matrix 變數位置
+    g_2dProjLoc = CShaderPool::getInstance().getUniformLocation(g_uiShader, "mxProj");     // 取得 proj matrix 變數位置
     g_2dmxProj = glm::ortho(0.0f, (float)SCREEN_WIDTH, 0.0f, (float)SCREEN_HEIGHT, -1.0f, 1.0f);
     glUniformMatrix4fv(g_2dProjLoc, 1, GL_FALSE, glm::value_ptr(g_2dmxProj));
 
     glClearColor(0.0f, 0.0f, 0.0f, 1.0f); // 設定清除 back buffer 背景的顏色
-    glEnable(GL_DEPTH_TEST); // 啟動深度測試
+    CGLState::getInstance().enable(GL_DEPTH_TEST); // 啟動深度測試
     
     setupCameraFollowObject();
+    
+    // 熱重載：shader 重新 link 後，CShape / CSprite2D / Model 在下次繪製時自行重新解析 uniform 位置，
+    // 這裡只需要處理 Homework 自己快取的 handle
+    g_hotReload.watchShaders();
+    for (const auto& model : models) g_hotReload.watchModel(model.get());
+    g_hotReload.setShaderReloadedCallback([]() {
+        g_lightPosUniform.bind(g_shadingProg, "lightPos");
+    });
+    g_hotReload.setModelReloadedCallback([](Model* model) {
+        if (g_staticBatch.contains(model)) g_staticBatch.bake();
+        // 動態模型的 local 邊界可能改變，下一個 frame 重新寫入 BVH
+        for (size_t i = 0; i < g_renderableModels.size(); ++i) {
+            if (g_renderableModels[i] == model) g_modelNodeVersions[i] = NODE_VERSION_NONE;
+        }
+        for (size_t i = 0; i < g_renderableModels.size(); ++i) {
+            if (g_renderableModels[i] == model && (g_renderableFlags[i] & SCENE_INSTANCE_OCCLUDER)) { setupOccluders(); break; }
+        }
+        setupShadowCasters(); // VAO 重新建立，靜態 shadow map 也需要重畫
+    });
+    g_hotReload.start();
+}
+//----------------------------------------------------------------------------
+// 場景檔中的模型依序載入，只載入一次，同一個模型的多個 instance 共用
+void loadSceneModels()
+{
+    g_sceneModels.assign(g_scene.getModelCount(), nullptr);
+    for (int i = 0; i < g_scene.getModelCount(); ++i) {
+        const SceneModelRecord& record = g_scene.getModel(i);
+        const char* path = g_scene.getString(record.path);
+        auto model = std::make_unique<Model>();
+        if (model->LoadModel(path)) {
+            model->setDynamic((record.flags & SCENE_MODEL_DYNAMIC) != 0);
+            g_sceneModels[i] = model.get();
+            models.push_back(std::move(model));
+            std::cout << "Successfully loaded: " << path << std::endl;
+        } else {
+            std::cout << "Failed to load: " << path << std::endl;
+        }
+    }
+    int truck = g_scene.findModel("truck"), robot = g_scene.findModel("robot");
+    g_truck = (truck != SCENE_NULL_INDEX) ? g_sceneModels[truck] : nullptr;
+    g_robot = (robot != SCENE_NULL_INDEX) ? g_sceneModels[robot] : nullptr;
+}
+//----------------------------------------------------------------------------
+// 場景檔中的光源與材質，光源依宣告順序加入 (第一盞提供環境光)
+void loadSceneLights()
+{
+    g_sceneLights.clear();
+    for (int i = 0; i < g_scene.getLightCount(); ++i) {
+        const SceneLightRecord& r = g_scene.getLight(i);
+        glm::vec3 position = glm::make_vec3(r.position);
+        glm::vec4 ambient = glm::make_vec4(r.ambient), diffuse = glm::make_vec4(r.diffuse), specular = glm::make_vec4(r.specular);
+        if (r.type == SCENE_LIGHT_SPOT)
+            g_sceneLights.push_back(std::make_unique<CLight>(position, glm::make_vec3(r.target), r.cutoff[0], r.cutoff[1], r.cutoff[2],
+                                                             ambient, diffuse, specular, r.attenuation[0], r.attenuation[1], r.attenuation[2]));
+        else
+            g_sceneLights.push_back(std::make_unique<CLight>(position, ambient, diffuse, specular,
+                                                             r.attenuation[0], r.attenuation[1], r.attenuation[2]));
+        lightManager.addLight(g_sceneLights.back().get());
+    }
+    auto findLight = [](const char* name) {
+        int index = g_scene.findLight(name);
+        if (index == SCENE_NULL_INDEX) std::cerr << "loadSceneLights: scene has no light named " << name << std::endl;
+        return (index != SCENE_NULL_INDEX) ? g_sceneLights[index].get() : nullptr;
+    };
+    g_light = findLight("main");
+    pointLight1 = findLight("ceiling");
+    spotLight1 = findLight("spot1");
+    spotLight2 = findLight("spot2");
+    spotLight3 = findLight("spot3");
+
+    g_sceneMaterials.clear();
+    for (int i = 0; i < g_scene.getMaterialCount(); ++i) {
+        const SceneMaterialRecord& r = g_scene.getMaterial(i);
+        g_sceneMaterials.emplace_back(glm::make_vec4(r.ambient), glm::make_vec4(r.diffuse), glm::make_vec4(r.specular), r.shininess);
+    }
+}
+//----------------------------------------------------------------------------
+// 遮蔽物：場景檔中標記為 occluder 的 instance (House) 的網格，不會移動
+// 房間的牆不列入：鏡頭一直在房間內，牆後沒有需要剔除的物件
+void setupOccluders()
+{
+    g_occlusion.clearOccluders();
+    for (size_t i = 0; i < g_renderableModels.size(); ++i) {
+        if (!(g_renderableFlags[i] & SCENE_INSTANCE_OCCLUDER)) continue;
+        const Model* model = g_renderableModels[i];
+        glm::mat4 mxModel = getModelPlacement(i);
+        for (size_t m = 0; m < model->GetMeshCount(); ++m) {
+            const Mesh& mesh = model->GetMesh(m);
+            if (mesh.vertices.empty() || mesh.indices.empty()) continue;
+            g_occlusion.addOccluderMesh(mesh.vertices[0].position, static_cast<int>(mesh.vertices.size()), sizeof(Vertex) / sizeof(float),
+                                        mesh.indices.data(), static_cast<int>(mesh.indices.size()), mxModel);
+        }
+    }
+}
+//----------------------------------------------------------------------------
+// 不會移動的 instance 與 g_tknot 是靜態的陰影投射物，標記為 noshadow 的 (光源正下方的燈具) 不投射陰影
+void setupShadowCasters()
+{
+    g_shadows.clearStaticCasters();
+    for (size_t i = 0; i < g_renderableModels.size(); ++i) {
+        if (g_renderableModels[i]->isDynamic() || (g_renderableFlags[i] & SCENE_INSTANCE_NO_SHADOW)) continue;
+        glm::mat4 mxModel = getModelPlacement(i);
+        for (size_t m = 0; m < g_renderableModels[i]->GetMeshCount(); ++m)
+            g_shadows.addStaticCaster(g_renderableModels[i]->GetMeshPacket(m, g_shadingProg, mxModel));
+    }
+    if (g_staticBatch.contains(&g_tknot)) g_shadows.addStaticCaster(g_tknot.getDrawPacket());
+}
+//----------------------------------------------------------------------------
+// 依場景檔的順序走訪一次：每個節點在 transform graph 建立對應的節點 (parent 一定在前)，
+// 每個 instance 成為一個 renderable；Truck 的移動與 Robot 的跟隨寫入場景檔中具名的節點，
+// 每個 frame 只更新這兩個節點，其餘擺放位置不需要重算
+void setupTransformGraph()
+{
+    CTransformGraph& graph = CTransformGraph::getInstance();
+    graph.clear();
+    g_sceneNodes.assign(g_scene.getNodeCount(), TRANSFORM_NULL_NODE);
+    for (int i = 0; i < g_scene.getNodeCount(); ++i) {
+        const SceneNodeRecord& r = g_scene.getNode(i);
+        int node = graph.createNode(r.parent != SCENE_NULL_INDEX ? g_sceneNodes[r.parent] : TRANSFORM_NULL_NODE);
+        glm::quat rotation(r.rotation[3], r.rotation[0], r.rotation[1], r.rotation[2]);
+        graph.setLocal(node, glm::make_vec3(r.position), rotation, glm::make_vec3(r.scale));
+        g_sceneNodes[i] = node;
+    }
+
+    g_renderableModels.clear();
+    g_renderableFlags.clear();
+    g_modelNodes.clear();
+    for (int i = 0; i < g_scene.getInstanceCount(); ++i) {
+        const SceneInstanceRecord& r = g_scene.getInstance(i);
+        if (g_sceneModels[r.model] == nullptr) continue;
+        g_renderableModels.push_back(g_sceneModels[r.model]);
+        g_renderableFlags.push_back(r.flags);
+        g_modelNodes.push_back(g_sceneNodes[r.node]);
+    }
+    g_modelNodeVersions.assign(g_modelNodes.size(), NODE_VERSION_NONE); // 第一個 frame 一定寫入 BVH 邊界
+
+    int truckMotion = g_scene.findNode("truckMotion"), robotFollow = g_scene.findNode("robotFollow");
+    g_truckMotionNode = (g_truck && truckMotion != SCENE_NULL_INDEX) ? g_sceneNodes[truckMotion] : TRANSFORM_NULL_NODE;
+    g_robotFollowNode = (g_robot && robotFollow != SCENE_NULL_INDEX) ? g_sceneNodes[robotFollow] : TRANSFORM_NULL_NODE;
+    if (g_robotFollowNode != TRANSFORM_NULL_NODE) g_robotRestPlacement = graph.getLocalMatrix(g_robotFollowNode);
+    if (g_truck) g_truck->setAutoRotate();
+
+    g_lightAttachments.clear();
+    for (int i = 0; i < g_scene.getLightCount(); ++i) {
+        int parent = g_scene.getLight(i).parent;
+        if (parent != SCENE_NULL_INDEX) attachLight(g_sceneLights[i].get(), g_sceneNodes[parent]);
+    }
+    g_tknotNode = graph.createNode();
+    g_tknotNodeVersion = NODE_VERSION_NONE;
+    g_tknot.setTransformNode(g_tknotNode);
+    updateTransformGraph();
+}
+//----------------------------------------------------------------------------
+// 光源節點的 local 以目前的位置換算到燈具的座標系，接上時光源的位置與方向不變
+void attachLight(CLight* light, int parentNode)
+{
+    CTransformGraph& graph = CTransformGraph::getInstance();
+    glm::mat4 mxInverse = glm::inverse(graph.getWorldMatrix(parentNode));
+    LightAttachment attachment;
+    attachment.light = light;
+    attachment.node = graph.createNode(parentNode);
+    graph.setLocalMatrix(attachment.node, mxInverse * glm::translate(glm::mat4(1.0f), light->getPos()));
+    attachment.localTarget = glm::vec3(mxInverse * glm::vec4(light->getTarget(), 1.0f));
+    attachment.version = graph.getVersion(attachment.node);
+    g_lightAttachments.push_back(attachment);
+}
+//----------------------------------------------------------------------------
+// 每個 frame 在模型 update 之後呼叫：寫入運動節點的 local，只重算 dirty 的節點，
+// 接在燈具上的光源只有在節點改變時才更新 (光源因此標記為 dirty，LightBlock 與 shadow map 跟著更新)
+void updateTransformGraph()
+{
+    CTransformGraph& graph = CTransformGraph::getInstance();
+    if (g_truckMotionNode != TRANSFORM_NULL_NODE) graph.setLocalMatrix(g_truckMotionNode, g_truck->getModelMatrix());
+    if (g_robotFollowNode != TRANSFORM_NULL_NODE)
+        graph.setLocalMatrix(g_robotFollowNode, g_robot->isFollowingCamera() ? g_robot->getModelMatrix() : g_robotRestPlacement);
+    graph.update();
+
+    for (auto& attachment : g_lightAttachments) {
+        uint32_t version = graph.getVersion(attachment.node);
+        if (version == attachment.version) continue;
+        attachment.version = version;
+        const glm::mat4& mxWorld = graph.getWorldMatrix(attachment.node);
+        glm::mat4 mxParent = graph.getWorldMatrix(graph.getParent(attachment.node));
+        attachment.light->setTarget(glm::vec3(mxParent * glm::vec4(attachment.localTarget, 1.0f)));
+        attachment.light->setPos(glm::vec3(mxWorld[3]));
+    }
+}
+//----------------------------------------------------------------------------
+// 第 i 個 instance 在場景中的 model matrix (靜態合批與每個 frame 的動態模型共用)
+glm::mat4 getModelPlacement(size_t i)
+{
+    return CTransformGraph::getInstance().getWorldMatrix(g_modelNodes[i]);
 }
 //----------------------------------------------------------------------------
 
@@ -242,105 +468,94 @@ void render(void)
 {
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT); // 設定 back buffer 的背景顏色
     
-    glUseProgram(g_uiShader); // 使用 shader program
-    glUniformMatrix4fv(g_2dviewLoc, 1, GL_FALSE, glm::value_ptr(g_2dmxView));
-    glUniformMatrix4fv(g_2dProjLoc, 1, GL_FALSE, glm::value_ptr(g_2dmxProj));
+    g_hotReload.update(); // frame 之間套用修改過的 shader 與資源
+    
+    // 每個 frame 只上傳一次 view/proj/viewProj/鏡頭位置/時間，所有 program 共用
+    CCamera::getInstance().uploadFrameBlock((float)glfwGetTime());
+    CMaterialTable::getInstance().flush(); // 只上傳這個 frame 有變動的材質
+    CShaderPool::getInstance().finalizeReadyShaders(); // 背景編譯完成的變體，不會等待
+    
+    CGLState::getInstance().useProgram(g_uiShader); // 使用 shader program (2D 的 view/proj 於 loadScene 設定後不再改變)
     g_button[0].draw();
     g_button[1].draw();
     g_button[2].draw();
     g_button[3].draw();
     
-    glUseProgram(g_shadingProg);
+    CGLState::getInstance().useProgram(g_shadingProg);
+    
+    // 只重算這個 frame 移動過的節點 (Truck、Robot 與其子節點)，接在燈具上的光源在上傳前跟著更新
+    updateTransformGraph();
     
-    //上傳光源與相機位置
-    g_light->updateToShader();
-    glUniform3fv(glGetUniformLocation(g_shadingProg, "viewPos"), 1, glm::value_ptr(g_eyeloc));
-    glUniform3fv(glGetUniformLocation(g_shadingProg, "lightPos"), 1, glm::value_ptr(g_light->getPos()));
+    //上傳光源位置 (相機位置在 FrameBlock 中)
+    if (g_light) g_lightPosUniform.set(g_light->getPos());
 //    g_light.drawRaw();
-    lightManager.updateAllLightsToShader();
+    lightManager.updateAllLightsToShader(); // 只上傳有變動的光源到 LightBlock
+    lightManager.updateClusters(CCamera::getInstance().getViewMatrix(), CCamera::getInstance().getProjectionMatrix());
         
+    // 視錐剔除：靜態合批逐網格測試，動態模型與 g_tknot 更新場景 BVH 中的邊界後以視錐查詢
+    // 遮蔽剔除：先把遮蔽物畫進 CPU 深度 buffer，視錐內的物件再與 Hi-Z 比較
+    const CFrustum& frustum = CCamera::getInstance().getFrustum();
+    g_occlusion.render(CCamera::getInstance().getViewProjectionMatrix());
+    g_staticBatch.cull(frustum, &g_occlusion);
+    CSceneBVH& sceneBVH = CSceneBVH::getInstance();
+    glm::vec3 bmin, bmax;
+    int renderableCount = 0;
+    CTransformGraph& graph = CTransformGraph::getInstance();
+    for (size_t i = 0; i < g_renderableModels.size(); ++i) {
+        if (g_sceneProxies[i] < 0) continue;
+        renderableCount++;
+        // 節點沒有重算過時 model matrix 與邊界都不變
+        uint32_t version = graph.getVersion(g_modelNodes[i]);
+        if (version == g_modelNodeVersions[i]) continue;
+        g_modelNodeVersions[i] = version;
+        g_modelPlacements[i] = getModelPlacement(i);
+        g_renderableModels[i]->getLocalBounds(bmin, bmax);
+        CCuller::transformBounds(g_modelPlacements[i], bmin, bmax, bmin, bmax);
+        sceneBVH.update(g_sceneProxies[i], bmin, bmax); // 仍在 fat AABB 內時樹不需要修改
+    }
+    if (g_tknotProxy >= 0) {
+        g_tknot.getWorldBounds(bmin, bmax); // 同時把 g_tknot 的 TRS 寫入節點
+        if (graph.getVersion(g_tknotNode) != g_tknotNodeVersion) {
+            g_tknotNodeVersion = graph.getVersion(g_tknotNode);
+            sceneBVH.update(g_tknotProxy, bmin, bmax);
+        }
+        renderableCount++;
+    }
+    sceneBVH.queryFrustum(frustum, SCENE_RENDERABLE, g_visibleProxies);
+    g_culledCount = g_staticBatch.getCulledCount() + renderableCount - static_cast<int>(g_visibleProxies.size());
+    g_visibleProxies.erase(std::remove_if(g_visibleProxies.begin(), g_visibleProxies.end(), [&](int proxy) {
+        sceneBVH.getBounds(proxy, bmin, bmax);
+        return !g_occlusion.isVisible(bmin, bmax);
+    }), g_visibleProxies.end());
+
+    // 動態模型的陰影疊在快取的靜態 shadow map 上 (不在視錐內的模型也可能把影子投進畫面)
+    g_shadows.beginDynamicCasters();
+    for (size_t i = 0; i < g_renderableModels.size(); ++i) {
+        Model* model = g_renderableModels[i];
+        if (!model->isDynamic() || g_sceneProxies[i] < 0 || (g_renderableFlags[i] & SCENE_INSTANCE_NO_SHADOW)) continue;
+        for (size_t m = 0; m < model->GetMeshCount(); ++m)
+            g_shadows.addDynamicCaster(model->GetMeshPacket(m, g_shadingProg, g_modelPlacements[i]));
+    }
+    g_shadows.update();
+
+    // 3D 物件都送進繪製佇列，依 program / 材質 / VAO 排序後再繪製
+    g_renderQueue.begin(CCamera::getInstance().getViewLocation());
+
     // 繪製光源視覺表示
-    lightManager.draw();
-    
-    g_tknot.uploadMaterial();
-    g_tknot.drawRaw();
+    lightManager.submit(g_renderQueue);
     
-    g_centerloc.drawRaw();
+    g_centerloc.submit(g_renderQueue); // 沒有建立 VAO，佇列會直接略過
     
-    //繪製obj model
-    GLint modelLoc = glGetUniformLocation(g_shadingProg, "mxModel");
-    for (size_t i = 0; i < models.size(); ++i) {
-        glm::mat4 modelMatrix = modelMatrices[i];
-        if (i == 0) { // woodCube
-            modelMatrix = glm::translate(modelMatrix, glm::vec3(-2.0f, 2.3f, 0.0f));
-            modelMatrix = glm::scale(modelMatrix, glm::vec3(0.8f));
-        } else
-        if (i == 1) { // Elephant_Toy
-            modelMatrix = glm::translate(modelMatrix, glm::vec3(0.0f, 2.8f, 0.0f));
-            modelMatrix = glm::rotate(modelMatrix, glm::radians(45.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-            modelMatrix = glm::scale(modelMatrix, glm::vec3(2.5f));
-        } else if (i == 2) { // House
-            modelMatrix = glm::translate(modelMatrix, glm::vec3(0.0f, 1.5f, 0.0f));
-            modelMatrix = glm::scale(modelMatrix, glm::vec3(3.0f));
-        }else if (i == 3) { // Truck
-            modelMatrix = glm::translate(modelMatrix, glm::vec3(4.0f, 1.5f, -2.2f));
-            modelMatrix = glm::scale(modelMatrix, glm::vec3(0.1f));
-            modelMatrix = glm::rotate(modelMatrix, glm::radians(225.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-            modelMatrix = modelMatrix * models[i]->getModelMatrix();
-            models[3]->setAutoRotate();
-        }else if (i == 4) { // Spotlight1
-            modelMatrix = glm::translate(modelMatrix, glm::vec3(-4.0f, 8.0f, 4.0f));
-            modelMatrix = glm::scale(modelMatrix, glm::vec3(0.2f));
-            modelMatrix = glm::rotate(modelMatrix, glm::radians(180.0f), glm::vec3(1.0f, .0f, 0.0f));
-        }else if (i == 5) { // Spotlight2
-            modelMatrix = glm::translate(modelMatrix, glm::vec3(0.0f, 8.0f, -5.0f));
-            modelMatrix = glm::scale(modelMatrix, glm::vec3(0.2f));
-            modelMatrix = glm::rotate(modelMatrix, glm::radians(180.0f), glm::vec3(1.0f, 0.0f, 0.0f));
-        }else if (i == 6) { // Spotlight3
-            modelMatrix = glm::translate(modelMatrix, glm::vec3(4.0f, 8.0f, 4.0f));
-            modelMatrix = glm::scale(modelMatrix, glm::vec3(0.2f));
-            modelMatrix = glm::rotate(modelMatrix, glm::radians(180.0f), glm::vec3(1.0f, 0.0f, 0.0f));
-//        }else if (i == 8) { // g_light
-//            modelMatrix = glm::translate(modelMatrix, glm::vec3(3.5f, 5.5f, 0.0f));
-//            modelMatrix = glm::scale(modelMatrix, glm::vec3(0.2f));
-//            modelMatrix = glm::rotate(modelMatrix, glm::radians(180.0f), glm::vec3(1.0f, 0.0f, 0.0f));
-//            modelMatrix = modelMatrix * models[i]->getModelMatrix();
-//            models[8]->setFollowLight(g_light);
-            
-        }else if (i == 7) { // Rocket
-            modelMatrix = glm::translate(modelMatrix, glm::vec3(-0.5f, 1.5f, -5.0f));
-            modelMatrix = glm::scale(modelMatrix, glm::vec3(0.8f));
-            modelMatrix = glm::rotate(modelMatrix, glm::radians(30.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-        } else if (i == 8) { // Bear
-            modelMatrix = glm::translate(modelMatrix, glm::vec3(4.0f, 1.5f, 4.2f));
-            modelMatrix = glm::scale(modelMatrix, glm::vec3(0.3f));
-            modelMatrix = glm::rotate(modelMatrix, glm::radians(220.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-        } else if (i == 10) { // Teddy
-            modelMatrix = glm::translate(modelMatrix, glm::vec3(-4.0f, 2.15f, 4.0f));
-            modelMatrix = glm::scale(modelMatrix, glm::vec3(0.6f));
-            modelMatrix = glm::rotate(modelMatrix, glm::radians(60.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-        }
-        else if (i == 9 ){
-            if (models[9]->isFollowingCamera()) {
-                // 取得模型自己計算的矩陣，然後加上縮放
-                modelMatrix = models[9]->getModelMatrix();
-                modelMatrix = glm::scale(modelMatrix, glm::vec3(0.1f));
-                // 可以加上額外的旋轉
-                modelMatrix = glm::rotate(modelMatrix, glm::radians(270.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-            } else {
-//                // 如果不跟隨攝影機，使用原來的固定位置
-                modelMatrix = glm::translate(modelMatrix, glm::vec3(5.0f, 1.15f, 5.0f));
-                modelMatrix = glm::scale(modelMatrix, glm::vec3(0.1f));
-                modelMatrix = glm::rotate(modelMatrix, glm::radians(270.0f), glm::vec3(0.0f, 1.5f, 0.0f));
-            }
-        }
-        
-        
-        if (modelLoc != -1) {
-            glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(modelMatrix));
-        }
-        models[i]->Render(g_shadingProg);
+    //繪製obj model：靜態模型已在 loadScene 合批，這裡只送出動態模型
+    g_staticBatch.submit(g_renderQueue);
+    for (int proxy : g_visibleProxies) {
+        int i = sceneBVH.getUserData(proxy);
+        if (i < 0) g_tknot.submit(g_renderQueue); // 材質索引隨 DrawPacket 設定
+        else g_renderableModels[i]->Submit(g_renderQueue, g_shadingProg, g_modelPlacements[i]);
     }
+    g_renderQueue.execute();
+    
+    CGLState::getInstance().endFrame();
 }
 //----------------------------------------------------------------------------
 
@@ -348,24 +563,110 @@ void update(float dt)
 {
     std::cout << "Current g_eyeloc in update: ("<< g_eyeloc.x << ", " << g_eyeloc.y << ", " << g_eyeloc.z << ")" << std::endl;
     glm::mat4 mxView = CCamera::getInstance().getViewMatrix();
-    g_light->update(dt);
+    if (g_light) g_light->update(dt);
 //    models[8]->update(dt);
-    models[9]->setCameraPos(g_eyeloc);
-    models[9]->setViewMatrix(mxView);
-    models[3]->update(dt);
-    models[9]->update(dt);
+    if (g_truck) g_truck->update(dt);
+    if (g_robot) {
+        g_robot->setCameraPos(g_eyeloc);
+        g_robot->setViewMatrix(mxView);
+        g_robot->update(dt);
+    }
     
-    if (models[9]->isFollowingCamera()) {
-        glm::mat4 modelMatrix = models[10]->getModelMatrix();
+    if (g_robot && g_robot->isFollowingCamera()) {
+        glm::mat4 modelMatrix = g_robot->getModelMatrix();
         glm::vec3 modelPos = glm::vec3(modelMatrix[3]);
         std::cout << "Following object pos: (" << modelPos.x << ", " << modelPos.y << ", " << modelPos.z << ")" << std::endl;
     }
+    
+    // 每秒輸出一次上一個 frame 的繪製統計
+    g_statTimer += dt;
+    if (g_statTimer >= 1.0f) {
+        g_statTimer = 0.0f;
+        CGLState& gl = CGLState::getInstance();
+        std::cout << "[Frame stats] GL state calls issued: " << gl.getIssuedCalls()
+                  << ", skipped: " << gl.getSkippedCalls()
+                  << ", draw packets: " << g_renderQueue.getPacketCount()
+                  << ", culled: " << g_culledCount
+                  << ", occluded: " << g_occlusion.getOccludedCount() << "/" << g_occlusion.getTestedCount()
+                  << " (" << g_occlusion.getTriangleCount() << " occluder triangles, "
+                  << g_occlusion.getRasterMilliseconds() << " ms)"
+                  << ", depth pre-pass: " << (g_renderQueue.isDepthPrepassEnabled() ? "on" : "off")
+                  << " (" << g_renderQueue.getPrepassCount() << " packets)"
+                  << ", shaded samples: " << g_renderQueue.getShadedSamples()
+                  << " (overdraw " << g_renderQueue.getOverdraw() << "x)"
+                  << ", lights: " << lightManager.getLightCount()
+                  << " (clustered: " << (lightManager.isClusteringEnabled() ? "on" : "off")
+                  << ", max per cluster " << lightManager.getClusters().getMaxLightsPerCluster()
+                  << ", indices " << lightManager.getClusters().getLightIndices().size() << ")"
+                  << ", per-object lists: " << (g_renderQueue.isObjectLightsEnabled() ? "on" : "off")
+                  << " (" << g_renderQueue.getAverageObjectLights() << " lights/object over "
+                  << g_renderQueue.getObjectLightPacketCount() << " packets, "
+                  << g_renderQueue.getObjectLightFallbackCount() << " use clusters)"
+                  << ", shadow maps: " << g_shadows.getLightCount()
+                  << " (static redraws " << g_shadows.getStaticRenderCount()
+                  << ", dynamic overlays " << g_shadows.getDynamicOverlayCount()
+                  << " with " << g_shadows.getDynamicCasterCount() << " casters)"
+                  << ", transform nodes updated: " << CTransformGraph::getInstance().getUpdatedCount()
+                  << "/" << CTransformGraph::getInstance().getNodeCount() << std::endl;
+    }
+}
+
+//----------------------------------------------------------------------------
+// M 鍵：同樣數量的物件每個 frame 都改變位置、旋轉與縮放，比較兩種方式的耗時
+//   CShape：每個物件 setPos / setRotate / setScale 後 updateMatrix (三次 4x4 乘法與一次 uniform 上傳)
+//   CTransformStore：寫入 SoA 陣列後以 SIMD 一次組合，再一次寫入 instance buffer 並上傳
+void runTransformBenchmark()
+{
+    const int count = 4096, frames = 60;
+    std::vector<std::unique_ptr<CQuad>> shapes;
+    shapes.reserve(count);
+    CTransformStore store;
+    store.reserve(count);
+    CInstanceSet instances;
+    instances.reserve(count);
+    for (int i = 0; i < count; ++i) {
+        shapes.push_back(std::make_unique<CQuad>());
+        store.add(glm::vec3(0.0f));
+        instances.add(glm::mat4(1.0f));
+    }
+    CGLState::getInstance().useProgram(g_shadingProg);
+
+    auto start = std::chrono::steady_clock::now();
+    for (int f = 0; f < frames; ++f) {
+        for (int i = 0; i < count; ++i) {
+            float t = f * 0.1f + i;
+            shapes[i]->setPos(glm::vec3(i % 64, t * 0.01f, i / 64));
+            shapes[i]->setRotate(t, glm::vec3(0.0f, 1.0f, 0.0f));
+            shapes[i]->setScale(glm::vec3(1.0f + (i % 3) * 0.5f));
+            shapes[i]->updateMatrix();
+        }
+    }
+    auto mid = std::chrono::steady_clock::now();
+    for (int f = 0; f < frames; ++f) {
+        for (int i = 0; i < count; ++i) {
+            float t = f * 0.1f + i;
+            store.set(i, glm::vec3(i % 64, t * 0.01f, i / 64),
+                      glm::angleAxis(glm::radians(t), glm::vec3(0.0f, 1.0f, 0.0f)), glm::vec3(1.0f + (i % 3) * 0.5f));
+        }
+        store.update();
+        instances.setTransforms(0, store.size(), store.getWorldRows(0));
+        instances.upload();
+    }
+    auto end = std::chrono::steady_clock::now();
 
+    double shapeMs = std::chrono::duration<double, std::milli>(mid - start).count() / frames;
+    double storeMs = std::chrono::duration<double, std::milli>(end - mid).count() / frames;
+    std::cout << "[Transform benchmark] " << count << " objects, per frame: CShape::updateMatrix "
+              << shapeMs << " ms, CTransformStore " << storeMs << " ms ("
+              << (storeMs > 0.0 ? shapeMs / storeMs : 0.0) << "x)" << std::endl;
 }
+//----------------------------------------------------------------------------
 
 void releaseAll()
 {
 //    g_modelManager.cleanup();
+    g_hotReload.stop();
+    g_shadows.release();
     lightManager.clearLights();
 }
 
@@ -429,20 +730,12 @@ int main() {
 }
 
 void adjustShaderEffects(float normalStrength, float specularStrength, float specularPower) {
-    glUseProgram(g_shadingProg);
-    
-    GLint normalStrengthLoc = glGetUniformLocation(g_shadingProg, "uNormalStrength");
-    if (normalStrengthLoc != -1) {
-        glUniform1f(normalStrengthLoc, normalStrength);
-    }
-    
-    GLint specularStrengthLoc = glGetUniformLocation(g_shadingProg, "uSpecularStrength");
-    if (specularStrengthLoc != -1) {
-        glUniform1f(specularStrengthLoc, specularStrength);
-    }
-    
-    GLint specularPowerLoc = glGetUniformLocation(g_shadingProg, "uSpecularPower");
-    if (specularPowerLoc != -1) {
-        glUniform1f(specularPowerLoc, specularPower);
+    // 之後才建立的變體會從 g_shadingProg 複製這些值，已存在的變體需要逐一設定
+    for (GLuint prog : CShaderPool::getInstance().getVariants(g_shadingProg)) {
+        CGLState::getInstance().useProgram(prog);
+        CUniform<float>(prog, "uNormalStrength").set(normalStrength);
+        CUniform<float>(prog, "uSpecularStrength").set(specularStrength);
+        CUniform<float>(prog, "uSpecularPower").set(specularPower);
     }
+    CGLState::getInstance().useProgram(g_shadingProg);
 }
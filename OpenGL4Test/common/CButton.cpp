@@ -54,21 +54,19 @@ bool CButton::isMouseOver(float mx, float my) const {
 
 void CButton::draw()
 {
-    glUseProgram(_shaderProg);
-    glBindVertexArray(_vao);
+    CGLState::getInstance().useProgram(_shaderProg);
+    CGLState::getInstance().bindVertexArray(_vao);
     updateMatrix();
     glUniform1i(_coloringModeLoc, _coloringMode);
     if (_bObjColor) glUniform4fv(_colorLoc, 1, glm::value_ptr(_color));
     glDrawElements(GL_TRIANGLES, _idxCount, GL_UNSIGNED_INT, 0);
-    glBindVertexArray(0);
 }
 
 void CButton::drawRaw()
 {
-    glBindVertexArray(_vao);
+    CGLState::getInstance().bindVertexArray(_vao);
     updateMatrix();
     glUniform1i(_coloringModeLoc, _coloringMode);
     if (_bObjColor) glUniform4fv(_colorLoc, 1, glm::value_ptr(_color));
     glDrawElements(GL_TRIANGLES, _idxCount, GL_UNSIGNED_INT, 0);
-    glBindVertexArray(0);
 }
\ No newline at end of file
@@ -3,6 +3,7 @@
 #include <iostream>
 #include "typedefs.h"
 #include "CollisionManager.h"
+#include "CShaderPool.h"
 extern CollisionManager g_collisionManager;
 
 using namespace glm;
@@ -208,13 +209,34 @@ const glm::mat4& CCamera::getViewProjectionMatrix() const
 {
 	if ( _bviewUpdate || _bprojUpdate ) {
 		_mxViewProj = _mxProj * _mxView;
+		_frustum.extract(_mxViewProj);
 		_bviewUpdate = false;
 		_bprojUpdate = false;
 	}
 	return _mxViewProj;
 }
 
+const CFrustum& CCamera::getFrustum() const
+{
+	getViewProjectionMatrix();
+	return _frustum;
+}
+
 CCamera::Type CCamera::getProjectionType() const
 {
 	return _type;
 }
+
+void CCamera::uploadFrameBlock(float time)
+{
+	if ( !_frameUBO.isCreated() ) {
+		_frameUBO.create(sizeof(FrameBlockData), FRAME_BLOCK_BINDING);
+		CShaderPool::getInstance().bindUniformBlock("FrameBlock", FRAME_BLOCK_BINDING);
+	}
+	_frameData.mxView = _mxView;
+	_frameData.mxProj = _mxProj;
+	_frameData.mxViewProj = getViewProjectionMatrix();
+	_frameData.viewPos = _view;
+	_frameData.time = time;
+	_frameUBO.update(0, sizeof(FrameBlockData), &_frameData);
+}
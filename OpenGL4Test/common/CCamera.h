@@ -1,6 +1,17 @@
 #pragma once
 #include <glm/glm.hpp>
 #include <glm/gtc/quaternion.hpp>
+#include "CUniformBuffer.h"
+#include "CFrustum.h"
+
+// P shader  uniform block FrameBlock  std140 tm@P
+struct FrameBlockData {
+	glm::mat4 mxView;
+	glm::mat4 mxProj;
+	glm::mat4 mxViewProj;
+	glm::vec3 viewPos;	// Ym
+	float     time;		// {}lgL
+};
 
 class CCamera
 {
@@ -29,8 +40,14 @@ public:
 	const glm::mat4& getProjectionMatrix();
 	const glm::mat4& getViewMatrix();
 	const glm::mat4& getViewProjectionMatrix() const;
+	// view  projection ܫĤ@ήɤ~sX
+	const CFrustum& getFrustum() const;
 	CCamera::Type getProjectionType() const;
 
+	// C frame }lɩIs@AN view/proj/viewProj/eye/time gJ FrameBlockA
+	// Ҧŧi FrameBlock  program @ΡAƥ callback AӧOWǯx}
+	void uploadFrameBlock(float time);
+
 protected:
 	// Constructor & Destructor
 	CCamera();
@@ -47,6 +64,7 @@ protected:
 	mutable glm::mat4 _mxView;
 	mutable glm::mat4 _mxProj;
 	mutable glm::mat4 _mxViewProj;
+	mutable CFrustum  _frustum;		// P _mxViewProj Pɧs
 
 	CCamera::Type _type;
 	mutable bool _bviewUpdate;
@@ -61,4 +79,8 @@ protected:
 	float _theta;  // 
 	float _phi;    // 
 	float _radius; // eye P center Z
+
+	// C frame @α`
+	CUniformBuffer _frameUBO;
+	FrameBlockData _frameData;
 };
\ No newline at end of file
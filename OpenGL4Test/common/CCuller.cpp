@@ -0,0 +1,132 @@
+//  CCuller.cpp
+#include <cmath>
+#include "CCuller.h"
+
+#if defined(__SSE__) || defined(_M_X64)
+#include <xmmintrin.h>
+#define CULLER_USE_SSE
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#define CULLER_USE_NEON
+#endif
+
+int CCuller::add(const glm::vec3& bmin, const glm::vec3& bmax) {
+	int index = _count++;
+	// 補齊為 4 的倍數，SIMD 核心不需要處理尾端；補上的球半徑為 0、位於原點，結果不會被讀取
+	size_t padded = (static_cast<size_t>(_count) + 3) & ~static_cast<size_t>(3);
+	for (auto* v : { &_centerX, &_centerY, &_centerZ, &_radius, &_minX, &_minY, &_minZ, &_maxX, &_maxY, &_maxZ })
+		v->resize(padded, 0.0f);
+	_sphereState.resize(padded, SPHERE_INSIDE);
+	_visible.resize(_count, 1);
+	setBounds(index, bmin, bmax);
+	return index;
+}
+
+void CCuller::setBounds(int index, const glm::vec3& bmin, const glm::vec3& bmax) {
+	glm::vec3 center = (bmin + bmax) * 0.5f;
+	_centerX[index] = center.x; _centerY[index] = center.y; _centerZ[index] = center.z;
+	_radius[index] = glm::length(bmax - center);
+	_minX[index] = bmin.x; _minY[index] = bmin.y; _minZ[index] = bmin.z;
+	_maxX[index] = bmax.x; _maxY[index] = bmax.y; _maxZ[index] = bmax.z;
+}
+
+void CCuller::clear() {
+	_count = _culledCount = 0;
+	for (auto* v : { &_centerX, &_centerY, &_centerZ, &_radius, &_minX, &_minY, &_minZ, &_maxX, &_maxY, &_maxZ })
+		v->clear();
+	_sphereState.clear();
+	_visible.clear();
+}
+
+void CCuller::testSpheres(const CFrustum& frustum) {
+	const int padded = static_cast<int>(_radius.size());
+#if defined(CULLER_USE_SSE)
+	__m128 nx[CFrustum::PLANE_COUNT], ny[CFrustum::PLANE_COUNT], nz[CFrustum::PLANE_COUNT], nw[CFrustum::PLANE_COUNT];
+	for (int p = 0; p < CFrustum::PLANE_COUNT; p++) {
+		const glm::vec4& plane = frustum.getPlane(p);
+		nx[p] = _mm_set1_ps(plane.x); ny[p] = _mm_set1_ps(plane.y);
+		nz[p] = _mm_set1_ps(plane.z); nw[p] = _mm_set1_ps(plane.w);
+	}
+	const __m128 zero = _mm_setzero_ps();
+	for (int i = 0; i < padded; i += 4) {
+		__m128 x = _mm_loadu_ps(&_centerX[i]), y = _mm_loadu_ps(&_centerY[i]), z = _mm_loadu_ps(&_centerZ[i]);
+		__m128 r = _mm_loadu_ps(&_radius[i]);
+		__m128 negR = _mm_sub_ps(zero, r);
+		__m128 outside = zero, intersect = zero;
+		for (int p = 0; p < CFrustum::PLANE_COUNT; p++) {
+			__m128 d = _mm_add_ps(_mm_add_ps(_mm_mul_ps(nx[p], x), _mm_mul_ps(ny[p], y)),
+								  _mm_add_ps(_mm_mul_ps(nz[p], z), nw[p]));
+			outside = _mm_or_ps(outside, _mm_cmplt_ps(d, negR));
+			intersect = _mm_or_ps(intersect, _mm_cmplt_ps(d, r));
+		}
+		int outMask = _mm_movemask_ps(outside), intMask = _mm_movemask_ps(intersect);
+		for (int k = 0; k < 4; k++)
+			_sphereState[i + k] = (outMask >> k & 1) ? SPHERE_OUTSIDE : (intMask >> k & 1) ? SPHERE_INTERSECT : SPHERE_INSIDE;
+	}
+#elif defined(CULLER_USE_NEON)
+	for (int i = 0; i < padded; i += 4) {
+		float32x4_t x = vld1q_f32(&_centerX[i]), y = vld1q_f32(&_centerY[i]), z = vld1q_f32(&_centerZ[i]);
+		float32x4_t r = vld1q_f32(&_radius[i]);
+		float32x4_t negR = vnegq_f32(r);
+		uint32x4_t outside = vdupq_n_u32(0), intersect = vdupq_n_u32(0);
+		for (int p = 0; p < CFrustum::PLANE_COUNT; p++) {
+			const glm::vec4& plane = frustum.getPlane(p);
+			float32x4_t d = vdupq_n_f32(plane.w);
+			d = vmlaq_n_f32(d, x, plane.x);
+			d = vmlaq_n_f32(d, y, plane.y);
+			d = vmlaq_n_f32(d, z, plane.z);
+			outside = vorrq_u32(outside, vcltq_f32(d, negR));
+			intersect = vorrq_u32(intersect, vcltq_f32(d, r));
+		}
+		uint32_t outLane[4], intLane[4];
+		vst1q_u32(outLane, outside);
+		vst1q_u32(intLane, intersect);
+		for (int k = 0; k < 4; k++)
+			_sphereState[i + k] = outLane[k] ? SPHERE_OUTSIDE : intLane[k] ? SPHERE_INTERSECT : SPHERE_INSIDE;
+	}
+#else
+	for (int i = 0; i < padded; i++) {
+		uint8_t state = SPHERE_INSIDE;
+		for (int p = 0; p < CFrustum::PLANE_COUNT; p++) {
+			const glm::vec4& plane = frustum.getPlane(p);
+			float d = plane.x * _centerX[i] + plane.y * _centerY[i] + plane.z * _centerZ[i] + plane.w;
+			if (d < -_radius[i]) { state = SPHERE_OUTSIDE; break; }
+			if (d < _radius[i]) state = SPHERE_INTERSECT;
+		}
+		_sphereState[i] = state;
+	}
+#endif
+}
+
+bool CCuller::testAABB(const CFrustum& frustum, int index) const {
+	return frustum.testAABB(glm::vec3(_minX[index], _minY[index], _minZ[index]),
+							glm::vec3(_maxX[index], _maxY[index], _maxZ[index]));
+}
+
+bool CCuller::cull(const CFrustum& frustum) {
+	testSpheres(frustum);
+	bool changed = false;
+	_culledCount = 0;
+	for (int i = 0; i < _count; i++) {
+		uint8_t visible = 1;
+		if (_sphereState[i] == SPHERE_OUTSIDE) visible = 0;
+		else if (_sphereState[i] == SPHERE_INTERSECT) visible = testAABB(frustum, i) ? 1 : 0;
+		if (visible != _visible[i]) { _visible[i] = visible; changed = true; }
+		if (!visible) _culledCount++;
+	}
+	return changed;
+}
+
+void CCuller::transformBounds(const glm::mat4& mxModel, const glm::vec3& bmin, const glm::vec3& bmax,
+							  glm::vec3& outMin, glm::vec3& outMax) {
+	const glm::vec3 lo = bmin, hi = bmax;	// 允許 out 與輸入為同一個變數
+	outMin = outMax = glm::vec3(mxModel[3]);
+	for (int c = 0; c < 3; c++) {
+		for (int r = 0; r < 3; r++) {
+			float a = mxModel[c][r] * lo[c];
+			float b = mxModel[c][r] * hi[c];
+			outMin[r] += std::fmin(a, b);
+			outMax[r] += std::fmax(a, b);
+		}
+	}
+}
@@ -0,0 +1,45 @@
+//  CCuller.h
+//  視錐剔除：物件的世界座標邊界以 SoA 陣列存放 (球心 x/y/z、半徑、AABB 六個分量各一個陣列)，
+//  cull() 先以 SIMD 一次測試四個包圍球，完全在外的直接剔除、完全在內的直接保留，
+//  只有與平面相交的物件再以 AABB 細測；全部是 CPU 計算，不需要 GL context
+
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include "CFrustum.h"
+
+class CCuller {
+public:
+	// 回傳物件編號，之後以 setBounds / isVisible 存取
+	int add(const glm::vec3& bmin, const glm::vec3& bmax);
+	void setBounds(int index, const glm::vec3& bmin, const glm::vec3& bmax);
+	void clear();
+	int size() const { return _count; }
+
+	// 測試所有物件，回傳可見集合是否與上一次不同 (呼叫端可據此決定是否重建 draw 命令)
+	bool cull(const CFrustum& frustum);
+	bool isVisible(int index) const { return _visible[index] != 0; }
+	int getVisibleCount() const { return _count - _culledCount; }
+	int getCulledCount() const { return _culledCount; }
+
+	// 把區域座標的 AABB 轉成世界座標的 AABB (Arvo 的方法，不需要轉換八個頂點)
+	static void transformBounds(const glm::mat4& mxModel, const glm::vec3& bmin, const glm::vec3& bmax,
+								glm::vec3& outMin, glm::vec3& outMax);
+
+private:
+	// 包圍球的測試結果
+	enum : uint8_t { SPHERE_OUTSIDE = 0, SPHERE_INSIDE = 1, SPHERE_INTERSECT = 2 };
+
+	// SIMD 核心：一次處理四個球，陣列長度已補齊為 4 的倍數
+	void testSpheres(const CFrustum& frustum);
+	bool testAABB(const CFrustum& frustum, int index) const;
+
+	int _count = 0;
+	int _culledCount = 0;
+	std::vector<float> _centerX, _centerY, _centerZ, _radius;
+	std::vector<float> _minX, _minY, _minZ, _maxX, _maxY, _maxZ;
+	std::vector<uint8_t> _sphereState;
+	std::vector<uint8_t> _visible;
+};
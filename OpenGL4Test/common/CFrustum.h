@@ -0,0 +1,62 @@
+//  CFrustum.h
+//  由 view-projection 矩陣取出的六個平面 (Gribb-Hartmann)，法向量朝內且已正規化，
+//  平面方程式 dot(n, p) + w >= 0 代表 p 在平面內側；只用到 glm，不需要 GL context
+
+#pragma once
+
+#include <glm/glm.hpp>
+
+class CFrustum {
+public:
+	enum Plane { PLANE_LEFT = 0, PLANE_RIGHT, PLANE_BOTTOM, PLANE_TOP, PLANE_NEAR, PLANE_FAR, PLANE_COUNT };
+
+	void extract(const glm::mat4& mxViewProj) {
+		// glm 為 column-major，mxViewProj[c][r] 是第 r 列第 c 行
+		glm::vec4 row0(mxViewProj[0][0], mxViewProj[1][0], mxViewProj[2][0], mxViewProj[3][0]);
+		glm::vec4 row1(mxViewProj[0][1], mxViewProj[1][1], mxViewProj[2][1], mxViewProj[3][1]);
+		glm::vec4 row2(mxViewProj[0][2], mxViewProj[1][2], mxViewProj[2][2], mxViewProj[3][2]);
+		glm::vec4 row3(mxViewProj[0][3], mxViewProj[1][3], mxViewProj[2][3], mxViewProj[3][3]);
+		_planes[PLANE_LEFT]   = row3 + row0;
+		_planes[PLANE_RIGHT]  = row3 - row0;
+		_planes[PLANE_BOTTOM] = row3 + row1;
+		_planes[PLANE_TOP]    = row3 - row1;
+		_planes[PLANE_NEAR]   = row3 + row2;	// OpenGL 的 clip space z 範圍為 [-w, w]
+		_planes[PLANE_FAR]    = row3 - row2;
+		for (auto& plane : _planes) plane = plane * (1.0f / glm::length(glm::vec3(plane)));
+	}
+
+	const glm::vec4& getPlane(int i) const { return _planes[i]; }
+
+	// 單一物件的測試，大量物件請使用 CCuller
+	bool testSphere(const glm::vec3& center, float radius) const {
+		for (const auto& plane : _planes)
+			if (glm::dot(glm::vec3(plane), center) + plane.w < -radius) return false;
+		return true;
+	}
+	bool testAABB(const glm::vec3& bmin, const glm::vec3& bmax) const {
+		for (const auto& plane : _planes) {
+			// 只需檢查沿法向量最遠的頂點 (p-vertex)
+			glm::vec3 p(plane.x >= 0.0f ? bmax.x : bmin.x,
+						plane.y >= 0.0f ? bmax.y : bmin.y,
+						plane.z >= 0.0f ? bmax.z : bmin.z);
+			if (glm::dot(glm::vec3(plane), p) + plane.w < 0.0f) return false;
+		}
+		return true;
+	}
+	// 階層式剔除使用：完全在內的節點不需要再測試子節點
+	enum Result { OUTSIDE = 0, INSIDE, INTERSECT };
+	Result classifyAABB(const glm::vec3& bmin, const glm::vec3& bmax) const {
+		Result result = INSIDE;
+		for (const auto& plane : _planes) {
+			glm::vec3 n(plane);
+			glm::vec3 p(n.x >= 0.0f ? bmax.x : bmin.x, n.y >= 0.0f ? bmax.y : bmin.y, n.z >= 0.0f ? bmax.z : bmin.z);
+			glm::vec3 q(n.x >= 0.0f ? bmin.x : bmax.x, n.y >= 0.0f ? bmin.y : bmax.y, n.z >= 0.0f ? bmin.z : bmax.z);
+			if (glm::dot(n, p) + plane.w < 0.0f) return OUTSIDE;
+			if (glm::dot(n, q) + plane.w < 0.0f) result = INTERSECT;
+		}
+		return result;
+	}
+
+private:
+	glm::vec4 _planes[PLANE_COUNT];
+};
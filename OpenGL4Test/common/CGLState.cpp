@@ -0,0 +1,146 @@
+//  CGLState.cpp
+#include "CGLState.h"
+
+CGLState& CGLState::getInstance() {
+    static CGLState instance;
+    return instance;
+}
+
+CGLState::CGLState() : _vaoDeleteCount(0), _issued(0), _skipped(0), _lastIssued(0), _lastSkipped(0) {
+    invalidate();
+}
+
+void CGLState::invalidate() {
+    // 與 context 建立時的 GL 預設值一致
+    _program = 0;
+    _vao = 0;
+    _activeUnit = 0;
+    for (int i = 0; i < GLSTATE_MAX_TEXTURE_UNITS; i++) {
+        _textures[i] = 0;
+        _textureTargets[i] = GL_TEXTURE_2D;
+    }
+    _caps[0] = _caps[1] = _caps[2] = -1;
+    _blendSrc = GL_ONE;
+    _blendDst = GL_ZERO;
+    _depthMask = GL_TRUE;
+    _depthFunc = GL_LESS;
+    _colorMask = GL_TRUE;
+    _cullFace = GL_BACK;
+}
+
+void CGLState::useProgram(GLuint program) {
+    if (program == _program) { _skipped++; return; }
+    glUseProgram(program);
+    _program = program;
+    _issued++;
+}
+
+void CGLState::bindVertexArray(GLuint vao) {
+    if (vao == _vao) { _skipped++; return; }
+    glBindVertexArray(vao);
+    _vao = vao;
+    _issued++;
+}
+
+void CGLState::bindTexture(GLuint unit, GLenum target, GLuint texture) {
+    if (unit >= GLSTATE_MAX_TEXTURE_UNITS) {
+        glActiveTexture(GL_TEXTURE0 + unit);
+        glBindTexture(target, texture);
+        _activeUnit = unit;
+        _issued += 2;
+        return;
+    }
+    if (_textures[unit] == texture && _textureTargets[unit] == target) { _skipped++; return; }
+    if (_activeUnit != unit) {
+        glActiveTexture(GL_TEXTURE0 + unit);
+        _activeUnit = unit;
+        _issued++;
+    }
+    glBindTexture(target, texture);
+    _textures[unit] = texture;
+    _textureTargets[unit] = target;
+    _issued++;
+}
+
+void CGLState::deleteVertexArray(GLuint vao) {
+    if (vao == 0) return;
+    glDeleteVertexArrays(1, &vao);
+    if (_vao == vao) _vao = 0;
+    _vaoDeleteCount++;
+}
+
+void CGLState::deleteTexture(GLuint texture) {
+    if (texture == 0) return;
+    glDeleteTextures(1, &texture);
+    for (int i = 0; i < GLSTATE_MAX_TEXTURE_UNITS; i++) {
+        if (_textures[i] == texture) _textures[i] = 0;
+    }
+}
+
+void CGLState::deleteProgram(GLuint program) {
+    if (program == 0) return;
+    glDeleteProgram(program);
+    if (_program == program) _program = 0;
+}
+
+int CGLState::capIndex(GLenum cap) const {
+    switch (cap) {
+        case GL_BLEND:      return 0;
+        case GL_DEPTH_TEST: return 1;
+        case GL_CULL_FACE:  return 2;
+        default:            return -1;
+    }
+}
+
+void CGLState::setCap(GLenum cap, bool on) {
+    int index = capIndex(cap);
+    if (index >= 0 && _caps[index] == (on ? 1 : 0)) { _skipped++; return; }
+    if (on) glEnable(cap); else glDisable(cap);
+    if (index >= 0) _caps[index] = on ? 1 : 0;
+    _issued++;
+}
+
+void CGLState::enable(GLenum cap) { setCap(cap, true); }
+void CGLState::disable(GLenum cap) { setCap(cap, false); }
+
+void CGLState::blendFunc(GLenum src, GLenum dst) {
+    if (src == _blendSrc && dst == _blendDst) { _skipped++; return; }
+    glBlendFunc(src, dst);
+    _blendSrc = src;
+    _blendDst = dst;
+    _issued++;
+}
+
+void CGLState::depthMask(GLboolean flag) {
+    if (flag == _depthMask) { _skipped++; return; }
+    glDepthMask(flag);
+    _depthMask = flag;
+    _issued++;
+}
+
+void CGLState::depthFunc(GLenum func) {
+    if (func == _depthFunc) { _skipped++; return; }
+    glDepthFunc(func);
+    _depthFunc = func;
+    _issued++;
+}
+
+void CGLState::colorMask(GLboolean flag) {
+    if (flag == _colorMask) { _skipped++; return; }
+    glColorMask(flag, flag, flag, flag);
+    _colorMask = flag;
+    _issued++;
+}
+
+void CGLState::cullFace(GLenum mode) {
+    if (mode == _cullFace) { _skipped++; return; }
+    glCullFace(mode);
+    _cullFace = mode;
+    _issued++;
+}
+
+void CGLState::endFrame() {
+    _lastIssued = _issued;
+    _lastSkipped = _skipped;
+    _issued = _skipped = 0;
+}
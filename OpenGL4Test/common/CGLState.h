@@ -0,0 +1,73 @@
+//  CGLState.h
+//  GL 狀態快取：記錄目前的 program、VAO、各貼圖單元的綁定與 blend/depth/cull 狀態，
+//  設定值與目前相同時不呼叫 driver。所有繪製路徑都必須經由這裡設定這些狀態，
+//  直接呼叫 gl* 修改時要呼叫 invalidate() 讓快取重新同步
+
+#pragma once
+
+#include <GL/glew.h>
+
+#define GLSTATE_MAX_TEXTURE_UNITS 16
+
+class CGLState {
+public:
+    static CGLState& getInstance();
+
+    void useProgram(GLuint program);
+    void bindVertexArray(GLuint vao);
+    // 需要時才切換 glActiveTexture
+    void bindTexture(GLuint unit, GLenum target, GLuint texture);
+
+    // 只追蹤 GL_BLEND、GL_DEPTH_TEST、GL_CULL_FACE，其他 cap 直接轉給 driver
+    void enable(GLenum cap);
+    void disable(GLenum cap);
+    void blendFunc(GLenum src, GLenum dst);
+    void depthMask(GLboolean flag);
+    void depthFunc(GLenum func);
+    // 四個色彩通道一起開關 (深度預先繪製時關閉)
+    void colorMask(GLboolean flag);
+    void cullFace(GLenum mode);
+
+    // 刪除物件並清除快取中的綁定，避免之後重複使用同一個名稱時被誤判為已綁定
+    void deleteVertexArray(GLuint vao);
+    void deleteTexture(GLuint texture);
+    void deleteProgram(GLuint program);
+
+    GLuint getProgram() const { return _program; }
+    GLuint getVertexArray() const { return _vao; }
+    // 每次 deleteVertexArray 加一，快取 VAO 名稱的地方用來判斷是否需要重新設定
+    int getVertexArrayDeleteCount() const { return _vaoDeleteCount; }
+
+    // 以 GL 預設值重設快取 (下一次設定一定會送出)
+    void invalidate();
+
+    // 每個 frame 結束時呼叫，保存本 frame 的統計並歸零
+    void endFrame();
+    int getIssuedCalls() const { return _lastIssued; }
+    int getSkippedCalls() const { return _lastSkipped; }
+
+private:
+    CGLState();
+    ~CGLState() = default;
+    CGLState(const CGLState&) = delete;
+    CGLState& operator=(const CGLState&) = delete;
+
+    int  capIndex(GLenum cap) const;
+    void setCap(GLenum cap, bool on);
+
+    GLuint _program;
+    GLuint _vao;
+    GLuint _activeUnit;
+    GLuint _textures[GLSTATE_MAX_TEXTURE_UNITS];
+    GLenum _textureTargets[GLSTATE_MAX_TEXTURE_UNITS];
+    signed char _caps[3];   // -1 未知，0 關閉，1 開啟
+    GLenum _blendSrc, _blendDst;
+    GLboolean _depthMask;
+    GLenum _depthFunc;
+    GLboolean _colorMask;
+    GLenum _cullFace;
+
+    int _vaoDeleteCount;
+    int _issued, _skipped;
+    int _lastIssued, _lastSkipped;
+};
@@ -0,0 +1,192 @@
+//  CHotReload.cpp
+#include "CHotReload.h"
+#include "CShaderPool.h"
+#include <iostream>
+#include <chrono>
+#include <algorithm>
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <poll.h>
+#include <unistd.h>
+#endif
+
+CFileWatcher::CFileWatcher() : _running(false) {
+#ifdef __linux__
+    _inotifyFd = inotify_init1(IN_NONBLOCK);
+    if (_inotifyFd < 0) std::cerr << "CFileWatcher: inotify_init1 failed" << std::endl;
+#endif
+}
+
+CFileWatcher::~CFileWatcher() {
+    stop();
+#ifdef __linux__
+    if (_inotifyFd >= 0) close(_inotifyFd);
+#endif
+}
+
+void CFileWatcher::watch(const std::string& path) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (!_files.insert(path).second) return;
+
+#ifdef __linux__
+    // inotify 監看的是目錄，事件中的檔名加上前綴後與登錄的路徑比對
+    size_t slash = path.find_last_of('/');
+    std::string dir = (slash == std::string::npos) ? "." : path.substr(0, slash);
+    std::string prefix = (slash == std::string::npos) ? "" : path.substr(0, slash + 1);
+    if (_inotifyFd < 0) return;
+    int wd = inotify_add_watch(_inotifyFd, dir.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+    if (wd < 0) {
+        std::cerr << "CFileWatcher: cannot watch " << dir << std::endl;
+        return;
+    }
+    _dirPrefix[wd] = prefix;
+#else
+    std::error_code ec;
+    _mtimes[path] = std::filesystem::last_write_time(path, ec);
+#endif
+}
+
+void CFileWatcher::start() {
+    if (_running) return;
+    _running = true;
+    _thread = std::thread(&CFileWatcher::run, this);
+}
+
+void CFileWatcher::stop() {
+    _running = false;
+    if (_thread.joinable()) _thread.join();
+}
+
+std::vector<std::string> CFileWatcher::takeChanges() {
+    std::lock_guard<std::mutex> lock(_mutex);
+    std::vector<std::string> changes(_changed.begin(), _changed.end());
+    _changed.clear();
+    return changes;
+}
+
+void CFileWatcher::run() {
+    while (_running) {
+#ifdef __linux__
+        pollfd pfd = { _inotifyFd, POLLIN, 0 };
+        if (_inotifyFd < 0 || poll(&pfd, 1, 250) <= 0) continue;
+
+        alignas(inotify_event) char buffer[4096];
+        ssize_t length;
+        while ((length = read(_inotifyFd, buffer, sizeof(buffer))) > 0) {
+            std::lock_guard<std::mutex> lock(_mutex);
+            for (char* p = buffer; p < buffer + length; ) {
+                const inotify_event* event = reinterpret_cast<const inotify_event*>(p);
+                if (event->len > 0) {
+                    auto dir = _dirPrefix.find(event->wd);
+                    if (dir != _dirPrefix.end()) {
+                        std::string path = dir->second + event->name;
+                        if (_files.count(path)) _changed.insert(path);
+                    }
+                }
+                p += sizeof(inotify_event) + event->len;
+            }
+        }
+#else
+        std::this_thread::sleep_for(std::chrono::milliseconds(250));
+        std::lock_guard<std::mutex> lock(_mutex);
+        for (auto& file : _mtimes) {
+            std::error_code ec;
+            auto mtime = std::filesystem::last_write_time(file.first, ec);
+            if (!ec && mtime != file.second) {
+                file.second = mtime;
+                _changed.insert(file.first);
+            }
+        }
+#endif
+    }
+}
+
+CHotReload::~CHotReload() {
+    stop();
+}
+
+void CHotReload::watchShaders() {
+    for (const auto& file : CShaderPool::getInstance().getShaderFiles()) _watcher.watch(file);
+}
+
+void CHotReload::watchModel(Model* model) {
+    if (std::find(_models.begin(), _models.end(), model) == _models.end()) _models.push_back(model);
+
+    const std::string& source = model->GetSourcePath();
+    _watcher.watch(source);
+    size_t dot = source.find_last_of('.');
+    if (dot != std::string::npos) _watcher.watch(source.substr(0, dot) + ".mtl");
+    for (const auto& path : model->GetTexturePaths()) _watcher.watch(path);
+}
+
+void CHotReload::stop() {
+    _watcher.stop();
+    // 等待背景工作結束，避免程式結束時還在解碼
+    for (auto& job : _textureJobs) {
+        DecodedImage image = job.result.get();
+        Model::FreeImage(image);
+    }
+    for (auto& job : _modelJobs) job.result.wait();
+    _textureJobs.clear();
+    _modelJobs.clear();
+}
+
+void CHotReload::update() {
+    // 1. 依變動的檔案分派工作：shader 直接重新 link (需要 GL context)，解析與解碼交給背景執行緒
+    bool shaderReloaded = false;
+    for (const auto& path : _watcher.takeChanges()) {
+        std::cout << "Hot reload: " << path << " changed" << std::endl;
+
+        if (CShaderPool::getInstance().reloadShaderFile(path) > 0) {
+            shaderReloaded = true;
+            continue;
+        }
+
+        bool isTexture = false;
+        for (Model* model : _models) {
+            if (model->IsSourceFile(path)) {
+                std::string source = model->GetSourcePath();
+                _modelJobs.push_back({ model, std::async(std::launch::async, [source]() {
+                    ObjData data;
+                    if (!Model::ParseObj(source, data)) data.filepath.clear();
+                    return data;
+                }) });
+            }
+            else if (!isTexture) {
+                const auto paths = model->GetTexturePaths();
+                isTexture = std::find(paths.begin(), paths.end(), path) != paths.end();
+            }
+        }
+        if (isTexture) {
+            _textureJobs.push_back({ path, std::async(std::launch::async, [path]() {
+                DecodedImage image;
+                Model::DecodeImage(path, image);
+                return image;
+            }) });
+        }
+    }
+    if (shaderReloaded && _onShaderReloaded) _onShaderReloaded();
+
+    // 2. 套用已完成的背景工作，這時沒有任何 draw call 在使用這些 GL 物件
+    for (auto it = _textureJobs.begin(); it != _textureJobs.end(); ) {
+        if (!isReady(it->result)) { ++it; continue; }
+        DecodedImage image = it->result.get();
+        if (image.data != nullptr) {
+            for (Model* model : _models) model->ReloadTexture(it->path, image);
+        }
+        Model::FreeImage(image);
+        it = _textureJobs.erase(it);
+    }
+    for (auto it = _modelJobs.begin(); it != _modelJobs.end(); ) {
+        if (!isReady(it->result)) { ++it; continue; }
+        ObjData data = it->result.get();
+        if (!data.filepath.empty() && it->model->Reimport(data)) {
+            watchModel(it->model);   // 新增的貼圖也納入監看
+            if (_onModelReloaded) _onModelReloaded(it->model);
+        } else {
+            std::cerr << "Hot reload: keeping the previous version of " << it->model->GetSourcePath() << std::endl;
+        }
+        it = _modelJobs.erase(it);
+    }
+}
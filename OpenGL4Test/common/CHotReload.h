@@ -0,0 +1,91 @@
+//  CHotReload.h
+//  開發用的熱重載：背景執行緒監看 shader、OBJ/MTL 與貼圖檔案，
+//  修改後只重新編譯或重新載入該檔案，結果在 frame 之間一次套用
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <set>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <future>
+#include <functional>
+#include <filesystem>
+#include "Model.h"
+
+// 監看一組檔案，Linux 使用 inotify，其他平台每 250ms 比對修改時間
+class CFileWatcher {
+public:
+    CFileWatcher();
+    ~CFileWatcher();
+
+    // 可以在 start 前後加入，重複加入同一個檔案不會有影響
+    void watch(const std::string& path);
+    void start();
+    void stop();
+
+    // 取出上次呼叫之後有變動的檔案 (同一檔案只回報一次)
+    std::vector<std::string> takeChanges();
+
+private:
+    CFileWatcher(const CFileWatcher&) = delete;
+    CFileWatcher& operator=(const CFileWatcher&) = delete;
+
+    void run();
+
+    std::thread _thread;
+    std::atomic<bool> _running;
+    std::mutex _mutex;                  // 保護以下成員
+    std::set<std::string> _files;
+    std::set<std::string> _changed;
+#ifdef __linux__
+    int _inotifyFd;
+    std::map<int, std::string> _dirPrefix;   // watch descriptor -> 路徑前綴 ("" 代表目前目錄)
+#else
+    std::map<std::string, std::filesystem::file_time_type> _mtimes;
+#endif
+};
+
+class CHotReload {
+public:
+    CHotReload() = default;
+    ~CHotReload();
+
+    // 監看 CShaderPool 中所有 program 使用的 shader 檔
+    void watchShaders();
+    // 監看模型的 OBJ/MTL 與所有貼圖
+    void watchModel(Model* model);
+    // shader 重新 link 後呼叫，讓場景物件重新解析自己快取的 uniform 位置
+    void setShaderReloadedCallback(std::function<void()> callback) { _onShaderReloaded = callback; }
+    // 模型重新匯入後呼叫，讓使用模型頂點資料的地方 (例如 CStaticBatch) 重新建立
+    void setModelReloadedCallback(std::function<void(Model*)> callback) { _onModelReloaded = callback; }
+
+    void start() { _watcher.start(); }
+    void stop();
+
+    // 每個 frame 開始時呼叫：依變動的檔案送出背景工作，並把完成的結果套用到 GL 物件
+    void update();
+
+private:
+    struct TextureJob {
+        std::string path;
+        std::future<DecodedImage> result;
+    };
+    struct ModelJob {
+        Model* model;
+        std::future<ObjData> result;
+    };
+
+    static bool isReady(const std::future<DecodedImage>& f) { return f.wait_for(std::chrono::seconds(0)) == std::future_status::ready; }
+    static bool isReady(const std::future<ObjData>& f) { return f.wait_for(std::chrono::seconds(0)) == std::future_status::ready; }
+
+    CFileWatcher _watcher;
+    std::vector<Model*> _models;
+    std::vector<TextureJob> _textureJobs;
+    std::vector<ModelJob> _modelJobs;
+    std::function<void()> _onShaderReloaded;
+    std::function<void(Model*)> _onModelReloaded;
+};
@@ -0,0 +1,147 @@
+//  CInstanceSet.cpp
+#include <cstddef>
+#include <algorithm>
+#include "CInstanceSet.h"
+#include "CGLState.h"
+#include "typedefs.h"
+
+CInstanceSet::CInstanceSet()
+    : _attachedDeleteCount(0), _vbo(0), _capacity(0), _uploadedBytes(0) {}
+
+CInstanceSet::~CInstanceSet() {
+    if (_vbo != 0) glDeleteBuffers(1, &_vbo);
+}
+
+int CInstanceSet::add(const glm::mat4& mxModel, const glm::vec4& color, GLint materialIndex) {
+    InstanceData data;
+    data.mxModel = mxModel;
+    data.color = color;
+    data.materialIndex = materialIndex;
+    _instances.push_back(data);
+    int index = size() - 1;
+    markDirty(index, index + 1);
+    return index;
+}
+
+void CInstanceSet::setTransform(int index, const glm::mat4& mxModel) {
+    _instances[index].mxModel = mxModel;
+    markDirty(index, index + 1);
+}
+
+void CInstanceSet::setTransforms(int first, int count, const glm::vec4* rows) {
+    if (count <= 0) return;
+    for (int i = 0; i < count; i++, rows += 3) {
+        glm::mat4& m = _instances[first + i].mxModel;
+        m[0] = glm::vec4(rows[0].x, rows[1].x, rows[2].x, 0.0f);
+        m[1] = glm::vec4(rows[0].y, rows[1].y, rows[2].y, 0.0f);
+        m[2] = glm::vec4(rows[0].z, rows[1].z, rows[2].z, 0.0f);
+        m[3] = glm::vec4(rows[0].w, rows[1].w, rows[2].w, 1.0f);
+    }
+    markDirty(first, first + count);
+}
+
+void CInstanceSet::setColor(int index, const glm::vec4& color) {
+    _instances[index].color = color;
+    markDirty(index, index + 1);
+}
+
+void CInstanceSet::setMaterial(int index, GLint materialIndex) {
+    _instances[index].materialIndex = materialIndex;
+    markDirty(index, index + 1);
+}
+
+void CInstanceSet::remove(int index) {
+    int last = size() - 1;
+    if (index != last) {
+        _instances[index] = _instances[last];
+        markDirty(index, index + 1);
+    }
+    _instances.pop_back();
+}
+
+void CInstanceSet::clear() {
+    _instances.clear();
+    _dirtyRanges.clear();
+}
+
+void CInstanceSet::reserve(int count) {
+    _instances.reserve(count);
+}
+
+void CInstanceSet::markDirty(int begin, int end) {
+    // 連續修改 (例如依序 add 或每個 frame 更新全部) 直接延伸最後一段
+    if (!_dirtyRanges.empty()) {
+        std::pair<int, int>& last = _dirtyRanges.back();
+        if (begin <= last.second && end >= last.first) {
+            last.first = std::min(last.first, begin);
+            last.second = std::max(last.second, end);
+            return;
+        }
+    }
+    _dirtyRanges.push_back({ begin, end });
+}
+
+void CInstanceSet::attach(GLuint vao) {
+    if (vao == 0) return;
+    int deleteCount = CGLState::getInstance().getVertexArrayDeleteCount();
+    if (deleteCount != _attachedDeleteCount) {
+        _attachedVaos.clear();
+        _attachedDeleteCount = deleteCount;
+    }
+    if (std::find(_attachedVaos.begin(), _attachedVaos.end(), vao) != _attachedVaos.end()) return;
+
+    if (_vbo == 0) glGenBuffers(1, &_vbo);
+    CGLState& gl = CGLState::getInstance();
+    GLuint previous = gl.getVertexArray();
+    gl.bindVertexArray(vao);
+    glBindBuffer(GL_ARRAY_BUFFER, _vbo);
+    for (int c = 0; c < 4; c++) {
+        glVertexAttribPointer(INSTANCE_MODEL_LOCATION + c, 4, GL_FLOAT, GL_FALSE, sizeof(InstanceData),
+                              BUFFER_OFFSET(offsetof(InstanceData, mxModel) + c * sizeof(glm::vec4)));
+        glEnableVertexAttribArray(INSTANCE_MODEL_LOCATION + c);
+        glVertexAttribDivisor(INSTANCE_MODEL_LOCATION + c, 1);
+    }
+    glVertexAttribIPointer(INSTANCE_MATERIAL_LOCATION, 1, GL_INT, sizeof(InstanceData), BUFFER_OFFSET(offsetof(InstanceData, materialIndex)));
+    glEnableVertexAttribArray(INSTANCE_MATERIAL_LOCATION);
+    glVertexAttribDivisor(INSTANCE_MATERIAL_LOCATION, 1);
+    glVertexAttribPointer(INSTANCE_COLOR_LOCATION, 4, GL_FLOAT, GL_FALSE, sizeof(InstanceData), BUFFER_OFFSET(offsetof(InstanceData, color)));
+    glEnableVertexAttribArray(INSTANCE_COLOR_LOCATION);
+    glVertexAttribDivisor(INSTANCE_COLOR_LOCATION, 1);
+    gl.bindVertexArray(previous);
+    _attachedVaos.push_back(vao);
+}
+
+void CInstanceSet::upload() {
+    _uploadedBytes = 0;
+    if (_vbo == 0) glGenBuffers(1, &_vbo);
+    glBindBuffer(GL_ARRAY_BUFFER, _vbo);
+
+    // 容量不足時以兩倍成長重新配置，attribute 指向的是 buffer 名稱，已設定的 VAO 不需要更新
+    if (size() > _capacity) {
+        _capacity = std::max(size(), _capacity * 2);
+        glBufferData(GL_ARRAY_BUFFER, _capacity * sizeof(InstanceData), nullptr, GL_DYNAMIC_DRAW);
+        _dirtyRanges.clear();
+        _dirtyRanges.push_back({ 0, size() });
+    }
+    if (_dirtyRanges.empty()) return;
+
+    // 範圍太多時合併，減少 glBufferSubData 的呼叫次數
+    if (_dirtyRanges.size() > INSTANCE_MAX_DIRTY_RANGES) {
+        int begin = size(), end = 0;
+        for (const auto& range : _dirtyRanges) {
+            begin = std::min(begin, range.first);
+            end = std::max(end, range.second);
+        }
+        _dirtyRanges.clear();
+        _dirtyRanges.push_back({ begin, end });
+    }
+    for (const auto& range : _dirtyRanges) {
+        // remove() 之後範圍可能超過目前的數量
+        int end = std::min(range.second, size());
+        if (range.first >= end) continue;
+        GLsizeiptr bytes = (end - range.first) * sizeof(InstanceData);
+        glBufferSubData(GL_ARRAY_BUFFER, range.first * sizeof(InstanceData), bytes, &_instances[range.first]);
+        _uploadedBytes += bytes;
+    }
+    _dirtyRanges.clear();
+}
@@ -0,0 +1,69 @@
+//  CInstanceSet.h
+//  同一個 CShape 或 Model 畫很多份時使用：每個 instance 的 model matrix、顏色與材質索引
+//  連續存放在一個 instance vertex buffer，整組以一次 glDrawElementsInstanced 繪製
+//  修改 instance 時只記錄 dirty 範圍，upload() 只重新上傳這些範圍
+
+#pragma once
+
+#include <vector>
+#include <utility>
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+// instance 屬性的 attribute location，與 v_phong.glsl / v_gouraud.glsl 一致
+#define INSTANCE_MODEL_LOCATION    4   // mat4 佔用 4~7
+#define INSTANCE_MATERIAL_LOCATION 8
+#define INSTANCE_COLOR_LOCATION    9
+
+// 超過這個數量的 dirty 範圍時合併成一段上傳
+#define INSTANCE_MAX_DIRTY_RANGES  16
+
+struct InstanceData {
+    glm::mat4 mxModel;          // 乘在物件本身的 model matrix 之後
+    glm::vec4 color;            // 與物件顏色 / 光照結果相乘
+    GLint     materialIndex;    // CMaterialTable 索引，-1 代表使用物件本身的材質
+};
+
+class CInstanceSet {
+public:
+    CInstanceSet();
+    ~CInstanceSet();
+
+    // 回傳新 instance 的索引
+    int  add(const glm::mat4& mxModel, const glm::vec4& color = glm::vec4(1.0f), GLint materialIndex = -1);
+    void setTransform(int index, const glm::mat4& mxModel);
+    // 以 3x4 的 row (每筆三個 vec4，第四個分量為位移) 連續設定 count 筆，只記錄一段 dirty 範圍
+    void setTransforms(int first, int count, const glm::vec4* rows);
+    void setColor(int index, const glm::vec4& color);
+    void setMaterial(int index, GLint materialIndex);
+    // 以最後一個 instance 填補，最後一個的索引會變成 index
+    void remove(int index);
+    void clear();
+    void reserve(int count);
+
+    int size() const { return static_cast<int>(_instances.size()); }
+    const InstanceData& get(int index) const { return _instances[index]; }
+
+    // 在 vao 上設定 instance 屬性，同一個 VAO 只設定一次 (需要 GL context)
+    void attach(GLuint vao);
+    // 上傳 dirty 範圍，buffer 容量不足時整個重新配置
+    void upload();
+
+    GLuint getBuffer() const { return _vbo; }
+    // 上一次 upload() 實際上傳的 bytes
+    GLsizeiptr getUploadedBytes() const { return _uploadedBytes; }
+
+private:
+    CInstanceSet(const CInstanceSet&) = delete;
+    CInstanceSet& operator=(const CInstanceSet&) = delete;
+
+    void markDirty(int begin, int end);
+
+    std::vector<InstanceData> _instances;
+    std::vector<std::pair<int, int>> _dirtyRanges;  // [begin, end)
+    std::vector<GLuint> _attachedVaos;
+    int _attachedDeleteCount;   // VAO 名稱會被重複使用，刪除過 VAO 後重新設定
+    GLuint _vbo;
+    int _capacity;              // GPU buffer 可容納的 instance 數
+    GLsizeiptr _uploadedBytes;
+};
@@ -18,6 +18,7 @@ CLight::CLight(
     _innerCutOff = 0.0f; _outerCutOff = 0.0f; _exponent = 1.0f;
     _displayOn = true; _motionOn = false; _clock = 0.0f;
     _lighingOn = true; _lightObj.setPos(position);
+    _dirty = true;
 }
 //CLight::CLight(glm::vec3 position, glm::vec3 direction, float innerCutOffDeg, float outerCutOffDeg,
 //    glm::vec3 ambient, glm::vec3 diffuse, glm::vec3 specular, float constant, float linear, float quadratic) {
@@ -38,13 +39,14 @@ CLight::CLight(glm::vec3 position, glm::vec3 target, float innerCutOffDeg, float
     _type = LightType::SPOT; _posStart = position;
     _displayOn = true; _motionOn = false; _clock = 0.0f;
     _lighingOn = true; _lightObj.setPos(position);
+    _dirty = true;
 }
 
 CLight::~CLight() = default;
 
 
 void CLight::setPos(glm::vec3 pos) { 
-    _position = pos; 
+    _position = pos; _dirty = true;
     
     if ( _type == LightType::SPOT ) {
         _direction = glm::normalize(_target - _position);
@@ -52,13 +54,13 @@ void CLight::setPos(glm::vec3 pos) {
 }
 glm::vec3 CLight::getPos()  { return _position; }
 
-void CLight::setAmbient( glm::vec4 amb) { _ambient = amb; }
+void CLight::setAmbient( glm::vec4 amb) { _ambient = amb; _dirty = true; }
 glm::vec4 CLight::getAmbient()  { return _ambient; }
 
-void CLight::setDiffuse( glm::vec4 diff) { _diffuse = diff; }
+void CLight::setDiffuse( glm::vec4 diff) { _diffuse = diff; _dirty = true; }
 glm::vec4 CLight::getDiffuse()  { return _diffuse; }
 
-void CLight::setSpecular( glm::vec4 spec) { _specular = spec; }
+void CLight::setSpecular( glm::vec4 spec) { _specular = spec; _dirty = true; }
 glm::vec4 CLight::getSpecular()  { return _specular; }
 
 void CLight::setIntensity(float intensity) { 
@@ -67,62 +69,63 @@ void CLight::setIntensity(float intensity) {
     _diffuse  = _diffuse  * _intensity;
     _specular = _specular * _intensity;
     _ambient.w = 1.0f; _diffuse.w = 1.0f; _specular.w = 1.0f;
+    _dirty = true;
 }
 
 void CLight::setAttenuation(float c, float l, float q) {
     _constant = c; _linear = l;  _quadratic = q;
+    _dirty = true;
 }
 void CLight::getAttenuation(float& c, float& l, float& q) {
     c = _constant; l = _linear;  q = _quadratic; 
 }
 
-void CLight::setLightOn(bool enable) { _lighingOn = enable; }
+void CLight::setLightOn(bool enable) { _lighingOn = enable; _dirty = true; }
 bool CLight::isLightOn(){ return _lighingOn; }
 
 void CLight::setMotionEnabled() { _motionOn = !_motionOn; }
 
 
+void CLightUniforms::bind(GLuint shaderProg, const std::string& name)
+{
+    position.bind(shaderProg, name + ".position");
+    ambient.bind(shaderProg, name + ".ambient");
+    diffuse.bind(shaderProg, name + ".diffuse");
+    specular.bind(shaderProg, name + ".specular");
+    constant.bind(shaderProg, name + ".constant");
+    linear.bind(shaderProg, name + ".linear");
+    quadratic.bind(shaderProg, name + ".quadratic");
+    direction.bind(shaderProg, name + ".direction");
+    cutOff.bind(shaderProg, name + ".cutOff");
+    outerCutOff.bind(shaderProg, name + ".outerCutOff");
+    exponent.bind(shaderProg, name + ".exponent");
+    type.bind(shaderProg, name + ".type");
+    enabled.bind(shaderProg, name + ".enabled");
+}
+
 void CLight::setShaderID(GLuint shaderProg, std::string name, bool displayon)
 {
     _shaderID = shaderProg; _lightname = name;
-    
+    _uniforms.bind(_shaderID, _lightname);
+    _lightTypeLoc.bind(_shaderID, "lightType");
+
     glm::vec4 amb = _lighingOn ? _ambient : glm::vec4(0.0f);
     glm::vec4 diff = _lighingOn ? _diffuse : glm::vec4(0.0f);
     glm::vec4 spec = _lighingOn ? _specular : glm::vec4(0.0f);
 
-    GLint loc = glGetUniformLocation(_shaderID, (_lightname + ".position").c_str());
-    glUniform3fv(loc, 1, glm::value_ptr(_position));
-
-    loc = glGetUniformLocation(_shaderID, (_lightname + ".ambient").c_str());
-    glUniform4fv(loc, 1, glm::value_ptr(amb));
-
-    loc = glGetUniformLocation(_shaderID, (_lightname + ".diffuse").c_str());
-    glUniform4fv(loc, 1, glm::value_ptr(diff));
-
-    loc = glGetUniformLocation(_shaderID, (_lightname + ".specular").c_str());
-    glUniform4fv(loc, 1, glm::value_ptr(spec));
-
-    loc = glGetUniformLocation(_shaderID, (_lightname + ".constant").c_str());
-    glUniform1f(loc, _constant);
-
-    loc = glGetUniformLocation(_shaderID, (_lightname + ".linear").c_str());
-    glUniform1f(loc, _linear);
-
-    loc = glGetUniformLocation(_shaderID, (_lightname + ".quadratic").c_str());
-    glUniform1f(loc, _quadratic);
-
-    loc = glGetUniformLocation(_shaderID, "lightType");
-    glUniform1i(loc, _type);
+    _uniforms.position.set(_position);
+    _uniforms.ambient.set(amb);
+    _uniforms.diffuse.set(diff);
+    _uniforms.specular.set(spec);
+    _uniforms.constant.set(_constant);
+    _uniforms.linear.set(_linear);
+    _uniforms.quadratic.set(_quadratic);
+    _lightTypeLoc.set(_type);
 
     if ( _type == LightType::SPOT ) {
-        loc = glGetUniformLocation(_shaderID, (_lightname + ".direction").c_str());
-        glUniform3fv(loc, 1, glm::value_ptr(_direction));
-
-        loc = glGetUniformLocation(_shaderID, (_lightname + ".cutOff").c_str());
-        glUniform1f(loc, _innerCutOff);
-
-        loc = glGetUniformLocation(_shaderID, (_lightname + ".outerCutOff").c_str());
-        glUniform1f(loc, _outerCutOff);
+        _uniforms.direction.set(_direction);
+        _uniforms.cutOff.set(_innerCutOff);
+        _uniforms.outerCutOff.set(_outerCutOff);
     }
     _displayOn = displayon;
     if ( _displayOn ) {
@@ -137,42 +140,20 @@ void CLight::updateToShader()
 {
     //if (!_needsUpdate) return;
 
-    GLint loc = glGetUniformLocation(_shaderID, (_lightname + ".position").c_str());
-    glUniform3fv(loc, 1, glm::value_ptr(_position));
-
-    loc = glGetUniformLocation(_shaderID, (_lightname + ".ambient").c_str());
-    glUniform4fv(loc, 1, glm::value_ptr(_ambient));
-
-    loc = glGetUniformLocation(_shaderID, (_lightname + ".diffuse").c_str());
-    glUniform4fv(loc, 1, glm::value_ptr(_diffuse));
-
-    loc = glGetUniformLocation(_shaderID, (_lightname + ".specular").c_str());
-    glUniform4fv(loc, 1, glm::value_ptr(_specular));
-
-    loc = glGetUniformLocation(_shaderID, (_lightname + ".constant").c_str());
-    glUniform1f(loc, _constant);
-
-    loc = glGetUniformLocation(_shaderID, (_lightname + ".linear").c_str());
-    glUniform1f(loc, _linear);
-
-    loc = glGetUniformLocation(_shaderID, (_lightname + ".quadratic").c_str());
-    glUniform1f(loc, _quadratic);
-
-    loc = glGetUniformLocation(_shaderID, "lightType");
-    glUniform1i(loc, _type);
+    _uniforms.position.set(_position);
+    _uniforms.ambient.set(_ambient);
+    _uniforms.diffuse.set(_diffuse);
+    _uniforms.specular.set(_specular);
+    _uniforms.constant.set(_constant);
+    _uniforms.linear.set(_linear);
+    _uniforms.quadratic.set(_quadratic);
+    _lightTypeLoc.set(_type);
 
     if (_type == LightType::SPOT) {
-        loc = glGetUniformLocation(_shaderID, (_lightname + ".direction").c_str());
-        glUniform3fv(loc, 1, glm::value_ptr(_direction));
-
-        loc = glGetUniformLocation(_shaderID, (_lightname + ".cutOff").c_str());
-        glUniform1f(loc, _innerCutOff);
-
-        loc = glGetUniformLocation(_shaderID, (_lightname + ".outerCutOff").c_str());
-        glUniform1f(loc, _outerCutOff);
-
-        loc = glGetUniformLocation(_shaderID, (_lightname + ".exponent").c_str());
-        glUniform1f(loc, _exponent);
+        _uniforms.direction.set(_direction);
+        _uniforms.cutOff.set(_innerCutOff);
+        _uniforms.outerCutOff.set(_outerCutOff);
+        _uniforms.exponent.set(_exponent);
     }
 
     // _needsUpdate = false;
@@ -185,6 +166,7 @@ void CLight::setTarget(const glm::vec3& target) {
     _target = target;
     _direction = glm::normalize(_target - _position);
     _type = LightType::SPOT;
+    _dirty = true;
 }
 
 void CLight::setCutOffDeg(float innerDeg, float outerDeg, float exponent) {
@@ -192,6 +174,7 @@ void CLight::setCutOffDeg(float innerDeg, float outerDeg, float exponent) {
     _outerCutOff = glm::cos(glm::radians(outerDeg));
     _exponent = exponent;
     _type = LightType::SPOT;
+    _dirty = true;
 }
 
 void CLight::update(float dt)
@@ -239,6 +222,11 @@ void CLight::drawRaw()
     if (_displayOn) _lightObj.drawRaw();
 }
 
+void CLight::submit(CRenderQueue& queue)
+{
+    if (_displayOn) _lightObj.submit(queue);
+}
+
 CLight::LightType CLight::getType() const {
     return _type;
 }
@@ -4,6 +4,26 @@
 #include <GL/glew.h>
 #include <string>
 #include "../models/CCube.h"
+#include "CUniform.h"
+
+// GLSL  struct UwѪRn handle
+struct CLightUniforms {
+    CUniform<glm::vec3> position;
+    CUniform<glm::vec4> ambient;
+    CUniform<glm::vec4> diffuse;
+    CUniform<glm::vec4> specular;
+    CUniform<float>     constant;
+    CUniform<float>     linear;
+    CUniform<float>     quadratic;
+    CUniform<glm::vec3> direction;
+    CUniform<float>     cutOff;
+    CUniform<float>     outerCutOff;
+    CUniform<float>     exponent;
+    CUniform<int>       type;
+    CUniform<int>       enabled;
+    // uniformName: GLSL ܼƦW١AҦp "uLight"  "uLights[0]"
+    void bind(GLuint shaderProg, const std::string& uniformName);
+};
 
 class CLight {
 public:
@@ -61,6 +81,7 @@ public:
     // yøN light ҫ
     void draw();
     void drawRaw();
+    void submit(CRenderQueue& queue);
     
     LightType getType() const;
     float getInnerCutOff() const;
@@ -70,9 +91,15 @@ public:
     float getClock() const;
     glm::vec3 getStartPos() const;
 
+    // |vT shader ݥƪ setter |аO dirtyA CLightManager WǫM
+    bool isDirty() const { return _dirty; }
+    void clearDirty() { _dirty = false; }
+
 private:
     std::string _lightname;
     GLuint _shaderID;
+    CLightUniforms _uniforms;       //  setShaderID ɸѪR
+    CUniform<int>  _lightTypeLoc;   // @ shader ϥΪ "lightType"
     glm::vec3 _position;
     glm::vec3 _posStart;
     glm::vec4 _ambient;
@@ -89,6 +116,7 @@ private:
     float     _exponent;      // cos 
     LightType _type;
     bool      _lighingOn;
+    bool      _dirty;
 
     // N light ҫAiۦ
     CCube _lightObj;
@@ -0,0 +1,226 @@
+//  CLightClusters.cpp
+#include "CLightClusters.h"
+#include <cmath>
+#include <algorithm>
+#include <iostream>
+
+CLightClusters::CLightClusters(int gridX, int gridY, int gridZ)
+	: _gridX(gridX), _gridY(gridY), _gridZ(gridZ), _mxProj(1.0f), _hasProjection(false),
+	  _near(0.1f), _far(100.0f), _depthScale(0.0f), _depthBias(0.0f),
+	  _maxIndices(65536), _maxPerCluster(0), _dropped(0) {
+	_table.assign(getClusterCount() * 2, 0);
+	_bins.resize(getClusterCount());
+}
+
+float CLightClusters::attenuationRange(float constant, float linear, float quadratic, float intensity, float threshold) {
+	// 解 c + l*d + q*d^2 = intensity / threshold
+	float target = intensity / threshold;
+	if (target <= constant) return 0.0f;
+	if (quadratic > 0.0f) {
+		float disc = linear * linear - 4.0f * quadratic * (constant - target);
+		return (-linear + std::sqrt(disc)) / (2.0f * quadratic);
+	}
+	if (linear > 0.0f) return (target - constant) / linear;
+	return CLUSTER_INFINITE_RANGE;
+}
+
+glm::vec3 CLightClusters::pointAtDepth(const glm::vec3& nearPoint, const glm::vec3& farPoint, float depth) {
+	float t = (-depth - nearPoint.z) / (farPoint.z - nearPoint.z);
+	return nearPoint + (farPoint - nearPoint) * t;
+}
+
+void CLightClusters::setProjection(const glm::mat4& mxProj) {
+	if (_hasProjection && mxProj == _mxProj) return;
+	_mxProj = mxProj;
+	_hasProjection = true;
+
+	// 以反矩陣把 NDC 的點轉回 view space，透視與正交投影共用同一套計算
+	glm::mat4 mxInvProj = glm::inverse(mxProj);
+	auto unproject = [&](float x, float y, float z) {
+		glm::vec4 p = mxInvProj * glm::vec4(x, y, z, 1.0f);
+		return glm::vec3(p) * (1.0f / p.w);
+	};
+	_near = -unproject(0.0f, 0.0f, -1.0f).z;
+	_far  = -unproject(0.0f, 0.0f,  1.0f).z;
+
+	// 指數間隔的 slice：近處切得細，遠處切得粗
+	float logRatio = std::log(_far / _near);
+	_depthScale = _gridZ / logRatio;
+	_depthBias = -_gridZ * std::log(_near) / logRatio;
+	_sliceDepth.resize(_gridZ + 1);
+	for (int z = 0; z <= _gridZ; z++) _sliceDepth[z] = _near * std::pow(_far / _near, static_cast<float>(z) / _gridZ);
+
+	// tile 分界平面：由近平面與遠平面上的三個點決定，法向量朝 NDC 座標增加的方向
+	auto makePlane = [](const glm::vec3& a, const glm::vec3& b, const glm::vec3& c, const glm::vec3& inside) {
+		glm::vec3 n = glm::normalize(glm::cross(b - a, c - a));
+		float w = -glm::dot(n, a);
+		if (glm::dot(n, inside) + w < 0.0f) { n = -n; w = -w; }
+		return glm::vec4(n, w);
+	};
+	_planesX.resize(_gridX + 1);
+	for (int x = 0; x <= _gridX; x++) {
+		float ndc = -1.0f + 2.0f * x / _gridX;
+		glm::vec3 inside = unproject(ndc + 1.0f, 0.0f, 1.0f);   // 平面 +x 側的點
+		_planesX[x] = makePlane(unproject(ndc, -1.0f, -1.0f), unproject(ndc, 1.0f, -1.0f), unproject(ndc, -1.0f, 1.0f), inside);
+	}
+	_planesY.resize(_gridY + 1);
+	for (int y = 0; y <= _gridY; y++) {
+		float ndc = -1.0f + 2.0f * y / _gridY;
+		glm::vec3 inside = unproject(0.0f, ndc + 1.0f, 1.0f);
+		_planesY[y] = makePlane(unproject(-1.0f, ndc, -1.0f), unproject(1.0f, ndc, -1.0f), unproject(-1.0f, ndc, 1.0f), inside);
+	}
+
+	// 每個 cluster 的 AABB：tile 四個角的視線與 slice 前後兩個深度平面的交點
+	_boundsMin.resize(getClusterCount());
+	_boundsMax.resize(getClusterCount());
+	for (int y = 0; y < _gridY; y++) {
+		for (int x = 0; x < _gridX; x++) {
+			glm::vec3 nearPoints[4], farPoints[4];
+			for (int k = 0; k < 4; k++) {
+				float ndcX = -1.0f + 2.0f * (x + (k & 1)) / _gridX;
+				float ndcY = -1.0f + 2.0f * (y + (k >> 1)) / _gridY;
+				nearPoints[k] = unproject(ndcX, ndcY, -1.0f);
+				farPoints[k] = unproject(ndcX, ndcY, 1.0f);
+			}
+			for (int z = 0; z < _gridZ; z++) {
+				int cluster = getClusterIndex(x, y, z);
+				for (int k = 0; k < 8; k++) {
+					glm::vec3 p = pointAtDepth(nearPoints[k & 3], farPoints[k & 3], _sliceDepth[z + (k >> 2)]);
+					_boundsMin[cluster] = (k == 0) ? p : glm::min(_boundsMin[cluster], p);
+					_boundsMax[cluster] = (k == 0) ? p : glm::max(_boundsMax[cluster], p);
+				}
+			}
+		}
+	}
+}
+
+int CLightClusters::depthSlice(float depth) const {
+	if (depth <= _near) return 0;
+	int slice = static_cast<int>(std::log(depth) * _depthScale + _depthBias);
+	return std::min(std::max(slice, 0), _gridZ - 1);
+}
+
+int CLightClusters::findCluster(float ndcX, float ndcY, float depth) const {
+	int x = std::min(std::max(static_cast<int>((ndcX * 0.5f + 0.5f) * _gridX), 0), _gridX - 1);
+	int y = std::min(std::max(static_cast<int>((ndcY * 0.5f + 0.5f) * _gridY), 0), _gridY - 1);
+	return getClusterIndex(x, y, depthSlice(depth));
+}
+
+CLightClusters::ViewLight CLightClusters::toViewSpace(const glm::mat4& mxView, const ClusterLight& light) const {
+	ViewLight v;
+	v.apex = glm::vec3(mxView * glm::vec4(light.position, 1.0f));
+	v.range = light.range;
+	v.spot = light.cosOuterCutOff > 0.0f && light.range < CLUSTER_INFINITE_RANGE;
+	if (!v.spot) {
+		v.center = v.apex;
+		v.radius = light.range;
+		v.axis = glm::vec3(0.0f);
+		v.cosAngle = -1.0f; v.sinAngle = 0.0f;
+		return v;
+	}
+	v.axis = glm::normalize(glm::vec3(mxView * glm::vec4(light.direction, 0.0f)));
+	v.cosAngle = light.cosOuterCutOff;
+	v.sinAngle = std::sqrt(std::max(0.0f, 1.0f - v.cosAngle * v.cosAngle));
+	// 圓錐與球的交集 (扇形) 的包圍球：角度小於 45 度時為通過頂點與邊緣的外接球
+	if (v.cosAngle >= 0.70710678f) {
+		v.radius = light.range / (2.0f * v.cosAngle);
+		v.center = v.apex + v.axis * v.radius;
+	} else {
+		v.radius = light.range * v.sinAngle;
+		v.center = v.apex + v.axis * (light.range * v.cosAngle);
+	}
+	return v;
+}
+
+bool CLightClusters::intersects(const ViewLight& light, int cluster) const {
+	const glm::vec3& bmin = _boundsMin[cluster];
+	const glm::vec3& bmax = _boundsMax[cluster];
+	// 包圍球與 AABB
+	glm::vec3 closest = glm::clamp(light.center, bmin, bmax);
+	glm::vec3 d = closest - light.center;
+	if (glm::dot(d, d) > light.radius * light.radius) return false;
+	if (!light.spot) return true;
+
+	// 圓錐與 cluster 的包圍球
+	glm::vec3 center = (bmin + bmax) * 0.5f;
+	return coneIntersectsSphere(light.apex, light.axis, light.cosAngle, light.sinAngle, light.range,
+								center, glm::length(bmax - center));
+}
+
+bool CLightClusters::coneIntersectsSphere(const glm::vec3& apex, const glm::vec3& axis, float cosAngle, float sinAngle,
+										  float range, const glm::vec3& center, float radius) {
+	// 在圓錐外側、頂點後方或超出範圍時剔除
+	glm::vec3 v = center - apex;
+	float lenSq = glm::dot(v, v);
+	float along = glm::dot(v, axis);
+	float distToCone = cosAngle * std::sqrt(std::max(0.0f, lenSq - along * along)) - along * sinAngle;
+	if (distToCone > radius) return false;
+	if (along > range + radius) return false;
+	if (along < -radius) return false;
+	return true;
+}
+
+bool CLightClusters::affectsSphere(const ClusterLight& light, const glm::vec3& center, float radius) {
+	if (!light.enabled) return false;
+	if (light.range >= CLUSTER_INFINITE_RANGE) return true;
+	glm::vec3 d = center - light.position;
+	float reach = light.range + radius;
+	if (glm::dot(d, d) > reach * reach) return false;
+	if (light.cosOuterCutOff <= 0.0f) return true;
+	float cosAngle = light.cosOuterCutOff;
+	float sinAngle = std::sqrt(std::max(0.0f, 1.0f - cosAngle * cosAngle));
+	return coneIntersectsSphere(light.position, glm::normalize(light.direction), cosAngle, sinAngle, light.range, center, radius);
+}
+
+int CLightClusters::build(const glm::mat4& mxView, const std::vector<ClusterLight>& lights) {
+	for (auto& bin : _bins) bin.clear();
+	_maxPerCluster = 0;
+	_dropped = 0;
+
+	int total = 0;
+	int lightCount = std::min(static_cast<int>(lights.size()), 0xFFFF);
+	for (int i = 0; i < lightCount; i++) {
+		const ClusterLight& light = lights[i];
+		if (!light.enabled) continue;
+		bool infinite = light.range >= CLUSTER_INFINITE_RANGE;
+		ViewLight v = toViewSpace(mxView, light);
+
+		// 以分界平面找出 x / y 範圍，以深度找出 slice 範圍，再逐一測試範圍內的 cluster
+		int x0 = 0, x1 = _gridX - 1, y0 = 0, y1 = _gridY - 1, z0 = 0, z1 = _gridZ - 1;
+		if (!infinite) {
+			float depth = -v.center.z;
+			if (depth + v.radius < _near || depth - v.radius > _far) continue;
+			z0 = depthSlice(depth - v.radius);
+			z1 = depthSlice(depth + v.radius);
+			auto dist = [&](const glm::vec4& plane) { return glm::dot(glm::vec3(plane), v.center) + plane.w; };
+			// 完全在分界平面 +側的欄不受影響 (從左邊排除)，完全在 -側的從右邊排除
+			while (x0 < _gridX && dist(_planesX[x0 + 1]) > v.radius) x0++;
+			while (x1 >= 0 && dist(_planesX[x1]) < -v.radius) x1--;
+			while (y0 < _gridY && dist(_planesY[y0 + 1]) > v.radius) y0++;
+			while (y1 >= 0 && dist(_planesY[y1]) < -v.radius) y1--;
+		}
+		for (int z = z0; z <= z1; z++) {
+			for (int y = y0; y <= y1; y++) {
+				for (int x = x0; x <= x1; x++) {
+					int cluster = getClusterIndex(x, y, z);
+					if (!infinite && !intersects(v, cluster)) continue;
+					if (total >= _maxIndices) { _dropped++; continue; }
+					_bins[cluster].push_back(static_cast<uint16_t>(i));
+					total++;
+				}
+			}
+		}
+	}
+	if (_dropped > 0) std::cerr << "CLightClusters: index list full, " << _dropped << " light/cluster pairs dropped" << std::endl;
+
+	// 每個 cluster 的光源索引依序緊密排列
+	_indices.clear();
+	_indices.reserve(total);
+	for (int c = 0; c < getClusterCount(); c++) {
+		_table[c * 2] = static_cast<uint32_t>(_indices.size());
+		_table[c * 2 + 1] = static_cast<uint32_t>(_bins[c].size());
+		_indices.insert(_indices.end(), _bins[c].begin(), _bins[c].end());
+		_maxPerCluster = std::max(_maxPerCluster, static_cast<int>(_bins[c].size()));
+	}
+	return total;
+}
@@ -0,0 +1,97 @@
+//  CLightClusters.h
+//  Clustered forward lighting 的 CPU 分組：把 view frustum 切成 X x Y 個螢幕 tile、Z 個以指數間隔的深度 slice，
+//  每個 frame 以光源的影響範圍 (由衰減係數求出的距離，聚光燈再以圓錐裁切) 找出涵蓋的 cluster，
+//  輸出每個 cluster 的 (offset, count) 與緊密排列的光源索引，fragment shader 只計算所屬 cluster 的光源；
+//  只用到 glm，不需要 GL context
+
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <glm/glm.hpp>
+
+#define CLUSTER_GRID_X 16
+#define CLUSTER_GRID_Y 9
+#define CLUSTER_GRID_Z 24
+#define CLUSTER_LIGHT_THRESHOLD (1.0f / 256.0f)   // 衰減後的亮度低於此值視為沒有影響
+#define CLUSTER_INFINITE_RANGE  1.0e30f           // 不會衰減的光源，放進每個 cluster
+
+// 分組使用的光源資料 (世界座標)
+struct ClusterLight {
+	glm::vec3 position = glm::vec3(0.0f);
+	float     range = CLUSTER_INFINITE_RANGE;
+	glm::vec3 direction = glm::vec3(0.0f, -1.0f, 0.0f);
+	float     cosOuterCutOff = -1.0f;       // 聚光燈外圓錐角的 cos，<= 0 時視為點光源
+	bool      enabled = true;
+};
+
+class CLightClusters {
+public:
+	CLightClusters(int gridX = CLUSTER_GRID_X, int gridY = CLUSTER_GRID_Y, int gridZ = CLUSTER_GRID_Z);
+
+	// 衰減 1 / (c + l*d + q*d^2) 乘上 intensity 降到 threshold 時的距離，不會衰減時回傳 CLUSTER_INFINITE_RANGE
+	static float attenuationRange(float constant, float linear, float quadratic, float intensity,
+								  float threshold = CLUSTER_LIGHT_THRESHOLD);
+	// 光源的影響範圍 (聚光燈再以圓錐裁切) 是否與世界座標的包圍球相交，逐物件的光源列表使用
+	static bool affectsSphere(const ClusterLight& light, const glm::vec3& center, float radius);
+
+	// projection 改變時才重新計算各 cluster 在 view space 的邊界，透視與正交投影都適用
+	void setProjection(const glm::mat4& mxProj);
+	// 每個 frame 以目前的 view matrix 重新分組，回傳寫入的索引數
+	int build(const glm::mat4& mxView, const std::vector<ClusterLight>& lights);
+	// 索引總數的上限 (例如 GL_MAX_TEXTURE_BUFFER_SIZE)，超過時其餘的光源不再加入並記錄在 getDroppedCount
+	void setMaxIndexCount(int maxIndices) { _maxIndices = maxIndices; }
+
+	int getGridX() const { return _gridX; }
+	int getGridY() const { return _gridY; }
+	int getGridZ() const { return _gridZ; }
+	int getClusterCount() const { return _gridX * _gridY * _gridZ; }
+	int getClusterIndex(int x, int y, int z) const { return x + _gridX * (y + _gridY * z); }
+	// shader 由 view space 深度求 slice：slice = log(depth) * scale + bias
+	float getDepthScale() const { return _depthScale; }
+	float getDepthBias() const { return _depthBias; }
+	float getNear() const { return _near; }
+	float getFar() const { return _far; }
+	// 與 shader 相同的算法，供測試與除錯使用；ndc 為 [-1,1]，depth 為 view space 中到鏡頭的距離 (正值)
+	int findCluster(float ndcX, float ndcY, float depth) const;
+	void getClusterBounds(int cluster, glm::vec3& bmin, glm::vec3& bmax) const { bmin = _boundsMin[cluster]; bmax = _boundsMax[cluster]; }
+
+	// 每個 cluster 兩個值：在索引表中的起點與光源數
+	const std::vector<uint32_t>& getClusterTable() const { return _table; }
+	const std::vector<uint16_t>& getLightIndices() const { return _indices; }
+	int getMaxLightsPerCluster() const { return _maxPerCluster; }
+	int getDroppedCount() const { return _dropped; }
+
+private:
+	// 一個光源在 view space 的範圍：包圍球與 (聚光燈的) 圓錐
+	struct ViewLight {
+		glm::vec3 center; float radius;         // 包圍球
+		glm::vec3 apex, axis; float range;      // 圓錐
+		float cosAngle, sinAngle;
+		bool spot;
+	};
+
+	ViewLight toViewSpace(const glm::mat4& mxView, const ClusterLight& light) const;
+	bool intersects(const ViewLight& light, int cluster) const;
+	// 圓錐 (頂點、單位軸向、半角的 cos / sin、長度) 與球是否可能相交，保守估計
+	static bool coneIntersectsSphere(const glm::vec3& apex, const glm::vec3& axis, float cosAngle, float sinAngle,
+									 float range, const glm::vec3& center, float radius);
+	int  depthSlice(float depth) const;
+	// 直線 (nearPoint -> farPoint) 與 z = -depth 平面的交點
+	static glm::vec3 pointAtDepth(const glm::vec3& nearPoint, const glm::vec3& farPoint, float depth);
+
+	int _gridX, _gridY, _gridZ;
+	glm::mat4 _mxProj;
+	bool _hasProjection;
+	float _near, _far, _depthScale, _depthBias;
+	std::vector<glm::vec3> _boundsMin, _boundsMax;     // 每個 cluster 的 view space AABB
+	std::vector<glm::vec4> _planesX, _planesY;         // tile 的分界平面，法向量朝 +x / +y
+	std::vector<float> _sliceDepth;                    // _gridZ + 1 個 slice 分界的深度
+
+	std::vector<uint32_t> _table;
+	std::vector<uint16_t> _indices;
+	std::vector<std::vector<uint16_t>> _bins;          // build 使用的暫存，保留容量
+	int _maxIndices;
+	int _maxPerCluster;
+	int _dropped;
+};
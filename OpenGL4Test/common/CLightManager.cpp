@@ -1,10 +1,20 @@
 //  CLightManager.cpp
 #include "CLightManager.h"
+#include "CShaderPool.h"
+#include "CGLState.h"
+#include "CShadowMaps.h"
 #include <glm/gtc/type_ptr.hpp>
 #include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <iostream>
 
-CLightManager::CLightManager() : shaderID(0) {
+static_assert(sizeof(LightBlockEntry) == 112, "LightBlockEntry must be 7 RGBA32F texels");
+static_assert(sizeof(LightBlockData) == 64, "LightBlockData must match std140 layout");
+
+CLightManager::CLightManager() : shaderID(0), staleFrom(0), countDirty(true), clusteringEnabled(true), shadowMaps(nullptr) {
     lights.reserve(MAX_LIGHTS);
+    std::memset(&blockData, 0, sizeof(blockData));
 }
 
 CLightManager::~CLightManager() {
@@ -13,100 +23,197 @@ CLightManager::~CLightManager() {
 }
 
 void CLightManager::addLight(CLight* light) {
-    if (lights.size() < MAX_LIGHTS && light != nullptr) {
-        lights.push_back(light);
+    if (light == nullptr) return;
+    if (lights.size() >= MAX_LIGHTS) {
+        std::cerr << "CLightManager::addLight: more than " << MAX_LIGHTS << " lights, ignored" << std::endl;
+        return;
     }
+    staleFrom = std::min(staleFrom, static_cast<int>(lights.size()));
+    lights.push_back(light);
+    countDirty = true;
 }
 
 void CLightManager::removeLight(int index) {
     if (index >= 0 && index < lights.size()) {
         lights.erase(lights.begin() + index);
+        staleFrom = std::min(staleFrom, index);
+        countDirty = true;
     }
 }
 
 void CLightManager::clearLights() {
     lights.clear();
+    staleFrom = 0;
+    countDirty = true;
 }
 
 void CLightManager::setShaderID(GLuint shaderProg) {
     shaderID = shaderProg;
     
-    // 設定光源數量
-    GLint loc = glGetUniformLocation(shaderID, "uNumLights");
-    glUniform1i(loc, static_cast<int>(lights.size()));
+    if (!lightUBO.isCreated()) {
+        lightUBO.create(sizeof(LightBlockData), LIGHT_BLOCK_BINDING);
+        CShaderPool::getInstance().bindUniformBlock("LightBlock", LIGHT_BLOCK_BINDING);
+        
+        // 光源 buffer 一次配置 MAX_LIGHTS 個，之後只更新 dirty 的範圍
+        entries.assign(MAX_LIGHTS, LightBlockEntry());
+        std::memset(entries.data(), 0, entries.size() * sizeof(LightBlockEntry));
+        lightBuffer.create(GL_RGBA32F);
+        lightBuffer.upload(entries.size() * sizeof(LightBlockEntry), entries.data());
+        clusterTable.create(GL_RG32UI);
+        clusterIndices.create(GL_R16UI);
+        GLint maxTexels = 0;
+        glGetIntegerv(GL_MAX_TEXTURE_BUFFER_SIZE, &maxTexels);
+        clusters.setMaxIndexCount(maxTexels);
+    }
+    
+    // buffer texture 與 shadow map 的 sampler 由 CShaderPool 在 link 時設定 (LIGHT_DATA_TEXTURE_UNIT 等)，
+    // 之後建立的變體會複製基礎 program 的值
+    CGLState& gl = CGLState::getInstance();
+    for (GLuint prog : CShaderPool::getInstance().getVariants(shaderProg)) {
+        gl.useProgram(prog);
+        CUniform<int>(prog, "uObjectLightCount").set(-1);   // 預設沒有逐物件的光源列表 (CRenderQueue 繪製時才設定)
+    }
+    gl.useProgram(shaderProg);
     
+    // 第一次上傳全部
+    staleFrom = 0;
+    countDirty = true;
     updateAllLightsToShader();
 }
 
+float CLightManager::getLightRange(CLight* light) {
+    // 漫射與鏡面反射中最亮的分量衰減到門檻以下的距離
+    float constant, linear, quadratic;
+    light->getAttenuation(constant, linear, quadratic);
+    glm::vec4 diffuse = light->getDiffuse(), specular = light->getSpecular();
+    float intensity = 0.0f;
+    for (int k = 0; k < 3; k++) intensity = std::max(intensity, std::max(diffuse[k], specular[k]));
+    return CLightClusters::attenuationRange(constant, linear, quadratic, intensity);
+}
+
+void CLightManager::packLight(int index) {
+    CLight* light = lights[index];
+    LightBlockEntry& e = entries[index];
+    
+    // Colors (考慮光源開關狀態)
+    bool on = light->isLightOn();
+    e.position = light->getPos();
+    e.ambient  = on ? light->getAmbient()  : glm::vec4(0.0f);
+    e.diffuse  = on ? light->getDiffuse()  : glm::vec4(0.0f);
+    e.specular = on ? light->getSpecular() : glm::vec4(0.0f);
+    
+    // Attenuation
+    light->getAttenuation(e.constant, e.linear, e.quadratic);
+    
+    // Light type and enabled state
+    e.type = static_cast<GLint>(light->getType());
+    e.enabled = on ? 1 : 0;
+    e.shadow = shadowMaps != nullptr ? shadowMaps->getSlot(light) : -1;
+    
+    // Spot light specific parameters
+    if (light->getType() == CLight::LightType::SPOT) {
+        e.direction = light->getDirection();
+        e.cutOff = light->getInnerCutOff();
+        e.outerCutOff = light->getOuterCutOff();
+        e.exponent = light->getExponent();
+    } else {
+        e.direction = glm::vec3(0.0f);
+        e.cutOff = e.outerCutOff = 0.0f;
+        e.exponent = 1.0f;
+    }
+    
+    // 影響範圍 (關閉的光源沒有影響)
+    e.range = on ? getLightRange(light) : 0.0f;
+    
+    // 分組與逐物件列表使用的世界座標資料
+    ClusterLight& c = clusterLights[index];
+    c.position = e.position;
+    c.range = e.range;
+    c.direction = e.direction;
+    c.cosOuterCutOff = (e.type == static_cast<GLint>(CLight::LightType::SPOT) && e.cutOff > 0.0f) ? e.outerCutOff : -1.0f;
+    c.enabled = e.enabled != 0;
+    light->clearDirty();
+}
+
 void CLightManager::updateAllLightsToShader() {
-    if (shaderID == 0) return;
+    if (!lightUBO.isCreated()) return;
+    
+    // 找出需要更新的光源，合併成一段連續範圍上傳
+    int count = static_cast<int>(lights.size());
+    clusterLights.resize(count);
+    int first = -1, last = -1;
+    for (int i = 0; i < count; i++) {
+        if (i >= staleFrom || lights[i]->isDirty()) {
+            packLight(i);
+            if (first == -1) first = i;
+            last = i;
+        }
+    }
+    staleFrom = MAX_LIGHTS;
+    
+    if (first != -1) {
+        lightBuffer.update(first * sizeof(LightBlockEntry), (last - first + 1) * sizeof(LightBlockEntry), &entries[first]);
+    }
     
     // 更新光源數量
-    GLint loc = glGetUniformLocation(shaderID, "uNumLights");
-    glUniform1i(loc, static_cast<int>(lights.size()));
+    if (countDirty) {
+        blockData.numLights = count;
+        lightUBO.update(offsetof(LightBlockData, numLights), sizeof(GLint), &blockData.numLights);
+        countDirty = false;
+    }
+}
+
+void CLightManager::updateClusters(const glm::mat4& mxView, const glm::mat4& mxProj) {
+    if (!lightUBO.isCreated()) return;
+    CGLState& gl = CGLState::getInstance();
+    gl.bindTexture(LIGHT_DATA_TEXTURE_UNIT, GL_TEXTURE_BUFFER, lightBuffer.getTexture());
     
-    // 更新每個光源的資料
-    for (int i = 0; i < lights.size() && i < MAX_LIGHTS; i++) {
-        CLight* light = lights[i];
-        std::string lightName = "uLights[" + std::to_string(i) + "]";
-        
-        // Position
-        loc = glGetUniformLocation(shaderID, (lightName + ".position").c_str());
-        glm::vec3 pos = light->getPos();
-        glUniform3fv(loc, 1, glm::value_ptr(pos));
-        
-        // Colors (考慮光源開關狀態)
-        glm::vec4 amb = light->isLightOn() ? light->getAmbient() : glm::vec4(0.0f);
-        glm::vec4 diff = light->isLightOn() ? light->getDiffuse() : glm::vec4(0.0f);
-        glm::vec4 spec = light->isLightOn() ? light->getSpecular() : glm::vec4(0.0f);
-        
-        loc = glGetUniformLocation(shaderID, (lightName + ".ambient").c_str());
-        glUniform4fv(loc, 1, glm::value_ptr(amb));
-        
-        loc = glGetUniformLocation(shaderID, (lightName + ".diffuse").c_str());
-        glUniform4fv(loc, 1, glm::value_ptr(diff));
-        
-        loc = glGetUniformLocation(shaderID, (lightName + ".specular").c_str());
-        glUniform4fv(loc, 1, glm::value_ptr(spec));
-        
-        // Attenuation
-        float c, l, q;
-        light->getAttenuation(c, l, q);
-        
-        loc = glGetUniformLocation(shaderID, (lightName + ".constant").c_str());
-        glUniform1f(loc, c);
-        
-        loc = glGetUniformLocation(shaderID, (lightName + ".linear").c_str());
-        glUniform1f(loc, l);
-        
-        loc = glGetUniformLocation(shaderID, (lightName + ".quadratic").c_str());
-        glUniform1f(loc, q);
-        
-        // Light type and enabled state
-        loc = glGetUniformLocation(shaderID, (lightName + ".type").c_str());
-        glUniform1i(loc, static_cast<int>(light->getType()));
+    // 不分組時 shader 計算所有光源，不需要索引表
+    bool changed = blockData.clustered != (clusteringEnabled ? 1 : 0);
+    blockData.clustered = clusteringEnabled ? 1 : 0;
+    if (clusteringEnabled) {
+        clusters.setProjection(mxProj);
+        clusters.build(mxView, clusterLights);
         
-        loc = glGetUniformLocation(shaderID, (lightName + ".enabled").c_str());
-        glUniform1i(loc, light->isLightOn() ? 1 : 0);
+        const std::vector<uint32_t>& table = clusters.getClusterTable();
+        const std::vector<uint16_t>& indices = clusters.getLightIndices();
+        clusterTable.upload(table.size() * sizeof(uint32_t), table.data());
+        if (!indices.empty()) clusterIndices.upload(indices.size() * sizeof(uint16_t), indices.data());
+        gl.bindTexture(CLUSTER_TABLE_TEXTURE_UNIT, GL_TEXTURE_BUFFER, clusterTable.getTexture());
+        gl.bindTexture(CLUSTER_LIGHTS_TEXTURE_UNIT, GL_TEXTURE_BUFFER, clusterIndices.getTexture());
         
-        // Spot light specific parameters
-        if (light->getType() == CLight::LightType::SPOT) {
-            loc = glGetUniformLocation(shaderID, (lightName + ".direction").c_str());
-            glm::vec3 dir = light->getDirection();
-            glUniform3fv(loc, 1, glm::value_ptr(dir));
-            
-            loc = glGetUniformLocation(shaderID, (lightName + ".cutOff").c_str());
-            glUniform1f(loc, light->getInnerCutOff());
-            
-            loc = glGetUniformLocation(shaderID, (lightName + ".outerCutOff").c_str());
-            glUniform1f(loc, light->getOuterCutOff());
-            
-            loc = glGetUniformLocation(shaderID, (lightName + ".exponent").c_str());
-            glUniform1f(loc, light->getExponent());
-        }
+        // gl_FragCoord 以像素為單位，需要 viewport 換算成 tile
+        GLint vp[4];
+        glGetIntegerv(GL_VIEWPORT, vp);
+        glm::ivec4 grid(clusters.getGridX(), clusters.getGridY(), clusters.getGridZ(), 0);
+        glm::vec4 depth(clusters.getDepthScale(), clusters.getDepthBias(), 0.0f, 0.0f);
+        glm::vec4 viewport(vp[0], vp[1], vp[2] > 0 ? 1.0f / vp[2] : 0.0f, vp[3] > 0 ? 1.0f / vp[3] : 0.0f);
+        changed |= grid != blockData.clusterGrid || depth != blockData.clusterDepth || viewport != blockData.viewport;
+        blockData.clusterGrid = grid;
+        blockData.clusterDepth = depth;
+        blockData.viewport = viewport;
+    }
+    if (changed) {
+        lightUBO.update(offsetof(LightBlockData, clustered), sizeof(LightBlockData) - offsetof(LightBlockData, clustered),
+                        &blockData.clustered);
     }
 }
 
+void CLightManager::setShadowMaps(const CShadowMaps* shadows) {
+    shadowMaps = shadows;
+    staleFrom = 0;
+}
+
+int CLightManager::gatherLights(const glm::vec3& center, float radius, GLint* indices, int maxCount) const {
+    int count = 0;
+    for (int i = 0; i < static_cast<int>(clusterLights.size()); i++) {
+        if (!CLightClusters::affectsSphere(clusterLights[i], center, radius)) continue;
+        if (count >= maxCount) return -1;
+        indices[count++] = i;
+    }
+    return count;
+}
+
 void CLightManager::update(float dt) {
     for (auto& light : lights) {
         light->update(dt);
@@ -125,6 +232,12 @@ void CLightManager::drawRaw() {
     }
 }
 
+void CLightManager::submit(CRenderQueue& queue) {
+    for (auto& light : lights) {
+        light->submit(queue);
+    }
+}
+
 CLight* CLightManager::getLight(int index) {
     if (index >= 0 && index < lights.size()) {
         return lights[index];
@@ -3,16 +3,65 @@
 #pragma once
 
 #include "CLight.h"
+#include "CUniformBuffer.h"
+#include "CTextureBuffer.h"
+#include "CLightClusters.h"
+#include "CShaderPool.h"
 #include <vector>
 #include <GL/glew.h>
 
-#define MAX_LIGHTS 8
+#define MAX_LIGHTS 256
+
+// 每個光源 112 bytes，在 buffer texture (GL_RGBA32F) 中佔 7 個 texel，
+// 與 f_phong.glsl 的 fetchLight 一一對應；整數欄位以 floatBitsToInt 讀取
+struct LightBlockEntry {
+    glm::vec3 position;  float constant;
+    glm::vec4 ambient;
+    glm::vec4 diffuse;
+    glm::vec4 specular;
+    glm::vec3 direction; float linear;
+    float quadratic, cutOff, outerCutOff, exponent;
+    GLint type, enabled;
+    float range;        // 衰減到 CLUSTER_LIGHT_THRESHOLD 的距離，shader 在此距離內平滑降到 0
+    GLint shadow;       // CShadowMaps 的 slot，-1 代表沒有陰影
+};
+
+// 與 f_phong.glsl 中 uniform block LightBlock 的 std140 配置對應
+struct LightBlockData {
+    GLint numLights;
+    GLint clustered;            // 0 代表每個像素計算所有光源
+    GLint pad[2];
+    glm::ivec4 clusterGrid;     // x, y, z 的 cluster 數
+    glm::vec4  clusterDepth;    // slice = log(深度) * x + y
+    glm::vec4  viewport;        // x, y 為原點，z, w 為寬高的倒數
+};
+
+class CShadowMaps;
 
 class CLightManager {
 private:
     std::vector<CLight*> lights;
     GLuint shaderID;
     
+    // 光源資料的 CPU 端鏡像：光源本身放在 buffer texture，只上傳有變動的範圍；
+    // 光源數量與 cluster 參數放在 LightBlock uniform buffer
+    CUniformBuffer lightUBO;
+    LightBlockData blockData;
+    std::vector<LightBlockEntry> entries;
+    CTextureBuffer lightBuffer;
+    int staleFrom;      // 從此索引開始的光源不論是否 dirty 都需要重新填寫 (新增/移除光源後)
+    bool countDirty;    // 光源數量是否改變
+    
+    // clustered forward lighting：每個 frame 分組後上傳 (offset, count) 表與光源索引
+    CLightClusters clusters;
+    std::vector<ClusterLight> clusterLights;    // 與 entries 同步，packLight 時填寫
+    CTextureBuffer clusterTable;
+    CTextureBuffer clusterIndices;
+    bool clusteringEnabled;
+    const CShadowMaps* shadowMaps;
+    
+    void packLight(int index);
+    
 public:
     CLightManager();
     ~CLightManager();
@@ -23,13 +72,29 @@ public:
     void clearLights();
     
     // Shader 設定
+    // 光源資料放在 LightBlock uniform buffer，所有宣告 LightBlock 的 program 共用同一份資料，
+    // 切換 program 時不需要重新上傳
     void setShaderID(GLuint shaderProg);
-    void updateAllLightsToShader();
+    void updateAllLightsToShader(); // 只上傳 dirty 光源所在的範圍
+    // 在 updateAllLightsToShader 之後呼叫：依目前的鏡頭把光源分到各個 cluster 並上傳索引表
+    void updateClusters(const glm::mat4& mxView, const glm::mat4& mxProj);
+    // 關閉時每個像素計算所有光源 (比較用)，下一次 updateClusters 生效
+    void setClusteringEnabled(bool enabled) { clusteringEnabled = enabled; }
+    bool isClusteringEnabled() const { return clusteringEnabled; }
+    const CLightClusters& getClusters() const { return clusters; }
+    // 影響範圍與世界座標包圍球相交的光源索引 (已關閉的不算)，超過 maxCount 個時回傳 -1；
+    // 使用上一次 updateAllLightsToShader 的資料
+    int gatherLights(const glm::vec3& center, float radius, GLint* indices, int maxCount) const;
+    // 有 shadow map 的光源在光源資料中記錄 slot，設定後所有光源重新上傳
+    void setShadowMaps(const CShadowMaps* shadows);
+    // 光源開啟時的影響範圍：衰減到 CLUSTER_LIGHT_THRESHOLD 的距離 (CShadowMaps 的遠平面也取這個值)
+    static float getLightRange(CLight* light);
     
     // 更新和繪製
     void update(float dt);
     void draw();
     void drawRaw();
+    void submit(CRenderQueue& queue);
     
     // 取得光源數量
     int getLightCount() const { return static_cast<int>(lights.size()); }
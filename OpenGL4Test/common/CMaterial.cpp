@@ -1,4 +1,5 @@
 #include "CMaterial.h"
+#include "CMaterialTable.h"
 #include <glm/gtc/type_ptr.hpp>
 
 CMaterial::CMaterial(glm::vec4 ambient, glm::vec4 diffuse, glm::vec4 specular, float shininess) {
@@ -8,28 +9,44 @@ CMaterial::CMaterial(glm::vec4 ambient, glm::vec4 diffuse, glm::vec4 specular, f
 
 CMaterial::~CMaterial() = default;
 
-void CMaterial::setAmbient(glm::vec4 amb) { _ambient = amb; }
+void CMaterial::setAmbient(glm::vec4 amb) { _ambient = amb; updateTable(); }
 glm::vec4 CMaterial::getAmbient() { return _ambient; }
 
-void CMaterial::setDiffuse(glm::vec4 diff) { _diffuse = diff; }
+void CMaterial::setDiffuse(glm::vec4 diff) { _diffuse = diff; updateTable(); }
 glm::vec4 CMaterial::getDiffuse() { return _diffuse; }
 
-void CMaterial::setSpecular(glm::vec4 spec) { _specular = spec; }
+void CMaterial::setSpecular(glm::vec4 spec) { _specular = spec; updateTable(); }
 glm::vec4 CMaterial::getSpecular() { return _specular; }
 
-void CMaterial::setShininess(float shininess) { _shininess = shininess; }
+void CMaterial::setShininess(float shininess) { _shininess = shininess; updateTable(); }
 float CMaterial::getShininess() { return _shininess; }
 
-void CMaterial::uploadToShader(GLuint shaderProg, std::string name) {
-    GLint loc = glGetUniformLocation(shaderProg, (name + ".ambient").c_str());
-    glUniform4fv(loc, 1, glm::value_ptr(_ambient));
+int CMaterial::getTableIndex() {
+    if (_tableIndex == -1) {
+        _tableIndex = CMaterialTable::getInstance().addMaterial(_ambient, _diffuse, _specular, _shininess);
+    }
+    return _tableIndex;
+}
+
+void CMaterial::updateTable() {
+    // |nɤݭnsAnɷ|gJ̷s
+    if (_tableIndex > 0) {
+        CMaterialTable::getInstance().setMaterial(_tableIndex, _ambient, _diffuse, _specular, _shininess);
+    }
+}
 
-    loc = glGetUniformLocation(shaderProg, (name + ".diffuse").c_str());
-    glUniform4fv(loc, 1, glm::value_ptr(_diffuse));
+void CMaterialUniforms::bind(GLuint shaderProg, const std::string& name) {
+    index.bind(shaderProg, name + "Index");
+}
 
-    loc = glGetUniformLocation(shaderProg, (name + ".specular").c_str());
-    glUniform4fv(loc, 1, glm::value_ptr(_specular));
+void CMaterial::uploadToShader(GLuint shaderProg, const std::string& name) {
+    if (shaderProg != _uniformProg) {
+        _uniforms.bind(shaderProg, name);
+        _uniformProg = shaderProg;
+    }
+    uploadToShader(_uniforms);
+}
 
-    loc = glGetUniformLocation(shaderProg, (name + ".shininess").c_str());
-    glUniform1f(loc, _shininess);
-}
\ No newline at end of file
+void CMaterial::uploadToShader(const CMaterialUniforms& uniforms) {
+    uniforms.index.set(getTableIndex());
+}
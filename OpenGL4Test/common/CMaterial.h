@@ -2,6 +2,15 @@
 #include <glm/glm.hpp>
 #include <GL/glew.h>
 #include <string>
+#include "CUniform.h"
+
+// b shader ݪ handleGƩb CMaterialTable  MaterialBlockA
+// øsɥuݭn]w <uniformName>IndexAҦp "uMaterialIndex"
+struct CMaterialUniforms {
+    CUniform<int> index;
+    // uniformName: GLSL W١AҦp "uMaterial"
+    void bind(GLuint shaderProg, const std::string& uniformName);
+};
 
 class CMaterial {
 public:
@@ -17,12 +26,24 @@ public:
     glm::vec4 getSpecular();
     void setShininess(float shininess);
     float getShininess();
+    // ob CMaterialTable ޡAĤ@Isɵn
+    // ƻsXӪ CMaterial @ΦP@
+    int getTableIndex();
     // NѼƤWǨw shader program
     // uniformName: GLSL  Material struct W١AҦp "material"
-    void uploadToShader(GLuint shaderProg, std::string uniformName);
+    void uploadToShader(GLuint shaderProg, const std::string& uniformName);
+    // ϥιwѪRn handle WǡArBzPmd
+    void uploadToShader(const CMaterialUniforms& uniforms);
 private:
+    void updateTable();
+
     glm::vec4 _ambient;
     glm::vec4 _diffuse;
     glm::vec4 _specular;
     float     _shininess;
+    int       _tableIndex = -1;
+
+    // ¤ϥΪ handle ֨Aub program ܮɤ~sѪR
+    CMaterialUniforms _uniforms;
+    GLuint _uniformProg = 0;
 };
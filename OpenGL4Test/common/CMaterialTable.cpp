@@ -0,0 +1,68 @@
+//  CMaterialTable.cpp
+#include "CMaterialTable.h"
+#include "CShaderPool.h"
+#include <iostream>
+#include <algorithm>
+
+static_assert(sizeof(MaterialBlockEntry) == 64, "MaterialBlockEntry must match std140 layout");
+
+CMaterialTable& CMaterialTable::getInstance() {
+    static CMaterialTable instance;
+    return instance;
+}
+
+CMaterialTable::CMaterialTable() : m_dirtyFirst(-1), m_dirtyLast(-1) {
+    m_entries.reserve(MAX_MATERIALS);
+    // 索引 0：沒有指定材質的網格使用的預設值
+    addMaterial(glm::vec4(0.2f, 0.2f, 0.2f, 1.0f), glm::vec4(0.8f, 0.8f, 0.8f, 1.0f),
+                glm::vec4(1.0f), 32.0f);
+}
+
+int CMaterialTable::addMaterial(const glm::vec4& ambient, const glm::vec4& diffuse, const glm::vec4& specular,
+                                float shininess, float alpha, GLint textureFlags) {
+    if (m_entries.size() >= MAX_MATERIALS) {
+        std::cerr << "CMaterialTable is full (" << MAX_MATERIALS << "), using default material" << std::endl;
+        return 0;
+    }
+    m_entries.push_back(MaterialBlockEntry());
+    int index = static_cast<int>(m_entries.size()) - 1;
+    setMaterial(index, ambient, diffuse, specular, shininess, alpha, textureFlags);
+    return index;
+}
+
+void CMaterialTable::setMaterial(int index, const glm::vec4& ambient, const glm::vec4& diffuse, const glm::vec4& specular,
+                                 float shininess, float alpha, GLint textureFlags) {
+    if (index < 0 || index >= getCount()) return;
+    MaterialBlockEntry& e = m_entries[index];
+    e.ambient = ambient;
+    e.diffuse = diffuse;
+    e.specular = specular;
+    e.shininess = shininess;
+    e.alpha = alpha;
+    e.textureFlags = textureFlags;
+    e.pad = 0;
+    markDirty(index);
+}
+
+const MaterialBlockEntry& CMaterialTable::getMaterial(int index) const {
+    if (index < 0 || index >= getCount()) return m_entries[0];
+    return m_entries[index];
+}
+
+void CMaterialTable::markDirty(int index) {
+    m_dirtyFirst = (m_dirtyFirst == -1) ? index : std::min(m_dirtyFirst, index);
+    m_dirtyLast = std::max(m_dirtyLast, index);
+}
+
+void CMaterialTable::flush() {
+    if (!m_ubo.isCreated()) {
+        m_ubo.create(MAX_MATERIALS * sizeof(MaterialBlockEntry), MATERIAL_BLOCK_BINDING);
+        CShaderPool::getInstance().bindUniformBlock("MaterialBlock", MATERIAL_BLOCK_BINDING);
+    }
+    if (m_dirtyFirst == -1) return;
+
+    m_ubo.update(m_dirtyFirst * sizeof(MaterialBlockEntry),
+                 (m_dirtyLast - m_dirtyFirst + 1) * sizeof(MaterialBlockEntry),
+                 &m_entries[m_dirtyFirst]);
+    m_dirtyFirst = m_dirtyLast = -1;
+}
@@ -0,0 +1,60 @@
+//  CMaterialTable.h
+//  全域材質表：所有材質在載入時寫入同一個 MaterialBlock uniform buffer，
+//  繪製時只需要傳入材質索引 (uMaterialIndex)，切換材質只是一個整數
+
+#pragma once
+
+#include <vector>
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include "CUniformBuffer.h"
+
+// 256 * 64 bytes = 16KB，為 GL_MAX_UNIFORM_BLOCK_SIZE 保證的最小值
+#define MAX_MATERIALS 256
+
+// 材質使用的貼圖種類 (textureFlags)
+#define MATERIAL_DIFFUSE_MAP   0x1
+#define MATERIAL_NORMAL_MAP    0x2
+#define MATERIAL_SPECULAR_MAP  0x4
+#define MATERIAL_ALPHA_MAP     0x8
+
+// 與 f_phong.glsl 中 MaterialData 的 std140 配置一致 (64 bytes)
+struct MaterialBlockEntry {
+    glm::vec4 ambient;
+    glm::vec4 diffuse;
+    glm::vec4 specular;
+    float shininess;
+    float alpha;
+    GLint textureFlags;
+    GLint pad;
+};
+
+class CMaterialTable {
+public:
+    static CMaterialTable& getInstance();
+
+    // 新增一筆材質並回傳其索引，表已滿時回傳 0 (預設材質)
+    int addMaterial(const glm::vec4& ambient, const glm::vec4& diffuse, const glm::vec4& specular,
+                    float shininess, float alpha = 1.0f, GLint textureFlags = 0);
+    // 修改既有材質，只標記該筆為 dirty
+    void setMaterial(int index, const glm::vec4& ambient, const glm::vec4& diffuse, const glm::vec4& specular,
+                     float shininess, float alpha = 1.0f, GLint textureFlags = 0);
+
+    const MaterialBlockEntry& getMaterial(int index) const;
+    int getCount() const { return static_cast<int>(m_entries.size()); }
+
+    // 將 dirty 範圍上傳到 uniform buffer，每個 frame 開始時呼叫一次，沒有變動時不做任何事
+    void flush();
+
+private:
+    CMaterialTable();
+    ~CMaterialTable() = default;
+    CMaterialTable(const CMaterialTable&) = delete;
+    CMaterialTable& operator=(const CMaterialTable&) = delete;
+
+    void markDirty(int index);
+
+    std::vector<MaterialBlockEntry> m_entries;  // CPU 端鏡像，索引 0 為預設材質
+    CUniformBuffer m_ubo;
+    int m_dirtyFirst, m_dirtyLast;
+};
@@ -0,0 +1,35 @@
+//  CMultiDraw.cpp
+#include "CMultiDraw.h"
+#include "typedefs.h"
+
+bool CMultiDrawRun::isIndirectSupported() {
+    return GLEW_VERSION_4_3 || GLEW_ARB_multi_draw_indirect;
+}
+
+void CMultiDrawRun::addCommand(const DrawElementsIndirectCommand& command) {
+    _commands.push_back(command);
+    _counts.push_back(static_cast<GLsizei>(command.count));
+    _indexOffsets.push_back(BUFFER_OFFSET(command.firstIndex * sizeof(GLuint)));
+    _baseVertices.push_back(command.baseVertex);
+}
+
+void CMultiDrawRun::clear() {
+    _commands.clear();
+    _counts.clear();
+    _indexOffsets.clear();
+    _baseVertices.clear();
+    _indirectBuffer = 0;
+    _indirectOffset = 0;
+}
+
+void CMultiDrawRun::draw() const {
+    if (_commands.empty()) return;
+    if (_indirectBuffer != 0) {
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, _indirectBuffer);
+        glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, BUFFER_OFFSET(_indirectOffset),
+                                    static_cast<GLsizei>(_commands.size()), 0);
+    } else {
+        glMultiDrawElementsBaseVertex(GL_TRIANGLES, _counts.data(), GL_UNSIGNED_INT, _indexOffsets.data(),
+                                      static_cast<GLsizei>(_counts.size()), const_cast<GLint*>(_baseVertices.data()));
+    }
+}
@@ -0,0 +1,44 @@
+//  CMultiDraw.h
+//  共用同一組 VAO (頂點/索引 arena) 的多個網格以一次呼叫送出：
+//  GL 4.3 (或 ARB_multi_draw_indirect) 使用 glMultiDrawElementsIndirect 讀取 GPU 上的命令 buffer，
+//  GL 3.3 context (例如 macOS) 改用 glMultiDrawElementsBaseVertex，兩者都只需要一次 API 呼叫
+
+#pragma once
+
+#include <vector>
+#include <GL/glew.h>
+
+// 與 GL 規格的 DrawElementsIndirectCommand 配置相同
+struct DrawElementsIndirectCommand {
+    GLuint count;           // 索引數
+    GLuint instanceCount;
+    GLuint firstIndex;      // 在 index arena 中的起點 (以索引為單位)
+    GLint  baseVertex;      // 在 vertex arena 中的起點
+    GLuint baseInstance;
+};
+
+// 一段可以一次送出的連續命令 (相同 program、材質與貼圖)
+class CMultiDrawRun {
+public:
+    void addCommand(const DrawElementsIndirectCommand& command);
+    void clear();
+
+    // indirectBuffer 中 [offset, offset + 命令數) 為本段的命令；為 0 時使用 fallback
+    void setIndirectBuffer(GLuint buffer, GLintptr offset) { _indirectBuffer = buffer; _indirectOffset = offset; }
+    const std::vector<DrawElementsIndirectCommand>& getCommands() const { return _commands; }
+    int getDrawCount() const { return static_cast<int>(_commands.size()); }
+
+    // 需要先綁定 arena 的 VAO
+    void draw() const;
+
+    static bool isIndirectSupported();
+
+private:
+    std::vector<DrawElementsIndirectCommand> _commands;
+    // glMultiDrawElementsBaseVertex 需要的 SoA 陣列，於 addCommand 時一併建立
+    std::vector<GLsizei> _counts;
+    std::vector<const void*> _indexOffsets;
+    std::vector<GLint> _baseVertices;
+    GLuint _indirectBuffer = 0;
+    GLintptr _indirectOffset = 0;
+};
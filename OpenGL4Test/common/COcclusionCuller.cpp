@@ -0,0 +1,317 @@
+//  COcclusionCuller.cpp
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include "COcclusionCuller.h"
+
+#if defined(__SSE__) || defined(_M_X64)
+#include <xmmintrin.h>
+#define OCCLUSION_USE_SSE
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#define OCCLUSION_USE_NEON
+#endif
+
+namespace {
+	// 以四個相鄰像素為一組：三個邊函數都 >= 0 的像素寫入較近的深度
+	inline void shadeQuad(float* dst, float e0, float e1, float e2, float de0, float de1, float de2, float z, float dz) {
+#if defined(OCCLUSION_USE_SSE)
+		const __m128 offs = _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f);
+		const __m128 zero = _mm_setzero_ps();
+		__m128 E0 = _mm_add_ps(_mm_set1_ps(e0), _mm_mul_ps(offs, _mm_set1_ps(de0)));
+		__m128 E1 = _mm_add_ps(_mm_set1_ps(e1), _mm_mul_ps(offs, _mm_set1_ps(de1)));
+		__m128 E2 = _mm_add_ps(_mm_set1_ps(e2), _mm_mul_ps(offs, _mm_set1_ps(de2)));
+		__m128 inside = _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(E0, zero), _mm_cmpge_ps(E1, zero)), _mm_cmpge_ps(E2, zero));
+		if (_mm_movemask_ps(inside) == 0) return;
+		__m128 Z = _mm_add_ps(_mm_set1_ps(z), _mm_mul_ps(offs, _mm_set1_ps(dz)));
+		__m128 old = _mm_loadu_ps(dst);
+		_mm_storeu_ps(dst, _mm_or_ps(_mm_and_ps(inside, _mm_min_ps(old, Z)), _mm_andnot_ps(inside, old)));
+#elif defined(OCCLUSION_USE_NEON)
+		static const float offsets[4] = { 0.0f, 1.0f, 2.0f, 3.0f };
+		const float32x4_t offs = vld1q_f32(offsets);
+		const float32x4_t zero = vdupq_n_f32(0.0f);
+		float32x4_t E0 = vmlaq_n_f32(vdupq_n_f32(e0), offs, de0);
+		float32x4_t E1 = vmlaq_n_f32(vdupq_n_f32(e1), offs, de1);
+		float32x4_t E2 = vmlaq_n_f32(vdupq_n_f32(e2), offs, de2);
+		uint32x4_t inside = vandq_u32(vandq_u32(vcgeq_f32(E0, zero), vcgeq_f32(E1, zero)), vcgeq_f32(E2, zero));
+		float32x4_t Z = vmlaq_n_f32(vdupq_n_f32(z), offs, dz);
+		float32x4_t old = vld1q_f32(dst);
+		vst1q_f32(dst, vbslq_f32(inside, vminq_f32(old, Z), old));
+#else
+		for (int k = 0; k < 4; k++) {
+			if (e0 + de0 * k >= 0.0f && e1 + de1 * k >= 0.0f && e2 + de2 * k >= 0.0f)
+				dst[k] = std::min(dst[k], z + dz * k);
+		}
+#endif
+	}
+}
+
+COcclusionCuller::COcclusionCuller(int width, int height) {
+	_width = (width + OCCLUSION_TILE_SIZE - 1) / OCCLUSION_TILE_SIZE * OCCLUSION_TILE_SIZE;
+	_height = (height + OCCLUSION_TILE_SIZE - 1) / OCCLUSION_TILE_SIZE * OCCLUSION_TILE_SIZE;
+	_tilesX = _width / OCCLUSION_TILE_SIZE;
+	_tilesY = _height / OCCLUSION_TILE_SIZE;
+	_bins.resize(_tilesX * _tilesY);
+	// 每一層長寬減半，到 tile 大小為止 (最上層每個 texel 對應一個 tile)
+	for (int level = 0; (OCCLUSION_TILE_SIZE >> level) >= 1; level++)
+		_hiz.emplace_back((_width >> level) * (_height >> level), 1.0f);
+	_mxViewProj = glm::mat4(1.0f);
+	_generation = _busyWorkers = 0;
+	_bQuit = false;
+	_nextTile = 0;
+	_rasterMs = 0.0f;
+	_tested = _occluded = 0;
+}
+
+COcclusionCuller::~COcclusionCuller() {
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_bQuit = true;
+	}
+	_startCondition.notify_all();
+	for (auto& worker : _workers) worker.join();
+}
+
+void COcclusionCuller::startWorkers() {
+	if (!_workers.empty()) return;
+	unsigned int hardware = std::max(1u, std::thread::hardware_concurrency());
+	int workerCount = static_cast<int>(std::min<unsigned int>(hardware, OCCLUSION_MAX_THREADS)) - 1;
+	for (int i = 0; i < workerCount; i++) _workers.emplace_back(&COcclusionCuller::workerLoop, this);
+}
+
+int COcclusionCuller::addOccluderMesh(const float* positions, int vertexCount, int stride,
+									  const unsigned int* indices, int indexCount, const glm::mat4& mxModel) {
+	Occluder occluder;
+	occluder.positions.reserve(vertexCount);
+	for (int i = 0; i < vertexCount; i++)
+		occluder.positions.emplace_back(positions[i * stride], positions[i * stride + 1], positions[i * stride + 2]);
+	occluder.indices.assign(indices, indices + indexCount);
+	occluder.mxModel = mxModel;
+	_occluders.push_back(std::move(occluder));
+	return static_cast<int>(_occluders.size()) - 1;
+}
+
+int COcclusionCuller::addOccluderBox(const glm::vec3& bmin, const glm::vec3& bmax) {
+	const float corners[8 * 3] = {
+		bmin.x, bmin.y, bmin.z,  bmax.x, bmin.y, bmin.z,  bmax.x, bmax.y, bmin.z,  bmin.x, bmax.y, bmin.z,
+		bmin.x, bmin.y, bmax.z,  bmax.x, bmin.y, bmax.z,  bmax.x, bmax.y, bmax.z,  bmin.x, bmax.y, bmax.z
+	};
+	// 六個面各兩個三角形，光柵化不分正反面
+	const unsigned int faces[36] = {
+		0, 1, 2, 0, 2, 3,  4, 6, 5, 4, 7, 6,  0, 4, 5, 0, 5, 1,
+		3, 2, 6, 3, 6, 7,  0, 3, 7, 0, 7, 4,  1, 5, 6, 1, 6, 2
+	};
+	return addOccluderMesh(corners, 8, 3, faces, 36, glm::mat4(1.0f));
+}
+
+void COcclusionCuller::setOccluderTransform(int occluder, const glm::mat4& mxModel) {
+	_occluders[occluder].mxModel = mxModel;
+}
+
+void COcclusionCuller::clearOccluders() {
+	_occluders.clear();
+}
+
+void COcclusionCuller::render(const glm::mat4& mxViewProj) {
+	auto start = std::chrono::steady_clock::now();
+	_mxViewProj = mxViewProj;
+	_tested = _occluded = 0;
+	setupTriangles(mxViewProj);
+
+	// 呼叫端的執行緒與 worker 一起處理所有 tile
+	_nextTile = 0;
+	if (!_workers.empty()) {
+		std::lock_guard<std::mutex> lock(_mutex);
+		_generation++;
+		_busyWorkers = static_cast<int>(_workers.size());
+	}
+	_startCondition.notify_all();
+	processTiles();
+	if (!_workers.empty()) {
+		std::unique_lock<std::mutex> lock(_mutex);
+		_doneCondition.wait(lock, [this]() { return _busyWorkers == 0; });
+	}
+	buildHiZ();
+	_rasterMs = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+void COcclusionCuller::workerLoop() {
+	int generation = 0;
+	while (true) {
+		{
+			std::unique_lock<std::mutex> lock(_mutex);
+			_startCondition.wait(lock, [&]() { return _bQuit || _generation != generation; });
+			if (_bQuit) return;
+			generation = _generation;
+		}
+		processTiles();
+		std::lock_guard<std::mutex> lock(_mutex);
+		if (--_busyWorkers == 0) _doneCondition.notify_one();
+	}
+}
+
+void COcclusionCuller::processTiles() {
+	const int tileCount = _tilesX * _tilesY;
+	for (int tile = _nextTile.fetch_add(1); tile < tileCount; tile = _nextTile.fetch_add(1))
+		rasterizeTile(tile);
+}
+
+void COcclusionCuller::setupTriangles(const glm::mat4& mxViewProj) {
+	_triangles.clear();
+	for (auto& bin : _bins) bin.clear();
+
+	for (const auto& occluder : _occluders) {
+		glm::mat4 mxClip = mxViewProj * occluder.mxModel;
+		_clipPositions.resize(occluder.positions.size());
+		for (size_t i = 0; i < occluder.positions.size(); i++)
+			_clipPositions[i] = mxClip * glm::vec4(occluder.positions[i], 1.0f);
+
+		for (size_t i = 0; i + 2 < occluder.indices.size(); i += 3) {
+			const glm::vec4& a = _clipPositions[occluder.indices[i]];
+			const glm::vec4& b = _clipPositions[occluder.indices[i + 1]];
+			const glm::vec4& c = _clipPositions[occluder.indices[i + 2]];
+			// 三個頂點都在同一個平面外側時整個三角形看不到 (近平面由裁切處理)
+			if ((a.x > a.w && b.x > b.w && c.x > c.w) || (a.x < -a.w && b.x < -b.w && c.x < -c.w) ||
+				(a.y > a.w && b.y > b.w && c.y > c.w) || (a.y < -a.w && b.y < -b.w && c.y < -c.w) ||
+				(a.z > a.w && b.z > b.w && c.z > c.w)) continue;
+			addClippedTriangle(a, b, c);
+		}
+	}
+
+	// 依螢幕範圍分到各 tile
+	for (int t = 0; t < static_cast<int>(_triangles.size()); t++) {
+		const ScreenTriangle& tri = _triangles[t];
+		for (int ty = tri.minY / OCCLUSION_TILE_SIZE; ty <= tri.maxY / OCCLUSION_TILE_SIZE; ty++)
+			for (int tx = tri.minX / OCCLUSION_TILE_SIZE; tx <= tri.maxX / OCCLUSION_TILE_SIZE; tx++)
+				_bins[ty * _tilesX + tx].push_back(t);
+	}
+}
+
+void COcclusionCuller::addClippedTriangle(const glm::vec4& a, const glm::vec4& b, const glm::vec4& c) {
+	// 近平面為 z = -w，d = z + w >= 0 為內側
+	const glm::vec4 in[3] = { a, b, c };
+	float d[3] = { a.z + a.w, b.z + b.w, c.z + c.w };
+	if (d[0] >= 0.0f && d[1] >= 0.0f && d[2] >= 0.0f) { addScreenTriangle(a, b, c); return; }
+	if (d[0] < 0.0f && d[1] < 0.0f && d[2] < 0.0f) return;
+
+	glm::vec4 out[4];
+	int count = 0;
+	for (int i = 0; i < 3; i++) {
+		int j = (i + 1) % 3;
+		if (d[i] >= 0.0f) out[count++] = in[i];
+		if ((d[i] >= 0.0f) != (d[j] >= 0.0f)) out[count++] = in[i] + (in[j] - in[i]) * (d[i] / (d[i] - d[j]));
+	}
+	for (int k = 1; k + 1 < count; k++) addScreenTriangle(out[0], out[k], out[k + 1]);
+}
+
+void COcclusionCuller::addScreenTriangle(const glm::vec4& a, const glm::vec4& b, const glm::vec4& c) {
+	ScreenTriangle tri;
+	const glm::vec4* clip[3] = { &a, &b, &c };
+	float minX = 1e30f, minY = 1e30f, maxX = -1e30f, maxY = -1e30f;
+	for (int i = 0; i < 3; i++) {
+		float invW = 1.0f / clip[i]->w;
+		tri.v[i] = glm::vec3((clip[i]->x * invW * 0.5f + 0.5f) * _width,
+							 (clip[i]->y * invW * 0.5f + 0.5f) * _height,
+							 std::min(std::max(clip[i]->z * invW * 0.5f + 0.5f, 0.0f), 1.0f));
+		minX = std::min(minX, tri.v[i].x); maxX = std::max(maxX, tri.v[i].x);
+		minY = std::min(minY, tri.v[i].y); maxY = std::max(maxY, tri.v[i].y);
+	}
+	tri.minX = std::max(0, static_cast<int>(std::floor(minX)));
+	tri.minY = std::max(0, static_cast<int>(std::floor(minY)));
+	tri.maxX = std::min(_width - 1, static_cast<int>(std::ceil(maxX)));
+	tri.maxY = std::min(_height - 1, static_cast<int>(std::ceil(maxY)));
+	if (tri.minX > tri.maxX || tri.minY > tri.maxY) return;
+	_triangles.push_back(tri);
+}
+
+void COcclusionCuller::rasterizeTile(int tile) {
+	const int x0 = (tile % _tilesX) * OCCLUSION_TILE_SIZE, y0 = (tile / _tilesX) * OCCLUSION_TILE_SIZE;
+	const int x1 = x0 + OCCLUSION_TILE_SIZE - 1, y1 = y0 + OCCLUSION_TILE_SIZE - 1;
+	float* depth = _hiz[0].data();
+	for (int y = y0; y <= y1; y++) std::fill(depth + y * _width + x0, depth + y * _width + x1 + 1, 1.0f);
+	for (int t : _bins[tile]) rasterizeTriangle(_triangles[t], x0, y0, x1, y1);
+}
+
+void COcclusionCuller::rasterizeTriangle(const ScreenTriangle& tri, int tileX0, int tileY0, int tileX1, int tileY1) {
+	glm::vec3 v0 = tri.v[0], v1 = tri.v[1], v2 = tri.v[2];
+	float area = (v1.x - v0.x) * (v2.y - v0.y) - (v2.x - v0.x) * (v1.y - v0.y);
+	if (std::fabs(area) < 1e-8f) return;
+	if (area < 0.0f) { std::swap(v1, v2); area = -area; }
+
+	// 深度在螢幕上為線性：z = v0.z + dzdx * (x - v0.x) + dzdy * (y - v0.y)
+	float dzdx = ((v1.z - v0.z) * (v2.y - v0.y) - (v2.z - v0.z) * (v1.y - v0.y)) / area;
+	float dzdy = ((v2.z - v0.z) * (v1.x - v0.x) - (v1.z - v0.z) * (v2.x - v0.x)) / area;
+
+	// 邊函數 E(p) = (b - a) x (p - a)，三條邊都 >= 0 的像素在三角形內
+	const glm::vec3* edgeA[3] = { &v0, &v1, &v2 };
+	const glm::vec3* edgeB[3] = { &v1, &v2, &v0 };
+	// 相鄰三角形共用的邊在浮點誤差下可能兩邊都沒畫到，每條邊往外放寬 OCCLUSION_EDGE_BIAS 像素
+	float dEdx[3], dEdy[3], bias[3];
+	for (int e = 0; e < 3; e++) {
+		dEdx[e] = -(edgeB[e]->y - edgeA[e]->y);
+		dEdy[e] = edgeB[e]->x - edgeA[e]->x;
+		bias[e] = OCCLUSION_EDGE_BIAS * std::sqrt(dEdx[e] * dEdx[e] + dEdy[e] * dEdy[e]);
+	}
+
+	// x 起點對齊到 4 的倍數 (tile 寬度也是 4 的倍數，不會超出 tile)
+	int xs = std::max(tri.minX, tileX0) & ~3, xe = std::min(tri.maxX, tileX1);
+	int ys = std::max(tri.minY, tileY0), ye = std::min(tri.maxY, tileY1);
+	float* depth = _hiz[0].data();
+	for (int y = ys; y <= ye; y++) {
+		float px = xs + 0.5f, py = y + 0.5f;
+		float e[3];
+		for (int k = 0; k < 3; k++)
+			e[k] = dEdy[k] * (py - edgeA[k]->y) + dEdx[k] * (px - edgeA[k]->x) + bias[k];
+		float z = v0.z + dzdx * (px - v0.x) + dzdy * (py - v0.y);
+		float* row = depth + y * _width;
+		for (int x = xs; x <= xe; x += 4) {
+			shadeQuad(row + x, e[0], e[1], e[2], dEdx[0], dEdx[1], dEdx[2], z, dzdx);
+			e[0] += 4.0f * dEdx[0]; e[1] += 4.0f * dEdx[1]; e[2] += 4.0f * dEdx[2];
+			z += 4.0f * dzdx;
+		}
+	}
+}
+
+void COcclusionCuller::buildHiZ() {
+	// 每個 texel 取下一層 2x2 中最遠的深度，測試時不會誤判為被遮住
+	for (size_t level = 1; level < _hiz.size(); level++) {
+		const int w = _width >> level, h = _height >> level, srcW = _width >> (level - 1);
+		const float* src = _hiz[level - 1].data();
+		float* dst = _hiz[level].data();
+		for (int y = 0; y < h; y++)
+			for (int x = 0; x < w; x++) {
+				const float* s = src + (2 * y) * srcW + 2 * x;
+				dst[y * w + x] = std::max(std::max(s[0], s[1]), std::max(s[srcW], s[srcW + 1]));
+			}
+	}
+}
+
+bool COcclusionCuller::isVisible(const glm::vec3& bmin, const glm::vec3& bmax) const {
+	_tested++;
+	float minX = 1e30f, minY = 1e30f, maxX = -1e30f, maxY = -1e30f, minZ = 1.0f;
+	for (int i = 0; i < 8; i++) {
+		glm::vec4 clip = _mxViewProj * glm::vec4((i & 1) ? bmax.x : bmin.x, (i & 2) ? bmax.y : bmin.y, (i & 4) ? bmax.z : bmin.z, 1.0f);
+		if (clip.w <= 1e-5f || clip.z < -clip.w) return true;   // 跨過近平面，無法判斷
+		float invW = 1.0f / clip.w;
+		float sx = (clip.x * invW * 0.5f + 0.5f) * _width, sy = (clip.y * invW * 0.5f + 0.5f) * _height;
+		minX = std::min(minX, sx); maxX = std::max(maxX, sx);
+		minY = std::min(minY, sy); maxY = std::max(maxY, sy);
+		minZ = std::min(minZ, clip.z * invW * 0.5f + 0.5f);
+	}
+	// 完全在畫面外的交給視錐剔除
+	if (maxX < 0.0f || maxY < 0.0f || minX >= _width || minY >= _height) return true;
+	int x0 = std::max(0, static_cast<int>(minX)), x1 = std::min(_width - 1, static_cast<int>(maxX));
+	int y0 = std::max(0, static_cast<int>(minY)), y1 = std::min(_height - 1, static_cast<int>(maxY));
+
+	// 選擇讓範圍只涵蓋 2x2 個 texel 的層
+	int level = 0;
+	while (level + 1 < static_cast<int>(_hiz.size()) && ((x1 >> level) - (x0 >> level) > 1 || (y1 >> level) - (y0 >> level) > 1))
+		level++;
+	const int w = _width >> level;
+	const float* hiz = _hiz[level].data();
+	for (int y = y0 >> level; y <= (y1 >> level); y++)
+		for (int x = x0 >> level; x <= (x1 >> level); x++)
+			if (hiz[y * w + x] >= minZ) return true;
+	_occluded++;
+	return false;
+}
@@ -0,0 +1,101 @@
+//  COcclusionCuller.h
+//  CPU 軟體遮蔽剔除：每個 frame 把少數指定的遮蔽物 (例如 House) 以低解析度畫進深度 buffer，
+//  畫面切成 tile，由數個 worker thread 各自光柵化一個 tile，一次以 SIMD 處理四個像素；
+//  之後建立 hierarchical-Z (每層取 2x2 中最遠的深度)，物件的 AABB 在送出前與對應層比較，
+//  完全在遮蔽物後方的不送出。全部在 CPU 上執行，不需要 GL context
+
+#pragma once
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <glm/glm.hpp>
+
+#define OCCLUSION_DEFAULT_WIDTH  256
+#define OCCLUSION_DEFAULT_HEIGHT 128
+#define OCCLUSION_TILE_SIZE      32    // 寬高必須是 tile 大小的倍數
+#define OCCLUSION_MAX_THREADS    4     // 含呼叫 render() 的執行緒
+#define OCCLUSION_EDGE_BIAS      0.01f // 光柵化時三角形邊界放寬的像素數
+
+class COcclusionCuller {
+public:
+	COcclusionCuller(int width = OCCLUSION_DEFAULT_WIDTH, int height = OCCLUSION_DEFAULT_HEIGHT);
+	~COcclusionCuller();
+
+	// 建立 worker thread (重複呼叫沒有作用)；沒有呼叫時 render() 只在呼叫端的執行緒執行
+	// 不在建構函式中建立，全域物件在靜態初始化時不會啟動執行緒
+	void startWorkers();
+
+	// 遮蔽物以區域座標的頂點位置 (每個頂點 stride 個 float，前三個為位置) 與三角形索引加入，回傳編號
+	int  addOccluderMesh(const float* positions, int vertexCount, int stride,
+						 const unsigned int* indices, int indexCount, const glm::mat4& mxModel);
+	int  addOccluderBox(const glm::vec3& bmin, const glm::vec3& bmax);
+	void setOccluderTransform(int occluder, const glm::mat4& mxModel);
+	void clearOccluders();
+	int  getOccluderCount() const { return static_cast<int>(_occluders.size()); }
+
+	// 以這個 frame 的 view-projection 畫出所有遮蔽物並建立 Hi-Z
+	void render(const glm::mat4& mxViewProj);
+	// 世界座標的 AABB 是否可能被看到 (保守估計，無法判斷時回傳 true)
+	bool isVisible(const glm::vec3& bmin, const glm::vec3& bmax) const;
+
+	int getWidth() const { return _width; }
+	int getHeight() const { return _height; }
+	// level 0 為完整解析度，[0,1] 的深度，1 為最遠
+	const float* getDepth(int level = 0) const { return _hiz[level].data(); }
+	int getLevelCount() const { return static_cast<int>(_hiz.size()); }
+
+	// 統計：上一次 render() 的三角形數與花費時間，以及之後 isVisible 的測試與剔除數
+	int getTriangleCount() const { return static_cast<int>(_triangles.size()); }
+	float getRasterMilliseconds() const { return _rasterMs; }
+	int getTestedCount() const { return _tested; }
+	int getOccludedCount() const { return _occluded; }
+
+private:
+	COcclusionCuller(const COcclusionCuller&) = delete;
+	COcclusionCuller& operator=(const COcclusionCuller&) = delete;
+
+	struct Occluder {
+		std::vector<glm::vec3> positions;   // 區域座標
+		std::vector<unsigned int> indices;
+		glm::mat4 mxModel;
+	};
+	// 螢幕座標的三角形 (像素單位，y 朝上)，z 為 [0,1] 的深度
+	struct ScreenTriangle {
+		glm::vec3 v[3];
+		int minX, minY, maxX, maxY;     // 包含的像素範圍
+	};
+
+	void setupTriangles(const glm::mat4& mxViewProj);
+	// 在 clip space 以近平面裁切後轉成螢幕座標
+	void addClippedTriangle(const glm::vec4& a, const glm::vec4& b, const glm::vec4& c);
+	void addScreenTriangle(const glm::vec4& a, const glm::vec4& b, const glm::vec4& c);
+	void rasterizeTile(int tile);
+	void rasterizeTriangle(const ScreenTriangle& tri, int tileX0, int tileY0, int tileX1, int tileY1);
+	void buildHiZ();
+
+	// worker thread：每一輪由 _nextTile 取 tile 直到做完
+	void workerLoop();
+	void processTiles();
+
+	int _width, _height, _tilesX, _tilesY;
+	std::vector<Occluder> _occluders;
+	std::vector<glm::vec4> _clipPositions;     // setupTriangles 重複使用的暫存
+	std::vector<ScreenTriangle> _triangles;
+	std::vector<std::vector<int>> _bins;        // 每個 tile 涵蓋的三角形
+	std::vector<std::vector<float>> _hiz;       // _hiz[0] 即深度 buffer
+	glm::mat4 _mxViewProj;
+
+	std::vector<std::thread> _workers;
+	std::mutex _mutex;
+	std::condition_variable _startCondition, _doneCondition;
+	int _generation;                // 每一輪加一，worker 以此判斷有新的工作
+	int _busyWorkers;
+	bool _bQuit;
+	std::atomic<int> _nextTile;
+
+	float _rasterMs;
+	mutable int _tested, _occluded;
+};
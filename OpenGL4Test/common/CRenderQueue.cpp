@@ -0,0 +1,280 @@
+//  CRenderQueue.cpp
+#include "CRenderQueue.h"
+#include "CGLState.h"
+#include "CShaderPool.h"
+#include "CLightManager.h"
+#include <algorithm>
+
+void CRenderQueue::begin(const glm::vec3& viewPos) {
+    _viewPos = viewPos;
+    _packets.clear();
+    _keys.clear();
+    _transparentCount = 0;
+    // 其他程式碼 (例如 CShape::setColor) 可能在 frame 之間直接修改 uniform，每個 frame 重新送出一次
+    for (auto& h : _handles) {
+        h.second.lastShadingMode = -1;
+        h.second.lastMaterialIndex = -2;
+        h.second.lastInstanced = -1;
+    }
+}
+
+void CRenderQueue::submit(const DrawPacket& packet) {
+    if (packet.program == 0 || packet.vao == 0) return;
+    if (packet.multiDraw != nullptr ? packet.multiDraw->getDrawCount() == 0 : packet.indexCount == 0) return;
+    _packets.push_back(packet);
+    _keys.push_back(makeKey(packet));
+    if (packet.pass == RENDER_PASS_TRANSPARENT) _transparentCount++;
+}
+
+uint64_t CRenderQueue::makeKey(const DrawPacket& packet) const {
+    // 以 center 轉到世界座標後到鏡頭的距離量化成 24 bits
+    glm::vec3 center = glm::vec3(packet.mxModel * glm::vec4(packet.center, 1.0f));
+    float dist = glm::length(center - _viewPos) / RENDER_QUEUE_DEPTH_RANGE;
+    uint64_t depth = static_cast<uint64_t>(std::min(std::max(dist, 0.0f), 1.0f) * 0xFFFFFF);
+    // GL 物件名稱是由 1 開始的小整數，只取低位元
+    uint64_t program  = packet.program & 0x3FF;
+    uint64_t material = static_cast<uint64_t>(packet.materialIndex + 1) & 0xFFF;
+    uint64_t vao      = packet.vao & 0xFFFF;
+    uint64_t pass     = static_cast<uint64_t>(packet.pass) & 0x3;
+
+    if (packet.pass == RENDER_PASS_TRANSPARENT) {
+        // [pass 2][遠到近 24][program 10][material 12][vao 16]
+        return (pass << 62) | ((0xFFFFFF - depth) << 38) | (program << 28) | (material << 16) | vao;
+    }
+    // [pass 2][粗略深度 4][program 10][material 12][vao 16][近到遠 20]
+    // 前 4 bits 的深度區間讓近的物件先寫入深度，後面被擋住的像素在 early-z 就被捨棄，區間內仍依狀態分組
+    return (pass << 62) | ((depth >> 20) << 58) | (program << 48) | (material << 36) | (vao << 20) | (depth & 0xFFFFF);
+}
+
+void CRenderQueue::radixSort() {
+    size_t n = _keys.size();
+    _order.resize(n);
+    for (size_t i = 0; i < n; i++) _order[i] = static_cast<uint32_t>(i);
+    _keysScratch.resize(n);
+    _orderScratch.resize(n);
+
+    // LSD radix sort，每次 8 bits 共 8 輪；所有鍵在該位元組都相同時略過該輪
+    for (int shift = 0; shift < 64; shift += 8) {
+        size_t count[256] = { 0 };
+        for (size_t i = 0; i < n; i++) count[(_keys[i] >> shift) & 0xFF]++;
+        if (count[(_keys[0] >> shift) & 0xFF] == n) continue;
+
+        size_t offset = 0;
+        for (int b = 0; b < 256; b++) {
+            size_t c = count[b];
+            count[b] = offset;
+            offset += c;
+        }
+        for (size_t i = 0; i < n; i++) {
+            size_t dst = count[(_keys[i] >> shift) & 0xFF]++;
+            _keysScratch[dst] = _keys[i];
+            _orderScratch[dst] = _order[i];
+        }
+        _keys.swap(_keysScratch);
+        _order.swap(_orderScratch);
+    }
+}
+
+CRenderQueue::ProgramHandles& CRenderQueue::getHandles(GLuint program) {
+    // shader 熱重載後 uniform 位置可能改變
+    int reloadCount = CShaderPool::getInstance().getReloadCount();
+    if (reloadCount != _handlesReloadCount) {
+        _handles.clear();
+        _handlesReloadCount = reloadCount;
+    }
+
+    auto it = _handles.find(program);
+    if (it != _handles.end()) return it->second;
+
+    ProgramHandles& h = _handles[program];
+    h.modelMatrix.bind(program, "mxModel");
+    h.shadingMode.bind(program, "uShadingMode");
+    h.color.bind(program, "ui4Color");
+    h.materialIndex.bind(program, "uMaterialIndex");
+    h.instanced.bind(program, "uInstanced");
+    h.objectLightCount.bind(program, "uObjectLightCount");
+    h.objectLights = CShaderPool::getInstance().getUniformLocation(program, "uObjectLights");
+    // 貼圖單元固定，只需設定一次 (呼叫端已經 useProgram)
+    static const char* samplers[4] = { "uDiffuseTexture", "uNormalTexture", "uSpecularTexture", "uAlphaTexture" };
+    for (int unit = 0; unit < 4; unit++) CUniform<int>(program, samplers[unit]).set(unit);
+    return h;
+}
+
+void CRenderQueue::setDepthPrepass(GLuint depthProgram, GLuint shadingProgram) {
+    _depthProgram = depthProgram;
+    _prepassShadingProgram = shadingProgram;
+    _prepassEnabled = depthProgram != 0;
+}
+
+void CRenderQueue::setObjectLights(const CLightManager* lights, GLuint shadingProgram) {
+    _lightManager = lights;
+    _objectLightShadingProgram = shadingProgram;
+    _objectLightsEnabled = lights != nullptr;
+}
+
+void CRenderQueue::setObjectLightList(const DrawPacket& p, ProgramHandles& h) {
+    if (std::find(_objectLightPrograms.begin(), _objectLightPrograms.end(), p.program) == _objectLightPrograms.end()) return;
+
+    GLint indices[RENDER_QUEUE_MAX_OBJECT_LIGHTS];
+    GLint count = -1;
+    if (p.radius >= 0.0f && p.instanceCount == 0) {
+        // 包圍球轉到世界座標，半徑乘上最大的縮放
+        glm::vec3 center = glm::vec3(p.mxModel * glm::vec4(p.center, 1.0f));
+        float scale = std::max(glm::length(glm::vec3(p.mxModel[0])),
+                               std::max(glm::length(glm::vec3(p.mxModel[1])), glm::length(glm::vec3(p.mxModel[2]))));
+        count = _lightManager->gatherLights(center, p.radius * scale, indices, RENDER_QUEUE_MAX_OBJECT_LIGHTS);
+    }
+    if (count >= 0) {
+        _objectLightPackets++;
+        _objectLightTotal += count;
+        if (count > 0 && h.objectLights != -1) glUniform1iv(h.objectLights, count, indices);
+    } else {
+        _objectLightFallbacks++;
+    }
+    if (count != h.lastObjectLightCount) {
+        h.objectLightCount.set(count);
+        h.lastObjectLightCount = count;
+    }
+}
+
+void CRenderQueue::resetObjectLightLists() {
+    // 其他直接繪製的物件 (例如 UI) 仍使用 cluster
+    CGLState& gl = CGLState::getInstance();
+    for (auto& entry : _handles) {
+        if (entry.second.lastObjectLightCount == -1) continue;
+        gl.useProgram(entry.first);
+        entry.second.objectLightCount.set(-1);
+        entry.second.lastObjectLightCount = -1;
+    }
+}
+
+bool CRenderQueue::usesPrepass(const DrawPacket& packet) const {
+    // 深度預先繪製沒有 discard，會 discard 的 packet 若參與，被挖空的部分也會擋住後方
+    if (packet.alphaTested) return false;
+    return std::find(_prepassPrograms.begin(), _prepassPrograms.end(), packet.program) != _prepassPrograms.end();
+}
+
+void CRenderQueue::draw(const DrawPacket& p, ProgramHandles& h, GLuint vao) {
+    h.modelMatrix.set(p.mxModel);
+    GLint instanced = p.instanceCount > 0 ? 1 : 0;
+    if (instanced != h.lastInstanced) {
+        h.instanced.set(instanced);
+        h.lastInstanced = instanced;
+    }
+
+    CGLState::getInstance().bindVertexArray(vao);
+    if (p.multiDraw != nullptr) p.multiDraw->draw();
+    else if (instanced) glDrawElementsInstanced(GL_TRIANGLES, p.indexCount, GL_UNSIGNED_INT, 0, p.instanceCount);
+    else glDrawElements(GL_TRIANGLES, p.indexCount, GL_UNSIGNED_INT, 0);
+}
+
+void CRenderQueue::depthPrepass(size_t opaqueCount) {
+    // 不透明的 packet 已由近到遠排序，只寫入深度，不需要材質與貼圖
+    CGLState& gl = CGLState::getInstance();
+    gl.colorMask(GL_FALSE);
+    gl.depthMask(GL_TRUE);
+    gl.depthFunc(GL_LESS);
+    gl.useProgram(_depthProgram);
+    ProgramHandles& h = getHandles(_depthProgram);
+    for (size_t i = 0; i < opaqueCount; i++) {
+        const DrawPacket& p = _packets[_order[i]];
+        if (!usesPrepass(p)) continue;
+        // 有位置 stream 時只讀取位置，不經過交錯的完整頂點
+        draw(p, h, p.positionVao != 0 ? p.positionVao : p.vao);
+        _prepassCount++;
+    }
+    gl.colorMask(GL_TRUE);
+}
+
+void CRenderQueue::beginOverdrawQuery() {
+    if (!_overdrawEnabled) return;
+    if (_samplesQueries[0] == 0) glGenQueries(2, _samplesQueries);
+    // 同一個 query 兩個 frame 才重複使用一次，結果通常已經可以讀取；還沒完成時保留上一次的數值
+    int slot = _queryFrame & 1;
+    GLuint query = _samplesQueries[slot];
+    if (_queryIssued[slot]) {
+        GLuint available = 0;
+        glGetQueryObjectuiv(query, GL_QUERY_RESULT_AVAILABLE, &available);
+        if (available) glGetQueryObjectuiv(query, GL_QUERY_RESULT, &_shadedSamples);
+    }
+    GLint viewport[4];
+    glGetIntegerv(GL_VIEWPORT, viewport);
+    _viewportPixels = viewport[2] * viewport[3];
+    glBeginQuery(GL_SAMPLES_PASSED, query);
+    _queryIssued[slot] = true;
+}
+
+void CRenderQueue::endOverdrawQuery() {
+    if (!_overdrawEnabled) return;
+    glEndQuery(GL_SAMPLES_PASSED);
+    _queryFrame++;
+}
+
+void CRenderQueue::execute() {
+    _prepassCount = 0;
+    _objectLightPackets = _objectLightFallbacks = _objectLightTotal = 0;
+    if (_packets.empty()) return;
+    radixSort();
+    _objectLightPrograms.clear();
+    if (isObjectLightsEnabled()) _objectLightPrograms = CShaderPool::getInstance().getVariants(_objectLightShadingProgram);
+
+    // 排序後不透明的 packet 在前面
+    size_t opaqueCount = _packets.size() - _transparentCount;
+    bool prepass = isDepthPrepassEnabled() && opaqueCount > 0;
+    if (prepass) {
+        // 變體在第一次用到時才建立，每個 frame 重新取得
+        _prepassPrograms = CShaderPool::getInstance().getVariants(_prepassShadingProgram);
+        depthPrepass(opaqueCount);
+    }
+
+    CGLState& gl = CGLState::getInstance();
+    // 不透明的 packet 不需要混合；遇到第一個透明的 packet 才開啟混合並停止寫入深度
+    gl.disable(GL_BLEND);
+    gl.depthMask(GL_TRUE);
+    gl.depthFunc(GL_LESS);
+    bool blending = false;
+    beginOverdrawQuery();
+
+    for (size_t i = 0; i < _order.size(); i++) {
+        const DrawPacket& p = _packets[_order[i]];
+        if (i == opaqueCount) {
+            // 透明的 packet 不計入重疊繪製
+            endOverdrawQuery();
+            gl.enable(GL_BLEND);
+            gl.blendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+            gl.depthMask(GL_FALSE);
+            gl.depthFunc(GL_LESS);
+            blending = true;
+        } else if (prepass && !blending) {
+            // 深度已經寫好，只有深度相同 (最前面) 的 fragment 會執行光照
+            bool equal = usesPrepass(p);
+            gl.depthFunc(equal ? GL_EQUAL : GL_LESS);
+            gl.depthMask(equal ? GL_FALSE : GL_TRUE);
+        }
+        gl.useProgram(p.program);
+        ProgramHandles& h = getHandles(p.program);
+
+        if (p.shadingMode >= 0 && p.shadingMode != h.lastShadingMode) {
+            h.shadingMode.set(p.shadingMode);
+            h.lastShadingMode = p.shadingMode;
+        }
+        if (p.useColor) h.color.set(p.color);
+        // 沒有材質的 packet (例如光源模型) 也要送出，否則會沿用前一個 packet 的材質
+        if (p.materialIndex != h.lastMaterialIndex) {
+            h.materialIndex.set(p.materialIndex);
+            h.lastMaterialIndex = p.materialIndex;
+        }
+        for (GLuint unit = 0; unit < 4; unit++) {
+            if (p.textures[unit] != 0) gl.bindTexture(unit, GL_TEXTURE_2D, p.textures[unit]);
+        }
+        setObjectLightList(p, h);
+        draw(p, h, p.vao);
+    }
+    if (!blending) endOverdrawQuery();
+    resetObjectLightLists();
+
+    // 還原，之後的繪製 (例如 UI) 與下一個 frame 的 glClear 需要寫入深度
+    gl.depthFunc(GL_LESS);
+    gl.depthMask(GL_TRUE);
+    gl.disable(GL_BLEND);
+}
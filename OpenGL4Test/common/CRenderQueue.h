@@ -0,0 +1,147 @@
+//  CRenderQueue.h
+//  繪製佇列：CShape、Model 與光源模型不直接繪製，而是送出 DrawPacket，
+//  每個 frame 以 64-bit 排序鍵 (pass、program、材質、VAO、深度) 做 radix sort 後再依序執行，
+//  相同 program / 材質 / VAO 的繪製會排在一起，減少狀態切換；
+//  可選擇先以只輸出位置的 shader 畫一次不透明物件的深度，主要 pass 再以 GL_EQUAL 測試，
+//  昂貴的光照 shader 每個可見像素只執行一次；
+//  也可以在 CPU 上以物件的包圍球與光源的影響範圍相交，每個 draw 只送出會照到它的光源索引
+
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <unordered_map>
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include "CUniform.h"
+#include "CMultiDraw.h"
+
+// 排序鍵中深度使用的距離範圍 (超過的視為最遠)
+#define RENDER_QUEUE_DEPTH_RANGE 100.0f
+// 每個 draw 的光源列表長度，必須與 f_phong.glsl 的 MAX_OBJECT_LIGHTS 相同
+#define RENDER_QUEUE_MAX_OBJECT_LIGHTS 8
+
+class CLightManager;
+
+enum RenderPass {
+    RENDER_PASS_OPAQUE      = 0,    // 關閉混合，粗略由近到遠，同一深度區間內依狀態分組
+    RENDER_PASS_TRANSPARENT = 1     // 開啟混合且不寫入深度，由遠到近，深度優先於狀態
+};
+
+struct DrawPacket {
+    GLuint    program = 0;
+    GLuint    vao = 0;
+    GLuint    positionVao = 0;      // 只有位置 stream 的 VAO (索引與 vao 相同)，深度預先繪製使用，0 代表使用 vao
+    GLsizei   indexCount = 0;
+    GLsizei   instanceCount = 0;    // > 0 時以 glDrawElementsInstanced 繪製並設定 uInstanced
+    const CMultiDrawRun* multiDraw = nullptr;   // 非 nullptr 時改以 multi-draw 送出 (indexCount 不使用)
+    glm::mat4 mxModel = glm::mat4(1.0f);
+    GLint     shadingMode = -1;     // -1 代表不設定 uShadingMode
+    bool      useColor = false;     // 是否設定 ui4Color
+    glm::vec4 color = glm::vec4(1.0f);
+    GLint     materialIndex = -1;   // -1 代表沒有材質，shader 使用材質表索引 0 的預設材質
+    GLuint    textures[4] = { 0, 0, 0, 0 };   // 依序綁定到貼圖單元 0~3，0 代表不綁定
+    RenderPass pass = RENDER_PASS_OPAQUE;
+    bool      alphaTested = false;  // 不透明但 fragment shader 會 discard (Mesh::alphaTested)，不參與深度預先繪製
+    glm::vec3 center = glm::vec3(0.0f);  // 計算排序深度的點 (mxModel 前的區域座標)，例如網格 AABB 的中心
+    float     radius = -1.0f;       // 以 center 為球心的包圍球半徑 (區域座標)，< 0 代表未知，此時不建立光源列表
+};
+
+class CRenderQueue {
+public:
+    CRenderQueue() = default;
+
+    // 每個 frame 開始送出前呼叫，viewPos 用來計算深度
+    void begin(const glm::vec3& viewPos);
+    void submit(const DrawPacket& packet);
+    // 排序後依序繪製：先畫所有不透明的 packet，再開啟混合畫透明的
+    void execute();
+
+    int getPacketCount() const { return static_cast<int>(_packets.size()); }
+    int getTransparentCount() const { return _transparentCount; }
+
+    // 深度預先繪製：shadingProgram 與它的所有變體 (CShaderPool::getVariants) 的不透明 packet 先以 depthProgram 畫深度，
+    // 兩者的 vertex shader 必須以相同的算式與 invariant gl_Position 計算位置；
+    // depthProgram 不做 alpha 測試，alphaTested 的 packet 不參與，主要 pass 中以 GL_LESS 寫入深度
+    void setDepthPrepass(GLuint depthProgram, GLuint shadingProgram);
+    void setDepthPrepassEnabled(bool enabled) { _prepassEnabled = enabled; }
+    bool isDepthPrepassEnabled() const { return _prepassEnabled && _depthProgram != 0; }
+
+    // 重疊繪製計數：以 GL_SAMPLES_PASSED 查詢主要 pass 中不透明 packet 通過深度測試 (執行光照 shader) 的 sample 數，
+    // 讀取兩個 frame 前的結果所以不會等待 GPU，不需要畫面輸出也能比較開關預先繪製的差異
+    void setOverdrawCounterEnabled(bool enabled) { _overdrawEnabled = enabled; }
+    GLuint getShadedSamples() const { return _shadedSamples; }
+    // 每個像素平均執行光照 shader 的次數，1 代表沒有重疊繪製
+    float getOverdraw() const { return _viewportPixels > 0 ? static_cast<float>(_shadedSamples) / _viewportPixels : 0.0f; }
+    int getPrepassCount() const { return _prepassCount; }
+
+    // 逐物件的光源列表：shadingProgram 與它的變體的 packet 以 lights 找出會照到包圍球的光源，
+    // 以 uObjectLights / uObjectLightCount 送出，shader 只計算列表中的光源；
+    // 沒有包圍球、instanced 或超過 RENDER_QUEUE_MAX_OBJECT_LIGHTS 個光源的 packet 送出 -1，由 shader 改用 cluster
+    void setObjectLights(const CLightManager* lights, GLuint shadingProgram);
+    void setObjectLightsEnabled(bool enabled) { _objectLightsEnabled = enabled; }
+    bool isObjectLightsEnabled() const { return _objectLightsEnabled && _lightManager != nullptr; }
+    // 上一個 frame 有列表的 packet 數、沒有列表的 packet 數與每個 packet 平均的光源數
+    int getObjectLightPacketCount() const { return _objectLightPackets; }
+    int getObjectLightFallbackCount() const { return _objectLightFallbacks; }
+    float getAverageObjectLights() const {
+        return _objectLightPackets > 0 ? static_cast<float>(_objectLightTotal) / _objectLightPackets : 0.0f;
+    }
+
+private:
+    // 每個 program 的 uniform handle，第一次用到時解析
+    struct ProgramHandles {
+        CUniform<glm::mat4> modelMatrix;
+        CUniform<int>       shadingMode;
+        CUniform<glm::vec4> color;
+        CUniform<int>       materialIndex;
+        CUniform<int>       instanced;
+        CUniform<int>       objectLightCount;
+        GLint objectLights = -1;        // uObjectLights[0] 的位置
+        GLint lastShadingMode = -1;     // 與上一次相同時不重送
+        GLint lastMaterialIndex = -2;   // -1 也是有效值 (沒有材質)，第一個 packet 一定會送出
+        GLint lastInstanced = -1;
+        GLint lastObjectLightCount = -1;
+    };
+
+    uint64_t makeKey(const DrawPacket& packet) const;
+    void radixSort();
+    ProgramHandles& getHandles(GLuint program);
+    // 設定 model matrix 與 uInstanced 後以 vao 送出 draw call
+    void draw(const DrawPacket& packet, ProgramHandles& h, GLuint vao);
+    bool usesPrepass(const DrawPacket& packet) const;
+    void depthPrepass(size_t opaqueCount);
+    void beginOverdrawQuery();
+    void endOverdrawQuery();
+    // 設定 packet 的光源列表，program 不是 shadingProgram 的變體時不處理
+    void setObjectLightList(const DrawPacket& packet, ProgramHandles& h);
+    void resetObjectLightLists();
+
+    glm::vec3 _viewPos = glm::vec3(0.0f);
+    std::vector<DrawPacket> _packets;
+    std::vector<uint64_t> _keys, _keysScratch;
+    std::vector<uint32_t> _order, _orderScratch;
+    std::unordered_map<GLuint, ProgramHandles> _handles;
+    int _handlesReloadCount = 0;
+    int _transparentCount = 0;
+
+    GLuint _depthProgram = 0, _prepassShadingProgram = 0;
+    std::vector<GLuint> _prepassPrograms;    // 本 frame 的 shadingProgram 變體
+    bool _prepassEnabled = false;
+    int _prepassCount = 0;
+
+    bool _overdrawEnabled = false;
+    GLuint _samplesQueries[2] = { 0, 0 };
+    bool _queryIssued[2] = { false, false };
+    int _queryFrame = 0;
+    GLuint _shadedSamples = 0;
+    int _viewportPixels = 0;
+
+    const CLightManager* _lightManager = nullptr;
+    GLuint _objectLightShadingProgram = 0;
+    std::vector<GLuint> _objectLightPrograms;   // 本 frame 的 shadingProgram 變體
+    bool _objectLightsEnabled = false;
+    int _objectLightPackets = 0;
+    int _objectLightFallbacks = 0;
+    int _objectLightTotal = 0;
+};
@@ -0,0 +1,324 @@
+//  CSceneBVH.cpp
+#include <algorithm>
+#include <cfloat>
+#include "CSceneBVH.h"
+
+namespace {
+	// 以表面積作為插入位置的成本 (SAH)
+	float surfaceArea(const glm::vec3& bmin, const glm::vec3& bmax) {
+		glm::vec3 d = bmax - bmin;
+		return 2.0f * (d.x * d.y + d.y * d.z + d.z * d.x);
+	}
+	bool overlaps(const glm::vec3& aMin, const glm::vec3& aMax, const glm::vec3& bMin, const glm::vec3& bMax) {
+		return aMin.x <= bMax.x && aMax.x >= bMin.x &&
+			   aMin.y <= bMax.y && aMax.y >= bMin.y &&
+			   aMin.z <= bMax.z && aMax.z >= bMin.z;
+	}
+	bool contains(const glm::vec3& outerMin, const glm::vec3& outerMax, const glm::vec3& bmin, const glm::vec3& bmax) {
+		return outerMin.x <= bmin.x && outerMin.y <= bmin.y && outerMin.z <= bmin.z &&
+			   bmax.x <= outerMax.x && bmax.y <= outerMax.y && bmax.z <= outerMax.z;
+	}
+	// slab 測試，回傳射線進入 AABB 的距離，沒有相交時為 FLT_MAX
+	// 方向分量為 0 的軸另外處理：原點剛好在 slab 平面上時 0 * inf 會得到 NaN，
+	// 所以該軸只檢查原點是否落在 slab 之間
+	float rayEnter(const glm::vec3& origin, const glm::vec3& direction, const glm::vec3& invDir,
+				   const glm::vec3& bmin, const glm::vec3& bmax, float maxDistance) {
+		float enter = 0.0f, exit = maxDistance;
+		for (int axis = 0; axis < 3; axis++) {
+			if (direction[axis] == 0.0f) {
+				if (origin[axis] < bmin[axis] || origin[axis] > bmax[axis]) return FLT_MAX;
+				continue;
+			}
+			float t1 = (bmin[axis] - origin[axis]) * invDir[axis];
+			float t2 = (bmax[axis] - origin[axis]) * invDir[axis];
+			enter = std::max(enter, std::min(t1, t2));
+			exit  = std::min(exit, std::max(t1, t2));
+		}
+		return enter <= exit ? enter : FLT_MAX;
+	}
+}
+
+CSceneBVH& CSceneBVH::getInstance() {
+	static CSceneBVH instance;
+	return instance;
+}
+
+int CSceneBVH::allocateNode() {
+	if (_freeList == BVH_NULL_NODE) {
+		_nodes.emplace_back();
+		return static_cast<int>(_nodes.size()) - 1;
+	}
+	int node = _freeList;
+	_freeList = _nodes[node].parent;
+	_nodes[node] = Node();
+	return node;
+}
+
+void CSceneBVH::freeNode(int node) {
+	_nodes[node].parent = _freeList;
+	_nodes[node].height = -1;
+	_freeList = node;
+}
+
+int CSceneBVH::insert(const glm::vec3& bmin, const glm::vec3& bmax, int userData, unsigned int flags) {
+	int proxy = allocateNode();
+	Node& node = _nodes[proxy];
+	node.tightMin = bmin; node.tightMax = bmax;
+	node.fatMin = bmin - glm::vec3(BVH_FAT_MARGIN);
+	node.fatMax = bmax + glm::vec3(BVH_FAT_MARGIN);
+	node.userData = userData;
+	node.flags = flags;
+	insertLeaf(proxy);
+	_proxyCount++;
+	return proxy;
+}
+
+bool CSceneBVH::update(int proxy, const glm::vec3& bmin, const glm::vec3& bmax) {
+	Node& node = _nodes[proxy];
+	node.tightMin = bmin; node.tightMax = bmax;
+	if (contains(node.fatMin, node.fatMax, bmin, bmax)) return false;
+
+	removeLeaf(proxy);
+	_nodes[proxy].fatMin = bmin - glm::vec3(BVH_FAT_MARGIN);
+	_nodes[proxy].fatMax = bmax + glm::vec3(BVH_FAT_MARGIN);
+	insertLeaf(proxy);
+	return true;
+}
+
+void CSceneBVH::remove(int proxy) {
+	removeLeaf(proxy);
+	freeNode(proxy);
+	_proxyCount--;
+}
+
+void CSceneBVH::clear() {
+	_nodes.clear();
+	_root = _freeList = BVH_NULL_NODE;
+	_proxyCount = 0;
+}
+
+void CSceneBVH::refreshNode(int index) {
+	Node& node = _nodes[index];
+	const Node& a = _nodes[node.child1];
+	const Node& b = _nodes[node.child2];
+	node.fatMin = glm::min(a.fatMin, b.fatMin);
+	node.fatMax = glm::max(a.fatMax, b.fatMax);
+	node.height = 1 + std::max(a.height, b.height);
+	node.flags = a.flags | b.flags;
+}
+
+void CSceneBVH::refitAncestors(int index) {
+	while (index != BVH_NULL_NODE) {
+		index = balance(index);
+		refreshNode(index);
+		index = _nodes[index].parent;
+	}
+}
+
+void CSceneBVH::insertLeaf(int leaf) {
+	if (_root == BVH_NULL_NODE) {
+		_root = leaf;
+		_nodes[leaf].parent = BVH_NULL_NODE;
+		return;
+	}
+
+	// 由根往下，選擇加入後表面積增加最少的位置
+	const glm::vec3 leafMin = _nodes[leaf].fatMin, leafMax = _nodes[leaf].fatMax;
+	int index = _root;
+	while (!_nodes[index].isLeaf()) {
+		const Node& node = _nodes[index];
+		float area = surfaceArea(node.fatMin, node.fatMax);
+		float combined = surfaceArea(glm::min(node.fatMin, leafMin), glm::max(node.fatMax, leafMax));
+		float cost = 2.0f * combined;                       // 在這裡建立新的父節點
+		float inheritance = 2.0f * (combined - area);       // 往下走時祖先增加的面積
+
+		float childCost[2];
+		int children[2] = { node.child1, node.child2 };
+		for (int c = 0; c < 2; c++) {
+			const Node& child = _nodes[children[c]];
+			float enlarged = surfaceArea(glm::min(child.fatMin, leafMin), glm::max(child.fatMax, leafMax));
+			childCost[c] = (child.isLeaf() ? enlarged : enlarged - surfaceArea(child.fatMin, child.fatMax)) + inheritance;
+		}
+		if (cost < childCost[0] && cost < childCost[1]) break;
+		index = (childCost[0] < childCost[1]) ? children[0] : children[1];
+	}
+
+	// 以新的內部節點取代 sibling，leaf 與 sibling 成為它的子節點
+	int sibling = index;
+	int oldParent = _nodes[sibling].parent;
+	int newParent = allocateNode();
+	_nodes[newParent].parent = oldParent;
+	_nodes[newParent].child1 = sibling;
+	_nodes[newParent].child2 = leaf;
+	_nodes[sibling].parent = newParent;
+	_nodes[leaf].parent = newParent;
+	if (oldParent == BVH_NULL_NODE) _root = newParent;
+	else if (_nodes[oldParent].child1 == sibling) _nodes[oldParent].child1 = newParent;
+	else _nodes[oldParent].child2 = newParent;
+
+	refitAncestors(newParent);
+}
+
+void CSceneBVH::removeLeaf(int leaf) {
+	if (leaf == _root) {
+		_root = BVH_NULL_NODE;
+		return;
+	}
+	int parent = _nodes[leaf].parent;
+	int grandParent = _nodes[parent].parent;
+	int sibling = (_nodes[parent].child1 == leaf) ? _nodes[parent].child2 : _nodes[parent].child1;
+
+	// 父節點由 sibling 取代
+	if (grandParent == BVH_NULL_NODE) {
+		_root = sibling;
+		_nodes[sibling].parent = BVH_NULL_NODE;
+	} else {
+		if (_nodes[grandParent].child1 == parent) _nodes[grandParent].child1 = sibling;
+		else _nodes[grandParent].child2 = sibling;
+		_nodes[sibling].parent = grandParent;
+	}
+	freeNode(parent);
+	_nodes[leaf].parent = BVH_NULL_NODE;
+	refitAncestors(grandParent);
+}
+
+int CSceneBVH::balance(int iA) {
+	// 左右子樹高度差超過 1 時，把較高的子節點旋轉上來，回傳旋轉後這個位置的節點
+	Node& A = _nodes[iA];
+	if (A.isLeaf() || A.height < 2) return iA;
+
+	int iB = A.child1, iC = A.child2;
+	int diff = _nodes[iC].height - _nodes[iB].height;
+	if (diff > -2 && diff < 2) return iA;
+
+	// up 為要旋轉上來的子節點，A 成為 up 的子節點
+	int iUp = (diff > 0) ? iC : iB;
+	Node& up = _nodes[iUp];
+	int iF = up.child1, iG = up.child2;
+
+	up.child1 = iA;
+	up.parent = A.parent;
+	A.parent = iUp;
+	if (up.parent == BVH_NULL_NODE) _root = iUp;
+	else if (_nodes[up.parent].child1 == iA) _nodes[up.parent].child1 = iUp;
+	else _nodes[up.parent].child2 = iUp;
+
+	// up 較高的子節點留在 up 下面，較矮的交給 A 取代原本 up 的位置
+	int iKeep = (_nodes[iF].height > _nodes[iG].height) ? iF : iG;
+	int iGive = (iKeep == iF) ? iG : iF;
+	up.child2 = iKeep;
+	if (diff > 0) A.child2 = iGive;
+	else A.child1 = iGive;
+	_nodes[iGive].parent = iA;
+
+	refreshNode(iA);
+	refreshNode(iUp);
+	return iUp;
+}
+
+void CSceneBVH::collectLeaves(int node, unsigned int mask, std::vector<int>& results) const {
+	// 整個子樹都在視錐內，不需要再測試邊界
+	size_t base = _stack.size();
+	_stack.push_back(node);
+	while (_stack.size() > base) {
+		int index = _stack.back();
+		_stack.pop_back();
+		const Node& n = _nodes[index];
+		_visited++;
+		if ((n.flags & mask) == 0) continue;
+		if (n.isLeaf()) results.push_back(index);
+		else { _stack.push_back(n.child1); _stack.push_back(n.child2); }
+	}
+}
+
+void CSceneBVH::queryAABB(const glm::vec3& bmin, const glm::vec3& bmax, unsigned int mask, std::vector<int>& results) const {
+	results.clear();
+	_visited = 0;
+	if (_root == BVH_NULL_NODE) return;
+	_stack.clear();
+	_stack.push_back(_root);
+	while (!_stack.empty()) {
+		int index = _stack.back();
+		_stack.pop_back();
+		const Node& node = _nodes[index];
+		_visited++;
+		if ((node.flags & mask) == 0 || !overlaps(node.fatMin, node.fatMax, bmin, bmax)) continue;
+		if (node.isLeaf()) {
+			if (overlaps(node.tightMin, node.tightMax, bmin, bmax)) results.push_back(index);
+		} else {
+			_stack.push_back(node.child1);
+			_stack.push_back(node.child2);
+		}
+	}
+}
+
+void CSceneBVH::querySphere(const glm::vec3& center, float radius, unsigned int mask, std::vector<int>& results) const {
+	// 先以球的 AABB 找出候選，再與物件的 AABB 做精確測試
+	queryAABB(center - glm::vec3(radius), center + glm::vec3(radius), mask, results);
+	results.erase(std::remove_if(results.begin(), results.end(), [&](int proxy) {
+		glm::vec3 d = center - glm::clamp(center, _nodes[proxy].tightMin, _nodes[proxy].tightMax);
+		return glm::dot(d, d) >= radius * radius;
+	}), results.end());
+}
+
+void CSceneBVH::queryFrustum(const CFrustum& frustum, unsigned int mask, std::vector<int>& results) const {
+	results.clear();
+	_visited = 0;
+	if (_root == BVH_NULL_NODE) return;
+	_stack.clear();
+	_stack.push_back(_root);
+	while (!_stack.empty()) {
+		int index = _stack.back();
+		_stack.pop_back();
+		const Node& node = _nodes[index];
+		_visited++;
+		if ((node.flags & mask) == 0) continue;
+		if (node.isLeaf()) {
+			if (frustum.testAABB(node.tightMin, node.tightMax)) results.push_back(index);
+			continue;
+		}
+		CFrustum::Result result = frustum.classifyAABB(node.fatMin, node.fatMax);
+		if (result == CFrustum::OUTSIDE) continue;
+		if (result == CFrustum::INSIDE) {
+			collectLeaves(node.child1, mask, results);
+			collectLeaves(node.child2, mask, results);
+		} else {
+			_stack.push_back(node.child1);
+			_stack.push_back(node.child2);
+		}
+	}
+}
+
+int CSceneBVH::raycast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, unsigned int mask,
+					   float& hitDistance, float inflate) const {
+	_visited = 0;
+	int hit = BVH_NULL_NODE;
+	if (_root == BVH_NULL_NODE) return hit;
+
+	// 方向分量為 0 的軸不會用到 invDir (見 rayEnter)
+	glm::vec3 invDir(direction.x != 0.0f ? 1.0f / direction.x : 0.0f,
+					 direction.y != 0.0f ? 1.0f / direction.y : 0.0f,
+					 direction.z != 0.0f ? 1.0f / direction.z : 0.0f);
+	glm::vec3 grow(inflate);
+	float best = maxDistance;
+	_stack.clear();
+	_stack.push_back(_root);
+	while (!_stack.empty()) {
+		int index = _stack.back();
+		_stack.pop_back();
+		const Node& node = _nodes[index];
+		_visited++;
+		if ((node.flags & mask) == 0) continue;
+		// 比目前最近的擊中點還遠的子樹直接略過
+		if (rayEnter(origin, direction, invDir, node.fatMin - grow, node.fatMax + grow, best) == FLT_MAX) continue;
+		if (node.isLeaf()) {
+			float t = rayEnter(origin, direction, invDir, node.tightMin - grow, node.tightMax + grow, best);
+			if (t != FLT_MAX) { best = t; hit = index; }
+		} else {
+			_stack.push_back(node.child1);
+			_stack.push_back(node.child2);
+		}
+	}
+	if (hit != BVH_NULL_NODE) hitDistance = best;
+	return hit;
+}
@@ -0,0 +1,81 @@
+//  CSceneBVH.h
+//  場景物件的動態 BVH (AABB tree)：每個物件是一個葉節點，節點邊界是放大過的 (fat) AABB，
+//  物件移動但仍在 fat AABB 內時樹不需要修改，超出時才移除並重新插入，沿路更新祖先的邊界並做旋轉平衡，
+//  視錐剔除與 CollisionManager 查詢同一棵樹，查詢成本隨物件數對數成長；只用到 glm，不需要 GL context
+
+#pragma once
+
+#include <vector>
+#include <glm/glm.hpp>
+#include "CFrustum.h"
+
+#define BVH_NULL_NODE  -1
+#define BVH_FAT_MARGIN 0.2f   // 葉節點 AABB 每個方向放大的距離
+
+// 物件種類，查詢時以 mask 篩選
+enum SceneObjectFlags : unsigned int {
+	SCENE_RENDERABLE = 1,     // 參與視錐剔除的繪製物件
+	SCENE_WALL       = 2,     // CollisionManager 的牆壁
+	SCENE_OBSTACLE   = 4,     // CollisionManager 的障礙物
+	SCENE_COLLIDER   = SCENE_WALL | SCENE_OBSTACLE
+};
+
+class CSceneBVH {
+public:
+	static CSceneBVH& getInstance();
+
+	// 回傳 proxy 編號，userData 由呼叫端定義 (例如模型或牆壁的索引)
+	int  insert(const glm::vec3& bmin, const glm::vec3& bmax, int userData, unsigned int flags);
+	// 物件移動後呼叫，回傳 true 代表超出 fat AABB 而重新插入
+	bool update(int proxy, const glm::vec3& bmin, const glm::vec3& bmax);
+	void remove(int proxy);
+	void clear();
+
+	int getUserData(int proxy) const { return _nodes[proxy].userData; }
+	unsigned int getFlags(int proxy) const { return _nodes[proxy].flags; }
+	void getBounds(int proxy, glm::vec3& bmin, glm::vec3& bmax) const { bmin = _nodes[proxy].tightMin; bmax = _nodes[proxy].tightMax; }
+	int getProxyCount() const { return _proxyCount; }
+	int getHeight() const { return _root == BVH_NULL_NODE ? 0 : _nodes[_root].height; }
+	int getVisitedNodeCount() const { return _visited; }   // 上一次查詢走訪的節點數
+
+	// 查詢結果為 proxy 編號 (results 會先清空)，只回傳 flags 與 mask 有交集的物件
+	void queryAABB(const glm::vec3& bmin, const glm::vec3& bmax, unsigned int mask, std::vector<int>& results) const;
+	void querySphere(const glm::vec3& center, float radius, unsigned int mask, std::vector<int>& results) const;
+	void queryFrustum(const CFrustum& frustum, unsigned int mask, std::vector<int>& results) const;
+	// 回傳最近擊中的 proxy，沒有擊中時為 BVH_NULL_NODE；inflate 會把每個物件的 AABB 放大 (例如碰撞球半徑)
+	int raycast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, unsigned int mask,
+				float& hitDistance, float inflate = 0.0f) const;
+
+private:
+	CSceneBVH() = default;
+	CSceneBVH(const CSceneBVH&) = delete;
+	CSceneBVH& operator=(const CSceneBVH&) = delete;
+
+	struct Node {
+		glm::vec3 fatMin, fatMax;       // 內部節點為子節點的聯集
+		glm::vec3 tightMin, tightMax;   // 只有葉節點使用：物件實際的 AABB
+		int parent = BVH_NULL_NODE;     // 在 free list 中時為下一個空節點
+		int child1 = BVH_NULL_NODE, child2 = BVH_NULL_NODE;
+		int height = 0;                 // 葉節點為 0，空節點為 -1
+		int userData = 0;
+		unsigned int flags = 0;         // 內部節點為子樹中所有 flags 的聯集，可整個子樹略過
+		bool isLeaf() const { return child1 == BVH_NULL_NODE; }
+	};
+
+	int  allocateNode();
+	void freeNode(int node);
+	void insertLeaf(int leaf);
+	void removeLeaf(int leaf);
+	int  balance(int node);
+	void refreshNode(int node);
+	// 從 node 往上更新邊界與高度，並在需要時旋轉
+	void refitAncestors(int node);
+	void collectLeaves(int node, unsigned int mask, std::vector<int>& results) const;
+
+	std::vector<Node> _nodes;
+	int _root = BVH_NULL_NODE;
+	int _freeList = BVH_NULL_NODE;
+	int _proxyCount = 0;
+	mutable std::vector<int> _stack;    // 查詢用的走訪堆疊，保留容量避免每次配置
+	mutable int _visited = 0;
+};
@@ -0,0 +1,410 @@
+//  CSceneFile.cpp
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <cstring>
+#include <cstdlib>
+#include <filesystem>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include "CSceneFile.h"
+
+namespace {
+
+// 文字檔剖析的結果，寫出時依序成為二進位檔的各個陣列
+struct SceneCompiler {
+    std::vector<SceneModelRecord>    models;
+    std::vector<SceneMaterialRecord> materials;
+    std::vector<SceneNodeRecord>     nodes;
+    std::vector<SceneInstanceRecord> instances;
+    std::vector<SceneLightRecord>    lights;
+    std::vector<std::string> modelNames, materialNames, nodeNames, lightNames;
+    std::string strings;
+
+    uint32_t addString(const std::string& text) {
+        uint32_t offset = static_cast<uint32_t>(strings.size());
+        strings += text;
+        strings += '\0';
+        return offset;
+    }
+};
+
+int findName(const std::vector<std::string>& names, const std::string& name) {
+    for (size_t i = 0; i < names.size(); i++) {
+        if (names[i] == name) return static_cast<int>(i);
+    }
+    return SCENE_NULL_INDEX;
+}
+
+bool isNumber(const std::string& token) {
+    if (token.empty()) return false;
+    char* end = nullptr;
+    std::strtof(token.c_str(), &end);
+    return *end == '\0';
+}
+
+// 從 tokens[pos] 開始讀 count 個數字
+bool readFloats(const std::vector<std::string>& tokens, size_t& pos, float* out, int count) {
+    for (int i = 0; i < count; i++, pos++) {
+        if (pos >= tokens.size() || !isNumber(tokens[pos])) return false;
+        out[i] = std::strtof(tokens[pos].c_str(), nullptr);
+    }
+    return true;
+}
+
+void setNodeIdentity(SceneNodeRecord& node) {
+    node.position[0] = node.position[1] = node.position[2] = 0.0f;
+    node.rotation[0] = node.rotation[1] = node.rotation[2] = 0.0f;
+    node.rotation[3] = 1.0f;
+    node.scale[0] = node.scale[1] = node.scale[2] = 1.0f;
+}
+
+// pos / rot / scale；遇到其他關鍵字時停下，回傳 false 代表數字不足
+bool readTransform(const std::vector<std::string>& tokens, size_t& pos, SceneNodeRecord& node) {
+    while (pos < tokens.size()) {
+        const std::string& key = tokens[pos];
+        if (key == "pos") {
+            pos++;
+            if (!readFloats(tokens, pos, node.position, 3)) return false;
+        } else if (key == "rot") {
+            pos++;
+            float angleAxis[4];
+            if (!readFloats(tokens, pos, angleAxis, 4)) return false;
+            glm::vec3 axis(angleAxis[1], angleAxis[2], angleAxis[3]);
+            if (glm::length(axis) <= 0.0f) return false;
+            glm::quat q = glm::angleAxis(glm::radians(angleAxis[0]), glm::normalize(axis));
+            node.rotation[0] = q.x; node.rotation[1] = q.y; node.rotation[2] = q.z; node.rotation[3] = q.w;
+        } else if (key == "scale") {
+            pos++;
+            if (!readFloats(tokens, pos, node.scale, 1)) return false;
+            // 只有一個數字時為等比例縮放
+            if (pos + 1 < tokens.size() && isNumber(tokens[pos]) && isNumber(tokens[pos + 1])) {
+                if (!readFloats(tokens, pos, node.scale + 1, 2)) return false;
+            } else {
+                node.scale[1] = node.scale[2] = node.scale[0];
+            }
+        } else {
+            break;
+        }
+    }
+    return true;
+}
+
+template <typename T>
+void writeArray(std::ofstream& file, const std::vector<T>& records) {
+    if (!records.empty()) file.write(reinterpret_cast<const char*>(records.data()), records.size() * sizeof(T));
+}
+
+} // namespace
+
+CSceneFile::CSceneFile()
+    : _mapping(nullptr), _mappingSize(0), _header(nullptr), _models(nullptr), _materials(nullptr),
+      _nodes(nullptr), _instances(nullptr), _lights(nullptr), _strings(nullptr) {}
+
+CSceneFile::~CSceneFile() {
+    close();
+}
+
+bool CSceneFile::load(const std::string& textPath, const std::string& binaryPath) {
+    std::error_code ec;
+    bool hasText = std::filesystem::exists(textPath, ec);
+    bool hasBinary = std::filesystem::exists(binaryPath, ec);
+    bool compiled = false;
+    if (hasText && (!hasBinary ||
+        std::filesystem::last_write_time(textPath, ec) > std::filesystem::last_write_time(binaryPath, ec))) {
+        compiled = compile(textPath, binaryPath);
+        if (!compiled) {
+            if (!hasBinary) return false;
+            std::cerr << "CSceneFile: keeping the previous " << binaryPath << std::endl;
+        }
+    }
+    if (open(binaryPath)) return true;
+    // 舊版本或損毀的二進位檔即使比文字檔新也無法使用，由文字檔重新編譯一次
+    if (!hasText || compiled) return false;
+    std::cerr << "CSceneFile: recompiling " << binaryPath << " from " << textPath << std::endl;
+    return compile(textPath, binaryPath) && open(binaryPath);
+}
+
+bool CSceneFile::compile(const std::string& textPath, const std::string& binaryPath) {
+    std::ifstream text(textPath);
+    if (!text.is_open()) {
+        std::cerr << "CSceneFile: cannot open " << textPath << std::endl;
+        return false;
+    }
+
+    SceneCompiler scene;
+    scene.addString(""); // 位移 0 為空字串，沒有名稱的節點共用
+    std::string line;
+    int lineNumber = 0;
+    auto fail = [&](const std::string& message) {
+        std::cerr << textPath << ":" << lineNumber << ": " << message << std::endl;
+        return false;
+    };
+    while (std::getline(text, line)) {
+        lineNumber++;
+        size_t comment = line.find('#');
+        if (comment != std::string::npos) line.erase(comment);
+        std::istringstream stream(line);
+        std::vector<std::string> tokens;
+        for (std::string token; stream >> token;) tokens.push_back(token);
+        if (tokens.empty()) continue;
+
+        const std::string& kind = tokens[0];
+        size_t pos = 1;
+        if (kind == "model") {
+            if (tokens.size() < 3) return fail("model needs a name and a path");
+            if (findName(scene.modelNames, tokens[1]) != SCENE_NULL_INDEX) return fail("duplicate model " + tokens[1]);
+            SceneModelRecord model;
+            model.name = scene.addString(tokens[1]);
+            model.path = scene.addString(tokens[2]);
+            model.flags = 0;
+            for (pos = 3; pos < tokens.size(); pos++) {
+                if (tokens[pos] == "dynamic") model.flags |= SCENE_MODEL_DYNAMIC;
+                else return fail("unknown model flag " + tokens[pos]);
+            }
+            scene.modelNames.push_back(tokens[1]);
+            scene.models.push_back(model);
+        } else if (kind == "material") {
+            if (tokens.size() < 2) return fail("material needs a name");
+            SceneMaterialRecord material;
+            material.name = scene.addString(tokens[1]);
+            // 與 CMaterial 的預設值相同
+            for (int i = 0; i < 4; i++) {
+                material.ambient[i] = 0.2f; material.diffuse[i] = 0.8f; material.specular[i] = 1.0f;
+            }
+            material.shininess = 32.0f;
+            for (pos = 2; pos < tokens.size();) {
+                const std::string key = tokens[pos++];
+                bool ok;
+                if (key == "ambient") ok = readFloats(tokens, pos, material.ambient, 4);
+                else if (key == "diffuse") ok = readFloats(tokens, pos, material.diffuse, 4);
+                else if (key == "specular") ok = readFloats(tokens, pos, material.specular, 4);
+                else if (key == "shininess") ok = readFloats(tokens, pos, &material.shininess, 1);
+                else return fail("unknown material field " + key);
+                if (!ok) return fail("missing numbers after " + key);
+            }
+            scene.materialNames.push_back(tokens[1]);
+            scene.materials.push_back(material);
+        } else if (kind == "node" || kind == "instance") {
+            bool isInstance = (kind == "instance");
+            size_t minTokens = isInstance ? 4 : 3;
+            if (tokens.size() < minTokens) return fail(kind + " needs a name" + (isInstance ? ", a model" : "") + " and a parent");
+            const std::string& name = tokens[1];
+            if (name != "-" && findName(scene.nodeNames, name) != SCENE_NULL_INDEX) return fail("duplicate node " + name);
+            SceneInstanceRecord instance = { SCENE_NULL_INDEX, SCENE_NULL_INDEX, 0 };
+            if (isInstance) {
+                instance.model = findName(scene.modelNames, tokens[2]);
+                if (instance.model == SCENE_NULL_INDEX) return fail("unknown model " + tokens[2]);
+            }
+            const std::string& parentName = tokens[minTokens - 1];
+            SceneNodeRecord node;
+            setNodeIdentity(node);
+            node.name = (name == "-") ? 0 : scene.addString(name);
+            node.parent = SCENE_NULL_INDEX;
+            if (parentName != "-") {
+                node.parent = findName(scene.nodeNames, parentName);
+                if (node.parent == SCENE_NULL_INDEX) return fail("unknown parent node " + parentName);
+            }
+            pos = minTokens;
+            if (!readTransform(tokens, pos, node)) return fail("bad transform");
+            for (; pos < tokens.size(); pos++) {
+                if (isInstance && tokens[pos] == "noshadow") instance.flags |= SCENE_INSTANCE_NO_SHADOW;
+                else if (isInstance && tokens[pos] == "occluder") instance.flags |= SCENE_INSTANCE_OCCLUDER;
+                else return fail("unknown " + kind + " field " + tokens[pos]);
+            }
+            scene.nodeNames.push_back(name == "-" ? "" : name);
+            scene.nodes.push_back(node);
+            if (isInstance) {
+                instance.node = static_cast<int32_t>(scene.nodes.size()) - 1;
+                scene.instances.push_back(instance);
+            }
+        } else if (kind == "light") {
+            if (tokens.size() < 4) return fail("light needs a type, a name and a parent");
+            SceneLightRecord light;
+            std::memset(&light, 0, sizeof(light));
+            if (tokens[1] == "point") light.type = SCENE_LIGHT_POINT;
+            else if (tokens[1] == "spot") light.type = SCENE_LIGHT_SPOT;
+            else return fail("unknown light type " + tokens[1]);
+            if (findName(scene.lightNames, tokens[2]) != SCENE_NULL_INDEX) return fail("duplicate light " + tokens[2]);
+            light.name = scene.addString(tokens[2]);
+            light.parent = SCENE_NULL_INDEX;
+            if (tokens[3] != "-") {
+                light.parent = findName(scene.nodeNames, tokens[3]);
+                if (light.parent == SCENE_NULL_INDEX) return fail("unknown parent node " + tokens[3]);
+            }
+            light.ambient[3] = light.diffuse[3] = light.specular[3] = 1.0f;
+            light.attenuation[0] = 1.0f;
+            bool hasTarget = false;
+            for (pos = 4; pos < tokens.size();) {
+                const std::string key = tokens[pos++];
+                bool ok = true;
+                if (key == "pos") ok = readFloats(tokens, pos, light.position, 3);
+                else if (key == "target") { ok = readFloats(tokens, pos, light.target, 3); hasTarget = true; }
+                else if (key == "cutoff") ok = readFloats(tokens, pos, light.cutoff, 3);
+                else if (key == "ambient") ok = readFloats(tokens, pos, light.ambient, 4);
+                else if (key == "diffuse") ok = readFloats(tokens, pos, light.diffuse, 4);
+                else if (key == "specular") ok = readFloats(tokens, pos, light.specular, 4);
+                else if (key == "atten") ok = readFloats(tokens, pos, light.attenuation, 3);
+                else if (key == "shadow") light.flags |= SCENE_LIGHT_SHADOW;
+                else return fail("unknown light field " + key);
+                if (!ok) return fail("missing numbers after " + key);
+            }
+            if (light.type == SCENE_LIGHT_SPOT && (!hasTarget || light.cutoff[1] <= 0.0f))
+                return fail("spot light needs a target and a cutoff");
+            scene.lightNames.push_back(tokens[2]);
+            scene.lights.push_back(light);
+        } else {
+            return fail("unknown entry " + kind);
+        }
+    }
+
+    // 各陣列依序緊接在 header 之後 (每筆紀錄都是 4 bytes 的倍數)，字串表放在最後
+    SceneFileHeader header;
+    header.magic = SCENE_FILE_MAGIC;
+    header.version = SCENE_FILE_VERSION;
+    uint32_t offset = sizeof(SceneFileHeader);
+    auto place = [&offset](uint32_t& countField, uint32_t& offsetField, size_t count, size_t recordSize) {
+        countField = static_cast<uint32_t>(count);
+        offsetField = offset;
+        offset += static_cast<uint32_t>(count * recordSize);
+    };
+    place(header.modelCount, header.modelOffset, scene.models.size(), sizeof(SceneModelRecord));
+    place(header.materialCount, header.materialOffset, scene.materials.size(), sizeof(SceneMaterialRecord));
+    place(header.nodeCount, header.nodeOffset, scene.nodes.size(), sizeof(SceneNodeRecord));
+    place(header.instanceCount, header.instanceOffset, scene.instances.size(), sizeof(SceneInstanceRecord));
+    place(header.lightCount, header.lightOffset, scene.lights.size(), sizeof(SceneLightRecord));
+    place(header.stringSize, header.stringOffset, scene.strings.size(), 1);
+    header.fileSize = offset;
+
+    std::ofstream binary(binaryPath, std::ios::binary | std::ios::trunc);
+    if (!binary.is_open()) {
+        std::cerr << "CSceneFile: cannot write " << binaryPath << std::endl;
+        return false;
+    }
+    binary.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    writeArray(binary, scene.models);
+    writeArray(binary, scene.materials);
+    writeArray(binary, scene.nodes);
+    writeArray(binary, scene.instances);
+    writeArray(binary, scene.lights);
+    binary.write(scene.strings.data(), scene.strings.size());
+    if (!binary.good()) {
+        std::cerr << "CSceneFile: failed writing " << binaryPath << std::endl;
+        return false;
+    }
+    std::cout << "Compiled " << textPath << " -> " << binaryPath << " (" << scene.models.size() << " models, "
+              << scene.instances.size() << " instances, " << scene.nodes.size() << " nodes, "
+              << scene.lights.size() << " lights, " << scene.materials.size() << " materials)" << std::endl;
+    return true;
+}
+
+bool CSceneFile::open(const std::string& binaryPath) {
+    close();
+    int fd = ::open(binaryPath.c_str(), O_RDONLY);
+    if (fd < 0) {
+        std::cerr << "CSceneFile: cannot open " << binaryPath << std::endl;
+        return false;
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size < static_cast<off_t>(sizeof(SceneFileHeader))) {
+        ::close(fd);
+        std::cerr << "CSceneFile: " << binaryPath << " is too small" << std::endl;
+        return false;
+    }
+    size_t size = static_cast<size_t>(info.st_size);
+    void* mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd); // mapping 在 munmap 前一直有效
+    if (mapping == MAP_FAILED) {
+        std::cerr << "CSceneFile: mmap failed for " << binaryPath << std::endl;
+        return false;
+    }
+    _mapping = mapping;
+    _mappingSize = size;
+
+    // 檢查 header 與每個陣列都在檔案範圍內，之後的存取不需要再檢查
+    const SceneFileHeader* header = static_cast<const SceneFileHeader*>(mapping);
+    auto inside = [size](uint32_t offset, uint32_t count, size_t recordSize) {
+        return offset % 4 == 0 && offset <= size && count <= (size - offset) / recordSize;
+    };
+    bool valid = header->magic == SCENE_FILE_MAGIC && header->version == SCENE_FILE_VERSION && header->fileSize == size &&
+                 inside(header->modelOffset, header->modelCount, sizeof(SceneModelRecord)) &&
+                 inside(header->materialOffset, header->materialCount, sizeof(SceneMaterialRecord)) &&
+                 inside(header->nodeOffset, header->nodeCount, sizeof(SceneNodeRecord)) &&
+                 inside(header->instanceOffset, header->instanceCount, sizeof(SceneInstanceRecord)) &&
+                 inside(header->lightOffset, header->lightCount, sizeof(SceneLightRecord)) &&
+                 header->stringOffset <= size && header->stringSize <= size - header->stringOffset &&
+                 header->stringSize > 0;
+    const char* base = static_cast<const char*>(mapping);
+    if (valid) {
+        _header = header;
+        _models = reinterpret_cast<const SceneModelRecord*>(base + header->modelOffset);
+        _materials = reinterpret_cast<const SceneMaterialRecord*>(base + header->materialOffset);
+        _nodes = reinterpret_cast<const SceneNodeRecord*>(base + header->nodeOffset);
+        _instances = reinterpret_cast<const SceneInstanceRecord*>(base + header->instanceOffset);
+        _lights = reinterpret_cast<const SceneLightRecord*>(base + header->lightOffset);
+        _strings = base + header->stringOffset;
+        valid = _strings[header->stringSize - 1] == '\0';
+        uint32_t strings = header->stringSize;
+        for (int i = 0; valid && i < getModelCount(); i++)
+            valid = _models[i].name < strings && _models[i].path < strings;
+        for (int i = 0; valid && i < getMaterialCount(); i++)
+            valid = _materials[i].name < strings;
+        for (int i = 0; valid && i < getNodeCount(); i++)
+            valid = _nodes[i].name < strings && _nodes[i].parent >= SCENE_NULL_INDEX && _nodes[i].parent < i;
+        for (int i = 0; valid && i < getInstanceCount(); i++)
+            valid = _instances[i].model >= 0 && _instances[i].model < getModelCount() &&
+                    _instances[i].node >= 0 && _instances[i].node < getNodeCount();
+        for (int i = 0; valid && i < getLightCount(); i++)
+            valid = _lights[i].name < strings && _lights[i].parent >= SCENE_NULL_INDEX && _lights[i].parent < getNodeCount();
+    }
+    if (!valid) {
+        std::cerr << "CSceneFile: " << binaryPath << " is not a valid scene file" << std::endl;
+        close();
+        return false;
+    }
+    return true;
+}
+
+void CSceneFile::close() {
+    if (_mapping != nullptr) munmap(_mapping, _mappingSize);
+    _mapping = nullptr;
+    _mappingSize = 0;
+    _header = nullptr;
+    _models = nullptr; _materials = nullptr; _nodes = nullptr; _instances = nullptr; _lights = nullptr;
+    _strings = nullptr;
+}
+
+int CSceneFile::findModel(const std::string& name) const {
+    for (int i = 0; i < getModelCount(); i++) {
+        if (name == getString(_models[i].name)) return i;
+    }
+    return SCENE_NULL_INDEX;
+}
+
+int CSceneFile::findMaterial(const std::string& name) const {
+    for (int i = 0; i < getMaterialCount(); i++) {
+        if (name == getString(_materials[i].name)) return i;
+    }
+    return SCENE_NULL_INDEX;
+}
+
+int CSceneFile::findNode(const std::string& name) const {
+    if (name.empty()) return SCENE_NULL_INDEX;
+    for (int i = 0; i < getNodeCount(); i++) {
+        if (name == getString(_nodes[i].name)) return i;
+    }
+    return SCENE_NULL_INDEX;
+}
+
+int CSceneFile::findLight(const std::string& name) const {
+    for (int i = 0; i < getLightCount(); i++) {
+        if (name == getString(_lights[i].name)) return i;
+    }
+    return SCENE_NULL_INDEX;
+}
@@ -0,0 +1,131 @@
+//  CSceneFile.h
+//  場景描述檔：文字格式 (例如 scene.txt) 用於編輯，宣告模型、材質、transform 節點、模型的擺放 (instance) 與光源；
+//  編譯後的二進位格式以 mmap 直接讀取，所有紀錄都是固定大小的 POD 陣列，載入時不需要剖析或配置記憶體，
+//  呼叫端依序走訪各個陣列一次即可建立場景。文字檔比二進位檔新 (或二進位檔不存在) 時 load() 會重新編譯
+//
+//  文字格式 (# 之後為註解，名稱為 - 代表沒有 parent / 沒有名稱)：
+//    model    <name> <path> [dynamic]
+//    material <name> ambient r g b a diffuse r g b a specular r g b a shininess s
+//    node     <name> <parent> [pos x y z] [rot deg ax ay az] [scale s | scale sx sy sz]
+//    instance <name> <model> <parent> [pos ...] [rot ...] [scale ...] [noshadow] [occluder]
+//    light    point <name> <parent> pos x y z ambient ... diffuse ... specular ... atten c l q
+//    light    spot  <name> <parent> pos x y z target x y z cutoff inner outer exponent ambient ... [shadow]
+//  node 與 instance 的 parent 必須在前面宣告；光源的 pos / target 為世界座標，接在 parent 節點下跟著移動
+
+#pragma once
+
+#include <string>
+#include <cstdint>
+#include <cstddef>
+
+#define SCENE_FILE_MAGIC    0x314E4353u     // "SCN1"
+#define SCENE_FILE_VERSION  1
+#define SCENE_NULL_INDEX    -1
+
+// 模型
+#define SCENE_MODEL_DYNAMIC         0x1u    // 每個 frame 可能移動，不參與靜態合批
+// instance
+#define SCENE_INSTANCE_NO_SHADOW    0x1u    // 不投射陰影 (例如光源正下方的燈具)
+#define SCENE_INSTANCE_OCCLUDER     0x2u    // 網格畫進 CPU 遮蔽剔除的深度 buffer
+// 光源
+#define SCENE_LIGHT_POINT           0u
+#define SCENE_LIGHT_SPOT            1u
+#define SCENE_LIGHT_SHADOW          0x1u    // 建立 shadow map
+
+// 二進位檔的紀錄，字串以字串表中的位移表示
+struct SceneModelRecord {
+    uint32_t name;
+    uint32_t path;
+    uint32_t flags;
+};
+
+struct SceneMaterialRecord {
+    uint32_t name;
+    float    ambient[4], diffuse[4], specular[4];
+    float    shininess;
+};
+
+// 節點依宣告順序存放，parent 一定在子節點之前
+struct SceneNodeRecord {
+    uint32_t name;
+    int32_t  parent;
+    float    position[3];
+    float    rotation[4];       // 四元數 x, y, z, w
+    float    scale[3];
+};
+
+struct SceneInstanceRecord {
+    int32_t  model;
+    int32_t  node;              // 每個 instance 有自己的節點
+    uint32_t flags;
+};
+
+struct SceneLightRecord {
+    uint32_t name;
+    uint32_t type;
+    int32_t  parent;
+    uint32_t flags;
+    float    position[3], target[3];
+    float    cutoff[3];         // inner / outer (度) 與 exponent，只有聚光燈使用
+    float    ambient[4], diffuse[4], specular[4];
+    float    attenuation[3];    // constant, linear, quadratic
+};
+
+struct SceneFileHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t fileSize;
+    uint32_t modelCount, modelOffset;
+    uint32_t materialCount, materialOffset;
+    uint32_t nodeCount, nodeOffset;
+    uint32_t instanceCount, instanceOffset;
+    uint32_t lightCount, lightOffset;
+    uint32_t stringSize, stringOffset;
+};
+
+class CSceneFile {
+public:
+    CSceneFile();
+    ~CSceneFile();
+
+    // 二進位檔不存在或比文字檔舊時先編譯，再以 mmap 開啟；二進位檔驗證失敗 (版本不符或損毀) 時重新編譯後再開啟一次
+    bool load(const std::string& textPath, const std::string& binaryPath);
+    // 剖析文字檔並寫出二進位檔，錯誤時輸出行號並回傳 false
+    static bool compile(const std::string& textPath, const std::string& binaryPath);
+    bool open(const std::string& binaryPath);
+    void close();
+    bool isOpen() const { return _header != nullptr; }
+
+    int getModelCount() const { return _header ? static_cast<int>(_header->modelCount) : 0; }
+    int getMaterialCount() const { return _header ? static_cast<int>(_header->materialCount) : 0; }
+    int getNodeCount() const { return _header ? static_cast<int>(_header->nodeCount) : 0; }
+    int getInstanceCount() const { return _header ? static_cast<int>(_header->instanceCount) : 0; }
+    int getLightCount() const { return _header ? static_cast<int>(_header->lightCount) : 0; }
+
+    const SceneModelRecord& getModel(int i) const { return _models[i]; }
+    const SceneMaterialRecord& getMaterial(int i) const { return _materials[i]; }
+    const SceneNodeRecord& getNode(int i) const { return _nodes[i]; }
+    const SceneInstanceRecord& getInstance(int i) const { return _instances[i]; }
+    const SceneLightRecord& getLight(int i) const { return _lights[i]; }
+    const char* getString(uint32_t offset) const { return _strings + offset; }
+
+    // 以名稱查詢，找不到時回傳 SCENE_NULL_INDEX
+    int findModel(const std::string& name) const;
+    int findMaterial(const std::string& name) const;
+    int findNode(const std::string& name) const;
+    int findLight(const std::string& name) const;
+
+private:
+    CSceneFile(const CSceneFile&) = delete;
+    CSceneFile& operator=(const CSceneFile&) = delete;
+
+    void*  _mapping;
+    size_t _mappingSize;
+    const SceneFileHeader*     _header;
+    const SceneModelRecord*    _models;
+    const SceneMaterialRecord* _materials;
+    const SceneNodeRecord*     _nodes;
+    const SceneInstanceRecord* _instances;
+    const SceneLightRecord*    _lights;
+    const char*                _strings;
+};
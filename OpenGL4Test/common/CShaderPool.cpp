@@ -1,14 +1,21 @@
 #pragma once
 #include "CShaderPool.h"
+#include "CGLState.h"
 #include <iostream>
+#include <string>
+#include <algorithm>
 
 CShaderPool& CShaderPool::getInstance() {
     static CShaderPool instance;
     return instance;
 }
 
-CShaderPool::CShaderPool() {
-    // ibLlƤu@
+CShaderPool::CShaderPool() : m_pendingCount(0), m_parallelCompileEnabled(false), m_reloadCount(0) {
+    // Pv sampler bCӥΨ쪺 program TwϥΦP@ӶKϳ椸
+    m_samplerBindings["uLightData"] = LIGHT_DATA_TEXTURE_UNIT;
+    m_samplerBindings["uClusterTable"] = CLUSTER_TABLE_TEXTURE_UNIT;
+    m_samplerBindings["uClusterLights"] = CLUSTER_LIGHTS_TEXTURE_UNIT;
+    m_samplerBindings["uShadowMaps"] = SHADOW_MAP_TEXTURE_UNIT;
 }
 
 CShaderPool::~CShaderPool() {
@@ -17,19 +24,344 @@ CShaderPool::~CShaderPool() {
 }
 
 GLuint CShaderPool::getShader(const std::string& vertexShaderName, const std::string& fragmentShaderName) {
-    // ˬd vector O_wsbۦP shader T
-    for (const auto& entry : m_shaderEntries) {
-        if (entry.vertexShaderName == vertexShaderName && entry.fragmentShaderName == fragmentShaderName) {
+    // ˬd vector O_wsbۦP shader TAweXsĶbĤ@ήɤ~T{G
+    for (auto& entry : m_shaderEntries) {
+        if (!entry.isVariant && entry.vertexShaderName == vertexShaderName && entry.fragmentShaderName == fragmentShaderName) {
+            if (entry.pending) finalize(entry);
+            return entry.shaderID;
+        }
+    }
+
+    // sbɡAeXsĶߧYݵG
+    ShaderEntry& newEntry = submit(vertexShaderName, fragmentShaderName, false, 0, 0);
+    finalize(newEntry);
+    return newEntry.shaderID;
+}
+
+GLuint CShaderPool::getShaderVariant(const std::string& vertexShaderName, const std::string& fragmentShaderName, unsigned int featureMask) {
+    return getShaderVariant(getShader(vertexShaderName, fragmentShaderName), featureMask);
+}
+
+GLuint CShaderPool::getShaderVariant(GLuint baseShaderID, unsigned int featureMask) {
+    unsigned long long key = (static_cast<unsigned long long>(baseShaderID) << 32) | featureMask;
+    auto cached = m_variantCache.find(key);
+    if (cached != m_variantCache.end()) return cached->second;
+
+    // wg precompileVariants eXsĶ
+    for (auto& entry : m_shaderEntries) {
+        if (entry.isVariant && entry.baseShaderID == baseShaderID && entry.featureMask == featureMask) {
+            if (entry.pending) finalize(entry);
             return entry.shaderID;
         }
     }
 
-    // sbɡAIs~禡إ߷s shader
-    GLuint shaderID = createShader(vertexShaderName, fragmentShaderName);
+    const ShaderEntry* base = findEntry(baseShaderID);
+    if (base == nullptr || base->isVariant) {
+        std::cerr << "CShaderPool::getShaderVariant: " << baseShaderID << " is not a base program in the pool" << std::endl;
+        return baseShaderID;
+    }
+    // submit | base ХġAƻsW
+    std::string vertexShaderName = base->vertexShaderName, fragmentShaderName = base->fragmentShaderName;
+    ShaderEntry& newEntry = submit(vertexShaderName, fragmentShaderName, true, featureMask, baseShaderID);
+    finalize(newEntry);
+    return newEntry.shaderID;
+}
+
+void CShaderPool::precompile(const std::vector<std::pair<std::string, std::string>>& programs) {
+    enableParallelCompile();
+    for (const auto& program : programs) {
+        if (findBase(program.first, program.second) == nullptr) {
+            submit(program.first, program.second, false, 0, 0);
+        }
+    }
+}
+
+void CShaderPool::precompileVariants(const std::string& vertexShaderName, const std::string& fragmentShaderName,
+                                     const std::vector<unsigned int>& featureMasks) {
+    enableParallelCompile();
+    const ShaderEntry* base = findBase(vertexShaderName, fragmentShaderName);
+    GLuint baseShaderID = base ? base->shaderID : submit(vertexShaderName, fragmentShaderName, false, 0, 0).shaderID;
+
+    for (unsigned int featureMask : featureMasks) {
+        bool exists = false;
+        for (const auto& entry : m_shaderEntries) {
+            if (entry.isVariant && entry.baseShaderID == baseShaderID && entry.featureMask == featureMask) { exists = true; break; }
+        }
+        if (!exists) submit(vertexShaderName, fragmentShaderName, true, featureMask, baseShaderID);
+    }
+}
+
+void CShaderPool::finalizeReadyShaders() {
+    if (m_pendingCount == 0) return;
+    for (auto& entry : m_shaderEntries) {
+        if (entry.pending && isShaderReady(entry.build)) finalize(entry);
+    }
+}
 
-    // xss shader T vector 
-    ShaderEntry newEntry = { vertexShaderName, fragmentShaderName, shaderID };
+std::vector<GLuint> CShaderPool::getVariants(GLuint baseShaderID) const {
+    // |b finalize ɤ~ƻs¦ program ȡAo̤ݭn
+    std::vector<GLuint> ids = { baseShaderID };
+    for (const auto& entry : m_shaderEntries) {
+        if (entry.isVariant && !entry.pending && entry.baseShaderID == baseShaderID) ids.push_back(entry.shaderID);
+    }
+    return ids;
+}
+
+void CShaderPool::enableParallelCompile() {
+    if (m_parallelCompileEnabled) return;
+    enableParallelShaderCompile();
+    m_parallelCompileEnabled = true;
+}
+
+std::string CShaderPool::variantDefines(unsigned int featureMask) {
+    // N\줸ন #defineAϥΪ\wq 0A shader bsĶɳQ
+    static const char* featureNames[SHADER_FEATURE_COUNT] = {
+        "HAS_DIFFUSE_MAP", "HAS_NORMAL_MAP", "HAS_SPECULAR_MAP", "HAS_ALPHA_MAP"
+    };
+    std::string defines = "#define SHADER_VARIANT\n";
+    for (int i = 0; i < SHADER_FEATURE_COUNT; i++) {
+        defines += std::string("#define ") + featureNames[i] + ((featureMask & (1u << i)) ? " 1\n" : " 0\n");
+    }
+    return defines;
+}
+
+ShaderEntry& CShaderPool::submit(const std::string& vertexShaderName, const std::string& fragmentShaderName,
+                                 bool isVariant, unsigned int featureMask, GLuint baseShaderID) {
+    std::string defines = isVariant ? variantDefines(featureMask) : "";
+
+    ShaderEntry newEntry;
+    newEntry.vertexShaderName = vertexShaderName;
+    newEntry.fragmentShaderName = fragmentShaderName;
+    newEntry.build = beginCreateShader(vertexShaderName, fragmentShaderName, defines);
+    newEntry.shaderID = newEntry.build.program;    // program id beXɴNwTw
+    newEntry.pending = true;
+    newEntry.isVariant = isVariant;
+    newEntry.featureMask = featureMask;
+    newEntry.baseShaderID = baseShaderID;
     m_shaderEntries.push_back(newEntry);
+    m_pendingCount++;
+    return m_shaderEntries.back();
+}
+
+void CShaderPool::finalize(ShaderEntry& entry) {
+    if (!entry.pending) return;
+    finishCreateShader(entry.build);   // ѮɻP createShader ۦPA{
+    entry.pending = false;
+    m_pendingCount--;
+
+    reflectUniforms(entry);
+    applyBlockBindings(entry);
+
+    if (entry.isVariant) {
+        // ~Ӱ¦ program ثe uniform 
+        for (auto& base : m_shaderEntries) {
+            if (base.shaderID == entry.baseShaderID) {
+                if (base.pending) finalize(base);
+                restoreUniforms(entry, snapshotUniforms(base));
+                break;
+            }
+        }
+        m_variantCache[(static_cast<unsigned long long>(entry.baseShaderID) << 32) | entry.featureMask] = entry.shaderID;
+        std::cout << "Shader variant 0x" << std::hex << entry.featureMask << std::dec << " of "
+                  << entry.fragmentShaderName << " -> " << entry.shaderID << std::endl;
+    }
+    applySamplerBindings(entry);
+}
+
+const ShaderEntry* CShaderPool::findBase(const std::string& vertexShaderName, const std::string& fragmentShaderName) const {
+    for (const auto& entry : m_shaderEntries) {
+        if (!entry.isVariant && entry.vertexShaderName == vertexShaderName && entry.fragmentShaderName == fragmentShaderName) return &entry;
+    }
+    return nullptr;
+}
+
+std::vector<UniformValue> CShaderPool::snapshotUniforms(const ShaderEntry& entry) const {
+    std::vector<UniformValue> values;
+    values.reserve(entry.uniforms.size());
+    for (const auto& uniform : entry.uniforms) {
+        UniformValue value;
+        value.name = uniform.first;
+        value.type = uniform.second.type;
+        switch (value.type) {
+            case GL_FLOAT: case GL_FLOAT_VEC2: case GL_FLOAT_VEC3: case GL_FLOAT_VEC4:
+            case GL_FLOAT_MAT3: case GL_FLOAT_MAT4:
+                glGetUniformfv(entry.shaderID, uniform.second.location, value.f);
+                break;
+            case GL_INT: case GL_BOOL:
+            case GL_SAMPLER_2D: case GL_SAMPLER_CUBE: case GL_SAMPLER_2D_SHADOW:
+            case GL_SAMPLER_BUFFER: case GL_UNSIGNED_INT_SAMPLER_BUFFER: case GL_SAMPLER_2D_ARRAY_SHADOW:
+                glGetUniformiv(entry.shaderID, uniform.second.location, value.i);
+                break;
+            default:
+                continue;
+        }
+        values.push_back(value);
+    }
+    return values;
+}
+
+void CShaderPool::restoreUniforms(const ShaderEntry& entry, const std::vector<UniformValue>& values) const {
+    CGLState& gl = CGLState::getInstance();
+    GLuint currentProgram = gl.getProgram();
+    gl.useProgram(entry.shaderID);
+
+    // ̦WٹAOP (shader Qק)  uniform Odw]
+    for (const auto& value : values) {
+        auto target = entry.uniforms.find(value.name);
+        if (target == entry.uniforms.end() || target->second.type != value.type) continue;
+        GLint dst = target->second.location;
+        switch (value.type) {
+            case GL_FLOAT:      glUniform1fv(dst, 1, value.f); break;
+            case GL_FLOAT_VEC2: glUniform2fv(dst, 1, value.f); break;
+            case GL_FLOAT_VEC3: glUniform3fv(dst, 1, value.f); break;
+            case GL_FLOAT_VEC4: glUniform4fv(dst, 1, value.f); break;
+            case GL_FLOAT_MAT3: glUniformMatrix3fv(dst, 1, GL_FALSE, value.f); break;
+            case GL_FLOAT_MAT4: glUniformMatrix4fv(dst, 1, GL_FALSE, value.f); break;
+            default:            glUniform1iv(dst, 1, value.i); break;
+        }
+    }
+    gl.useProgram(currentProgram);
+}
+
+int CShaderPool::reloadShaderFile(const std::string& fileName) {
+    int relinked = 0;
+    for (auto& entry : m_shaderEntries) {
+        if (entry.vertexShaderName != fileName && entry.fragmentShaderName != fileName) continue;
+        if (entry.pending) finalize(entry);
+
+        // sĶȮɪ program ˬd~AѮɫOd쥻iΪ
+        // ɮ׼Ȯɤsb (Bs边HW覡s) ɤs linkAUקAJ
+        PendingShader build;
+        if (!tryBeginCreateShader(entry.vertexShaderName, entry.fragmentShaderName,
+                                  entry.isVariant ? variantDefines(entry.featureMask) : "", build)) {
+            std::cerr << "Hot reload of " << fileName << " skipped, keeping the previous program" << std::endl;
+            continue;
+        }
+        std::string errorLog;
+        bool ok = checkShader(build, errorLog);
+        if (ok) {
+            // s shader 쥻 program s linkAprogram id ܡA id 󤣻ݭns
+            std::vector<UniformValue> values = snapshotUniforms(entry);
+            GLuint attached[4];
+            GLsizei attachedCount = 0;
+            glGetAttachedShaders(entry.shaderID, 4, &attachedCount, attached);
+            for (GLsizei i = 0; i < attachedCount; i++) glDetachShader(entry.shaderID, attached[i]);
+            glAttachShader(entry.shaderID, build.vertexShader);
+            glAttachShader(entry.shaderID, build.fragmentShader);
+            glLinkProgram(entry.shaderID);
+
+            reflectUniforms(entry);
+            applyBlockBindings(entry);
+            restoreUniforms(entry, values);
+            applySamplerBindings(entry);
+            relinked++;
+        } else {
+            std::cerr << "Hot reload of " << fileName << " failed, keeping the previous program\n" << errorLog << std::endl;
+        }
+        glDeleteShader(build.vertexShader);
+        glDeleteShader(build.fragmentShader);
+        glDeleteProgram(build.program);
+    }
+    if (relinked > 0) m_reloadCount++;
+    return relinked;
+}
+
+std::vector<std::string> CShaderPool::getShaderFiles() const {
+    std::vector<std::string> files;
+    for (const auto& entry : m_shaderEntries) {
+        for (const std::string* name : { &entry.vertexShaderName, &entry.fragmentShaderName }) {
+            if (std::find(files.begin(), files.end(), *name) == files.end()) files.push_back(*name);
+        }
+    }
+    return files;
+}
+
+void CShaderPool::reflectUniforms(ShaderEntry& entry) {
+    entry.uniforms.clear();
+
+    GLint count = 0, maxLength = 0;
+    glGetProgramiv(entry.shaderID, GL_ACTIVE_UNIFORMS, &count);
+    glGetProgramiv(entry.shaderID, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+    std::vector<GLchar> nameBuf(maxLength > 0 ? maxLength : 1);
+
+    for (GLuint i = 0; i < static_cast<GLuint>(count); i++) {
+        GLsizei length = 0;
+        GLint size = 0;
+        GLenum type = 0;
+        glGetActiveUniform(entry.shaderID, i, static_cast<GLsizei>(nameBuf.size()), &length, &size, &type, nameBuf.data());
+        std::string name(nameBuf.data(), length);
+
+        // uniform block S locationA uniform buffer td
+        GLint location = glGetUniformLocation(entry.shaderID, name.c_str());
+        if (location == -1) continue;
+
+        entry.uniforms[name] = { location, type, size };
 
-    return shaderID;
+        // 򥻫O}Cu|^ "name[0]"APɵnO "name" PC@Ӥ "name[i]"
+        if (name.size() > 3 && name.compare(name.size() - 3, 3, "[0]") == 0) {
+            std::string base = name.substr(0, name.size() - 3);
+            entry.uniforms[base] = { location, type, size };
+            for (GLint e = 1; e < size; e++) {
+                std::string elem = base + "[" + std::to_string(e) + "]";
+                GLint elemLoc = glGetUniformLocation(entry.shaderID, elem.c_str());
+                if (elemLoc != -1) entry.uniforms[elem] = { elemLoc, type, 1 };
+            }
+        }
+    }
+}
+
+void CShaderPool::applyBlockBindings(const ShaderEntry& entry) const {
+    for (const auto& binding : m_blockBindings) {
+        GLuint blockIndex = glGetUniformBlockIndex(entry.shaderID, binding.first.c_str());
+        if (blockIndex != GL_INVALID_INDEX) {
+            glUniformBlockBinding(entry.shaderID, blockIndex, binding.second);
+        }
+    }
+}
+
+void CShaderPool::applySamplerBindings(const ShaderEntry& entry) const {
+    CGLState& gl = CGLState::getInstance();
+    GLuint currentProgram = gl.getProgram();
+    bool switched = false;
+    for (const auto& binding : m_samplerBindings) {
+        auto it = entry.uniforms.find(binding.first);
+        if (it == entry.uniforms.end()) continue;
+        if (!switched) { gl.useProgram(entry.shaderID); switched = true; }
+        glUniform1i(it->second.location, binding.second);
+    }
+    if (switched) gl.useProgram(currentProgram);
+}
+
+void CShaderPool::bindUniformBlock(const std::string& blockName, GLuint bindingPoint) {
+    m_blockBindings[blockName] = bindingPoint;
+    for (const auto& entry : m_shaderEntries) {
+        GLuint blockIndex = glGetUniformBlockIndex(entry.shaderID, blockName.c_str());
+        if (blockIndex != GL_INVALID_INDEX) {
+            glUniformBlockBinding(entry.shaderID, blockIndex, bindingPoint);
+        }
+    }
+}
+
+const ShaderEntry* CShaderPool::findEntry(GLuint shaderID) const {
+    for (const auto& entry : m_shaderEntries) {
+        if (entry.shaderID == shaderID) return &entry;
+    }
+    return nullptr;
+}
+
+const UniformInfo* CShaderPool::getUniformInfo(GLuint shaderID, const std::string& uniformName) const {
+    const ShaderEntry* entry = findEntry(shaderID);
+    if (entry == nullptr) return nullptr;
+    auto it = entry->uniforms.find(uniformName);
+    return (it != entry->uniforms.end()) ? &it->second : nullptr;
+}
+
+GLint CShaderPool::getUniformLocation(GLuint shaderID, const std::string& uniformName) const {
+    const ShaderEntry* entry = findEntry(shaderID);
+    if (entry == nullptr) {
+        // O CShaderPool إߪ programAh^d
+        return glGetUniformLocation(shaderID, uniformName.c_str());
+    }
+    auto it = entry->uniforms.find(uniformName);
+    return (it != entry->uniforms.end()) ? it->second.location : -1;
 }
\ No newline at end of file
@@ -1,14 +1,53 @@
 #pragma once
 #include <string>
 #include <vector>
+#include <unordered_map>
 #include <GL/glew.h>
 #include "initshader.h"
 
+//  glGetActiveUniform Ϯgo쪺 uniform T
+struct UniformInfo {
+    GLint  location;
+    GLenum type;
+    GLint  size;    // }CסAD}C 1
+};
+
+// s link ΫإɥΨӫOs uniform ثe
+struct UniformValue {
+    std::string name;
+    GLenum  type;
+    GLfloat f[16];
+    GLint   i[4];
+};
+
+// ۦ⾹骺\줸AƭȻP CMaterialTable  MATERIAL_*_MAP ۦPAiϥΧ誺 textureFlags
+// CӦ줸bsĶন #define HAS_xxx_MAP 0/1AB~wq SHADER_VARIANT
+#define SHADER_FEATURE_DIFFUSE_MAP   0x1
+#define SHADER_FEATURE_NORMAL_MAP    0x2
+#define SHADER_FEATURE_SPECULAR_MAP  0x4
+#define SHADER_FEATURE_ALPHA_MAP     0x8
+#define SHADER_FEATURE_COUNT         4
+
+// TwKϳ椸 (0~3 K)GơBcluster ުP shadow mapA
+// Ҧ program b link ɴN]wnAݭngL CLightManager::setShaderID
+#define LIGHT_DATA_TEXTURE_UNIT     4
+#define CLUSTER_TABLE_TEXTURE_UNIT  5
+#define CLUSTER_LIGHTS_TEXTURE_UNIT 6
+#define SHADOW_MAP_TEXTURE_UNIT     7   // CShadowMaps  depth texture array
+
 // xs shader Tc
 struct ShaderEntry {
     std::string vertexShaderName;
     std::string fragmentShaderName;
     GLuint shaderID;
+    // link Ϯg@Ҧ active uniformAudAIs glGetUniformLocation
+    std::unordered_map<std::string, UniformInfo> uniforms;
+    bool isVariant = false;         //  getShaderVariant إ
+    unsigned int featureMask = 0;   // SHADER_FEATURE_* զX
+    GLuint baseShaderID = 0;        // ݪ¦ program
+    // 妸eXsĶ|T{GAĤ@ήɤ~ (Ϯg uniformBjw block)
+    bool pending = false;
+    PendingShader build;
 };
 
 class CShaderPool {
@@ -20,6 +59,38 @@ public:
     // _hIs~ createShader إ߷s shaderAA^ shaderID
     GLuint getShader(const std::string& vertexShaderName, const std::string& fragmentShaderName);
 
+    // ow\զXAĤ@ϥήɤ~sĶç֨
+    // إ߮ɽƻs¦ program ثe uniform ȡAݭn@Ϊ]wй getVariants() v@]w
+    GLuint getShaderVariant(const std::string& vertexShaderName, const std::string& fragmentShaderName, unsigned int featureMask);
+    GLuint getShaderVariant(GLuint baseShaderID, unsigned int featureMask);
+    // ¦ program PثewҦ
+    std::vector<GLuint> getVariants(GLuint baseShaderID) const;
+
+    // 妸eXsĶPsdߪAAdriver 䴩 KHR_parallel_shader_compile ɦbIsĶ
+    //  getShader / getShaderVariant Ĥ@άY program ɤ~ݨˬdG
+    void precompile(const std::vector<std::pair<std::string, std::string>>& programs);
+    void precompileVariants(const std::string& vertexShaderName, const std::string& fragmentShaderName,
+                            const std::vector<unsigned int>& featureMasks);
+    // wgsĶn programA|ݡAiHC frame Is
+    void finalizeReadyShaders();
+
+    // ssĶҦϥ fileName  program (t)A\ɪuέ쥻 program id ëOd uniform 
+    // sĶѩ shader ŪɫOdª programA^ǭs link ƶq
+    int reloadShaderFile(const std::string& fileName);
+    // Ҧ program Ψ쪺 shader ɦWAɮ׺ʬݨϥ
+    std::vector<std::string> getShaderFiles() const;
+    // C program s link N[@Auniform miܡA֨ handle ڦsѪR
+    int getReloadCount() const { return m_reloadCount; }
+
+    // ѤϮgo uniform mA䤣ɦ^ -1
+    // ublƮɩIs(Ҧpإ CUniform handle)AC frame øsϥ handle
+    GLint getUniformLocation(GLuint shaderID, const std::string& uniformName) const;
+    const UniformInfo* getUniformInfo(GLuint shaderID, const std::string& uniformName) const;
+
+    // w uniform block ϥΪ binding pointAMΨثePإߪҦ program
+    // PW block bҦ program P@ uniform buffer
+    void bindUniformBlock(const std::string& blockName, GLuint bindingPoint);
+
 private:
     // pغclPѺcl
     CShaderPool();
@@ -29,6 +100,33 @@ private:
     CShaderPool(const CShaderPool&) = delete;
     CShaderPool& operator=(const CShaderPool&) = delete;
 
+    // C| program Ҧ active uniform ëإ W -> m Ӫ
+    void reflectUniforms(ShaderEntry& entry);
+    void applyBlockBindings(const ShaderEntry& entry) const;
+    // TwKϳ椸 samplerAlink Ps link ]w
+    void applySamplerBindings(const ShaderEntry& entry) const;
+    const ShaderEntry* findEntry(GLuint shaderID) const;
+    const ShaderEntry* findBase(const std::string& vertexShaderName, const std::string& fragmentShaderName) const;
+    ShaderEntry& submit(const std::string& vertexShaderName, const std::string& fragmentShaderName,
+                        bool isVariant, unsigned int featureMask, GLuint baseShaderID);
+    void finalize(ShaderEntry& entry);
+    void enableParallelCompile();
+    std::vector<UniformValue> snapshotUniforms(const ShaderEntry& entry) const;
+    void restoreUniforms(const ShaderEntry& entry, const std::vector<UniformValue>& values) const;
+    static std::string variantDefines(unsigned int featureMask);
+
     // ϥ vector xsҦ shader 
     std::vector<ShaderEntry> m_shaderEntries;
+
+    // uniform block W -> binding point
+    std::unordered_map<std::string, GLuint> m_blockBindings;
+    // sampler W -> Kϳ椸 (*_TEXTURE_UNIT)
+    std::unordered_map<std::string, GLint> m_samplerBindings;
+
+    // (¦ shaderID << 32 | featureMask) ->  shaderIDAC draw d߮ɤr
+    std::unordered_map<unsigned long long, GLuint> m_variantCache;
+
+    int  m_pendingCount;
+    bool m_parallelCompileEnabled;
+    int  m_reloadCount;
 };
@@ -0,0 +1,255 @@
+//  CShadowMaps.cpp
+#include "CShadowMaps.h"
+#include "CLight.h"
+#include "CLightManager.h"
+#include "CGLState.h"
+#include "CShaderPool.h"
+#include <glm/gtc/matrix_transform.hpp>
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+static_assert(sizeof(ShadowBlockData) == MAX_SHADOW_LIGHTS * 64 + 32, "ShadowBlockData must match std140 layout");
+
+CShadowMaps::CShadowMaps()
+    : _size(SHADOW_MAP_SIZE), _texture(0), _depthProgram(0), _reloadCount(-1),
+      _staticRenders(0), _dynamicOverlays(0), _dynamicDraws(0) {
+    std::memset(_framebuffers, 0, sizeof(_framebuffers));
+    std::memset(&_blockData, 0, sizeof(_blockData));
+}
+
+CShadowMaps::~CShadowMaps() {
+    // GL context 可能已經結束，由 release() 明確釋放
+}
+
+void CShadowMaps::create(GLuint depthProgram, int size) {
+    if (_texture != 0) release();
+    _depthProgram = depthProgram;
+    _size = size;
+    _reloadCount = -1;
+
+    // 硬體比較 (sampler2DArrayShadow) 搭配線性過濾，每次取樣即為 2x2 PCF
+    glGenTextures(1, &_texture);
+    CGLState& gl = CGLState::getInstance();
+    gl.bindTexture(SHADOW_MAP_TEXTURE_UNIT, GL_TEXTURE_2D_ARRAY, _texture);
+    glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_DEPTH_COMPONENT24, _size, _size, MAX_SHADOW_LIGHTS * 2, 0,
+                 GL_DEPTH_COMPONENT, GL_FLOAT, nullptr);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+
+    // 每一層一個只有深度的 framebuffer
+    glGenFramebuffers(MAX_SHADOW_LIGHTS * 2, _framebuffers);
+    for (int layer = 0; layer < MAX_SHADOW_LIGHTS * 2; layer++) {
+        glBindFramebuffer(GL_FRAMEBUFFER, _framebuffers[layer]);
+        glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, _texture, 0, layer);
+        glDrawBuffer(GL_NONE);
+        glReadBuffer(GL_NONE);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+            std::cerr << "CShadowMaps: framebuffer for layer " << layer << " is incomplete" << std::endl;
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    _shadowUBO.create(sizeof(ShadowBlockData), SHADOW_BLOCK_BINDING);
+    CShaderPool::getInstance().bindUniformBlock("ShadowBlock", SHADOW_BLOCK_BINDING);
+    _blockData.layers = glm::ivec4(0);
+    _blockData.params = glm::vec4(SHADOW_DEPTH_BIAS, 1.0f / _size, SHADOW_NORMAL_OFFSET, 0.0f);
+    _shadowUBO.update(0, sizeof(ShadowBlockData), &_blockData);
+    for (auto& slot : _slots) slot.staticDirty = true;
+}
+
+void CShadowMaps::release() {
+    if (_framebuffers[0] != 0) glDeleteFramebuffers(MAX_SHADOW_LIGHTS * 2, _framebuffers);
+    std::memset(_framebuffers, 0, sizeof(_framebuffers));
+    if (_texture != 0) CGLState::getInstance().deleteTexture(_texture);
+    _texture = 0;
+    _shadowUBO.release();
+}
+
+int CShadowMaps::addLight(CLight* light) {
+    if (light == nullptr || light->getType() != CLight::SPOT) return -1;
+    int existing = getSlot(light);
+    if (existing >= 0) return existing;
+    if (_slots.size() >= MAX_SHADOW_LIGHTS) {
+        std::cerr << "CShadowMaps::addLight: more than " << MAX_SHADOW_LIGHTS << " shadowed lights, ignored" << std::endl;
+        return -1;
+    }
+    Slot slot;
+    slot.light = light;
+    slot.position = slot.direction = glm::vec3(0.0f);
+    slot.cosOuterCutOff = slot.range = 0.0f;
+    slot.mxViewProj = glm::mat4(1.0f);
+    slot.staticDirty = true;
+    _slots.push_back(slot);
+    updateMatrix(_slots.back());
+    return static_cast<int>(_slots.size()) - 1;
+}
+
+int CShadowMaps::getSlot(const CLight* light) const {
+    for (size_t i = 0; i < _slots.size(); i++) {
+        if (_slots[i].light == light) return static_cast<int>(i);
+    }
+    return -1;
+}
+
+void CShadowMaps::addStaticCaster(const DrawPacket& packet) {
+    // 透明物件不投射陰影
+    if (packet.pass == RENDER_PASS_TRANSPARENT) return;
+    _staticCasters.push_back(packet);
+    invalidateStatic();
+}
+
+void CShadowMaps::clearStaticCasters() {
+    _staticCasters.clear();
+    invalidateStatic();
+}
+
+void CShadowMaps::invalidateStatic() {
+    for (auto& slot : _slots) slot.staticDirty = true;
+}
+
+void CShadowMaps::beginDynamicCasters() {
+    _dynamicCasters.clear();
+}
+
+void CShadowMaps::addDynamicCaster(const DrawPacket& packet) {
+    if (packet.pass == RENDER_PASS_TRANSPARENT) return;
+    _dynamicCasters.push_back(packet);
+}
+
+bool CShadowMaps::updateMatrix(Slot& slot) {
+    CLight* light = slot.light;
+    glm::vec3 position = light->getPos();
+    glm::vec3 direction = glm::normalize(light->getDirection());
+    float cosOuter = light->getOuterCutOff();
+    // 遠平面取光源的影響範圍 (與 clustered lighting 相同)，顏色或衰減改變時也要重算
+    float range = std::min(std::max(CLightManager::getLightRange(light), 1.0f), SHADOW_MAX_DISTANCE);
+    if (position == slot.position && direction == slot.direction && cosOuter == slot.cosOuterCutOff && range == slot.range)
+        return false;
+    slot.position = position;
+    slot.direction = direction;
+    slot.cosOuterCutOff = cosOuter;
+    slot.range = range;
+
+    // 光錐的外角再加一點邊界，避免 PCF 取樣到邊緣外
+    float fov = 2.0f * std::acos(std::min(std::max(cosOuter, 0.0f), 1.0f)) + glm::radians(2.0f);
+    fov = std::min(fov, glm::radians(170.0f));
+    glm::vec3 up = std::abs(direction.y) > 0.99f ? glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+    glm::mat4 mxView = glm::lookAt(position, position + direction, up);
+    glm::mat4 mxProj = glm::perspective(fov, 1.0f, SHADOW_NEAR_PLANE, slot.range);
+    slot.mxViewProj = mxProj * mxView;
+    slot.frustum.extract(slot.mxViewProj);
+    slot.staticDirty = true;
+    return true;
+}
+
+bool CShadowMaps::isInside(const CFrustum& frustum, const DrawPacket& packet) {
+    if (packet.radius < 0.0f) return true;
+    glm::vec3 center = glm::vec3(packet.mxModel * glm::vec4(packet.center, 1.0f));
+    float scale = std::max(glm::length(glm::vec3(packet.mxModel[0])),
+                           std::max(glm::length(glm::vec3(packet.mxModel[1])), glm::length(glm::vec3(packet.mxModel[2]))));
+    return frustum.testSphere(center, packet.radius * scale);
+}
+
+void CShadowMaps::drawCaster(const DrawPacket& p) {
+    _uModel.set(p.mxModel);
+    _uInstanced.set(p.instanceCount > 0 ? 1 : 0);
+    CGLState::getInstance().bindVertexArray(p.positionVao != 0 ? p.positionVao : p.vao);
+    if (p.multiDraw != nullptr) p.multiDraw->draw();
+    else if (p.instanceCount > 0) glDrawElementsInstanced(GL_TRIANGLES, p.indexCount, GL_UNSIGNED_INT, 0, p.instanceCount);
+    else glDrawElements(GL_TRIANGLES, p.indexCount, GL_UNSIGNED_INT, 0);
+}
+
+void CShadowMaps::renderLayer(int layer, const glm::mat4& mxViewProj, const CFrustum& frustum,
+                              const std::vector<DrawPacket>& casters, bool clear) {
+    glBindFramebuffer(GL_FRAMEBUFFER, _framebuffers[layer]);
+    if (clear) glClear(GL_DEPTH_BUFFER_BIT);
+    _uLightViewProj.set(mxViewProj);
+    for (const auto& packet : casters) {
+        if (packet.vao == 0 || !isInside(frustum, packet)) continue;
+        drawCaster(packet);
+    }
+}
+
+void CShadowMaps::update() {
+    _staticRenders = _dynamicOverlays = _dynamicDraws = 0;
+    if (_texture == 0 || _slots.empty()) return;
+
+    int reloadCount = CShaderPool::getInstance().getReloadCount();
+    if (reloadCount != _reloadCount) {
+        _uModel.bind(_depthProgram, "mxModel");
+        _uLightViewProj.bind(_depthProgram, "uLightViewProj");
+        _uInstanced.bind(_depthProgram, "uInstanced");
+        _reloadCount = reloadCount;
+    }
+
+    CGLState& gl = CGLState::getInstance();
+    GLint viewport[4];
+    glGetIntegerv(GL_VIEWPORT, viewport);
+    bool bound = false;     // 真的需要畫時才切換 framebuffer 與狀態
+    auto bind = [&]() {
+        if (bound) return;
+        bound = true;
+        glViewport(0, 0, _size, _size);
+        gl.useProgram(_depthProgram);
+        gl.depthMask(GL_TRUE);
+        gl.depthFunc(GL_LESS);
+        // 斜面上的 shadow acne 以 slope-scaled bias 處理
+        gl.enable(GL_POLYGON_OFFSET_FILL);
+        glPolygonOffset(2.0f, 4.0f);
+    };
+
+    glm::ivec4 layers = _blockData.layers;
+    bool changed = false;
+    for (int i = 0; i < static_cast<int>(_slots.size()); i++) {
+        Slot& slot = _slots[i];
+        updateMatrix(slot);
+        if (_blockData.matrices[i] != slot.mxViewProj) {
+            _blockData.matrices[i] = slot.mxViewProj;
+            changed = true;
+        }
+        if (!slot.light->isLightOn()) continue;
+
+        // 靜態 map：只在光源或靜態物件改變後重畫
+        if (slot.staticDirty) {
+            bind();
+            renderLayer(i, slot.mxViewProj, slot.frustum, _staticCasters, true);
+            slot.staticDirty = false;
+            _staticRenders++;
+        }
+
+        // 光錐內有動態物件時：複製靜態 map 到合成層，再畫上動態物件
+        _visibleCasters.clear();
+        for (const auto& packet : _dynamicCasters) {
+            if (packet.vao != 0 && isInside(slot.frustum, packet)) _visibleCasters.push_back(packet);
+        }
+        int overlay = MAX_SHADOW_LIGHTS + i;
+        if (_visibleCasters.empty()) {
+            layers[i] = i;
+            continue;
+        }
+        bind();
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, _framebuffers[i]);
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, _framebuffers[overlay]);
+        glBlitFramebuffer(0, 0, _size, _size, 0, 0, _size, _size, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+        renderLayer(overlay, slot.mxViewProj, slot.frustum, _visibleCasters, false);
+        layers[i] = overlay;
+        _dynamicOverlays++;
+        _dynamicDraws += static_cast<int>(_visibleCasters.size());
+    }
+
+    if (bound) {
+        gl.disable(GL_POLYGON_OFFSET_FILL);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+    }
+    if (layers != _blockData.layers) {
+        _blockData.layers = layers;
+        changed = true;
+    }
+    if (changed) _shadowUBO.update(0, sizeof(ShadowBlockData), &_blockData);
+    gl.bindTexture(SHADOW_MAP_TEXTURE_UNIT, GL_TEXTURE_2D_ARRAY, _texture);
+}
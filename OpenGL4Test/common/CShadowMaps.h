@@ -0,0 +1,107 @@
+//  CShadowMaps.h
+//  聚光燈的 shadow map：每個光源一張靜態 map，只畫不會移動的物件，光源移動或靜態物件改變時才重畫；
+//  每個 frame 只有動態物件 (例如 Truck 與跟隨鏡頭的 Robot) 落在光錐內時，才把靜態 map 複製一份再畫上動態物件，
+//  光源與場景都沒有改變時幾乎沒有額外成本。所有 map 放在同一個 depth texture array，
+//  f_phong.glsl 以 ShadowBlock 中的矩陣與 layer 取樣
+
+#pragma once
+
+#include <vector>
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include "CUniformBuffer.h"
+#include "CUniform.h"
+#include "CFrustum.h"
+#include "CRenderQueue.h"
+
+#define SHADOW_MAP_SIZE         1024
+#define MAX_SHADOW_LIGHTS       4       // 必須與 f_phong.glsl 的 MAX_SHADOW_LIGHTS 相同
+#define SHADOW_NEAR_PLANE       0.5f
+#define SHADOW_MAX_DISTANCE     50.0f   // 光源的影響範圍超過此距離時以此為遠平面
+#define SHADOW_DEPTH_BIAS       0.0005f
+#define SHADOW_NORMAL_OFFSET    0.02f   // 取樣點沿法向量偏移的距離 (世界座標)
+
+class CLight;
+
+// 與 f_phong.glsl 中 uniform block ShadowBlock 的 std140 配置對應
+struct ShadowBlockData {
+    glm::mat4  matrices[MAX_SHADOW_LIGHTS];     // 世界座標 -> 光源的 clip space
+    glm::ivec4 layers;                          // 每個 slot 取樣的 layer (靜態 map 或合成後的 map)
+    glm::vec4  params;                          // x = depth bias, y = texel 大小, z = 法向量偏移
+};
+
+class CShadowMaps {
+public:
+    CShadowMaps();
+    ~CShadowMaps();
+
+    // 配置 2 * MAX_SHADOW_LIGHTS 層的 depth texture array (前半為靜態 map，後半為加上動態物件的 map) 與 ShadowBlock，
+    // depthProgram 為 v_shadow.glsl + f_depth.glsl
+    void create(GLuint depthProgram, int size = SHADOW_MAP_SIZE);
+    void release();
+
+    // 只接受聚光燈，回傳 slot；已滿或不是聚光燈時回傳 -1
+    int addLight(CLight* light);
+    int getSlot(const CLight* light) const;
+    int getLightCount() const { return static_cast<int>(_slots.size()); }
+
+    // 靜態遮蔽物 (packet 的 VAO 必須一直有效)，加入或清除後所有靜態 map 在下一次 update 重畫
+    void addStaticCaster(const DrawPacket& packet);
+    void clearStaticCasters();
+    void invalidateStatic();
+    // 動態遮蔽物每個 frame 重新加入
+    void beginDynamicCasters();
+    void addDynamicCaster(const DrawPacket& packet);
+
+    // 在主要 pass 之前呼叫：重畫需要更新的靜態 map、合成動態物件並更新 ShadowBlock，
+    // 結束後還原 framebuffer 與 viewport，shadow map 綁定在 SHADOW_MAP_TEXTURE_UNIT
+    void update();
+
+    GLuint getTexture() const { return _texture; }
+    // 上一次 update 重畫的靜態 map 數、合成動態物件的 map 數與畫出的動態物件數
+    int getStaticRenderCount() const { return _staticRenders; }
+    int getDynamicOverlayCount() const { return _dynamicOverlays; }
+    int getDynamicCasterCount() const { return _dynamicDraws; }
+
+private:
+    CShadowMaps(const CShadowMaps&) = delete;
+    CShadowMaps& operator=(const CShadowMaps&) = delete;
+
+    struct Slot {
+        CLight*   light;
+        glm::vec3 position, direction;      // 上一次計算矩陣時的光源參數，改變時重畫
+        float     cosOuterCutOff;
+        float     range;
+        glm::mat4 mxViewProj;
+        CFrustum  frustum;
+        bool      staticDirty;
+    };
+
+    // 光源參數改變時回傳 true
+    bool updateMatrix(Slot& slot);
+    // 畫進 layer，clear 為 false 時保留原本的深度
+    void renderLayer(int layer, const glm::mat4& mxViewProj, const CFrustum& frustum,
+                     const std::vector<DrawPacket>& casters, bool clear);
+    void drawCaster(const DrawPacket& packet);
+    static bool isInside(const CFrustum& frustum, const DrawPacket& packet);
+
+    int _size;
+    GLuint _texture;
+    GLuint _framebuffers[MAX_SHADOW_LIGHTS * 2];
+    GLuint _depthProgram;
+    CUniform<glm::mat4> _uModel;
+    CUniform<glm::mat4> _uLightViewProj;
+    CUniform<int>       _uInstanced;
+    int _reloadCount;                       // shader 熱重載後重新解析 uniform 位置
+    CUniformBuffer _shadowUBO;
+    ShadowBlockData _blockData;
+
+    std::vector<Slot> _slots;
+    std::vector<DrawPacket> _staticCasters;
+    std::vector<DrawPacket> _dynamicCasters;
+    std::vector<DrawPacket> _visibleCasters;   // update 重複使用的暫存
+
+    int _staticRenders;
+    int _dynamicOverlays;
+    int _dynamicDraws;
+};
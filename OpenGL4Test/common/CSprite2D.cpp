@@ -2,6 +2,7 @@
 
 #include "CSprite2D.h"
 #include "initshader.h"
+#include "CShaderPool.h"
 
 CSprite2D::CSprite2D()
 {
@@ -25,6 +26,7 @@ CSprite2D::CSprite2D()
 	_bObjColor = false; // w]ϥΪC
 	_coloringModeLoc = 0; _coloringMode = 2; //WҦiJI, WҦ
 	_colorLoc = 0; // WҦiJI
+	_uniformReloadCount = 0;
 }
 
 CSprite2D::~CSprite2D()
@@ -40,7 +42,7 @@ void CSprite2D::setupVertexAttributes()
 	glGenBuffers(1, &_ebo);
 
 	// Bind the Vertex Array Object first, then bind and set vertex buffer(s) and attribute pointer(s).
-	glBindVertexArray(_vao);
+	CGLState::getInstance().bindVertexArray(_vao);
 
 	// ]w VBO
 	glBindBuffer(GL_ARRAY_BUFFER, _vbo);
@@ -61,24 +63,38 @@ void CSprite2D::setupVertexAttributes()
 	//KϮyݩ
 	glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, _vtxAttrCount * sizeof(float), BUFFER_OFFSET(6 * sizeof(float)));
 	glEnableVertexAttribArray(2);
-	glBindVertexArray(0); // Ѱ VAO jw
+	CGLState::getInstance().bindVertexArray(0); // Ѱ VAO jw
 }
 
 void CSprite2D::setShaderID(GLuint shaderID)
 {
 	_shaderProg = shaderID;
-	glUseProgram(_shaderProg);
-	_modelMxLoc = glGetUniformLocation(_shaderProg, "mxModel"); 	// o mxModel ܼƪm
+	CGLState::getInstance().useProgram(_shaderProg);
+	resolveUniforms();
 	glUniformMatrix4fv(_modelMxLoc, 1, GL_FALSE, glm::value_ptr(_mxTRS));
-	_coloringModeLoc = glGetUniformLocation(_shaderProg, "iColorType"); 	// o iColorType ܼƪm
 	glUniform1i(_coloringModeLoc, _coloringMode);
 }
 
+void CSprite2D::resolveUniforms()
+{
+	CShaderPool& pool = CShaderPool::getInstance();
+	_modelMxLoc = pool.getUniformLocation(_shaderProg, "mxModel"); 	// o mxModel ܼƪm
+	_coloringModeLoc = pool.getUniformLocation(_shaderProg, "iColorType"); 	// o iColorType ܼƪm
+	_colorLoc = pool.getUniformLocation(_shaderProg, "ui4Color"); 	// o ui4Color ܼƪm
+	_uniformReloadCount = pool.getReloadCount();
+}
+
+void CSprite2D::refreshUniforms()
+{
+	// shader s link  uniform mi
+	if (_shaderProg != 0 && _uniformReloadCount != CShaderPool::getInstance().getReloadCount()) resolveUniforms();
+}
+
 void CSprite2D::setColor(glm::vec4 vColor)
 {
 	// zL glUniform ǤJҫC
 	_color = vColor;
-	_colorLoc = glGetUniformLocation(_shaderProg, "ui4Color"); 	// o ui4Color ܼƪm
+	refreshUniforms();
 	glUniform4fv(_colorLoc, 1, glm::value_ptr(_color));
 	_coloringMode = 2; // ]wWҦ uniform color
 	glUniform1i(_coloringModeLoc, _coloringMode);
@@ -147,6 +163,7 @@ void CSprite2D::updateMatrix()
 		_bTransform = false;
 	}
 	// phӼҫϥάۦP shader program,]C@Ӽҫ mxTRS PAҥHCframens
+	refreshUniforms();
 	glUniformMatrix4fv(_modelMxLoc, 1, GL_FALSE, glm::value_ptr(_mxFinal));
 }
 
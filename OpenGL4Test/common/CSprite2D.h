@@ -1,6 +1,7 @@
 #pragma once
 #include <glm/glm.hpp>
 #include <GL/glew.h>
+#include "CGLState.h"
 
 // w]ѪWAѳIW
 // ݭnIWAAѦ CShape O
@@ -48,4 +49,9 @@ protected:
 	glm::mat4 _mxScale, _mxTrans, _mxTRS; // ҫYB첾PY첾Xx}
 	glm::mat4 _mxFinal; // ̲תҫx}
 	glm::mat4 _mxTransform; // B~W[ഫx}
+
+	// P CShape ۦPAshader ᭫sѪR uniform m
+	void resolveUniforms();
+	void refreshUniforms();
+	int _uniformReloadCount;
 };
@@ -0,0 +1,241 @@
+//  CStaticBatch.cpp
+#include <cstddef>
+#include <algorithm>
+#include <iostream>
+#include "CStaticBatch.h"
+#include "CGLState.h"
+#include "Model.h"
+#include "typedefs.h"
+
+// 與 CShape::setupVertexAttributes 相同的頂點配置
+#define BATCH_VERTEX_FLOATS 11
+
+CStaticBatch::~CStaticBatch() {
+    release();
+}
+
+bool CStaticBatch::addShape(CShape* shape) {
+    if (shape == nullptr || shape->isDynamic() || shape->getVertexData() == nullptr) return false;
+    _sources.push_back({ shape, nullptr, 0, glm::mat4(1.0f) });
+    return true;
+}
+
+bool CStaticBatch::addModel(Model* model, GLuint shaderProgram, const glm::mat4& mxModel) {
+    if (model == nullptr || model->isDynamic() || !model->IsLoaded()) return false;
+    _sources.push_back({ model, model, shaderProgram, mxModel });
+    return true;
+}
+
+bool CStaticBatch::contains(const CShape* object) const {
+    for (const auto& source : _sources) {
+        if (source.shape == object) return true;
+    }
+    return false;
+}
+
+void CStaticBatch::release() {
+    CGLState::getInstance().deleteVertexArray(_vao);
+    if (_vbo != 0) glDeleteBuffers(1, &_vbo);
+    if (_ebo != 0) glDeleteBuffers(1, &_ebo);
+    if (_indirectBuffer != 0) glDeleteBuffers(1, &_indirectBuffer);
+    if (_positionVao != 0) CGLState::getInstance().deleteVertexArray(_positionVao);
+    if (_positionVbo != 0) glDeleteBuffers(1, &_positionVbo);
+    _vao = _vbo = _ebo = _indirectBuffer = 0;
+    _positionVao = _positionVbo = 0;
+    _entries.clear();
+    _batches.clear();
+    _culler.clear();
+    _occluded.clear();
+    _occludedCount = 0;
+}
+
+bool CStaticBatch::sameState(const DrawPacket& a, const DrawPacket& b) {
+    return a.program == b.program && a.shadingMode == b.shadingMode &&
+           a.useColor == b.useColor && (!a.useColor || a.color == b.color) &&
+           a.materialIndex == b.materialIndex && a.pass == b.pass && a.alphaTested == b.alphaTested &&
+           std::equal(std::begin(a.textures), std::end(a.textures), std::begin(b.textures));
+}
+
+void CStaticBatch::append(const DrawPacket& state, const glm::mat4& mxWorld,
+                          const GLfloat* vertices, int vertexCount, int stride,
+                          int posOffset, int colorOffset, int normalOffset, int texOffset,
+                          const GLuint* indices, int indexCount) {
+    // 索引保持網格內的編號，由 baseVertex 指到 arena 中的位置
+    Entry entry;
+    entry.state = state;
+    entry.command.count = static_cast<GLuint>(indexCount);
+    entry.command.instanceCount = 1;
+    entry.command.firstIndex = static_cast<GLuint>(_indices.size());
+    entry.command.baseVertex = static_cast<GLint>(_vertices.size() / BATCH_VERTEX_FLOATS);
+    entry.command.baseInstance = 0;
+
+    glm::mat3 mxNormal = glm::transpose(glm::inverse(glm::mat3(mxWorld)));
+    _vertices.reserve(_vertices.size() + vertexCount * BATCH_VERTEX_FLOATS);
+    for (int v = 0; v < vertexCount; v++) {
+        const GLfloat* src = vertices + v * stride;
+        glm::vec3 pos = glm::vec3(mxWorld * glm::vec4(src[posOffset], src[posOffset + 1], src[posOffset + 2], 1.0f));
+        entry.boundsMin = (v == 0) ? pos : glm::min(entry.boundsMin, pos);
+        entry.boundsMax = (v == 0) ? pos : glm::max(entry.boundsMax, pos);
+        glm::vec3 color = (colorOffset >= 0) ? glm::vec3(src[colorOffset], src[colorOffset + 1], src[colorOffset + 2]) : glm::vec3(1.0f);
+        glm::vec3 normal = glm::normalize(mxNormal * glm::vec3(src[normalOffset], src[normalOffset + 1], src[normalOffset + 2]));
+        const GLfloat out[BATCH_VERTEX_FLOATS] = {
+            pos.x, pos.y, pos.z, color.r, color.g, color.b,
+            normal.x, normal.y, normal.z, src[texOffset], src[texOffset + 1]
+        };
+        _vertices.insert(_vertices.end(), out, out + BATCH_VERTEX_FLOATS);
+    }
+    _indices.insert(_indices.end(), indices, indices + indexCount);
+    _entries.push_back(entry);
+}
+
+void CStaticBatch::bake() {
+    release();
+
+    // 1. CPU 端轉換到世界座標，依序放進 arena
+    for (const auto& source : _sources) {
+        if (source.model != nullptr) {
+            Model* model = source.model;
+            for (size_t m = 0; m < model->GetMeshCount(); m++) {
+                const Mesh& mesh = model->GetMesh(m);
+                if (mesh.vertices.empty() || mesh.indices.empty()) continue;
+                DrawPacket state = model->GetMeshPacket(m, source.shaderProgram, source.mxModel);
+                append(state, source.mxModel,
+                       mesh.vertices[0].position, static_cast<int>(mesh.vertices.size()), sizeof(Vertex) / sizeof(float),
+                       offsetof(Vertex, position) / sizeof(float), -1,
+                       offsetof(Vertex, normal) / sizeof(float), offsetof(Vertex, texCoords) / sizeof(float),
+                       mesh.indices.data(), static_cast<int>(mesh.indices.size()));
+            }
+        } else {
+            CShape* shape = source.shape;
+            DrawPacket state = shape->getDrawPacket();
+            append(state, state.mxModel,
+                   shape->getVertexData(), shape->getVertexCount(), shape->getVertexAttrCount(),
+                   0, 3, 6, 9, shape->getIndexData(), shape->getIndexCount());
+        }
+    }
+    if (_entries.empty()) return;
+
+    // 2. 依繪製狀態分組，同一組的命令在命令 buffer 中連續存放
+    // 透明的網格需要與其他 packet 一起由遠到近排序，一次 multi-draw 內無法排序，因此各自成一組
+    for (int e = 0; e < static_cast<int>(_entries.size()); e++) {
+        const Entry& entry = _entries[e];
+        auto it = _batches.end();
+        if (entry.state.pass != RENDER_PASS_TRANSPARENT) {
+            it = std::find_if(_batches.begin(), _batches.end(),
+                              [&](const Batch& batch) { return sameState(batch.packet, entry.state); });
+        }
+        if (it == _batches.end()) {
+            _batches.emplace_back();
+            it = _batches.end() - 1;
+            it->packet = entry.state;
+            it->packet.indexCount = 0;
+            it->packet.instanceCount = 0;
+            it->packet.mxModel = glm::mat4(1.0f);
+        }
+        it->entries.push_back(e);
+        _culler.add(entry.boundsMin, entry.boundsMax);
+    }
+    _occluded.assign(_entries.size(), 0);
+
+    // 3. 上傳 arena 與命令，所有組共用同一個 VAO
+    CGLState& gl = CGLState::getInstance();
+    glGenVertexArrays(1, &_vao);
+    glGenBuffers(1, &_vbo);
+    glGenBuffers(1, &_ebo);
+    gl.bindVertexArray(_vao);
+
+    glBindBuffer(GL_ARRAY_BUFFER, _vbo);
+    glBufferData(GL_ARRAY_BUFFER, _vertices.size() * sizeof(GLfloat), _vertices.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, _ebo);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, _indices.size() * sizeof(GLuint), _indices.data(), GL_STATIC_DRAW);
+
+    const GLsizei stride = BATCH_VERTEX_FLOATS * sizeof(float);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, BUFFER_OFFSET(0));
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, stride, BUFFER_OFFSET(3 * sizeof(float)));
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, stride, BUFFER_OFFSET(6 * sizeof(float)));
+    glEnableVertexAttribArray(2);
+    glVertexAttribPointer(3, 2, GL_FLOAT, GL_FALSE, stride, BUFFER_OFFSET(9 * sizeof(float)));
+    glEnableVertexAttribArray(3);
+
+    // 只有位置的 arena：baseVertex 與索引都與完整的 arena 相同，同一組命令可以直接使用
+    if (CShape::isPositionStreamEnabled()) {
+        size_t vertexCount = _vertices.size() / BATCH_VERTEX_FLOATS;
+        std::vector<GLfloat> positions(vertexCount * 3);
+        for (size_t v = 0; v < vertexCount; v++) {
+            for (int k = 0; k < 3; k++) positions[v * 3 + k] = _vertices[v * BATCH_VERTEX_FLOATS + k];
+        }
+        glGenVertexArrays(1, &_positionVao);
+        glGenBuffers(1, &_positionVbo);
+        gl.bindVertexArray(_positionVao);
+        glBindBuffer(GL_ARRAY_BUFFER, _positionVbo);
+        glBufferData(GL_ARRAY_BUFFER, positions.size() * sizeof(GLfloat), positions.data(), GL_STATIC_DRAW);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, _ebo);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), BUFFER_OFFSET(0));
+        glEnableVertexAttribArray(0);
+    }
+    gl.bindVertexArray(0);
+
+    // GL 4.3：所有組的命令放在同一個 indirect buffer，內容由 rebuildCommands 填入
+    if (CMultiDrawRun::isIndirectSupported()) {
+        glGenBuffers(1, &_indirectBuffer);
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, _indirectBuffer);
+        glBufferData(GL_DRAW_INDIRECT_BUFFER, _entries.size() * sizeof(DrawElementsIndirectCommand), nullptr, GL_DYNAMIC_DRAW);
+    }
+    // _batches 不再改變，這時才設定指向 run 的指標
+    for (auto& batch : _batches) {
+        batch.packet.vao = _vao;
+        batch.packet.positionVao = _positionVao;
+        batch.packet.multiDraw = &batch.run;
+        // 整組的世界座標包圍球：排序深度與逐物件的光源列表使用
+        glm::vec3 bmin = _entries[batch.entries[0]].boundsMin, bmax = _entries[batch.entries[0]].boundsMax;
+        for (int index : batch.entries) {
+            bmin = glm::min(bmin, _entries[index].boundsMin);
+            bmax = glm::max(bmax, _entries[index].boundsMax);
+        }
+        batch.packet.center = (bmin + bmax) * 0.5f;
+        batch.packet.radius = glm::length(bmax - batch.packet.center);
+    }
+    rebuildCommands();
+    std::vector<GLfloat>().swap(_vertices);
+    std::vector<GLuint>().swap(_indices);
+
+    std::cout << "Static batching: " << _entries.size() << " draw calls -> " << _batches.size()
+              << (_indirectBuffer != 0 ? " glMultiDrawElementsIndirect" : " glMultiDrawElementsBaseVertex") << " calls" << std::endl;
+}
+
+void CStaticBatch::rebuildCommands() {
+    // 各組的可見命令依序排在 indirect buffer 中，各組記錄自己的起點
+    std::vector<DrawElementsIndirectCommand> commands;
+    commands.reserve(_entries.size());
+    for (auto& batch : _batches) {
+        batch.run.clear();
+        for (int index : batch.entries) {
+            if (_culler.isVisible(index) && !_occluded[index]) batch.run.addCommand(_entries[index].command);
+        }
+        batch.run.setIndirectBuffer(_indirectBuffer, static_cast<GLintptr>(commands.size() * sizeof(DrawElementsIndirectCommand)));
+        commands.insert(commands.end(), batch.run.getCommands().begin(), batch.run.getCommands().end());
+    }
+    if (_indirectBuffer != 0 && !commands.empty()) {
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, _indirectBuffer);
+        glBufferSubData(GL_DRAW_INDIRECT_BUFFER, 0, commands.size() * sizeof(DrawElementsIndirectCommand), commands.data());
+    }
+}
+
+void CStaticBatch::cull(const CFrustum& frustum, const COcclusionCuller* occlusion) {
+    bool changed = _culler.cull(frustum);
+    _occludedCount = 0;
+    for (size_t i = 0; i < _entries.size(); i++) {
+        uint8_t occluded = 0;
+        if (occlusion != nullptr && _culler.isVisible(static_cast<int>(i)))
+            occluded = occlusion->isVisible(_entries[i].boundsMin, _entries[i].boundsMax) ? 0 : 1;
+        if (occluded != _occluded[i]) { _occluded[i] = occluded; changed = true; }
+        _occludedCount += occluded;
+    }
+    if (changed) rebuildCommands();   // 可見集合沒有改變時沿用上一次的命令
+}
+
+void CStaticBatch::submit(CRenderQueue& queue) {
+    for (const auto& batch : _batches) queue.submit(batch.packet);
+}
@@ -0,0 +1,85 @@
+//  CStaticBatch.h
+//  靜態物件合批：把不會移動的 CShape 與 Model 網格轉到世界座標，全部放進同一組頂點/索引 arena，
+//  每個網格是一個 DrawElementsIndirectCommand；相同 shader 變體、上色模式、材質與貼圖的命令排在一起，
+//  每組以一次 multi-draw 送出，送出的 CPU 成本與網格數量無關
+//  標記為 dynamic 的物件不會加入，仍由呼叫端個別送出
+//  每個網格保留世界座標的 AABB，cull() 後只有可見的命令會送出
+
+#pragma once
+
+#include <vector>
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include "CRenderQueue.h"
+#include "CCuller.h"
+#include "COcclusionCuller.h"
+
+class CShape;
+class Model;
+
+class CStaticBatch {
+public:
+    CStaticBatch() = default;
+    ~CStaticBatch();
+
+    // 以目前的 model matrix 加入，動態物件或沒有頂點資料時回傳 false
+    bool addShape(CShape* shape);
+    bool addModel(Model* model, GLuint shaderProgram, const glm::mat4& mxModel);
+    // 依已加入的物件 (重新) 建立所有合併的 buffer，模型重新載入後再呼叫一次即可
+    void bake();
+    void release();
+
+    // 以視錐剔除個別網格，occlusion 不為 nullptr 時再剔除被遮蔽物擋住的網格，
+    // 可見集合改變時才重建各組的命令 (與 indirect buffer)
+    void cull(const CFrustum& frustum, const COcclusionCuller* occlusion = nullptr);
+    void submit(CRenderQueue& queue);
+    bool contains(const CShape* object) const;
+
+    int getSourceDrawCount() const { return static_cast<int>(_entries.size()); }   // 合併前的 draw call 數
+    int getBatchCount() const { return static_cast<int>(_batches.size()); }     // 每組一次 multi-draw
+    int getCulledCount() const { return _culler.getCulledCount(); }              // 上一次 cull() 在視錐外的網格數
+    int getOccludedCount() const { return _occludedCount; }                      // 上一次 cull() 被遮蔽的網格數
+
+private:
+    CStaticBatch(const CStaticBatch&) = delete;
+    CStaticBatch& operator=(const CStaticBatch&) = delete;
+
+    struct Source {
+        CShape*   shape;
+        Model*    model;            // 非 nullptr 時為 Model，其他為一般 CShape
+        GLuint    shaderProgram;
+        glm::mat4 mxModel;
+    };
+    // 一個網格在 arena 中的位置與繪製狀態
+    struct Entry {
+        DrawPacket state;
+        DrawElementsIndirectCommand command;
+        glm::vec3 boundsMin, boundsMax;     // 世界座標的 AABB
+    };
+    struct Batch {
+        DrawPacket packet;          // 繪製狀態，mxModel 為單位矩陣，packet.multiDraw 指向 run
+        CMultiDrawRun run;
+        std::vector<int> entries;   // 屬於本組的網格 (_entries 的索引)
+    };
+
+    static bool sameState(const DrawPacket& a, const DrawPacket& b);
+    // vertices 每個頂點 stride 個 float，position / normal / texCoord 的位移由 offsets 指定，color 可為 -1
+    void append(const DrawPacket& state, const glm::mat4& mxWorld,
+                const GLfloat* vertices, int vertexCount, int stride,
+                int posOffset, int colorOffset, int normalOffset, int texOffset,
+                const GLuint* indices, int indexCount);
+    // 依 _culler 的結果重新填入各組的命令，indirect buffer 存在時一併更新
+    void rebuildCommands();
+
+    std::vector<Source> _sources;
+    std::vector<Entry> _entries;
+    std::vector<Batch> _batches;
+    CCuller _culler;                // 與 _entries 一一對應
+    std::vector<uint8_t> _occluded; // 1 代表在視錐內但被遮蔽物擋住
+    int _occludedCount = 0;
+    // arena：所有網格共用的頂點 (與 CShape 相同的 11 個 float 配置) 與索引，上傳後釋放 CPU 端資料
+    std::vector<GLfloat> _vertices;
+    std::vector<GLuint>  _indices;
+    GLuint _vao = 0, _vbo = 0, _ebo = 0, _indirectBuffer = 0;
+    GLuint _positionVao = 0, _positionVbo = 0;    // 只有位置的 arena，頂點順序與 _vbo 相同，共用 _ebo
+};
@@ -0,0 +1,52 @@
+//  CTextureBuffer.cpp
+#include "CTextureBuffer.h"
+#include "CGLState.h"
+#include <iostream>
+
+CTextureBuffer::CTextureBuffer() : _buffer(0), _texture(0), _format(GL_RGBA32F), _capacity(0) {
+}
+
+CTextureBuffer::~CTextureBuffer() {
+    // GL context 可能已經結束，由 release() 明確釋放
+}
+
+void CTextureBuffer::create(GLenum internalFormat) {
+    if (_texture != 0) release();
+    _format = internalFormat;
+    glGenBuffers(1, &_buffer);
+    glGenTextures(1, &_texture);
+}
+
+void CTextureBuffer::release() {
+    if (_texture != 0) CGLState::getInstance().deleteTexture(_texture);
+    if (_buffer != 0) glDeleteBuffers(1, &_buffer);
+    _texture = _buffer = 0;
+    _capacity = 0;
+}
+
+void CTextureBuffer::upload(GLsizeiptr size, const void* data) {
+    if (_buffer == 0 || size <= 0) return;
+    glBindBuffer(GL_TEXTURE_BUFFER, _buffer);
+    if (size > _capacity) {
+        GLsizeiptr capacity = _capacity > 0 ? _capacity : size;
+        while (capacity < size) capacity *= 2;
+        glBufferData(GL_TEXTURE_BUFFER, capacity, nullptr, GL_DYNAMIC_DRAW);
+        _capacity = capacity;
+        // 重新配置後 texture 需要重新指向 buffer (透過 CGLState 綁定，避免快取失去同步)
+        CGLState::getInstance().bindTexture(0, GL_TEXTURE_BUFFER, _texture);
+        glTexBuffer(GL_TEXTURE_BUFFER, _format, _buffer);
+    }
+    glBufferSubData(GL_TEXTURE_BUFFER, 0, size, data);
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+}
+
+void CTextureBuffer::update(GLintptr offset, GLsizeiptr size, const void* data) {
+    if (_buffer == 0 || size <= 0) return;
+    if (offset + size > _capacity) {
+        std::cerr << "CTextureBuffer::update out of range (" << offset << " + " << size << " > " << _capacity << ")" << std::endl;
+        return;
+    }
+    glBindBuffer(GL_TEXTURE_BUFFER, _buffer);
+    glBufferSubData(GL_TEXTURE_BUFFER, offset, size, data);
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+}
@@ -0,0 +1,36 @@
+//  CTextureBuffer.h
+//  buffer texture (GL_TEXTURE_BUFFER) 的封裝，GL 3.3 沒有 SSBO，
+//  大量或長度不固定的資料 (例如光源與 cluster 的索引表) 放在這裡，shader 以 texelFetch 讀取
+
+#pragma once
+
+#include <GL/glew.h>
+
+class CTextureBuffer {
+public:
+    CTextureBuffer();
+    ~CTextureBuffer();
+
+    // internalFormat 例如 GL_RGBA32F、GL_RG32UI、GL_R16UI
+    void create(GLenum internalFormat);
+    void release();
+
+    // 整個重新上傳，容量不足時重新配置 (以兩倍成長)，否則只更新前 size bytes
+    void upload(GLsizeiptr size, const void* data);
+    // 只更新 [offset, offset + size) 範圍的資料
+    void update(GLintptr offset, GLsizeiptr size, const void* data);
+
+    bool isCreated() const { return _texture != 0; }
+    GLuint getTexture() const { return _texture; }
+    GLuint getBuffer() const { return _buffer; }
+    GLsizeiptr getCapacity() const { return _capacity; }
+
+private:
+    CTextureBuffer(const CTextureBuffer&) = delete;
+    CTextureBuffer& operator=(const CTextureBuffer&) = delete;
+
+    GLuint _buffer;
+    GLuint _texture;
+    GLenum _format;
+    GLsizeiptr _capacity;
+};
@@ -0,0 +1,149 @@
+//  CTransformGraph.cpp
+#include "CTransformGraph.h"
+
+CTransformGraph& CTransformGraph::getInstance() {
+	static CTransformGraph instance;
+	return instance;
+}
+
+glm::mat4 CTransformGraph::composeTRS(const glm::vec3& position, const glm::quat& rotation, const glm::vec3& scale) {
+	glm::mat3 r = glm::mat3_cast(rotation);
+	glm::mat4 m;
+	m[0] = glm::vec4(r[0] * scale.x, 0.0f);
+	m[1] = glm::vec4(r[1] * scale.y, 0.0f);
+	m[2] = glm::vec4(r[2] * scale.z, 0.0f);
+	m[3] = glm::vec4(position, 1.0f);
+	return m;
+}
+
+int CTransformGraph::createNode(int parent) {
+	int node;
+	if (_freeList != TRANSFORM_NULL_NODE) {
+		node = _freeList;
+		_freeList = _parent[node];
+	} else {
+		node = static_cast<int>(_parent.size());
+		_parent.push_back(TRANSFORM_NULL_NODE);
+		_firstChild.push_back(TRANSFORM_NULL_NODE);
+		_nextSibling.push_back(TRANSFORM_NULL_NODE);
+		_local.emplace_back(1.0f);
+		_world.emplace_back(1.0f);
+		_version.push_back(0);
+		_dirty.push_back(0);
+		_alive.push_back(0);
+	}
+	_parent[node] = TRANSFORM_NULL_NODE;
+	_firstChild[node] = _nextSibling[node] = TRANSFORM_NULL_NODE;
+	_local[node] = _world[node] = glm::mat4(1.0f);
+	_dirty[node] = 0;
+	_alive[node] = 1;
+	_nodeCount++;
+	if (parent != TRANSFORM_NULL_NODE) {
+		attach(node, parent);
+		markDirty(node);
+	}
+	return node;
+}
+
+void CTransformGraph::destroyNode(int node) {
+	if (node < 0 || node >= static_cast<int>(_alive.size()) || !_alive[node]) return;
+	// 子節點改接到 parent，local 換成原本的 world 相對於新 parent 的矩陣
+	int parent = _parent[node];
+	while (_firstChild[node] != TRANSFORM_NULL_NODE) {
+		int child = _firstChild[node];
+		glm::mat4 world = getWorldMatrix(child);
+		detach(child);
+		if (parent != TRANSFORM_NULL_NODE) {
+			attach(child, parent);
+			_local[child] = glm::inverse(getWorldMatrix(parent)) * world;
+		} else {
+			_local[child] = world;
+		}
+		markDirty(child);
+	}
+	detach(node);
+	_alive[node] = 0;
+	_dirty[node] = 0;
+	_parent[node] = _freeList;
+	_freeList = node;
+	_nodeCount--;
+}
+
+void CTransformGraph::setParent(int node, int parent) {
+	if (_parent[node] == parent) return;
+	// 不允許接到自己的子孫下
+	for (int p = parent; p != TRANSFORM_NULL_NODE; p = _parent[p]) {
+		if (p == node) return;
+	}
+	detach(node);
+	if (parent != TRANSFORM_NULL_NODE) attach(node, parent);
+	markDirty(node);
+}
+
+void CTransformGraph::clear() {
+	_parent.clear(); _firstChild.clear(); _nextSibling.clear();
+	_local.clear(); _world.clear(); _version.clear(); _dirty.clear(); _alive.clear();
+	_dirtyList.clear();
+	_freeList = TRANSFORM_NULL_NODE;
+	_nodeCount = 0;
+}
+
+void CTransformGraph::detach(int node) {
+	int parent = _parent[node];
+	if (parent == TRANSFORM_NULL_NODE) return;
+	int* link = &_firstChild[parent];
+	while (*link != node) link = &_nextSibling[*link];
+	*link = _nextSibling[node];
+	_parent[node] = _nextSibling[node] = TRANSFORM_NULL_NODE;
+}
+
+void CTransformGraph::attach(int node, int parent) {
+	_parent[node] = parent;
+	_nextSibling[node] = _firstChild[parent];
+	_firstChild[parent] = node;
+}
+
+void CTransformGraph::setLocalMatrix(int node, const glm::mat4& mxLocal) {
+	if (mxLocal == _local[node]) return;
+	_local[node] = mxLocal;
+	markDirty(node);
+}
+
+void CTransformGraph::setLocal(int node, const glm::vec3& position, const glm::quat& rotation, const glm::vec3& scale) {
+	setLocalMatrix(node, composeTRS(position, rotation, scale));
+}
+
+void CTransformGraph::markDirty(int node) {
+	// dirty 的節點其子孫一定也是 dirty，遇到時整個子樹略過
+	if (_dirty[node]) return;
+	_dirty[node] = 1;
+	_dirtyList.push_back(node);
+	for (int child = _firstChild[node]; child != TRANSFORM_NULL_NODE; child = _nextSibling[child]) markDirty(child);
+}
+
+void CTransformGraph::resolve(int node) {
+	if (!_dirty[node]) return;
+	int parent = _parent[node];
+	if (parent != TRANSFORM_NULL_NODE) {
+		resolve(parent);
+		_world[node] = _world[parent] * _local[node];
+	} else {
+		_world[node] = _local[node];
+	}
+	_dirty[node] = 0;
+	_version[node]++;
+	_updated++;
+}
+
+const glm::mat4& CTransformGraph::getWorldMatrix(int node) {
+	resolve(node);
+	return _world[node];
+}
+
+void CTransformGraph::update() {
+	_updated = 0;
+	for (int node : _dirtyList) {
+		if (_alive[node]) resolve(node);
+	}
+	_dirtyList.clear();
+}
@@ -0,0 +1,72 @@
+//  CTransformGraph.h
+//  階層式的 transform：每個節點有 parent 與 local matrix，world = parent 的 world * local；
+//  所有節點放在平行的陣列中 (parent / 第一個子節點 / 下一個兄弟節點、local、world、dirty 旗標)，
+//  local 改變時才把節點與所有子孫標記為 dirty 並放進 dirty 列表，update() 只重算列表中的節點，
+//  沒有移動的物件每個 frame 不需要任何矩陣運算；只用到 glm，不需要 GL context
+
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#define TRANSFORM_NULL_NODE -1
+
+class CTransformGraph {
+public:
+	static CTransformGraph& getInstance();
+
+	// 新節點的 local 為單位矩陣，parent 為 TRANSFORM_NULL_NODE 時為根節點
+	int  createNode(int parent = TRANSFORM_NULL_NODE);
+	// 子節點改接到被移除節點的 parent，world 保持不變
+	void destroyNode(int node);
+	void setParent(int node, int parent);
+	int  getParent(int node) const { return _parent[node]; }
+	void clear();
+
+	// 與目前的 local 相同時不標記 dirty
+	void setLocalMatrix(int node, const glm::mat4& mxLocal);
+	void setLocal(int node, const glm::vec3& position, const glm::quat& rotation, const glm::vec3& scale);
+	const glm::mat4& getLocalMatrix(int node) const { return _local[node]; }
+
+	// dirty 時先重算祖先再重算自己，任何時候取得的都是最新的 world matrix
+	const glm::mat4& getWorldMatrix(int node);
+	glm::vec3 getWorldPosition(int node) { return glm::vec3(getWorldMatrix(node)[3]); }
+	// world matrix 每重算一次加一，呼叫端以此判斷是否需要更新 (例如 BVH 的邊界或光源的位置)
+	uint32_t getVersion(int node) const { return _version[node]; }
+	bool isDirty(int node) const { return _dirty[node] != 0; }
+
+	// 重算所有 dirty 的節點，每個 frame 在移動物件之後、繪製之前呼叫一次
+	void update();
+
+	int getNodeCount() const { return _nodeCount; }
+	int getUpdatedCount() const { return _updated; }   // 上一次 update() 重算的節點數
+
+	// T * R * S 直接組成矩陣，不經過三次 4x4 乘法
+	static glm::mat4 composeTRS(const glm::vec3& position, const glm::quat& rotation, const glm::vec3& scale);
+
+private:
+	CTransformGraph() = default;
+	CTransformGraph(const CTransformGraph&) = delete;
+	CTransformGraph& operator=(const CTransformGraph&) = delete;
+
+	// 節點與子孫標記為 dirty (已經是 dirty 的子樹不需要再走訪)
+	void markDirty(int node);
+	void resolve(int node);
+	void detach(int node);
+	void attach(int node, int parent);
+
+	std::vector<int> _parent;           // 在 free list 中時為下一個空節點
+	std::vector<int> _firstChild;
+	std::vector<int> _nextSibling;
+	std::vector<glm::mat4> _local;
+	std::vector<glm::mat4> _world;
+	std::vector<uint32_t> _version;
+	std::vector<uint8_t> _dirty;
+	std::vector<uint8_t> _alive;
+	std::vector<int> _dirtyList;        // 被標記的節點 (子孫在 resolve 時一併處理)
+	int _freeList = TRANSFORM_NULL_NODE;
+	int _nodeCount = 0;
+	int _updated = 0;
+};
@@ -0,0 +1,170 @@
+//  CTransformStore.cpp
+#include <algorithm>
+#include "CTransformStore.h"
+
+#if defined(__SSE__) || defined(_M_X64)
+#include <xmmintrin.h>
+#define TRANSFORM_USE_SSE
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#define TRANSFORM_USE_NEON
+#endif
+
+int CTransformStore::add(const glm::vec3& position, const glm::quat& rotation, const glm::vec3& scale) {
+	int index = _count++;
+	// 補齊為 4 的倍數，SIMD 核心不需要處理尾端；補上的是單位 transform，結果不會被讀取
+	size_t padded = (static_cast<size_t>(_count) + 3) & ~static_cast<size_t>(3);
+	for (auto* v : { &_posX, &_posY, &_posZ, &_rotX, &_rotY, &_rotZ }) v->resize(padded, 0.0f);
+	for (auto* v : { &_rotW, &_scaleX, &_scaleY, &_scaleZ }) v->resize(padded, 1.0f);
+	_world.resize(padded * 3, glm::vec4(0.0f));
+	set(index, position, rotation, scale);
+	return index;
+}
+
+void CTransformStore::set(int index, const glm::vec3& position, const glm::quat& rotation, const glm::vec3& scale) {
+	_posX[index] = position.x; _posY[index] = position.y; _posZ[index] = position.z;
+	_scaleX[index] = scale.x; _scaleY[index] = scale.y; _scaleZ[index] = scale.z;
+	setRotation(index, rotation);
+}
+
+void CTransformStore::setPosition(int index, const glm::vec3& position) {
+	_posX[index] = position.x; _posY[index] = position.y; _posZ[index] = position.z;
+	markDirty(index);
+}
+
+void CTransformStore::setRotation(int index, const glm::quat& rotation) {
+	glm::quat q = glm::normalize(rotation);
+	_rotX[index] = q.x; _rotY[index] = q.y; _rotZ[index] = q.z; _rotW[index] = q.w;
+	markDirty(index);
+}
+
+void CTransformStore::setScale(int index, const glm::vec3& scale) {
+	_scaleX[index] = scale.x; _scaleY[index] = scale.y; _scaleZ[index] = scale.z;
+	markDirty(index);
+}
+
+void CTransformStore::clear() {
+	_count = _dirtyBegin = _dirtyEnd = 0;
+	for (auto* v : { &_posX, &_posY, &_posZ, &_rotX, &_rotY, &_rotZ, &_rotW, &_scaleX, &_scaleY, &_scaleZ })
+		v->clear();
+	_world.clear();
+}
+
+void CTransformStore::reserve(int count) {
+	size_t padded = (static_cast<size_t>(count) + 3) & ~static_cast<size_t>(3);
+	for (auto* v : { &_posX, &_posY, &_posZ, &_rotX, &_rotY, &_rotZ, &_rotW, &_scaleX, &_scaleY, &_scaleZ })
+		v->reserve(padded);
+	_world.reserve(padded * 3);
+}
+
+void CTransformStore::markDirty(int index) {
+	// 只記錄一段範圍：每個 frame 更新全部或連續的一批時不需要額外的記錄
+	if (_dirtyBegin == _dirtyEnd) { _dirtyBegin = index; _dirtyEnd = index + 1; return; }
+	_dirtyBegin = std::min(_dirtyBegin, index);
+	_dirtyEnd = std::max(_dirtyEnd, index + 1);
+}
+
+int CTransformStore::update() {
+	if (_dirtyBegin == _dirtyEnd) return 0;
+	int begin = _dirtyBegin & ~3;
+	int end = (_dirtyEnd + 3) & ~3;
+	compose(begin, end);
+	int composed = _dirtyEnd - _dirtyBegin;
+	_dirtyBegin = _dirtyEnd = 0;
+	return composed;
+}
+
+void CTransformStore::compose(int begin, int end) {
+	// row i = (R[i][0] * sx, R[i][1] * sy, R[i][2] * sz, t[i])，R 由單位四元數展開：
+	//   R = | 1-2(yy+zz)   2(xy-wz)     2(xz+wy)   |
+	//       | 2(xy+wz)     1-2(xx+zz)   2(yz-wx)   |
+	//       | 2(xz-wy)     2(yz+wx)     1-2(xx+yy) |
+#if defined(TRANSFORM_USE_SSE)
+	const __m128 one = _mm_set1_ps(1.0f), two = _mm_set1_ps(2.0f);
+	for (int i = begin; i < end; i += 4) {
+		__m128 x = _mm_loadu_ps(&_rotX[i]), y = _mm_loadu_ps(&_rotY[i]);
+		__m128 z = _mm_loadu_ps(&_rotZ[i]), w = _mm_loadu_ps(&_rotW[i]);
+		__m128 sx = _mm_loadu_ps(&_scaleX[i]), sy = _mm_loadu_ps(&_scaleY[i]), sz = _mm_loadu_ps(&_scaleZ[i]);
+		__m128 x2 = _mm_mul_ps(x, two), y2 = _mm_mul_ps(y, two), z2 = _mm_mul_ps(z, two);
+		__m128 xx = _mm_mul_ps(x, x2), yy = _mm_mul_ps(y, y2), zz = _mm_mul_ps(z, z2);
+		__m128 xy = _mm_mul_ps(x, y2), xz = _mm_mul_ps(x, z2), yz = _mm_mul_ps(y, z2);
+		__m128 wx = _mm_mul_ps(w, x2), wy = _mm_mul_ps(w, y2), wz = _mm_mul_ps(w, z2);
+
+		__m128 r0 = _mm_mul_ps(_mm_sub_ps(one, _mm_add_ps(yy, zz)), sx);
+		__m128 r1 = _mm_mul_ps(_mm_sub_ps(xy, wz), sy);
+		__m128 r2 = _mm_mul_ps(_mm_add_ps(xz, wy), sz);
+		__m128 r3 = _mm_loadu_ps(&_posX[i]);
+		_MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+		float* out = &_world[static_cast<size_t>(i) * 3].x;
+		_mm_storeu_ps(out, r0); _mm_storeu_ps(out + 12, r1); _mm_storeu_ps(out + 24, r2); _mm_storeu_ps(out + 36, r3);
+
+		r0 = _mm_mul_ps(_mm_add_ps(xy, wz), sx);
+		r1 = _mm_mul_ps(_mm_sub_ps(one, _mm_add_ps(xx, zz)), sy);
+		r2 = _mm_mul_ps(_mm_sub_ps(yz, wx), sz);
+		r3 = _mm_loadu_ps(&_posY[i]);
+		_MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+		_mm_storeu_ps(out + 4, r0); _mm_storeu_ps(out + 16, r1); _mm_storeu_ps(out + 28, r2); _mm_storeu_ps(out + 40, r3);
+
+		r0 = _mm_mul_ps(_mm_sub_ps(xz, wy), sx);
+		r1 = _mm_mul_ps(_mm_add_ps(yz, wx), sy);
+		r2 = _mm_mul_ps(_mm_sub_ps(one, _mm_add_ps(xx, yy)), sz);
+		r3 = _mm_loadu_ps(&_posZ[i]);
+		_MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+		_mm_storeu_ps(out + 8, r0); _mm_storeu_ps(out + 20, r1); _mm_storeu_ps(out + 32, r2); _mm_storeu_ps(out + 44, r3);
+	}
+#elif defined(TRANSFORM_USE_NEON)
+	const float32x4_t one = vdupq_n_f32(1.0f);
+	for (int i = begin; i < end; i += 4) {
+		float32x4_t x = vld1q_f32(&_rotX[i]), y = vld1q_f32(&_rotY[i]);
+		float32x4_t z = vld1q_f32(&_rotZ[i]), w = vld1q_f32(&_rotW[i]);
+		float32x4_t sx = vld1q_f32(&_scaleX[i]), sy = vld1q_f32(&_scaleY[i]), sz = vld1q_f32(&_scaleZ[i]);
+		float32x4_t x2 = vaddq_f32(x, x), y2 = vaddq_f32(y, y), z2 = vaddq_f32(z, z);
+		float32x4_t xx = vmulq_f32(x, x2), yy = vmulq_f32(y, y2), zz = vmulq_f32(z, z2);
+		float32x4_t xy = vmulq_f32(x, y2), xz = vmulq_f32(x, z2), yz = vmulq_f32(y, z2);
+		float32x4_t wx = vmulq_f32(w, x2), wy = vmulq_f32(w, y2), wz = vmulq_f32(w, z2);
+
+		// vst4q 交錯存放四個向量，等於轉置後依序寫出四筆的同一個 row
+		float rows[3][16];
+		float32x4x4_t row;
+		row.val[0] = vmulq_f32(vsubq_f32(one, vaddq_f32(yy, zz)), sx);
+		row.val[1] = vmulq_f32(vsubq_f32(xy, wz), sy);
+		row.val[2] = vmulq_f32(vaddq_f32(xz, wy), sz);
+		row.val[3] = vld1q_f32(&_posX[i]);
+		vst4q_f32(rows[0], row);
+		row.val[0] = vmulq_f32(vaddq_f32(xy, wz), sx);
+		row.val[1] = vmulq_f32(vsubq_f32(one, vaddq_f32(xx, zz)), sy);
+		row.val[2] = vmulq_f32(vsubq_f32(yz, wx), sz);
+		row.val[3] = vld1q_f32(&_posY[i]);
+		vst4q_f32(rows[1], row);
+		row.val[0] = vmulq_f32(vsubq_f32(xz, wy), sx);
+		row.val[1] = vmulq_f32(vaddq_f32(yz, wx), sy);
+		row.val[2] = vmulq_f32(vsubq_f32(one, vaddq_f32(xx, yy)), sz);
+		row.val[3] = vld1q_f32(&_posZ[i]);
+		vst4q_f32(rows[2], row);
+		float* out = &_world[static_cast<size_t>(i) * 3].x;
+		for (int k = 0; k < 4; k++)
+			for (int r = 0; r < 3; r++) vst1q_f32(out + k * 12 + r * 4, vld1q_f32(&rows[r][k * 4]));
+	}
+#else
+	for (int i = begin; i < end; i++) {
+		float x = _rotX[i], y = _rotY[i], z = _rotZ[i], w = _rotW[i];
+		float xx = 2.0f * x * x, yy = 2.0f * y * y, zz = 2.0f * z * z;
+		float xy = 2.0f * x * y, xz = 2.0f * x * z, yz = 2.0f * y * z;
+		float wx = 2.0f * w * x, wy = 2.0f * w * y, wz = 2.0f * w * z;
+		glm::vec4* out = &_world[static_cast<size_t>(i) * 3];
+		out[0] = glm::vec4((1.0f - yy - zz) * _scaleX[i], (xy - wz) * _scaleY[i], (xz + wy) * _scaleZ[i], _posX[i]);
+		out[1] = glm::vec4((xy + wz) * _scaleX[i], (1.0f - xx - zz) * _scaleY[i], (yz - wx) * _scaleZ[i], _posY[i]);
+		out[2] = glm::vec4((xz - wy) * _scaleX[i], (yz + wx) * _scaleY[i], (1.0f - xx - yy) * _scaleZ[i], _posZ[i]);
+	}
+#endif
+}
+
+glm::mat4 CTransformStore::getWorldMatrix(int index) const {
+	const glm::vec4* rows = getWorldRows(index);
+	glm::mat4 m;
+	m[0] = glm::vec4(rows[0].x, rows[1].x, rows[2].x, 0.0f);
+	m[1] = glm::vec4(rows[0].y, rows[1].y, rows[2].y, 0.0f);
+	m[2] = glm::vec4(rows[0].z, rows[1].z, rows[2].z, 0.0f);
+	m[3] = glm::vec4(rows[0].w, rows[1].w, rows[2].w, 1.0f);
+	return m;
+}
@@ -0,0 +1,46 @@
+//  CTransformStore.h
+//  大量物件的 transform 以 SoA 陣列存放 (位置 x/y/z、四元數 x/y/z/w、縮放 x/y/z 各一個陣列)，
+//  update() 以 SIMD 一次處理四筆，直接由 TRS 組成 3x4 的 world matrix，不經過三次 4x4 乘法；
+//  結果每筆連續存放三個 row (x / y / z 軸的 row，第四個分量為位移)，以 CInstanceSet::setTransforms 一次寫入；
+//  只需要 glm，不需要 GL context
+
+#pragma once
+
+#include <vector>
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+class CTransformStore {
+public:
+	// 回傳新 transform 的索引，四元數會先正規化
+	int  add(const glm::vec3& position, const glm::quat& rotation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f),
+			 const glm::vec3& scale = glm::vec3(1.0f));
+	void set(int index, const glm::vec3& position, const glm::quat& rotation, const glm::vec3& scale);
+	void setPosition(int index, const glm::vec3& position);
+	void setRotation(int index, const glm::quat& rotation);
+	void setScale(int index, const glm::vec3& scale);
+	void clear();
+	void reserve(int count);
+	int  size() const { return _count; }
+
+	glm::vec3 getPosition(int index) const { return glm::vec3(_posX[index], _posY[index], _posZ[index]); }
+
+	// 重新組合上次 update() 之後修改過的範圍，回傳組合的筆數
+	int update();
+
+	// 第 index 筆的 3 個 row (update() 之後才是最新的)，之後的筆數連續存放
+	const glm::vec4* getWorldRows(int index) const { return &_world[static_cast<size_t>(index) * 3]; }
+	glm::mat4 getWorldMatrix(int index) const;
+
+private:
+	void markDirty(int index);
+	// SIMD 核心：組合 [begin, end)，begin 與 end 為 4 的倍數
+	void compose(int begin, int end);
+
+	int _count = 0;
+	int _dirtyBegin = 0, _dirtyEnd = 0;    // [begin, end)，沒有修改時兩者相等
+	std::vector<float> _posX, _posY, _posZ;
+	std::vector<float> _rotX, _rotY, _rotZ, _rotW;
+	std::vector<float> _scaleX, _scaleY, _scaleZ;
+	std::vector<glm::vec4> _world;          // 每筆 3 個 row，長度補齊為 4 筆的倍數
+};
@@ -0,0 +1,52 @@
+//  CUniform.h
+//  預先解析好位置的 uniform handle
+//  初始化時透過 CShaderPool 的反射表取得 location，繪製時直接 glUniform*，
+//  不再有字串組合與 glGetUniformLocation 的呼叫
+
+#pragma once
+
+#include <string>
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/type_ptr.hpp>
+#include "CShaderPool.h"
+
+template <typename T>
+class CUniform {
+public:
+    CUniform() : _location(-1) {}
+    CUniform(GLuint shaderProg, const std::string& name) { bind(shaderProg, name); }
+
+    // 由 CShaderPool 的反射表取得位置，只在初始化或切換 program 時呼叫
+    void bind(GLuint shaderProg, const std::string& name) {
+        _location = CShaderPool::getInstance().getUniformLocation(shaderProg, name);
+    }
+
+    // 與 glUniform* 相同，作用在目前 glUseProgram 的 program 上
+    void set(const T& value) const;
+
+    bool  isValid() const { return _location != -1; }
+    GLint location() const { return _location; }
+
+private:
+    GLint _location;
+};
+
+template <> inline void CUniform<int>::set(const int& value) const {
+    if (_location != -1) glUniform1i(_location, value);
+}
+template <> inline void CUniform<bool>::set(const bool& value) const {
+    if (_location != -1) glUniform1i(_location, value ? 1 : 0);
+}
+template <> inline void CUniform<float>::set(const float& value) const {
+    if (_location != -1) glUniform1f(_location, value);
+}
+template <> inline void CUniform<glm::vec3>::set(const glm::vec3& value) const {
+    if (_location != -1) glUniform3fv(_location, 1, glm::value_ptr(value));
+}
+template <> inline void CUniform<glm::vec4>::set(const glm::vec4& value) const {
+    if (_location != -1) glUniform4fv(_location, 1, glm::value_ptr(value));
+}
+template <> inline void CUniform<glm::mat4>::set(const glm::mat4& value) const {
+    if (_location != -1) glUniformMatrix4fv(_location, 1, GL_FALSE, glm::value_ptr(value));
+}
@@ -0,0 +1,42 @@
+//  CUniformBuffer.cpp
+#include "CUniformBuffer.h"
+#include <iostream>
+
+CUniformBuffer::CUniformBuffer() : _ubo(0), _bindingPoint(0), _size(0) {
+}
+
+CUniformBuffer::~CUniformBuffer() {
+    // GL context 可能已經結束，由 release() 明確釋放
+}
+
+void CUniformBuffer::create(GLsizeiptr size, GLuint bindingPoint) {
+    if (_ubo != 0) release();
+
+    _size = size;
+    _bindingPoint = bindingPoint;
+
+    glGenBuffers(1, &_ubo);
+    glBindBuffer(GL_UNIFORM_BUFFER, _ubo);
+    glBufferData(GL_UNIFORM_BUFFER, _size, nullptr, GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+    // 綁定到固定的 binding point，之後不需要再切換
+    glBindBufferBase(GL_UNIFORM_BUFFER, _bindingPoint, _ubo);
+}
+
+void CUniformBuffer::release() {
+    if (_ubo != 0) glDeleteBuffers(1, &_ubo);
+    _ubo = 0;
+    _size = 0;
+}
+
+void CUniformBuffer::update(GLintptr offset, GLsizeiptr size, const void* data) {
+    if (_ubo == 0 || size <= 0) return;
+    if (offset + size > _size) {
+        std::cerr << "CUniformBuffer::update out of range (" << offset << " + " << size << " > " << _size << ")" << std::endl;
+        return;
+    }
+    glBindBuffer(GL_UNIFORM_BUFFER, _ubo);
+    glBufferSubData(GL_UNIFORM_BUFFER, offset, size, data);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
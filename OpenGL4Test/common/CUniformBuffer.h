@@ -0,0 +1,40 @@
+//  CUniformBuffer.h
+//  std140 uniform block 的 buffer 封裝
+//  建立時綁定到固定的 binding point，所有含有同名 block 的 program 由 CShaderPool 綁定到同一個 binding point，
+//  因此切換 program 時不需要重新上傳資料
+
+#pragma once
+
+#include <GL/glew.h>
+
+// 各 uniform block 固定使用的 binding point
+#define LIGHT_BLOCK_BINDING    0
+#define FRAME_BLOCK_BINDING    1
+#define MATERIAL_BLOCK_BINDING 2
+#define SHADOW_BLOCK_BINDING   3
+
+class CUniformBuffer {
+public:
+    CUniformBuffer();
+    ~CUniformBuffer();
+
+    // 配置 size bytes 的 buffer 並綁定到 bindingPoint
+    void create(GLsizeiptr size, GLuint bindingPoint);
+    void release();
+
+    // 只更新 [offset, offset + size) 範圍的資料
+    void update(GLintptr offset, GLsizeiptr size, const void* data);
+
+    bool isCreated() const { return _ubo != 0; }
+    GLuint getBuffer() const { return _ubo; }
+    GLuint getBindingPoint() const { return _bindingPoint; }
+    GLsizeiptr getSize() const { return _size; }
+
+private:
+    CUniformBuffer(const CUniformBuffer&) = delete;
+    CUniformBuffer& operator=(const CUniformBuffer&) = delete;
+
+    GLuint _ubo;
+    GLuint _bindingPoint;
+    GLsizeiptr _size;
+};
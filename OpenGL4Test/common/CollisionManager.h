@@ -4,6 +4,7 @@
 #include <vector>
 #include <glm/glm.hpp>
 #include "../models/CCube.h"
+#include "CSceneBVH.h"
 #include <memory>
 
 // AABB 包圍盒結構
@@ -67,6 +68,10 @@ private:
     Sphere cameraCollider;             // 攝影機的球體碰撞器
     std::vector<Sphere> sphereObstacles; // 球體障礙物
     float m_cameraRadius = 0.3f;
+    // 牆壁與障礙物同時登記在場景 BVH，userData 為在 walls / obstacles 中的索引
+    std::vector<int> wallProxies;
+    std::vector<int> obstacleProxies;
+    std::vector<int> candidates;       // BVH 查詢結果，保留容量重複使用
     
 public:
     CollisionManager() {
@@ -79,6 +84,8 @@ public:
     void initializeWalls() {
         // 範例：創建一個房間的牆壁
         walls.clear();
+        for (int proxy : wallProxies) CSceneBVH::getInstance().remove(proxy);
+        wallProxies.clear();
         
         glm::vec3 roomCenter = glm::vec3(0.0f, 10.1f, 0.0f);
                 
@@ -117,10 +124,16 @@ public:
         // 6. 天花板 (Y 軸方向)
         walls.push_back(AABB(glm::vec3(roomMinX, roomMaxY, roomMinZ),
                                glm::vec3(roomMaxX, roomMaxY + wallThickness, roomMaxZ)));
+        
+        for (size_t i = 0; i < walls.size(); ++i) {
+            wallProxies.push_back(CSceneBVH::getInstance().insert(walls[i].min, walls[i].max, static_cast<int>(i), SCENE_WALL));
+        }
     }
     
     // 添加障礙物
     void addObstacle(const AABB& obstacle) {
+        obstacleProxies.push_back(CSceneBVH::getInstance().insert(obstacle.min, obstacle.max,
+                                                                  static_cast<int>(obstacles.size()), SCENE_OBSTACLE));
         obstacles.push_back(obstacle);
     }
     
@@ -128,9 +141,15 @@ public:
     bool checkCameraCollision(const glm::vec3& newPosition) {
         cameraCollider.center = newPosition;
         
+        // 由場景 BVH 取出與碰撞球 AABB 重疊的牆壁與障礙物，只對這些做精確測試
+        glm::vec3 extent(cameraCollider.radius);
+        CSceneBVH& bvh = CSceneBVH::getInstance();
+        bvh.queryAABB(newPosition - extent, newPosition + extent, SCENE_COLLIDER, candidates);
+        
         // 檢查與牆壁的碰撞
-        // 檢查與牆壁的碰撞
-        for (size_t i = 0; i < walls.size(); ++i) { // Use index to identify the wall
+        for (int proxy : candidates) {
+            if (bvh.getFlags(proxy) != SCENE_WALL) continue;
+            size_t i = static_cast<size_t>(bvh.getUserData(proxy)); // Use index to identify the wall
             const auto& wall = walls[i]; // Get the current wall
 
             if (cameraCollider.intersects(wall)) {
@@ -155,7 +174,9 @@ public:
         }
 
         // 檢查與障礙物的碰撞
-        for (const auto& obstacle : obstacles) {
+        for (int proxy : candidates) {
+            if (bvh.getFlags(proxy) != SCENE_OBSTACLE) continue;
+            const auto& obstacle = obstacles[bvh.getUserData(proxy)];
             if (cameraCollider.intersects(obstacle)) {
                 std::cout << "checkCameraCollision = true (Obstacle)" << std::endl;
                 std::cout << "Collision Pos (Camera attempt): (" << newPosition.x << "," << newPosition.y << "," << newPosition.z << ")" << std::endl;
@@ -210,21 +231,15 @@ public:
         return calculateSliding(movement, currentPos);
     }
     
-    // 射線檢測（用於預測碰撞）
+    // 射線檢測（用於預測碰撞）：在 BVH 中找最近的牆壁或障礙物，AABB 以攝影機碰撞球半徑放大
     bool raycast(const glm::vec3& origin, const glm::vec3& direction,
                 float maxDistance, glm::vec3& hitPoint) {
-        // 簡化的射線檢測實現
-        const int steps = 20;
-        float stepSize = maxDistance / steps;
-        
-        for (int i = 1; i <= steps; ++i) {
-            glm::vec3 testPos = origin + direction * (stepSize * i);
-            if (checkCameraCollision(testPos)) {
-                hitPoint = testPos;
-                return true;
-            }
-        }
-        return false;
+        float distance = 0.0f;
+        int proxy = CSceneBVH::getInstance().raycast(origin, direction, maxDistance, SCENE_COLLIDER,
+                                                     distance, cameraCollider.radius);
+        if (proxy == BVH_NULL_NODE) return false;
+        hitPoint = origin + direction * distance;
+        return true;
     }
     
     // 獲取攝影機碰撞器半徑
@@ -234,7 +249,11 @@ public:
     void setCameraRadius(float radius) { cameraCollider.radius = radius; }
     
     // 清除所有障礙物
-    void clearObstacles() { obstacles.clear(); }
+    void clearObstacles() {
+        for (int proxy : obstacleProxies) CSceneBVH::getInstance().remove(proxy);
+        obstacleProxies.clear();
+        obstacles.clear();
+    }
     
     // 獲取牆壁數量
     size_t getWallCount() const { return walls.size(); }
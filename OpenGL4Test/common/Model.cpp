@@ -1,5 +1,10 @@
 #include "Model.h"
+#include "CMaterialTable.h"
+#include "CShaderPool.h"
+#include "CGLState.h"
+#include "CCamera.h"
 #include <iostream>
+#include <algorithm>
 #include <fstream>
 #include <sstream>
 #include <filesystem>
@@ -14,21 +19,22 @@ Model::~Model() {
 }
 
 bool Model::LoadModel(const std::string& filepath) {
-    // 清理之前的資源
-    Cleanup();
-    
-    // 取得檔案目錄
-    directory = GetDirectory(filepath);
-    
-    // TinyObjLoader 變數
-    tinyobj::attrib_t attrib;
-    std::vector<tinyobj::shape_t> shapes;
-    std::vector<tinyobj::material_t> objMaterials;
+    ObjData data;
+    if (!ParseObj(filepath, data)) {
+        // 清理之前的資源
+        Cleanup();
+        return false;
+    }
+    return BuildFromObj(data);
+}
+
+bool Model::ParseObj(const std::string& filepath, ObjData& data) {
+    data.filepath = filepath;
     std::string warn, err;
     
     // 載入 OBJ 檔案
-    bool ret = tinyobj::LoadObj(&attrib, &shapes, &objMaterials, &warn, &err,
-                               filepath.c_str(), directory.c_str());
+    bool ret = tinyobj::LoadObj(&data.attrib, &data.shapes, &data.materials, &warn, &err,
+                               filepath.c_str(), GetDirectory(filepath).c_str());
     
     if (!warn.empty()) {
         std::cout << "Warning: " << warn << std::endl;
@@ -45,25 +51,93 @@ bool Model::LoadModel(const std::string& filepath) {
     }
     
     // 檢查是否有頂點資料
-    if (attrib.vertices.empty()) {
+    if (data.attrib.vertices.empty()) {
         std::cerr << "No vertices found in OBJ file!" << std::endl;
         return false;
     }
+    return true;
+}
+
+bool Model::BuildFromObj(const ObjData& data) {
+    // 清理之前的資源
+    Cleanup();
+    
+    // 取得檔案目錄
+    _filepath = data.filepath;
+    directory = GetDirectory(data.filepath);
     
     // 處理材質
-    ProcessMaterials(objMaterials);
+    ProcessMaterials(data.materials);
     
     // 處理每個形狀（網格）
-    for (const auto& shape : shapes) {
-        ProcessMesh(attrib, shape, objMaterials);
+    for (const auto& shape : data.shapes) {
+        ProcessMesh(data.attrib, shape, data.materials);
+    }
+    
+    // 整個模型的區域座標 AABB，供視錐剔除使用
+    bool first = true;
+    for (const auto& mesh : meshes) {
+        for (const auto& vertex : mesh.vertices) {
+            glm::vec3 p(vertex.position[0], vertex.position[1], vertex.position[2]);
+            _boundsMin = first ? p : glm::min(_boundsMin, p);
+            _boundsMax = first ? p : glm::max(_boundsMax, p);
+            first = false;
+        }
     }
     
-    std::cout << "Successfully loaded model: " << filepath << std::endl;
+    std::cout << "Successfully loaded model: " << data.filepath << std::endl;
     std::cout << "Meshes: " << meshes.size() << ", Materials: " << materials.size() << std::endl;
     
     return true;
 }
 
+bool Model::Reimport(const ObjData& data) {
+    // 沿用原本在材質表中的位置，重複載入不會佔滿 CMaterialTable
+    _recycledTableIndices.clear();
+    for (const auto& material : materials) _recycledTableIndices.push_back(material.tableIndex);
+    bool ok = BuildFromObj(data);
+    _recycledTableIndices.clear();
+    return ok;
+}
+
+bool Model::IsSourceFile(const std::string& path) const {
+    if (path == _filepath) return true;
+    // 與 OBJ 同目錄、同檔名的 MTL
+    size_t dot = _filepath.find_last_of('.');
+    return dot != std::string::npos && path == _filepath.substr(0, dot) + ".mtl";
+}
+
+std::vector<std::string> Model::GetTexturePaths() const {
+    std::vector<std::string> paths;
+    for (const auto& material : materials) {
+        for (const std::string* path : { &material.diffuseTexPath, &material.normalTexPath,
+                                         &material.specularTexPath, &material.alphaTexPath }) {
+            if (!path->empty()) paths.push_back(*path);
+        }
+    }
+    return paths;
+}
+
+bool Model::ReloadTexture(const std::string& path, const DecodedImage& image) {
+    // 重新上傳到原本的 texture id，材質與 Render 都不需要改變
+    bool used = false, diffuseChanged = false;
+    for (auto& material : materials) {
+        if (material.diffuseTexPath == path && material.diffuseTexture != 0) {
+            used |= UploadTexture(material.diffuseTexture, image);
+            diffuseChanged |= material.diffuseAlpha != image.alpha;
+            material.diffuseAlpha = image.alpha;
+        }
+        if (material.normalTexPath == path && material.normalTexture != 0)     used |= UploadTexture(material.normalTexture, image);
+        if (material.specularTexPath == path && material.specularTexture != 0) used |= UploadTexture(material.specularTexture, image);
+        if (material.alphaTexPath == path && material.alphaTexture != 0)       used |= UploadTexture(material.alphaTexture, image);
+    }
+    // 漫射貼圖的 alpha 改變時重新分類 (已合批的網格要等下次 bake 才會更新)
+    if (diffuseChanged) {
+        for (auto& mesh : meshes) ClassifyMesh(mesh);
+    }
+    return used;
+}
+
 void Model::ProcessMaterials(const std::vector<tinyobj::material_t>& objMaterials) {
     materials.reserve(objMaterials.size());
     
@@ -89,7 +163,7 @@ void Model::ProcessMaterials(const std::vector<tinyobj::material_t>& objMaterial
         // 載入紋理
         if (!objMat.diffuse_texname.empty()) {
             mat.diffuseTexPath = directory + "/" + objMat.diffuse_texname;
-            mat.diffuseTexture = LoadTexture(mat.diffuseTexPath);
+            mat.diffuseTexture = LoadTexture(mat.diffuseTexPath, &mat.diffuseAlpha);
         }
         
         if (!objMat.normal_texname.empty()) {
@@ -102,6 +176,31 @@ void Model::ProcessMaterials(const std::vector<tinyobj::material_t>& objMaterial
             mat.specularTexture = LoadTexture(mat.specularTexPath);
         }
         
+        if (!objMat.alpha_texname.empty()) {
+            mat.alphaTexPath = directory + "/" + objMat.alpha_texname;
+            mat.alphaTexture = LoadTexture(mat.alphaTexPath);
+        }
+        
+        // 登錄到全域材質表，繪製時只需要傳入索引 (重新載入時沿用原本的位置)
+        GLint textureFlags = 0;
+        if (mat.diffuseTexture != 0)  textureFlags |= MATERIAL_DIFFUSE_MAP;
+        if (mat.normalTexture != 0)   textureFlags |= MATERIAL_NORMAL_MAP;
+        if (mat.specularTexture != 0) textureFlags |= MATERIAL_SPECULAR_MAP;
+        if (mat.alphaTexture != 0)    textureFlags |= MATERIAL_ALPHA_MAP;
+        glm::vec4 ambient(mat.ambient[0], mat.ambient[1], mat.ambient[2], 1.0f);
+        glm::vec4 diffuse(mat.diffuse[0], mat.diffuse[1], mat.diffuse[2], 1.0f);
+        glm::vec4 specular(mat.specular[0], mat.specular[1], mat.specular[2], 1.0f);
+        size_t slot = materials.size();
+        if (slot < _recycledTableIndices.size() && _recycledTableIndices[slot] > 0) {
+            mat.tableIndex = _recycledTableIndices[slot];
+            CMaterialTable::getInstance().setMaterial(mat.tableIndex, ambient, diffuse, specular,
+                                                      mat.shininess, mat.alpha, textureFlags);
+        } else {
+            mat.tableIndex = CMaterialTable::getInstance().addMaterial(ambient, diffuse, specular,
+                                                                       mat.shininess, mat.alpha, textureFlags);
+        }
+        mat.textureFlags = textureFlags;
+        
         materials.push_back(mat);
     }
 }
@@ -179,6 +278,21 @@ void Model::ProcessMesh(const tinyobj::attrib_t& attrib,
         std::cout << "  Mesh has no material index" << std::endl;
     }
 
+    ClassifyMesh(mesh);
+
+    // 區域座標 AABB 的中心，排序時計算網格的深度
+    if (!mesh.vertices.empty()) {
+        glm::vec3 bmin(mesh.vertices[0].position[0], mesh.vertices[0].position[1], mesh.vertices[0].position[2]);
+        glm::vec3 bmax = bmin;
+        for (const auto& vertex : mesh.vertices) {
+            glm::vec3 p(vertex.position[0], vertex.position[1], vertex.position[2]);
+            bmin = glm::min(bmin, p);
+            bmax = glm::max(bmax, p);
+        }
+        mesh.center = (bmin + bmax) * 0.5f;
+        mesh.radius = glm::length(bmax - mesh.center);
+    }
+
     // 設置 OpenGL 緩衝區
     SetupMesh(mesh);
 
@@ -190,7 +304,7 @@ void Model::SetupMesh(Mesh& mesh) {
     glGenBuffers(1, &mesh.VBO);
     glGenBuffers(1, &mesh.EBO);
     
-    glBindVertexArray(mesh.VAO);
+    CGLState::getInstance().bindVertexArray(mesh.VAO);
     
     // 頂點緩衝區
     glBindBuffer(GL_ARRAY_BUFFER, mesh.VBO);
@@ -217,10 +331,37 @@ void Model::SetupMesh(Mesh& mesh) {
                          (void*)offsetof(Vertex, texCoords));
     glEnableVertexAttribArray(3);
     
-    glBindVertexArray(0);
+    // 只有位置的 stream，深度與陰影 pass 每個頂點只讀取 12 bytes
+    if (CShape::isPositionStreamEnabled()) {
+        std::vector<float> positions;
+        positions.reserve(mesh.vertices.size() * 3);
+        for (const auto& vertex : mesh.vertices) positions.insert(positions.end(), vertex.position, vertex.position + 3);
+        glGenVertexArrays(1, &mesh.positionVAO);
+        glGenBuffers(1, &mesh.positionVBO);
+        CGLState::getInstance().bindVertexArray(mesh.positionVAO);
+        glBindBuffer(GL_ARRAY_BUFFER, mesh.positionVBO);
+        glBufferData(GL_ARRAY_BUFFER, positions.size() * sizeof(float), positions.data(), GL_STATIC_DRAW);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.EBO);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
+        glEnableVertexAttribArray(0);
+    }
+    
+    CGLState::getInstance().bindVertexArray(0);
+}
+
+void Model::ClassifyMesh(Mesh& mesh) const {
+    // 材質的 alpha 小於 1、有透明度貼圖或漫射貼圖有半透明的像素才需要混合，其餘網格以不透明的方式繪製；
+    // 漫射貼圖只有完全透明與不透明的像素時仍然是不透明網格，但 fragment shader 會 discard，不能使用深度預先繪製
+    mesh.transparent = mesh.alphaTested = false;
+    if (mesh.materialIndex < 0 || mesh.materialIndex >= static_cast<int>(materials.size())) return;
+    const Material& material = materials[mesh.materialIndex];
+    bool hasDiffuse = material.diffuseTexture != 0;
+    mesh.transparent = material.alpha < 1.0f || !material.alphaTexPath.empty() ||
+                       (hasDiffuse && material.diffuseAlpha == TEXTURE_ALPHA_BLEND);
+    mesh.alphaTested = !mesh.transparent && hasDiffuse && material.diffuseAlpha == TEXTURE_ALPHA_MASK;
 }
 
-GLuint Model::LoadTexture(const std::string& path) {
+GLuint Model::LoadTexture(const std::string& path, TextureAlpha* alpha) {
     // 檢查檔案是否存在
     std::ifstream file(path);
     if (!file) {
@@ -242,205 +383,297 @@ GLuint Model::LoadTexture(const std::string& path) {
         return 0;
     }
     
-    stbi_set_flip_vertically_on_load(true);
+    DecodedImage image;
+    bool ok = DecodeImage(path, image) && UploadTexture(textureID, image);
+    if (ok && alpha != nullptr) *alpha = image.alpha;
+    FreeImage(image);
+    if (!ok) {
+        CGLState::getInstance().deleteTexture(textureID);
+        return 0;
+    }
+    return textureID;
+}
+
+bool Model::DecodeImage(const std::string& path, DecodedImage& image) {
+    // 熱重載會在背景執行緒解碼，翻轉旗標與錯誤訊息都使用 stb_image 的 thread_local 版本
+    // (stb_image_aug.cpp 以 C++ 編譯，STBI_THREAD_LOCAL 為 thread_local)
+    stbi_set_flip_vertically_on_load_thread(1);
     
-    int width, height, nrComponents;
-    unsigned char* data = stbi_load(path.c_str(), &width, &height, &nrComponents, 0);
+    image.path = path;
+    image.data = stbi_load(path.c_str(), &image.width, &image.height, &image.components, 0);
     
-    if (data && width > 0 && height > 0) {
-        GLenum format;
-        GLenum internalFormat;
-        
-        if (nrComponents == 1) {
-            format = GL_RED;
-            internalFormat = GL_RED;
-        }
-        else if (nrComponents == 3) {
-            format = GL_RGB;
-            internalFormat = GL_RGB8;
-        }
-        else if (nrComponents == 4) {
-            format = GL_RGBA;
-            internalFormat = GL_RGBA8;
-        } else {
-            std::cout << "Unsupported texture format: " << nrComponents << " components in " << path << std::endl;
-            stbi_image_free(data);
-            glDeleteTextures(1, &textureID);
-            return 0;
+    if (image.data && image.width > 0 && image.height > 0) {
+        if (image.components != 1 && image.components != 3 && image.components != 4) {
+            std::cout << "Unsupported texture format: " + std::to_string(image.components) + " components in " + path + "\n" << std::flush;
+            FreeImage(image);
+            return false;
         }
-        
-        // 綁定紋理前確保沒有其他紋理綁定
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, textureID);
-        
-        // 檢查綁定是否成功
-        error = glGetError();
-        if (error != GL_NO_ERROR) {
-            std::cout << "Error binding texture: " << error << std::endl;
-            stbi_image_free(data);
-            glDeleteTextures(1, &textureID);
-            return 0;
-        }
-        
-        // 設置紋理參數 (在上傳數據前設置)
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-        
-        // 上傳紋理數據
-        glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-        
-        // 檢查紋理上傳是否成功
-        error = glGetError();
-        if (error != GL_NO_ERROR) {
-            std::cout << "Failed to upload texture data: " << error << " for " << path << std::endl;
-            stbi_image_free(data);
-            glDeleteTextures(1, &textureID);
-            return 0;
-        }
-        
-        // 生成 mipmap
-        glGenerateMipmap(GL_TEXTURE_2D);
-        
-        // 檢查 mipmap 生成是否成功
-        error = glGetError();
-        if (error != GL_NO_ERROR) {
-            std::cout << "Error generating mipmap: " << error << std::endl;
-            // 不返回錯誤，因為紋理本身已經上傳成功
+        // 分類 alpha channel：f_phong.glsl 在 alpha < 0.01 (2.55 / 255) 時 discard
+        image.alpha = TEXTURE_ALPHA_OPAQUE;
+        if (image.components == 4) {
+            size_t pixelCount = static_cast<size_t>(image.width) * image.height;
+            for (size_t i = 0; i < pixelCount; i++) {
+                unsigned char a = image.data[i * 4 + 3];
+                if (a == 255) continue;
+                if (a > 2) { image.alpha = TEXTURE_ALPHA_BLEND; break; }
+                image.alpha = TEXTURE_ALPHA_MASK;
+            }
         }
-        
-        // 解綁紋理
-        glBindTexture(GL_TEXTURE_2D, 0);
-        
-        stbi_image_free(data);
-        std::cout << "Successfully loaded texture: " << path << " (ID: " << textureID << ", " << width << "x" << height << ", " << nrComponents << " components)" << std::endl;
-        
-        return textureID;
-        
-    } else {
-        std::cout << "Failed to load texture data: " << path;
-        if (data == nullptr) {
-            std::cout << " - STBI error: " << stbi_failure_reason();
+        return true;
+    }
+    
+    // 組成一行再輸出，避免與其他解碼中的執行緒交錯
+    std::string message = "Failed to load texture data: " + path;
+    if (image.data == nullptr) {
+        const char* reason = stbi_failure_reason();
+        message += std::string(" - STBI error: ") + (reason ? reason : "unknown");
+    }
+    std::cout << message + "\n" << std::flush;
+    FreeImage(image);
+    return false;
+}
+
+void Model::FreeImage(DecodedImage& image) {
+    if (image.data) stbi_image_free(image.data);
+    image.data = nullptr;
+}
+
+bool Model::UploadTexture(GLuint textureID, const DecodedImage& image) {
+    GLenum format;
+    GLenum internalFormat;
+    
+    if (image.components == 1) {
+        format = GL_RED;
+        internalFormat = GL_RED;
+    }
+    else if (image.components == 3) {
+        format = GL_RGB;
+        internalFormat = GL_RGB8;
+    }
+    else {
+        format = GL_RGBA;
+        internalFormat = GL_RGBA8;
+    }
+    
+    // 綁定紋理前確保沒有其他紋理綁定
+    CGLState& gl = CGLState::getInstance();
+    gl.bindTexture(0, GL_TEXTURE_2D, textureID);
+    
+    // 檢查綁定是否成功
+    GLenum error = glGetError();
+    if (error != GL_NO_ERROR) {
+        std::cout << "Error binding texture: " << error << std::endl;
+        return false;
+    }
+    
+    // 設置紋理參數 (在上傳數據前設置)
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    
+    // 上傳紋理數據
+    glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, image.width, image.height, 0, format, GL_UNSIGNED_BYTE, image.data);
+    
+    // 檢查紋理上傳是否成功
+    error = glGetError();
+    if (error != GL_NO_ERROR) {
+        std::cout << "Failed to upload texture data: " << error << " for " << image.path << std::endl;
+        gl.bindTexture(0, GL_TEXTURE_2D, 0);
+        return false;
+    }
+    
+    // 生成 mipmap
+    glGenerateMipmap(GL_TEXTURE_2D);
+    
+    // 檢查 mipmap 生成是否成功
+    error = glGetError();
+    if (error != GL_NO_ERROR) {
+        std::cout << "Error generating mipmap: " << error << std::endl;
+        // 不返回錯誤，因為紋理本身已經上傳成功
+    }
+    
+    // 解綁紋理
+    gl.bindTexture(0, GL_TEXTURE_2D, 0);
+    
+    std::cout << "Successfully loaded texture: " << image.path << " (ID: " << textureID << ", " << image.width << "x" << image.height << ", " << image.components << " components)" << std::endl;
+    return true;
+}
+
+void ModelMaterialUniforms::bind(GLuint shaderProgram) {
+    modelMatrix.bind(shaderProgram, "mxModel");
+    materialIndex.bind(shaderProgram, "uMaterialIndex");
+    diffuseTexture.bind(shaderProgram, "uDiffuseTexture");
+    normalTexture.bind(shaderProgram, "uNormalTexture");
+    specularTexture.bind(shaderProgram, "uSpecularTexture");
+    alphaTexture.bind(shaderProgram, "uAlphaTexture");
+}
+
+void Model::CollectShaderFeatures(std::vector<unsigned int>& featureMasks) const {
+    for (const auto& mesh : meshes) {
+        bool hasMaterial = mesh.materialIndex >= 0 && mesh.materialIndex < materials.size();
+        unsigned int mask = hasMaterial ? static_cast<unsigned int>(materials[mesh.materialIndex].textureFlags) : 0;
+        if (std::find(featureMasks.begin(), featureMasks.end(), mask) == featureMasks.end()) {
+            featureMasks.push_back(mask);
         }
-        std::cout << std::endl;
-        
-        if (data) stbi_image_free(data);
-        glDeleteTextures(1, &textureID);
-        return 0;
     }
 }
 
-void Model::Render(GLuint shaderProgram) {
-    // 確保 shader 程式是當前使用的
-    glUseProgram(shaderProgram);
-    // 如果有透明物體，需要啟用混合
-    glEnable(GL_BLEND);
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+const ModelMaterialUniforms& Model::GetUniforms(GLuint program) {
+    auto it = _programUniforms.find(program);
+    if (it != _programUniforms.end()) return it->second;
+
+    // 第一次使用這個變體：解析 handle，貼圖單元固定，只需設定一次
+    ModelMaterialUniforms& u = _programUniforms[program];
+    u.bind(program);
+    u.diffuseTexture.set(0);
+    u.normalTexture.set(1);
+    u.specularTexture.set(2);
+    u.alphaTexture.set(3);
+    return u;
+}
+
+void Model::Submit(CRenderQueue& queue, GLuint shaderProgram, const glm::mat4& mxModel) {
+    SubmitMeshes(queue, shaderProgram, mxModel, nullptr);
+}
 
+void Model::SubmitInstanced(CRenderQueue& queue, GLuint shaderProgram, const glm::mat4& mxModel, CInstanceSet& instances) {
+    if (instances.size() == 0) return;
+    instances.upload();
+    SubmitMeshes(queue, shaderProgram, mxModel, &instances);
+}
+
+void Model::SubmitMeshes(CRenderQueue& queue, GLuint shaderProgram, const glm::mat4& mxModel, CInstanceSet* instances) {
     for (size_t i = 0; i < meshes.size(); i++) {
-        const Mesh& mesh = meshes[i];
+        DrawPacket packet = GetMeshPacket(i, shaderProgram, mxModel);
+        if (instances != nullptr) {
+            // 同一個 instance buffer 設定到每個網格的 VAO
+            instances->attach(meshes[i].VAO);
+            if (meshes[i].positionVAO != 0) instances->attach(meshes[i].positionVAO);
+            packet.instanceCount = instances->size();
+        }
+        queue.submit(packet);
+    }
+}
 
-        std::cout << "  Rendering mesh " << i << " (Material Index: " << mesh.materialIndex << ")" << std::endl;
+DrawPacket Model::GetMeshPacket(size_t index, GLuint shaderProgram, const glm::mat4& mxModel) const {
+    const Mesh& mesh = GetMesh(index);
+    DrawPacket packet;
+    packet.vao = mesh.VAO;
+    packet.positionVao = mesh.positionVAO;
+    packet.indexCount = static_cast<GLsizei>(mesh.indices.size());
+    packet.mxModel = mxModel;
+    packet.materialIndex = 0;
+    packet.center = mesh.center;
+    packet.radius = mesh.radius;
+    packet.pass = mesh.transparent ? RENDER_PASS_TRANSPARENT : RENDER_PASS_OPAQUE;
+    packet.alphaTested = mesh.alphaTested;
+
+    bool hasMaterial = mesh.materialIndex >= 0 && mesh.materialIndex < materials.size();
+    if (hasMaterial) {
+        const Material& material = materials[mesh.materialIndex];
+        packet.materialIndex = material.tableIndex;
+        packet.textures[0] = material.diffuseTexture;
+        packet.textures[1] = material.normalTexture;
+        packet.textures[2] = material.specularTexture;
+        packet.textures[3] = material.alphaTexture;
+    }
+    packet.program = CShaderPool::getInstance().getShaderVariant(shaderProgram, hasMaterial ? materials[mesh.materialIndex].textureFlags : 0);
+    return packet;
+}
 
-        // 重置紋理單元 (確保乾淨的狀態)
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, 0);
-        glActiveTexture(GL_TEXTURE1);
-        glBindTexture(GL_TEXTURE_2D, 0);
-        glActiveTexture(GL_TEXTURE2);
-        glBindTexture(GL_TEXTURE_2D, 0);
-        glActiveTexture(GL_TEXTURE3);  // 透明度貼圖
-        glBindTexture(GL_TEXTURE_2D, 0);
-
-
-        // 設置預設值 (如果沒有材質)
-        glUniform1i(glGetUniformLocation(shaderProgram, "uMaterial.hasDiffuseTexture"), 0);
-        glUniform1i(glGetUniformLocation(shaderProgram, "uMaterial.hasNormalTexture"), 0);
-        glUniform1i(glGetUniformLocation(shaderProgram, "uMaterial.hasSpecularTexture"), 0);
-        glUniform1f(glGetUniformLocation(shaderProgram, "uMaterial.alpha"), 1.0f);
-
-        // 綁定材質
-        if (mesh.materialIndex >= 0 && mesh.materialIndex < materials.size()) {
-            const Material& material = materials[mesh.materialIndex];
+void Model::Render(GLuint shaderProgram, const glm::mat4& mxModel) {
+    CShaderPool& pool = CShaderPool::getInstance();
+    CGLState& gl = CGLState::getInstance();
+    // shader 熱重載後 uniform 位置可能改變，重新解析 handle
+    if (_uniformReloadCount != pool.getReloadCount()) {
+        _programUniforms.clear();
+        _uniformReloadCount = pool.getReloadCount();
+    }
+    GLuint currentProgram = 0;
+    const ModelMaterialUniforms* uniforms = nullptr;
 
-            std::cout << "  Applying material: " << material.name << std::endl;
+    // 依 view space 深度排序：不透明網格由近到遠排在前面，透明網格由遠到近排在後面
+    // view space 的 z 為負值，-z 越大越遠
+    const glm::mat4 mxModelView = CCamera::getInstance().getViewMatrix() * mxModel;
+    _drawOrder.clear();
+    for (size_t i = 0; i < meshes.size(); i++) {
+        float depth = -(mxModelView * glm::vec4(meshes[i].center, 1.0f)).z;
+        _drawOrder.emplace_back(meshes[i].transparent ? -depth : depth, static_cast<int>(i));
+    }
+    std::sort(_drawOrder.begin(), _drawOrder.end(), [this](const std::pair<float, int>& a, const std::pair<float, int>& b) {
+        bool ta = meshes[a.second].transparent, tb = meshes[b.second].transparent;
+        return ta != tb ? tb : a.first < b.first;
+    });
 
-            // 設定材質屬性 uniform 變數
-            GLint ambientLoc = glGetUniformLocation(shaderProgram, "uMaterial.ambient");
-            GLint diffuseLoc = glGetUniformLocation(shaderProgram, "uMaterial.diffuse");
-            GLint specularLoc = glGetUniformLocation(shaderProgram, "uMaterial.specular");
-            GLint shininessLoc = glGetUniformLocation(shaderProgram, "uMaterial.shininess");
-            GLint alphaLoc = glGetUniformLocation(shaderProgram, "uMaterial.alpha");
+    // 只有透明網格需要混合，並且不寫入深度以免擋住後面的透明網格
+    gl.disable(GL_BLEND);
+    bool blending = false;
 
-            if (ambientLoc != -1) {
-                glUniform4f(ambientLoc, material.ambient[0], material.ambient[1], material.ambient[2], 1.0f);
-            }
-            if (diffuseLoc != -1) {
-                glUniform4f(diffuseLoc, material.diffuse[0], material.diffuse[1], material.diffuse[2], 1.0f);
-            }
+    for (const auto& order : _drawOrder) {
+        size_t i = order.second;
+        const Mesh& mesh = meshes[i];
+        if (mesh.transparent && !blending) {
+            gl.enable(GL_BLEND);
+            gl.blendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+            gl.depthMask(GL_FALSE);
+            blending = true;
+        }
 
-            if (specularLoc != -1) {
-                glUniform4f(specularLoc, material.specular[0], material.specular[1], material.specular[2], 1.0f);
-            }
+        std::cout << "  Rendering mesh " << i << " (Material Index: " << mesh.materialIndex << ")" << std::endl;
 
-            if (shininessLoc != -1) {
-                glUniform1f(shininessLoc, material.shininess);
-            }
-            if (alphaLoc != -1) {
-                glUniform1f(alphaLoc, material.alpha);  // 設定材質透明度
-            }
+        // 依材質的貼圖組合選擇變體，沒有貼圖的材質完全不執行取樣與 TBN 計算
+        bool hasMaterial = mesh.materialIndex >= 0 && mesh.materialIndex < materials.size();
+        GLuint program = pool.getShaderVariant(shaderProgram, hasMaterial ? materials[mesh.materialIndex].textureFlags : 0);
+        if (program != currentProgram) {
+            gl.useProgram(program);
+            uniforms = &GetUniforms(program);
+            uniforms->modelMatrix.set(mxModel);
+            currentProgram = program;
+        }
+
+        // 綁定材質：材質數值與貼圖旗標都在材質表中，這裡只傳入索引
+        // shader 只會取樣旗標有設定的貼圖，因此不需要先清除未使用的貼圖單元
+        if (hasMaterial) {
+            const Material& material = materials[mesh.materialIndex];
 
+            std::cout << "  Applying material: " << material.name << std::endl;
+            uniforms->materialIndex.set(material.tableIndex);
 
             // 綁定漫反射紋理
             if (material.diffuseTexture != 0) {
-                glActiveTexture(GL_TEXTURE0);
-                glBindTexture(GL_TEXTURE_2D, material.diffuseTexture);
-                glUniform1i(glGetUniformLocation(shaderProgram, "uMaterial.diffuseTexture"), 0);
-                glUniform1i(glGetUniformLocation(shaderProgram, "uMaterial.hasDiffuseTexture"), 1); // 重要！
+                gl.bindTexture(0, GL_TEXTURE_2D, material.diffuseTexture);
             } else {
-                glUniform1i(glGetUniformLocation(shaderProgram, "uMaterial.hasDiffuseTexture"), 0);
                 std::cout << "    No diffuse texture" << std::endl;
             }
 
             // 綁定法線貼圖
             if (material.normalTexture != 0) {
-                glActiveTexture(GL_TEXTURE1);
-                glBindTexture(GL_TEXTURE_2D, material.normalTexture);
-                glUniform1i(glGetUniformLocation(shaderProgram, "uMaterial.normalTexture"), 1);
-                glUniform1i(glGetUniformLocation(shaderProgram, "uMaterial.hasNormalTexture"), 1);
+                gl.bindTexture(1, GL_TEXTURE_2D, material.normalTexture);
             } else {
-                glUniform1i(glGetUniformLocation(shaderProgram, "uMaterial.hasNormalTexture"), 0);
                 std::cout << "    No normal texture" << std::endl;
             }
 
             // 綁定鏡面反射貼圖
             if (material.specularTexture != 0) {
-                glActiveTexture(GL_TEXTURE2);
-                glBindTexture(GL_TEXTURE_2D, material.specularTexture);
-                glUniform1i(glGetUniformLocation(shaderProgram, "uMaterial.specularTexture"), 2);
-                glUniform1i(glGetUniformLocation(shaderProgram, "uMaterial.hasSpecularTexture"), 1);
+                gl.bindTexture(2, GL_TEXTURE_2D, material.specularTexture);
             } else {
-                glUniform1i(glGetUniformLocation(shaderProgram, "uMaterial.hasSpecularTexture"), 0);
                 std::cout << "    No specular texture" << std::endl;
             }
             // 綁定透明度貼圖
             if (material.alphaTexture != 0) {
-                glActiveTexture(GL_TEXTURE3);
-                glBindTexture(GL_TEXTURE_2D, material.alphaTexture);
-                glUniform1i(glGetUniformLocation(shaderProgram, "uMaterial.alphaTexture"), 3);
-                glUniform1i(glGetUniformLocation(shaderProgram, "uMaterial.hasAlphaTexture"), 1);
+                gl.bindTexture(3, GL_TEXTURE_2D, material.alphaTexture);
                 std::cout << "    Using alpha texture" << std::endl;
             }
 
         } else {
+            uniforms->materialIndex.set(0); // 預設材質
             std::cout << "  Mesh has no material assigned" << std::endl;
         }
 
         // 渲染網格
-        glBindVertexArray(mesh.VAO);
+        gl.bindVertexArray(mesh.VAO);
         glDrawElements(GL_TRIANGLES, static_cast<GLsizei>(mesh.indices.size()), GL_UNSIGNED_INT, 0);
-        glBindVertexArray(0);
 
         // 檢查 OpenGL 錯誤
         GLenum error = glGetError();
@@ -449,31 +682,43 @@ void Model::Render(GLuint shaderProgram) {
         }
     }
 
-    // 清理紋理綁定
-    for (int i = 0; i < 4; i++) {
-        glActiveTexture(GL_TEXTURE0 + i);
-        glBindTexture(GL_TEXTURE_2D, 0);
+    if (blending) {
+        gl.depthMask(GL_TRUE);
+        gl.disable(GL_BLEND);
     }
+
+    // 貼圖與 VAO 保持綁定，由 CGLState 過濾下一次相同的設定
+    // 還原呼叫端的 program
+    gl.useProgram(shaderProgram);
 }
 
 void Model::Cleanup() {
     for (auto& mesh : meshes) {
-        if (mesh.VAO != 0) glDeleteVertexArrays(1, &mesh.VAO);
+        if (mesh.VAO != 0) CGLState::getInstance().deleteVertexArray(mesh.VAO);
         if (mesh.VBO != 0) glDeleteBuffers(1, &mesh.VBO);
         if (mesh.EBO != 0) glDeleteBuffers(1, &mesh.EBO);
+        if (mesh.positionVAO != 0) CGLState::getInstance().deleteVertexArray(mesh.positionVAO);
+        if (mesh.positionVBO != 0) glDeleteBuffers(1, &mesh.positionVBO);
     }
     
     for (auto& material : materials) {
-        if (material.diffuseTexture != 0) glDeleteTextures(1, &material.diffuseTexture);
-        if (material.normalTexture != 0) glDeleteTextures(1, &material.normalTexture);
-        if (material.specularTexture != 0) glDeleteTextures(1, &material.specularTexture);
-        if (material.alphaTexture != 0) glDeleteTextures(1, &material.alphaTexture);
+        if (material.diffuseTexture != 0) CGLState::getInstance().deleteTexture(material.diffuseTexture);
+        if (material.normalTexture != 0) CGLState::getInstance().deleteTexture(material.normalTexture);
+        if (material.specularTexture != 0) CGLState::getInstance().deleteTexture(material.specularTexture);
+        if (material.alphaTexture != 0) CGLState::getInstance().deleteTexture(material.alphaTexture);
     }
     
     meshes.clear();
     materials.clear();
 }
 
+const Mesh& Model::GetMesh(size_t index) const {
+    if (index >= meshes.size()) {
+        throw std::out_of_range("Mesh index out of range");
+    }
+    return meshes[index];
+}
+
 const Material& Model::GetMaterial(size_t index) const {
     if (index >= materials.size()) {
         throw std::out_of_range("Material index out of range");
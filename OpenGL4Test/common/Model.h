@@ -13,6 +13,7 @@
 #include <iostream>
 
 #include "../models/CShape.h"
+#include "CUniform.h"
 // 需要包含 tiny_obj_loader.h
 //#define TINYOBJLOADER_IMPLEMENTATION
 #include "tiny_obj_loader.h"
@@ -33,6 +34,13 @@ struct Vertex {
     }
 };
 
+// 貼圖 alpha channel 的分類，DecodeImage 解碼時檢查
+enum TextureAlpha {
+    TEXTURE_ALPHA_OPAQUE = 0,   // 沒有 alpha channel 或全部為 255
+    TEXTURE_ALPHA_MASK,         // 只有完全不透明與會被 f_phong.glsl discard 的像素，不需要混合
+    TEXTURE_ALPHA_BLEND         // 有半透明的像素
+};
+
 // 材質結構
 struct Material {
     std::string name;
@@ -51,8 +59,12 @@ struct Material {
     std::string normalTexPath;
     std::string specularTexPath;
     std::string alphaTexPath;
+    TextureAlpha diffuseAlpha;  // 漫射貼圖的 alpha，網格分類使用
+    
+    int tableIndex;     // 在 CMaterialTable 中的索引，0 為預設材質
+    GLint textureFlags; // MATERIAL_*_MAP 組合，同時用來選擇 shader 變體
     
-    Material() : shininess(32.0f), alpha(1.0f), diffuseTexture(0), normalTexture(0), specularTexture(0), alphaTexture(0) {
+    Material() : shininess(32.0f), alpha(1.0f), diffuseTexture(0), normalTexture(0), specularTexture(0), alphaTexture(0), diffuseAlpha(TEXTURE_ALPHA_OPAQUE), tableIndex(0), textureFlags(0) {
         ambient[0] = ambient[1] = ambient[2] = 0.2f;
         diffuse[0] = diffuse[1] = diffuse[2] = 0.8f;
         specular[0] = specular[1] = specular[2] = 1.0f;
@@ -64,10 +76,43 @@ struct Mesh {
     std::vector<Vertex> vertices;
     std::vector<unsigned int> indices;
     int materialIndex;
+    bool transparent;       // 載入時依材質的 alpha、透明度貼圖與漫射貼圖的 alpha 分類，透明網格在不透明網格之後由遠到近繪製
+    bool alphaTested;       // 不透明但漫射貼圖有會被 discard 的像素 (TEXTURE_ALPHA_MASK)
+    glm::vec3 center;       // 區域座標 AABB 的中心，排序深度使用
+    float radius;           // 以 center 為球心的包圍球半徑，逐物件的光源列表使用
     
     GLuint VAO, VBO, EBO;
+    GLuint positionVAO, positionVBO;    // 只有位置的緊密 stream (CShape::isPositionStreamEnabled)，與 VAO 共用 EBO
     
-    Mesh() : materialIndex(-1), VAO(0), VBO(0), EBO(0) {}
+    Mesh() : materialIndex(-1), transparent(false), alphaTested(false), center(0.0f), radius(-1.0f), VAO(0), VBO(0), EBO(0), positionVAO(0), positionVBO(0) {}
+};
+
+// OBJ 解析結果，不含任何 GL 物件，可以在背景執行緒產生
+struct ObjData {
+    std::string filepath;
+    tinyobj::attrib_t attrib;
+    std::vector<tinyobj::shape_t> shapes;
+    std::vector<tinyobj::material_t> materials;
+};
+
+// 解碼後的貼圖像素，由 Model::FreeImage 釋放
+struct DecodedImage {
+    std::string path;
+    unsigned char* data = nullptr;
+    int width = 0, height = 0, components = 0;
+    TextureAlpha alpha = TEXTURE_ALPHA_OPAQUE;
+};
+
+// Render 使用的 handle，每個 shader 變體解析一次
+// 材質數值放在 CMaterialTable，每個網格只需設定 uMaterialIndex 並綁定貼圖
+struct ModelMaterialUniforms {
+    CUniform<glm::mat4> modelMatrix;
+    CUniform<int> materialIndex;
+    CUniform<int> diffuseTexture;
+    CUniform<int> normalTexture;
+    CUniform<int> specularTexture;
+    CUniform<int> alphaTexture;
+    void bind(GLuint shaderProgram);
 };
 
 // 主要的模型類別
@@ -79,21 +124,39 @@ private:
     
     
     // 載入紋理的輔助函數
-    GLuint LoadTexture(const std::string& path);
+    GLuint LoadTexture(const std::string& path, TextureAlpha* alpha = nullptr);
+    
+    // 由解析結果建立網格、材質與貼圖 (需要 GL context)
+    bool BuildFromObj(const ObjData& data);
     
     // 處理材質
     void ProcessMaterials(const std::vector<tinyobj::material_t>& objMaterials);
     
+    // Submit / SubmitInstanced 共用，instances 為 nullptr 時不使用 instancing
+    void SubmitMeshes(CRenderQueue& queue, GLuint shaderProgram, const glm::mat4& mxModel, CInstanceSet* instances);
+    
     // 處理網格
     void ProcessMesh(const tinyobj::attrib_t& attrib,
                      const tinyobj::shape_t& shape,
                      const std::vector<tinyobj::material_t>& objMaterials);
     
+    // 依材質設定 transparent / alphaTested
+    void ClassifyMesh(Mesh& mesh) const;
+    
     // 設置網格的 OpenGL 緩衝區
     void SetupMesh(Mesh& mesh);
     
     // 從檔案路徑中提取目錄
-    std::string GetDirectory(const std::string& filepath);
+    static std::string GetDirectory(const std::string& filepath);
+    
+    std::string _filepath;
+    std::vector<int> _recycledTableIndices;   // Reimport 時沿用的材質表位置
+    
+    // shader 變體 -> handle，第一次用到該變體時建立並設定貼圖單元
+    std::unordered_map<GLuint, ModelMaterialUniforms> _programUniforms;
+    int _uniformReloadCount = 0;
+    const ModelMaterialUniforms& GetUniforms(GLuint program);
+    std::vector<std::pair<float, int>> _drawOrder;   // Render 使用的 (深度, 網格) 暫存
     
     bool  _bautoRotate = false;
     float _clock = 0.0f;
@@ -118,12 +181,29 @@ public:
     // 載入模型
     bool LoadModel(const std::string& filepath);
     
-    // 渲染模型
-    void Render(GLuint shaderProgram);
+    // 渲染模型：依每個材質的貼圖組合選擇 shaderProgram 的變體，mxModel 會設定到用到的每個變體
+    // 不透明網格先以由近到遠、關閉混合的方式繪製，透明網格之後由遠到近開啟混合繪製
+    void Render(GLuint shaderProgram, const glm::mat4& mxModel);
+    // 每個網格送出一個 DrawPacket，由 CRenderQueue 排序後繪製
+    void Submit(CRenderQueue& queue, GLuint shaderProgram, const glm::mat4& mxModel);
+    // 整個模型依 instances 畫多份，每個網格一次 instanced draw call
+    void SubmitInstanced(CRenderQueue& queue, GLuint shaderProgram, const glm::mat4& mxModel, CInstanceSet& instances);
     
     // 清理資源
     void Cleanup();
     
+    // 熱重載：解析與解碼不使用 GL，可在背景執行緒執行；結果在 frame 之間交給 Reimport / ReloadTexture
+    static bool ParseObj(const std::string& filepath, ObjData& data);
+    static bool DecodeImage(const std::string& path, DecodedImage& image);
+    static void FreeImage(DecodedImage& image);
+    static bool UploadTexture(GLuint textureID, const DecodedImage& image);
+    bool Reimport(const ObjData& data);
+    bool ReloadTexture(const std::string& path, const DecodedImage& image);
+    // path 是否為此模型的 OBJ 或同名 MTL
+    bool IsSourceFile(const std::string& path) const;
+    const std::string& GetSourcePath() const { return _filepath; }
+    std::vector<std::string> GetTexturePaths() const;
+    
     // 取得材質數量
     size_t GetMaterialCount() const { return materials.size(); }
     
@@ -133,6 +213,14 @@ public:
     // 取得特定材質
     const Material& GetMaterial(size_t index) const;
     
+    // 取得特定網格 (CPU 端的頂點與索引資料在載入後保留)
+    const Mesh& GetMesh(size_t index) const;
+    // 網格以 shaderProgram 的變體繪製時的狀態 (program、VAO、材質索引與貼圖)
+    DrawPacket GetMeshPacket(size_t index, GLuint shaderProgram, const glm::mat4& mxModel) const;
+    
+    // 加入 Render 會用到的 shader 變體 (SHADER_FEATURE_* 組合)，已存在的不重複加入
+    void CollectShaderFeatures(std::vector<unsigned int>& featureMasks) const;
+    
     // 檢查是否成功載入
     bool IsLoaded() const { return !meshes.empty(); }
     void setAutoRotate();
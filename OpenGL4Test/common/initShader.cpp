@@ -1,64 +1,148 @@
 #include "initshader.h"
 
-// Function to read shader source from a file
-std::string readShaderSource(const std::string& filepath) {
+// Read shader source from a file; reports the error and returns false when it can't be opened
+bool tryReadShaderSource(const std::string& filepath, std::string& source) {
     std::ifstream file(filepath);
     if (!file.is_open()) {
         std::cerr << "Failed to open " << filepath << std::endl;
-        exit(EXIT_FAILURE);
+        return false;
     }
     std::stringstream buffer;
     buffer << file.rdbuf();
-    return buffer.str();
+    source = buffer.str();
+    return true;
+}
+
+// Function to read shader source from a file (startup path: a missing file is fatal)
+std::string readShaderSource(const std::string& filepath) {
+    std::string source;
+    if (!tryReadShaderSource(filepath, source)) exit(EXIT_FAILURE);
+    return source;
+}
+
+// Insert #define lines right after the #version directive (which must stay first)
+std::string injectDefines(const std::string& source, const std::string& defines) {
+    if (defines.empty()) return source;
+    size_t pos = 0;
+    if (source.compare(0, 8, "#version") == 0) {
+        pos = source.find('\n');
+        pos = (pos == std::string::npos) ? source.size() : pos + 1;
+    }
+    return source.substr(0, pos) + defines + source.substr(pos);
 }
 
 GLuint createShader(const std::string& vertexPath, const std::string& fragmentPath) {
-    std::string vertexCode = readShaderSource(vertexPath);
-    std::string fragmentCode = readShaderSource(fragmentPath);
+    return createShader(vertexPath, fragmentPath, "");
+}
 
+GLuint createShader(const std::string& vertexPath, const std::string& fragmentPath, const std::string& defines) {
+    PendingShader pending = beginCreateShader(vertexPath, fragmentPath, defines);
+    return finishCreateShader(pending);
+}
+
+// Submit both compiles and the link without asking for any status, so the driver
+// can keep working (on its own threads with KHR_parallel_shader_compile)
+static PendingShader submitShader(const std::string& vertexPath, const std::string& fragmentPath,
+                                  const std::string& vertexCode, const std::string& fragmentCode) {
     const char* vertexSource = vertexCode.c_str();
     const char* fragmentSource = fragmentCode.c_str();
 
-    GLuint vertexShader = glCreateShader(GL_VERTEX_SHADER);
-    glShaderSource(vertexShader, 1, &vertexSource, nullptr);
-    glCompileShader(vertexShader);
+    PendingShader pending;
+    pending.vertexPath = vertexPath;
+    pending.fragmentPath = fragmentPath;
+
+    pending.vertexShader = glCreateShader(GL_VERTEX_SHADER);
+    glShaderSource(pending.vertexShader, 1, &vertexSource, nullptr);
+    glCompileShader(pending.vertexShader);
+
+    pending.fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
+    glShaderSource(pending.fragmentShader, 1, &fragmentSource, nullptr);
+    glCompileShader(pending.fragmentShader);
+
+    pending.program = glCreateProgram();
+    glAttachShader(pending.program, pending.vertexShader);
+    glAttachShader(pending.program, pending.fragmentShader);
+    glLinkProgram(pending.program);
+
+    return pending;
+}
+
+PendingShader beginCreateShader(const std::string& vertexPath, const std::string& fragmentPath, const std::string& defines) {
+    return submitShader(vertexPath, fragmentPath, injectDefines(readShaderSource(vertexPath), defines),
+                        injectDefines(readShaderSource(fragmentPath), defines));
+}
 
+bool tryBeginCreateShader(const std::string& vertexPath, const std::string& fragmentPath, const std::string& defines,
+                          PendingShader& pending) {
+    std::string vertexCode, fragmentCode;
+    if (!tryReadShaderSource(vertexPath, vertexCode) || !tryReadShaderSource(fragmentPath, fragmentCode)) return false;
+    pending = submitShader(vertexPath, fragmentPath, injectDefines(vertexCode, defines), injectDefines(fragmentCode, defines));
+    return true;
+}
+
+bool isShaderReady(const PendingShader& pending) {
+#ifdef GL_KHR_parallel_shader_compile
+    if (GLEW_KHR_parallel_shader_compile) {
+        GLint done = GL_FALSE;
+        glGetProgramiv(pending.program, GL_COMPLETION_STATUS_KHR, &done);
+        return done == GL_TRUE;
+    }
+#endif
+    return true; // without the extension any status query simply blocks
+}
+
+// Blocks until the program is linked; on failure fills errorLog and returns false
+bool checkShader(const PendingShader& pending, std::string& errorLog) {
     GLint success;
-    glGetShaderiv(vertexShader, GL_COMPILE_STATUS, &success);
+    char infoLog[512];
+    glGetShaderiv(pending.vertexShader, GL_COMPILE_STATUS, &success);
     if (!success) {
-        char infoLog[512];
-        glGetShaderInfoLog(vertexShader, 512, nullptr, infoLog);
-        std::cerr << "ERROR::SHADER::VERTEX::COMPILATION_FAILED\n" << infoLog << std::endl;
-        exit(EXIT_FAILURE);
+        glGetShaderInfoLog(pending.vertexShader, 512, nullptr, infoLog);
+        errorLog = "ERROR::SHADER::VERTEX::COMPILATION_FAILED (" + pending.vertexPath + ")\n" + infoLog;
+        return false;
     }
 
-    GLuint fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
-    glShaderSource(fragmentShader, 1, &fragmentSource, nullptr);
-    glCompileShader(fragmentShader);
-
-    glGetShaderiv(fragmentShader, GL_COMPILE_STATUS, &success);
+    glGetShaderiv(pending.fragmentShader, GL_COMPILE_STATUS, &success);
     if (!success) {
-        char infoLog[512];
-        glGetShaderInfoLog(fragmentShader, 512, nullptr, infoLog);
-        std::cerr << "ERROR::SHADER::FRAGMENT::COMPILATION_FAILED\n" << infoLog << std::endl;
-        exit(EXIT_FAILURE);
+        glGetShaderInfoLog(pending.fragmentShader, 512, nullptr, infoLog);
+        errorLog = "ERROR::SHADER::FRAGMENT::COMPILATION_FAILED (" + pending.fragmentPath + ")\n" + infoLog;
+        return false;
     }
 
-    GLuint shaderProgram = glCreateProgram();
-    glAttachShader(shaderProgram, vertexShader);
-    glAttachShader(shaderProgram, fragmentShader);
-    glLinkProgram(shaderProgram);
-
-    glGetProgramiv(shaderProgram, GL_LINK_STATUS, &success);
+    glGetProgramiv(pending.program, GL_LINK_STATUS, &success);
     if (!success) {
-        char infoLog[512];
-        glGetProgramInfoLog(shaderProgram, 512, nullptr, infoLog);
-        std::cerr << "ERROR::SHADER::PROGRAM::LINKING_FAILED\n" << infoLog << std::endl;
+        glGetProgramInfoLog(pending.program, 512, nullptr, infoLog);
+        errorLog = std::string("ERROR::SHADER::PROGRAM::LINKING_FAILED\n") + infoLog;
+        return false;
+    }
+    return true;
+}
+
+// Blocks until the program is linked, then reports errors exactly like before
+GLuint finishCreateShader(PendingShader& pending) {
+    std::string errorLog;
+    if (!checkShader(pending, errorLog)) {
+        std::cerr << errorLog << std::endl;
         exit(EXIT_FAILURE);
     }
 
-    glDeleteShader(vertexShader);
-    glDeleteShader(fragmentShader);
+    glDeleteShader(pending.vertexShader);
+    glDeleteShader(pending.fragmentShader);
+    pending.vertexShader = pending.fragmentShader = 0;
+
+    return pending.program;
+}
 
-    return shaderProgram;
-}
\ No newline at end of file
+void enableParallelShaderCompile() {
+#ifdef GL_KHR_parallel_shader_compile
+    if (GLEW_KHR_parallel_shader_compile) {
+        glMaxShaderCompilerThreadsKHR(0xFFFFFFFF); // let the driver pick the thread count
+        return;
+    }
+#endif
+#ifdef GL_ARB_parallel_shader_compile
+    if (GLEW_ARB_parallel_shader_compile) {
+        glMaxShaderCompilerThreadsARB(0xFFFFFFFF);
+    }
+#endif
+}
@@ -9,3 +9,27 @@
 
 
 GLuint createShader(const std::string& vertexPath, const std::string& fragmentPath);
+// defines: inserted after #version in both sources, e.g. "#define HAS_NORMAL_MAP 1\n"
+GLuint createShader(const std::string& vertexPath, const std::string& fragmentPath, const std::string& defines);
+
+// Two-step creation for batches: begin submits compile + link without querying status,
+// finish blocks, checks the results and returns the program (same id as pending.program)
+struct PendingShader {
+    GLuint program = 0;
+    GLuint vertexShader = 0;
+    GLuint fragmentShader = 0;
+    std::string vertexPath;
+    std::string fragmentPath;
+};
+PendingShader beginCreateShader(const std::string& vertexPath, const std::string& fragmentPath, const std::string& defines);
+// Same as beginCreateShader but a missing source file is not fatal (used by hot reload):
+// returns false without creating any GL objects when either file can't be read
+bool tryBeginCreateShader(const std::string& vertexPath, const std::string& fragmentPath, const std::string& defines,
+                          PendingShader& pending);
+GLuint finishCreateShader(PendingShader& pending);
+// Non-fatal status check (used by hot reload); errorLog holds the driver message on failure
+bool checkShader(const PendingShader& pending, std::string& errorLog);
+// true when finishCreateShader would not block (always true without KHR_parallel_shader_compile)
+bool isShaderReady(const PendingShader& pending);
+// Use KHR/ARB_parallel_shader_compile when the driver exposes it
+void enableParallelShaderCompile();
@@ -17,6 +17,8 @@
 #include "../common/CButton.h"
 #include "../common/Model.h"
 #include "CollisionManager.h"
+#include "CRenderQueue.h"
+#include "CLightManager.h"
 
 //#define SPOT_TARGET  // Example 2
 
@@ -30,7 +32,7 @@ float g_mouseSens = 0.005f;
 extern CCube g_centerloc;
 extern GLuint g_shadingProg;
 extern glm::vec3 g_eyeloc;
-extern CLight* g_light;
+extern CLight* g_light; // 依名稱由場景檔取得，場景檔沒有該光源時為 nullptr
 extern CLight* pointLight1;
 extern CLight* spotLight1;
 extern CLight* spotLight2;
@@ -38,7 +40,9 @@ extern CLight* spotLight3;
 
 extern std::array<CButton, 4> g_button;
 extern std::vector<std::unique_ptr<Model>> models;
+extern Model* g_robot; // 場景檔中名為 robot 的模型
 
+void runTransformBenchmark();
 extern CMaterial g_matWaterGreen;
 extern CSphere  g_sphere;
 
@@ -47,8 +51,23 @@ extern CCube g_spotTarget;
 #endif
 
 extern CollisionManager g_collisionManager;
+extern CRenderQueue g_renderQueue;
+extern CLightManager lightManager;
 Arcball g_arcball;
 
+// 光源可能不在場景檔中，操作前先檢查
+static void toggleLight(CLight* light) {
+    if (light) light->setLightOn(!light->isLightOn());
+}
+
+// 三盞聚光燈使用 spotDiffuse，天花板的點光源使用 pointDiffuse
+static void setLightDiffuse(const glm::vec4& spotDiffuse, const glm::vec4& pointDiffuse) {
+    for (CLight* light : { spotLight1, spotLight2, spotLight3 }) {
+        if (light) light->setDiffuse(spotDiffuse);
+    }
+    if (pointLight1) pointLight1->setDiffuse(pointDiffuse);
+}
+
 // 新增：計算攝影機的前方、右方、上方向量
 glm::vec3 getCameraForward() {
     // 從攝影機的view matrix計算前方向量
@@ -88,17 +107,14 @@ void updateCameraPosition(const glm::vec3& movement) {
     std::cout << "After move: Eye(" << g_eyeloc.x << ", " << g_eyeloc.y << ", " << g_eyeloc.z << ") Center(" << g_centerloc.getPos().x << ", " << g_centerloc.getPos().y << ", " << g_centerloc.getPos().z << ")" << std::endl;
 
     CCamera::getInstance().updateViewCenter(g_eyeloc, g_centerloc.getPos());
-    
-    glm::mat4 mxView = CCamera::getInstance().getViewMatrix();
-    GLint viewLoc = glGetUniformLocation(g_shadingProg, "mxView");
-    glUniformMatrix4fv(viewLoc, 1, GL_FALSE, glm::value_ptr(mxView));
+    // view matrix 由 render() 每個 frame 透過 FrameBlock 統一上傳
 }
 
 void setupCameraFollowObject() {
     // 假設你想讓第一個模型跟隨攝影機
-    if (!models.empty() && models[9]) {
+    if (g_robot) {
         // 設定偏移量：右偏移0, 下偏移1單位, 前方偏移2單位
-        models[9]->setFollowCamera(true, glm::vec3(0.0f, -1.0f, 2.0f), true, 0.0f);
+        g_robot->setFollowCamera(true, glm::vec3(0.0f, -1.0f, 2.0f), true, 0.0f);
     }
 }
 
@@ -137,35 +153,10 @@ void mouseButtonCallback(GLFWwindow* window, int button, int action, int mods) {
         if (action == GLFW_PRESS)
         {
             g_bCamRoting = true;
-            if (g_button[0].handleClick((float)xpos, height - (float)ypos)) {
-                if(g_light->isLightOn() == true)
-                {
-                    g_light->setLightOn(false);
-                }else {
-                    g_light->setLightOn(true);
-                }
-            }
-            if (g_button[1].handleClick((float)xpos, height - (float)ypos)) {
-                if(spotLight1->isLightOn() == true){
-                    spotLight1->setLightOn(false);
-                }else{
-                    spotLight1->setLightOn(true);
-                }
-            }
-            if (g_button[2].handleClick((float)xpos, height - (float)ypos)) {
-                if(spotLight2->isLightOn() == true){
-                    spotLight2->setLightOn(false);
-                }else{
-                    spotLight2->setLightOn(true);
-                }
-            }
-            if (g_button[3].handleClick((float)xpos, height - (float)ypos)) {
-                if(spotLight3->isLightOn() == true){
-                    spotLight3->setLightOn(false);
-                }else{
-                    spotLight3->setLightOn(true);
-                }
-            }
+            if (g_button[0].handleClick((float)xpos, height - (float)ypos)) toggleLight(g_light);
+            if (g_button[1].handleClick((float)xpos, height - (float)ypos)) toggleLight(spotLight1);
+            if (g_button[2].handleClick((float)xpos, height - (float)ypos)) toggleLight(spotLight2);
+            if (g_button[3].handleClick((float)xpos, height - (float)ypos)) toggleLight(spotLight3);
         }
         else if (action == GLFW_RELEASE)
         {
@@ -216,14 +207,12 @@ void cursorPosCallback(GLFWwindow* window, double xpos, double ypos) {
                   << ", " << g_centerloc.getPos().y << ", " << g_centerloc.getPos().z
                   << ")" << std::endl;
         
-        glm::mat4 mxView = CCamera::getInstance().getViewMatrix();
-        GLint viewLoc = glGetUniformLocation(g_shadingProg, "mxView");
-        glUniformMatrix4fv(viewLoc, 1, GL_FALSE, glm::value_ptr(mxView));
-        
         glm::mat4 currentViewMatrix = CCamera::getInstance().getViewMatrix();
         glm::vec3 currentCameraPos = CCamera::getInstance().getViewLocation();
-        models[9]->setCameraPos(currentCameraPos);
-        models[9]->setViewMatrix(currentViewMatrix);
+        if (g_robot) {
+            g_robot->setCameraPos(currentCameraPos);
+            g_robot->setViewMatrix(currentViewMatrix);
+        }
                 
     }
 }
@@ -237,9 +226,6 @@ void framebufferSizeCallback(GLFWwindow* window, int width, int height) {
 void scrollCallback(GLFWwindow* window, double xoffset, double yoffset) {
 
     CCamera::getInstance().updateRadius((float)yoffset * -0.2f);
-    glm::mat4 mxView = CCamera::getInstance().getViewMatrix();
-    GLint viewLoc = glGetUniformLocation(g_shadingProg, "mxView");
-    glUniformMatrix4fv(viewLoc, 1, GL_FALSE, glm::value_ptr(mxView));
     g_eyeloc = CCamera::getInstance().getViewLocation();
 
     //std::cout << "Scroll event: xoffset = " << xoffset << ", yoffset = " << yoffset << std::endl;
@@ -265,22 +251,22 @@ void keyCallback(GLFWwindow* window, int key, int scancode, int action, int mods
         case 262:
             vPos = g_spotTarget.getPos();
             g_spotTarget.setPos(glm::vec3(vPos.x + 0.15f, vPos.y, vPos.z));
-            g_light.setTarget(g_spotTarget.getPos());
+            if (g_light) g_light->setTarget(g_spotTarget.getPos());
             break;
         case 263:
             vPos = g_spotTarget.getPos();
             g_spotTarget.setPos(glm::vec3(vPos.x - 0.15f, vPos.y, vPos.z));
-            g_light.setTarget(g_spotTarget.getPos());
+            if (g_light) g_light->setTarget(g_spotTarget.getPos());
             break;
         case 264:
             vPos = g_spotTarget.getPos();
             g_spotTarget.setPos(glm::vec3(vPos.x, vPos.y, vPos.z - 0.15f));
-            g_light.setTarget(g_spotTarget.getPos());
+            if (g_light) g_light->setTarget(g_spotTarget.getPos());
             break;
         case 265:
             vPos = g_spotTarget.getPos();
             g_spotTarget.setPos(glm::vec3(vPos.x, vPos.y, vPos.z + 0.15f));
-            g_light.setTarget(g_spotTarget.getPos());
+            if (g_light) g_light->setTarget(g_spotTarget.getPos());
             break;
 #endif
         default:
@@ -292,69 +278,39 @@ void keyCallback(GLFWwindow* window, int key, int scancode, int action, int mods
                     std::cout << "key = " << letter << std::endl;
                     switch (letter) {
                         case 'r': // diffuse（紅色調）
-                            spotLight1->setDiffuse(glm::vec4(1.0f, 0.5f, 0.5f, 1.0f));
-                            spotLight2->setDiffuse(glm::vec4(1.0f, 0.5f, 0.5f, 1.0f));
-                            spotLight3->setDiffuse(glm::vec4(1.0f, 0.5f, 0.5f, 1.0f));
-                            pointLight1->setDiffuse(glm::vec4(1.0f, 0.5f, 0.5f, 1.0f));
+                            setLightDiffuse(glm::vec4(1.0f, 0.5f, 0.5f, 1.0f), glm::vec4(1.0f, 0.5f, 0.5f, 1.0f));
                             break;
                         case 'R':
-                            spotLight1->setDiffuse(glm::vec4(1.0f, 0.5f, 0.5f, 1.0f));
-                            spotLight2->setDiffuse(glm::vec4(1.0f, 0.5f, 0.5f, 1.0f));
-                            spotLight3->setDiffuse(glm::vec4(1.0f, 0.5f, 0.5f, 1.0f));
-                            pointLight1->setDiffuse(glm::vec4(1.0f, 0.5f, 0.5f, 1.0f));
+                            setLightDiffuse(glm::vec4(1.0f, 0.5f, 0.5f, 1.0f), glm::vec4(1.0f, 0.5f, 0.5f, 1.0f));
                             break;
                         case 'b': // diffuse（藍色調）
-                            spotLight1->setDiffuse(glm::vec4(0.3f, 0.3f, 0.8f, 1.0f));
-                            spotLight2->setDiffuse(glm::vec4(0.3f, 0.3f, 0.8f, 1.0f));
-                            spotLight3->setDiffuse(glm::vec4(0.3f, 0.3f, 0.8f, 1.0f));
-                            pointLight1->setDiffuse(glm::vec4(0.3f, 0.3f, 0.8f, 1.0f));
+                            setLightDiffuse(glm::vec4(0.3f, 0.3f, 0.8f, 1.0f), glm::vec4(0.3f, 0.3f, 0.8f, 1.0f));
                             break;
                         case 'B':
-                            spotLight1->setDiffuse(glm::vec4(0.3f, 0.3f, 0.8f, 1.0f));
-                            spotLight2->setDiffuse(glm::vec4(0.3f, 0.3f, 0.8f, 1.0f));
-                            spotLight3->setDiffuse(glm::vec4(0.3f, 0.3f, 0.8f, 1.0f));
-                            pointLight1->setDiffuse(glm::vec4(0.3f, 0.3f, 0.8f, 1.0f));
+                            setLightDiffuse(glm::vec4(0.3f, 0.3f, 0.8f, 1.0f), glm::vec4(0.3f, 0.3f, 0.8f, 1.0f));
                             break;
                         case 'g': // diffuse（綠色調）
-                            spotLight1->setDiffuse(glm::vec4(0.3f, 0.8f, 0.5f, 1.0f));
-                            spotLight2->setDiffuse(glm::vec4(0.3f, 0.8f, 0.5f, 1.0f));
-                            spotLight3->setDiffuse(glm::vec4(0.3f, 0.8f, 0.5f, 1.0f));
-                            pointLight1->setDiffuse(glm::vec4(0.3f, 0.8f, 0.5f, 1.0f));
+                            setLightDiffuse(glm::vec4(0.3f, 0.8f, 0.5f, 1.0f), glm::vec4(0.3f, 0.8f, 0.5f, 1.0f));
                             break;
                         case 'G':
-                            spotLight1->setDiffuse(glm::vec4(0.3f, 0.8f, 0.5f, 1.0f));
-                            spotLight2->setDiffuse(glm::vec4(0.3f, 0.8f, 0.5f, 1.0f));
-                            spotLight3->setDiffuse(glm::vec4(0.3f, 0.8f, 0.5f, 1.0f));
-                            pointLight1->setDiffuse(glm::vec4(0.3f, 0.8f, 0.5f, 1.0f));
+                            setLightDiffuse(glm::vec4(0.3f, 0.8f, 0.5f, 1.0f), glm::vec4(0.3f, 0.8f, 0.5f, 1.0f));
                             break;
                         case 'n': // diffuse（白色調）
-                            spotLight1->setDiffuse(glm::vec4(0.6f, 0.6f, 0.6f, 1.0f));
-                            spotLight2->setDiffuse(glm::vec4(0.6f, 0.6f, 0.6f, 1.0f));
-                            spotLight3->setDiffuse(glm::vec4(0.6f, 0.6f, 0.6f, 1.0f));
-                            pointLight1->setDiffuse(glm::vec4(0.8f, 0.8f, 0.8f, 1.0f));
+                            setLightDiffuse(glm::vec4(0.6f, 0.6f, 0.6f, 1.0f), glm::vec4(0.8f, 0.8f, 0.8f, 1.0f));
                             break;
                         case 'N':
-                            spotLight1->setDiffuse(glm::vec4(0.6f, 0.6f, 0.6f, 1.0f));
-                            spotLight2->setDiffuse(glm::vec4(0.6f, 0.6f, 0.6f, 1.0f));
-                            spotLight3->setDiffuse(glm::vec4(0.6f, 0.6f, 0.6f, 1.0f));
-                            pointLight1->setDiffuse(glm::vec4(0.8f, 0.8f, 0.8f, 1.0f));
+                            setLightDiffuse(glm::vec4(0.6f, 0.6f, 0.6f, 1.0f), glm::vec4(0.8f, 0.8f, 0.8f, 1.0f));
                             break;
                         case 'P':
                         case 'p':
                             if (CCamera::getInstance().getProjectionType() != CCamera::Type::PERSPECTIVE) {
                                 CCamera::getInstance().updatePerspective(45.0f, 1.0f, 1.0f, 100.0f);
-                                mxProj = CCamera::getInstance().getProjectionMatrix();
-                                projLoc = glGetUniformLocation(g_shadingProg, "mxProj");
-                                glUniformMatrix4fv(projLoc, 1, GL_FALSE, glm::value_ptr(mxProj));
                             }
                             break;
                         case 'O':
                         case 'o':
                             if (CCamera::getInstance().getProjectionType() != CCamera::Type::ORTHOGRAPHIC) {
                                 CCamera::getInstance().updateOrthographic(-3.0f, 3.0f, -3.0f, 3.0f, 1.0f, 100.0f);
-                                mxProj = CCamera::getInstance().getProjectionMatrix();
-                                projLoc = glGetUniformLocation(g_shadingProg, "mxProj");
-                                glUniformMatrix4fv(projLoc, 1, GL_FALSE, glm::value_ptr(mxProj));
                             }
                             break;
                         case 'W':
@@ -445,7 +401,7 @@ void keyCallback(GLFWwindow* window, int key, int scancode, int action, int mods
                             break;
                         case 'L':
                         case 'l':
-                            g_light->setMotionEnabled();
+                            if (g_light) g_light->setMotionEnabled();
                             break;
                         case 'C':
                         case 'c':
@@ -462,6 +418,29 @@ void keyCallback(GLFWwindow* window, int key, int scancode, int action, int mods
                                 largeBoundary = !largeBoundary;
                             }
                             break;
+                        case 'Z':
+                        case 'z':
+                            // 切換深度預先繪製，比較統計中的 shaded samples
+                            g_renderQueue.setDepthPrepassEnabled(!g_renderQueue.isDepthPrepassEnabled());
+                            std::cout << "Depth pre-pass: " << (g_renderQueue.isDepthPrepassEnabled() ? "on" : "off") << std::endl;
+                            break;
+                        case 'K':
+                        case 'k':
+                            // 切換 clustered lighting，關閉時每個像素計算所有光源
+                            lightManager.setClusteringEnabled(!lightManager.isClusteringEnabled());
+                            std::cout << "Clustered lighting: " << (lightManager.isClusteringEnabled() ? "on" : "off") << std::endl;
+                            break;
+                        case 'J':
+                        case 'j':
+                            // 切換逐物件的光源列表，關閉時所有物件改用 cluster
+                            g_renderQueue.setObjectLightsEnabled(!g_renderQueue.isObjectLightsEnabled());
+                            std::cout << "Per-object light lists: " << (g_renderQueue.isObjectLightsEnabled() ? "on" : "off") << std::endl;
+                            break;
+                        case 'M':
+                        case 'm':
+                            // 比較 CShape::updateMatrix 與 CTransformStore 批次組合的耗時
+                            runTransformBenchmark();
+                            break;
                     }
                 }
             }
@@ -0,0 +1,7 @@
+// f_depth.glsl
+// Depth pre-pass: color writes are masked off, only the depth buffer is written.
+// There is no alpha test here, so CRenderQueue keeps alpha-tested packets out of the pre-pass.
+#version 330 core
+
+void main() {
+}
@@ -25,13 +25,24 @@ struct LightSource {
 };
 uniform LightSource uLight;
 
-struct Material {
+#define MAX_MATERIALS 256
+
+// std140 layout, must match MaterialBlockEntry in CMaterialTable.h
+struct MaterialData {
     vec4 ambient;   // ka
     vec4 diffuse;   // kd
     vec4 specular;  // ks
     float shininess;
+    float alpha;
+    int textureFlags; // 1 = diffuse, 2 = normal, 4 = specular, 8 = alpha
+    int pad;
+};
+
+// Every material lives in one table; a draw only selects an index
+layout(std140) uniform MaterialBlock {
+    MaterialData uMaterials[MAX_MATERIALS];
 };
-uniform Material uMaterial;
+uniform int uMaterialIndex;
 out vec4 FragColor;
 
 void main() {
@@ -45,19 +56,22 @@ void main() {
     vec3 V = normalize(vView);
     vec3 R = reflect(-L, N);
 
+    // -1 means the draw has no material (CRenderQueue), use the default entry 0
+    MaterialData material = uMaterials[max(uMaterialIndex, 0)];
+
     // Ambient
-    vec4 ambient = uLight.ambient * uMaterial.ambient;
+    vec4 ambient = uLight.ambient * material.ambient;
 
     // quantized diffuseG 3 q
     float diff = max(dot(N,L),0.0);
     float levels = 3.0;
     float d = floor(diff*levels)/levels;  // floot VU
-    vec4 diffuse = uLight.diffuse * d * uMaterial.diffuse;
+    vec4 diffuse = uLight.diffuse * d * material.diffuse;
 
     // quantized specularGubG
     float specAngle = max(dot(R,V),0.0);
     float spec = specAngle>0.9 ? 1.0 : 0.0;
-    vec4 specular = uLight.specular * spec * uMaterial.specular;
+    vec4 specular = uLight.specular * spec * material.specular;
 
     // Attenuation
     float dist = length(uLight.position - v3Pos);
@@ -14,46 +14,165 @@ in vec3 vBitangent;
 uniform int  uShadingMode;
 uniform vec4 ui4Color;
 
-#define MAX_LIGHTS 8
-
 struct LightSource {
     vec3 position;
+    float constant;
     vec4 ambient;
     vec4 diffuse;
     vec4 specular;
-    float constant;
-    float linear;
-    float quadratic;
     // Spot Light
     vec3 direction;
+    float linear;
+    float quadratic;
     float cutOff;
     float outerCutOff;
     float exponent;
     int type; // 0 = POINT, 1 = SPOT, 2 = DIRECTIONAL
     bool enabled;
+    float range; // attenuation falls below the clustering threshold here
+    int shadow;  // CShadowMaps slot, -1 = no shadow
 };
 
-uniform LightSource uLights[MAX_LIGHTS];
-uniform int uNumLights;
+// std140 layout, must match LightBlockData in CLightManager.h
+// (binding point set by CShaderPool; the lights themselves live in uLightData)
+layout(std140) uniform LightBlock {
+    int uNumLights;
+    int uClustered;         // 0 = evaluate every light
+    ivec4 uClusterGrid;     // clusters along x, y and z
+    vec4 uClusterDepth;     // z slice = log(view depth) * x + y
+    vec4 uViewport;         // origin in xy, 1 / size in zw
+};
+
+// Per-frame constants, written once per frame by CCamera::uploadFrameBlock
+layout(std140) uniform FrameBlock {
+    mat4 mxView;
+    mat4 mxProj;
+    mat4 mxViewProj;
+    vec3 viewPos;
+    float uTime;
+};
+
+uniform samplerBuffer  uLightData;     // 7 texels per light, LightBlockEntry layout
+uniform usamplerBuffer uClusterTable;  // (offset, count) per cluster
+uniform usamplerBuffer uClusterLights; // light indices, packed per cluster
+
+// Spot light shadow maps (CShadowMaps): one layer per light, either the cached static map
+// or a copy with the dynamic casters drawn on top
+#define MAX_SHADOW_LIGHTS 4
+layout(std140) uniform ShadowBlock {
+    mat4 uShadowMatrix[MAX_SHADOW_LIGHTS];  // world -> light clip space
+    ivec4 uShadowLayer;                     // array layer to sample per slot
+    vec4 uShadowParams;                     // x = depth bias, y = texel size, z = normal offset
+};
+uniform sampler2DArrayShadow uShadowMaps;
+
+// Per-draw light list built on the CPU (CRenderQueue::setObjectLights), must match RENDER_QUEUE_MAX_OBJECT_LIGHTS
+#define MAX_OBJECT_LIGHTS 8
+uniform int uObjectLightCount;          // -1 = no list, use the clusters
+uniform int uObjectLights[MAX_OBJECT_LIGHTS];
+
+LightSource fetchLight(int i) {
+    int base = i * 7;
+    vec4 t0 = texelFetch(uLightData, base);
+    vec4 t4 = texelFetch(uLightData, base + 4);
+    vec4 t5 = texelFetch(uLightData, base + 5);
+    vec4 t6 = texelFetch(uLightData, base + 6);
+    LightSource light;
+    light.position = t0.xyz;
+    light.constant = t0.w;
+    light.ambient = texelFetch(uLightData, base + 1);
+    light.diffuse = texelFetch(uLightData, base + 2);
+    light.specular = texelFetch(uLightData, base + 3);
+    light.direction = t4.xyz;
+    light.linear = t4.w;
+    light.quadratic = t5.x;
+    light.cutOff = t5.y;
+    light.outerCutOff = t5.z;
+    light.exponent = t5.w;
+    light.type = floatBitsToInt(t6.x);
+    light.enabled = floatBitsToInt(t6.y) != 0;
+    light.range = t6.z;
+    light.shadow = floatBitsToInt(t6.w);
+    return light;
+}
+
+// Distance and spot attenuation; L is the direction towards the light
+float lightAttenuation(LightSource light, out vec3 L) {
+    float attenuation = 1.0;
+    if (light.type == 2) { // DIRECTIONAL
+        L = normalize(-light.direction);
+    } else { // POINT or SPOT
+        L = normalize(light.position - v3Pos);
+        
+        float dist = length(light.position - v3Pos);
+        attenuation = 1.0 / (light.constant + light.linear * dist + light.quadratic * dist * dist);
+    }
+    
+    // Spot light
+    if (light.type == 1 && light.cutOff > 0.0) { // SPOT
+        float theta = dot(L, normalize(-light.direction));
+        float intensity = clamp(
+            (theta - light.outerCutOff) / (light.cutOff - light.outerCutOff),
+            0.0, 1.0
+        );
+        
+        if (light.exponent == 1.0) {
+            attenuation *= intensity;
+        } else {
+            attenuation *= pow(intensity, light.exponent);
+        }
+    }
+    return attenuation;
+}
+
+// 1 = lit, 0 = fully in shadow; four hardware-filtered taps (each a 2x2 PCF)
+float shadowFactor(int slot, vec3 N) {
+    vec4 p = uShadowMatrix[slot] * vec4(v3Pos + N * uShadowParams.z, 1.0);
+    if (p.w <= 0.0) return 1.0;
+    vec3 coord = p.xyz / p.w * 0.5 + 0.5;
+    if (any(lessThan(coord, vec3(0.0))) || any(greaterThan(coord, vec3(1.0)))) return 1.0;
+    float layer = float(uShadowLayer[slot]);
+    float ref = coord.z - uShadowParams.x;
+    float sum = 0.0;
+    for (int i = 0; i < 4; i++) {
+        vec2 offset = (vec2(i & 1, i >> 1) - 0.5) * uShadowParams.y;
+        sum += texture(uShadowMaps, vec4(coord.xy + offset, layer, ref));
+    }
+    return sum * 0.25;
+}
+
+// Fades to zero at the light's range so no hard edge shows at cluster borders
+float rangeWindow(LightSource light) {
+    if (light.type == 2) return 1.0;
+    float ratio = length(light.position - v3Pos) / max(light.range, 1e-4);
+    float fade = clamp(1.0 - ratio * ratio * ratio * ratio, 0.0, 1.0);
+    return fade * fade;
+}
 
-struct Material {
+#define MAX_MATERIALS 256
+
+// std140 layout, must match MaterialBlockEntry in CMaterialTable.h
+struct MaterialData {
     vec4 ambient;   // ka
     vec4 diffuse;   // kd
     vec4 specular;  // ks
     float shininess;
     float alpha;
-    
-    sampler2D diffuseTexture;
-    sampler2D normalTexture;
-    sampler2D specularTexture;
-    sampler2D alphaTexture;
-    
-    bool hasDiffuseTexture;
-    bool hasNormalTexture;
-    bool hasSpecularTexture;
-    bool hasAlphaTexture;
+    int textureFlags; // 1 = diffuse, 2 = normal, 4 = specular, 8 = alpha
+    int pad;
 };
-uniform Material uMaterial;
+
+// Every material lives in one table; a draw only selects an index
+layout(std140) uniform MaterialBlock {
+    MaterialData uMaterials[MAX_MATERIALS];
+};
+flat in int vMaterialIndex;   // uMaterialIndex or the per-instance index, see v_phong
+flat in vec4 vInstanceColor;  // per-instance tint, white when not instanced
+
+uniform sampler2D uDiffuseTexture;
+uniform sampler2D uNormalTexture;
+uniform sampler2D uSpecularTexture;
+uniform sampler2D uAlphaTexture;
 
 uniform float uNormalStrength = 2.0;
 uniform float uSpecularStrength = 3.0;
@@ -63,15 +182,31 @@ out vec4 FragColor;
 
 void main() {
 
-    if( uShadingMode == 1) { FragColor = vec4(vColor, 1.0);  return; }
-    if( uShadingMode == 2 ){ FragColor = ui4Color; return; }
+#ifndef SHADER_VARIANT
+    if( uShadingMode == 1) { FragColor = vec4(vColor, 1.0) * vInstanceColor;  return; }
+    if( uShadingMode == 2 ){ FragColor = ui4Color * vInstanceColor; return; }
+#endif
+
+    // -1 means the draw has no material (CRenderQueue), use the default entry 0
+    MaterialData material = uMaterials[max(vMaterialIndex, 0)];
+
+#ifdef SHADER_VARIANT
+    // Variant from CShaderPool::getShaderVariant: always lit, texture set fixed at
+    // compile time so the compiler drops the unused texture paths
+    const bool hasDiffuseTexture  = HAS_DIFFUSE_MAP != 0;
+    const bool hasNormalTexture   = HAS_NORMAL_MAP != 0;
+    const bool hasSpecularTexture = HAS_SPECULAR_MAP != 0;
+    const bool hasAlphaTexture    = HAS_ALPHA_MAP != 0;
+#else
+    bool hasDiffuseTexture  = (material.textureFlags & 1) != 0;
+    bool hasNormalTexture   = (material.textureFlags & 2) != 0;
+    bool hasSpecularTexture = (material.textureFlags & 4) != 0;
+    bool hasAlphaTexture    = (material.textureFlags & 8) != 0;
+#endif
 
-    mat3 TBN = mat3(normalize(vTangent), normalize(vBitangent), normalize(vNormal));
-    vec3 normalMap = texture(uMaterial.normalTexture, vTexCoord).rgb;
-    
 //    vec3 N = normalize(TBN * (2.0 * normalMap - 1.0));
     vec3 N;
-    if (uMaterial.hasNormalTexture) {
+    if (hasNormalTexture) {
         vec3 T = normalize(vTangent);
         vec3 B = normalize(vBitangent);
         vec3 vertexNormal = normalize(vNormal);
@@ -81,7 +216,7 @@ void main() {
         
         mat3 TBN = mat3(T, B, vertexNormal);
         
-        vec3 normalMap = texture(uMaterial.normalTexture, vTexCoord).rgb;
+        vec3 normalMap = texture(uNormalTexture, vTexCoord).rgb;
         normalMap = normalize(normalMap * 2.0 - 1.0);
         
         normalMap.xy *= uNormalStrength;
@@ -99,15 +234,15 @@ void main() {
 
     vec4 texDiffuse = vec4(1.0);
     vec4 texSpecular = vec4(1.0);
-    float finalAlpha = uMaterial.alpha;
+    float finalAlpha = material.alpha;
 
-    if(uMaterial.hasDiffuseTexture) {
-        texDiffuse = texture(uMaterial.diffuseTexture, vTexCoord);
+    if(hasDiffuseTexture) {
+        texDiffuse = texture(uDiffuseTexture, vTexCoord);
         finalAlpha *= texDiffuse.a;
     }
     
-    if(uMaterial.hasAlphaTexture) {
-        float alphaFromTexture = texture(uMaterial.alphaTexture, vTexCoord).r;
+    if(hasAlphaTexture) {
+        float alphaFromTexture = texture(uAlphaTexture, vTexCoord).r;
         finalAlpha *= alphaFromTexture;
     }
     
@@ -115,8 +250,8 @@ void main() {
        discard;
    }
 
-    if(uMaterial.hasSpecularTexture) {
-        texSpecular = texture(uMaterial.specularTexture, vTexCoord);
+    if(hasSpecularTexture) {
+        texSpecular = texture(uSpecularTexture, vTexCoord);
         texSpecular.rgb = pow(texSpecular.rgb, vec3(0.8));
     }
     
@@ -127,61 +262,59 @@ void main() {
     vec4 totalDiffuse = vec4(0.0);
     vec4 totalSpecular = vec4(0.0);
     
-    for (int i = 0; i < min(uNumLights, MAX_LIGHTS); i++) {
-        if (!uLights[i].enabled) continue;
-        
+    // first Ambient (only the first light contributes ambient)
+    if (uNumLights > 0) {
+        LightSource light = fetchLight(0);
         vec3 L;
-        float attenuation = 1.0;
-        
-        if (uLights[i].type == 2) { // DIRECTIONAL
-            L = normalize(-uLights[i].direction);
-        } else { // POINT or SPOT
-            L = normalize(uLights[i].position - v3Pos);
-            
-            float dist = length(uLights[i].position - v3Pos);
-            attenuation = 1.0 / (uLights[i].constant + uLights[i].linear * dist + uLights[i].quadratic * dist * dist);
-        }
-        
-        // Spot light
-        if (uLights[i].type == 1 && uLights[i].cutOff > 0.0) { // SPOT
-            float theta = dot(L, normalize(-uLights[i].direction));
-            float intensity = clamp(
-                (theta - uLights[i].outerCutOff) / (uLights[i].cutOff - uLights[i].outerCutOff),
-                0.0, 1.0
-            );
-            
-            if (uLights[i].exponent == 1.0) {
-                attenuation *= intensity;
-            } else {
-                attenuation *= pow(intensity, uLights[i].exponent);
-            }
-        }
+        if (light.enabled) totalAmbient += light.ambient * material.ambient * texDiffuse * lightAttenuation(light, L) * 1.0;
+    }
+    
+    // Only the lights in this draw's list or binned into this fragment's cluster, or all of them when both are off
+    bool objectList = uObjectLightCount >= 0;
+    bool clustered = !objectList && uClustered != 0;
+    int first = 0;
+    int count = uNumLights;
+    if (objectList) {
+        count = min(uObjectLightCount, MAX_OBJECT_LIGHTS);
+    } else if (clustered) {
+        ivec2 tile = ivec2((gl_FragCoord.xy - uViewport.xy) * uViewport.zw * vec2(uClusterGrid.xy));
+        tile = clamp(tile, ivec2(0), uClusterGrid.xy - 1);
+        float viewDepth = -(mxView * vec4(v3Pos, 1.0)).z;
+        int slice = clamp(int(log(max(viewDepth, 1e-4)) * uClusterDepth.x + uClusterDepth.y), 0, uClusterGrid.z - 1);
+        int cluster = tile.x + uClusterGrid.x * (tile.y + uClusterGrid.y * slice);
+        uvec2 entry = texelFetch(uClusterTable, cluster).xy;
+        first = int(entry.x);
+        count = int(entry.y);
+    }
+    
+    for (int k = 0; k < count; k++) {
+        int i = objectList ? uObjectLights[k] : (clustered ? int(texelFetch(uClusterLights, first + k).r) : k);
+        LightSource light = fetchLight(i);
+        if (!light.enabled) continue;
         
+        vec3 L;
+        float attenuation = lightAttenuation(light, L) * rangeWindow(light);
+        if (light.shadow >= 0 && attenuation > 0.0) attenuation *= shadowFactor(light.shadow, N);
         vec3 H = normalize(L + V);
         
-        // first Ambient
-        if (i == 0) {
-            totalAmbient += uLights[i].ambient * uMaterial.ambient * texDiffuse * attenuation * 1.0;
-        }
-        
         // Diffuse
         float diff = max(dot(N, L), 0.0);
-        totalDiffuse += uLights[i].diffuse * diff * uMaterial.diffuse * texDiffuse * attenuation;
+        totalDiffuse += light.diffuse * diff * material.diffuse * texDiffuse * attenuation;
         
         // Specular
-        float spec = pow(max(dot(N, H), 0.0), uMaterial.shininess * uSpecularPower);
-        vec4 specularColor = uLights[i].specular * spec * uMaterial.specular * texSpecular * uSpecularStrength;
+        float spec = pow(max(dot(N, H), 0.0), material.shininess * uSpecularPower);
+        vec4 specularColor = light.specular * spec * material.specular * texSpecular * uSpecularStrength;
         float fresnel = pow(1.0 - max(dot(N, V), 0.0), 2.0);
         specularColor *= (1.0 + fresnel * 0.5);
         totalSpecular += specularColor * attenuation;
     }
     
-    finalColor = totalAmbient + totalDiffuse + totalSpecular;
+    finalColor = (totalAmbient + totalDiffuse + totalSpecular) * vInstanceColor;
     
 //    finalColor.rgb = finalColor.rgb / (finalColor.rgb + vec3(1.0));
 //    finalColor.rgb = pow(finalColor.rgb, vec3(1.0/2.2)); // Gamma correction
     finalColor = clamp(finalColor, 0.0, 1.0);
-    finalColor.a = finalAlpha; 
+    finalColor.a = finalAlpha * vInstanceColor.a; 
     FragColor = finalColor;
     
 }
@@ -14,28 +14,26 @@ CBottle::CBottle(unsigned int radialSegs, unsigned int heightSegs, GLuint patter
 CBottle::~CBottle() {
     glDeleteBuffers(1, &_vbo);
     glDeleteBuffers(1, &_ebo);
-    glDeleteVertexArrays(1, &_vao);
+    CGLState::getInstance().deleteVertexArray(_vao);
     if (_points) delete[] _points;
     if (_idx)    delete[] _idx;
 }
 
 void CBottle::draw() {
-    glUseProgram(_shaderProg);
+    CGLState::getInstance().useProgram(_shaderProg);
     updateMatrix();
-    glBindVertexArray(_vao);
+    CGLState::getInstance().bindVertexArray(_vao);
     glUniform1i(_shadingModeLoc, _uShadingMode);
     if (_bObjColor) glUniform4fv(_colorLoc, 1, glm::value_ptr(_color));
     glDrawElements(GL_TRIANGLES, _idxCount, GL_UNSIGNED_INT, 0);
-    glBindVertexArray(0);
 }
 
 void CBottle::drawRaw() {
     updateMatrix();
-    glBindVertexArray(_vao);
+    CGLState::getInstance().bindVertexArray(_vao);
     glUniform1i(_shadingModeLoc, _uShadingMode);
     if (_bObjColor) glUniform4fv(_colorLoc, 1, glm::value_ptr(_color));
     glDrawElements(GL_TRIANGLES, _idxCount, GL_UNSIGNED_INT, 0);
-    glBindVertexArray(0);
 }
 
 void CBottle::update(float dt) {
@@ -74,30 +74,28 @@ CCube::~CCube()
 {
 	glDeleteBuffers(1, &_vbo);  // VBO P EBO
 	glDeleteBuffers(1, &_ebo);
-	glDeleteVertexArrays(1, &_vao); //A VAO
+	CGLState::getInstance().deleteVertexArray(_vao); //A VAO
 	if (_points != NULL) delete[] _points;
 	if (_idx != NULL) delete[] _idx;
 }
 
 void CCube::draw()
 {
-	glUseProgram(_shaderProg);
+	CGLState::getInstance().useProgram(_shaderProg);
 	updateMatrix();
-	glBindVertexArray(_vao);
+	CGLState::getInstance().bindVertexArray(_vao);
 	glUniform1i(_shadingModeLoc, _uShadingMode);
 	if ( _bObjColor ) glUniform4fv(_colorLoc, 1, glm::value_ptr(_color));
 	glDrawElements(GL_TRIANGLES, _idxCount, GL_UNSIGNED_INT, 0);
-	glBindVertexArray(0);
 }
 
 void CCube::drawRaw()
 {
 	updateMatrix();
-	glBindVertexArray(_vao);
+	CGLState::getInstance().bindVertexArray(_vao);
 	glUniform1i(_shadingModeLoc, _uShadingMode);
 	if (_bObjColor) glUniform4fv(_colorLoc, 1, glm::value_ptr(_color));
 	glDrawElements(GL_TRIANGLES, _idxCount, GL_UNSIGNED_INT, 0);
-	glBindVertexArray(0);
 }
 
 void CCube::update(float dt)
@@ -14,29 +14,27 @@ CCylinder::CCylinder(GLuint sectors, GLuint pattern) : CShape() {
 CCylinder::~CCylinder() {
     glDeleteBuffers(1, &_vbo);
     glDeleteBuffers(1, &_ebo);
-    glDeleteVertexArrays(1, &_vao);
+    CGLState::getInstance().deleteVertexArray(_vao);
     if (_points) delete[] _points;
     if (_idx)    delete[] _idx;
 }
 
 // Draw methods
 void CCylinder::draw() {
-    glUseProgram(_shaderProg);
+    CGLState::getInstance().useProgram(_shaderProg);
     updateMatrix();
-    glBindVertexArray(_vao);
+    CGLState::getInstance().bindVertexArray(_vao);
     glUniform1i(_shadingModeLoc, _uShadingMode);
     if (_bObjColor) glUniform4fv(_colorLoc, 1, glm::value_ptr(_color));
     glDrawElements(GL_TRIANGLES, _idxCount, GL_UNSIGNED_INT, 0);
-    glBindVertexArray(0);
 }
 
 void CCylinder::drawRaw() {
     updateMatrix();
-    glBindVertexArray(_vao);
+    CGLState::getInstance().bindVertexArray(_vao);
     glUniform1i(_shadingModeLoc, _uShadingMode);
     if (_bObjColor) glUniform4fv(_colorLoc, 1, glm::value_ptr(_color));
     glDrawElements(GL_TRIANGLES, _idxCount, GL_UNSIGNED_INT, 0);
-    glBindVertexArray(0);
 }
 
 void CCylinder::reset() {
@@ -15,28 +15,26 @@ CDonut::CDonut(float majorRadius, float minorRadius, GLuint segments, GLuint sli
 CDonut::~CDonut() {
     glDeleteBuffers(1, &_vbo);
     glDeleteBuffers(1, &_ebo);
-    glDeleteVertexArrays(1, &_vao);
+    CGLState::getInstance().deleteVertexArray(_vao);
     if (_points) delete[] _points;
     if (_idx)    delete[] _idx;
 }
 
 void CDonut::draw() {
-    glUseProgram(_shaderProg);
+    CGLState::getInstance().useProgram(_shaderProg);
     updateMatrix();
-    glBindVertexArray(_vao);
+    CGLState::getInstance().bindVertexArray(_vao);
     glUniform1i(_shadingModeLoc, _uShadingMode);
     if (_bObjColor) glUniform4fv(_colorLoc, 1, glm::value_ptr(_color));
     glDrawElements(GL_TRIANGLES, _idxCount, GL_UNSIGNED_INT, 0);
-    glBindVertexArray(0);
 }
 
 void CDonut::drawRaw() {
     updateMatrix();
-    glBindVertexArray(_vao);
+    CGLState::getInstance().bindVertexArray(_vao);
     glUniform1i(_shadingModeLoc, _uShadingMode);
     if (_bObjColor) glUniform4fv(_colorLoc, 1, glm::value_ptr(_color));
     glDrawElements(GL_TRIANGLES, _idxCount, GL_UNSIGNED_INT, 0);
-    glBindVertexArray(0);
 }
 
 void CDonut::reset() {
@@ -2,11 +2,17 @@
 
 #include "CShape.h"
 #include "../common/typedefs.h"
+#include "../common/CShaderPool.h"
+#include "../common/CCuller.h"
+#include <vector>
+
+bool CShape::_bPositionStream = true;
 
 CShape::CShape()
 {
 	_vtxCount = _vtxAttrCount = _idxCount = 0;
 	_vao = 0; _vbo = 0; _ebo = 0;
+	_posVao = 0; _posVbo = 0;
 	_shaderProg = 0;
 	_scale = glm::vec3(1.0f, 1.0f, 1.0f);
 	_color = glm::vec4(0.5f, 0.5f, 0.5f, 1.0f);
@@ -20,27 +26,42 @@ CShape::CShape()
 	_mxTRS = glm::mat4(1.0f);
 	_mxTransform = glm::mat4(1.0f);
 	_mxFinal = glm::mat4(1.0f);
-	_colorLoc = _modelMxLoc = 0;
+	_colorLoc = _modelMxLoc = _instancedLoc = -1;
 	_points = nullptr; _idx = nullptr;
 	_uShadingMode = 1; // w]WҦA1 : vertex color, 2: uniform color(object color)
 	_bObjColor = false; // w]ϥΪC
-	_shadingModeLoc = 0; // WҦiJI
+	_bMaterial = false;
+	_bDynamic = false;
+	_transformNode = TRANSFORM_NULL_NODE;
+	_boundsMin = _boundsMax = glm::vec3(0.0f);
+	_shadingModeLoc = -1; // WҦiJI
+	_uniformReloadCount = 0;
 }
 
 CShape::~CShape()
 {
-
+	// _vaoB_vbo P _ebo ѤlO
+	if (_posVbo != 0) glDeleteBuffers(1, &_posVbo);
+	if (_posVao != 0) CGLState::getInstance().deleteVertexArray(_posVao);
 }
 
 void CShape::setupVertexAttributes()
 {
+	// ϰyЪ AABB (uݭn CPU ݪIm)
+	_boundsMin = _boundsMax = glm::vec3(0.0f);
+	for (int i = 0; i < _vtxCount; i++) {
+		glm::vec3 p(_points[i * _vtxAttrCount], _points[i * _vtxAttrCount + 1], _points[i * _vtxAttrCount + 2]);
+		_boundsMin = (i == 0) ? p : glm::min(_boundsMin, p);
+		_boundsMax = (i == 0) ? p : glm::max(_boundsMax, p);
+	}
+
 	// ]w VAOBVBO P EBO
 	glGenVertexArrays(1, &_vao);
 	glGenBuffers(1, &_vbo);
 	glGenBuffers(1, &_ebo);
 
 	// Bind the Vertex Array Object first, then bind and set vertex buffer(s) and attribute pointer(s).
-	glBindVertexArray(_vao);
+	CGLState::getInstance().bindVertexArray(_vao);
 
 	// ]w VBO
 	glBindBuffer(GL_ARRAY_BUFFER, _vbo);
@@ -65,25 +86,60 @@ void CShape::setupVertexAttributes()
 	//KϮyݩ
 	glVertexAttribPointer(3, 2, GL_FLOAT, GL_FALSE, _vtxAttrCount * sizeof(float), BUFFER_OFFSET(9 * sizeof(float)));
 	glEnableVertexAttribArray(3);
-	glBindVertexArray(0); // Ѱ VAO jw
+
+	// um streamGqIƨXmKsA޻P _vao ۦP
+	if (_bPositionStream) {
+		std::vector<GLfloat> positions(_vtxCount * 3);
+		for (int i = 0; i < _vtxCount; i++) {
+			for (int k = 0; k < 3; k++) positions[i * 3 + k] = _points[i * _vtxAttrCount + k];
+		}
+		if (_posVao == 0) {
+			glGenVertexArrays(1, &_posVao);
+			glGenBuffers(1, &_posVbo);
+		}
+		CGLState::getInstance().bindVertexArray(_posVao);
+		glBindBuffer(GL_ARRAY_BUFFER, _posVbo);
+		glBufferData(GL_ARRAY_BUFFER, positions.size() * sizeof(GLfloat), positions.data(), GL_STATIC_DRAW);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, _ebo);
+		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), BUFFER_OFFSET(0));
+		glEnableVertexAttribArray(0);
+	}
+	CGLState::getInstance().bindVertexArray(0); // Ѱ VAO jw
 }
 
 void CShape::setShaderID(GLuint shaderID, int shadeingmode)
 {
 	_shaderProg = shaderID;
 	_uShadingMode = shadeingmode;
-	glUseProgram(_shaderProg);
-	_modelMxLoc = glGetUniformLocation(_shaderProg, "mxModel"); 	// o mxModel ܼƪm
+	CGLState::getInstance().useProgram(_shaderProg);
+	resolveUniforms();
 	glUniformMatrix4fv(_modelMxLoc, 1, GL_FALSE, glm::value_ptr(_mxTRS));
-	_shadingModeLoc = glGetUniformLocation(_shaderProg, "uShadingMode"); 	// o iColorType ܼƪm
 	glUniform1i(_shadingModeLoc, _uShadingMode);
 }
 
+void CShape::resolveUniforms()
+{
+	// Ҧ uniform mub]w program P shader ѪRAøsɪϥ
+	CShaderPool& pool = CShaderPool::getInstance();
+	_modelMxLoc = pool.getUniformLocation(_shaderProg, "mxModel"); 	// o mxModel ܼƪm
+	_shadingModeLoc = pool.getUniformLocation(_shaderProg, "uShadingMode"); 	// o iColorType ܼƪm
+	_colorLoc = pool.getUniformLocation(_shaderProg, "ui4Color"); 	// o ui4Color ܼƪm
+	_instancedLoc = pool.getUniformLocation(_shaderProg, "uInstanced"); // instanced øsɤ~] 1
+	_materialUniforms.bind(_shaderProg, "uMaterial");
+	_uniformReloadCount = pool.getReloadCount();
+}
+
+void CShape::refreshUniforms()
+{
+	// shader s link  uniform mi
+	if (_shaderProg != 0 && _uniformReloadCount != CShaderPool::getInstance().getReloadCount()) resolveUniforms();
+}
+
 void CShape::setColor(glm::vec4 vColor)
 {
 	// zL glUniform ǤJҫC
 	_color = vColor;
-	_colorLoc = glGetUniformLocation(_shaderProg, "ui4Color"); 	// o ui4Color ܼƪm
+	refreshUniforms();
 	glUniform4fv(_colorLoc, 1, glm::value_ptr(_color));
 	_uShadingMode = 2; // ]wWҦ uniform color
 	glUniform1i(_shadingModeLoc, _uShadingMode);
@@ -134,6 +190,14 @@ void CShape::setRotate(float angle, const glm::vec3& axis)
 }
 
 void CShape::updateMatrix()
+{
+	// phӼҫϥάۦP shader program,]C@Ӽҫ mxTRS PAҥHCframens
+	// UlO draw / drawRaw Iso̡AKT{ uniform mO_ݭnsѪR
+	refreshUniforms();
+	glUniformMatrix4fv(_modelMxLoc, 1, GL_FALSE, glm::value_ptr(refreshModelMatrix()));
+}
+
+const glm::mat4& CShape::refreshModelMatrix()
 {
 	if (_bScale || _bPos || _bRotation )
 	{
@@ -146,8 +210,70 @@ void CShape::updateMatrix()
 		_mxFinal = _mxTransform * _mxTRS;
 		_bTransform = false;
 	}
-	// phӼҫϥάۦP shader program,]C@Ӽҫ mxTRS PAҥHCframens
-	glUniformMatrix4fv(_modelMxLoc, 1, GL_FALSE, glm::value_ptr(_mxFinal));
+	if (_transformNode != TRANSFORM_NULL_NODE) {
+		// local Sܮ graph |аO dirty
+		CTransformGraph& graph = CTransformGraph::getInstance();
+		graph.setLocalMatrix(_transformNode, _mxFinal);
+		return graph.getWorldMatrix(_transformNode);
+	}
+	return _mxFinal;
+}
+
+void CShape::getWorldBounds(glm::vec3& bmin, glm::vec3& bmax)
+{
+	CCuller::transformBounds(refreshModelMatrix(), _boundsMin, _boundsMax, bmin, bmax);
+}
+
+void CShape::submit(CRenderQueue& queue)
+{
+	queue.submit(getDrawPacket());
+}
+
+DrawPacket CShape::getDrawPacket()
+{
+	DrawPacket packet;
+	packet.program = _shaderProg;
+	packet.vao = _vao;
+	packet.indexCount = _idxCount;
+	packet.mxModel = refreshModelMatrix();
+	packet.shadingMode = _uShadingMode;
+	packet.useColor = _bObjColor;
+	packet.color = _color;
+	// ӼҦ (3) @wݭnA]wɨϥιw]
+	if (_bMaterial || _uShadingMode >= 3) packet.materialIndex = _material.getTableIndex();
+	// Cbzɤ~z passAH AABB ߱Ƨ
+	if (_bObjColor && _color.a < 1.0f) packet.pass = RENDER_PASS_TRANSPARENT;
+	packet.center = (_boundsMin + _boundsMax) * 0.5f;
+	packet.radius = glm::length(_boundsMax - packet.center);
+	packet.positionVao = _posVao;
+	return packet;
+}
+
+void CShape::drawInstanced(CInstanceSet& instances)
+{
+	if (instances.size() == 0) return;
+	instances.attach(_vao);
+	instances.upload();
+	CGLState::getInstance().useProgram(_shaderProg);
+	CGLState::getInstance().bindVertexArray(_vao);
+	updateMatrix();
+	glUniform1i(_shadingModeLoc, _uShadingMode);
+	if (_bObjColor) glUniform4fv(_colorLoc, 1, glm::value_ptr(_color));
+	if (_bMaterial) uploadMaterial();
+	glUniform1i(_instancedLoc, 1);
+	glDrawElementsInstanced(GL_TRIANGLES, _idxCount, GL_UNSIGNED_INT, 0, instances.size());
+	glUniform1i(_instancedLoc, 0); // L@ΦP@ program
+}
+
+void CShape::submitInstanced(CRenderQueue& queue, CInstanceSet& instances)
+{
+	if (instances.size() == 0) return;
+	instances.attach(_vao);
+	if (_posVao != 0) instances.attach(_posVao);
+	instances.upload();
+	DrawPacket packet = getDrawPacket();
+	packet.instanceCount = instances.size();
+	queue.submit(packet);
 }
 
 void CShape::setTransformMatrix(glm::mat4 mxMatrix)
@@ -156,7 +282,11 @@ void CShape::setTransformMatrix(glm::mat4 mxMatrix)
 	_mxTransform = mxMatrix;
 }
 
-glm::mat4 CShape::getModelMatrix() { return _mxFinal; }
+glm::mat4 CShape::getModelMatrix()
+{
+	if (_transformNode != TRANSFORM_NULL_NODE) return CTransformGraph::getInstance().getWorldMatrix(_transformNode);
+	return _mxFinal;
+}
 GLuint CShape::getShaderProgram() { return _shaderProg; }
 glm::vec3 CShape::getScale(){ return _scale; }
 glm::vec3 CShape::getColor(){ return _color; }
@@ -183,8 +313,10 @@ void CShape::reset()
 
 void CShape::setMaterial(const CMaterial& material) {
 	_material = material;
+	_bMaterial = true;
 }
 
 void CShape::uploadMaterial()  {
-	_material.uploadToShader(_shaderProg, "uMaterial");
+	refreshUniforms();
+	_material.uploadToShader(_materialUniforms);
 }
@@ -2,6 +2,10 @@
 #include <glm/glm.hpp>
 #include <GL/glew.h>
 #include "../common/CMaterial.h"
+#include "../common/CGLState.h"
+#include "../common/CRenderQueue.h"
+#include "../common/CInstanceSet.h"
+#include "../common/CTransformGraph.h"
 
 class CShape
 {
@@ -20,12 +24,42 @@ public:
 	void setRotate(float angle, const glm::vec3& axis); // ]wҫਤ׻Pb
 	void setTransformMatrix(glm::mat4 mxMatrix);
 	void updateMatrix();
+	const glm::mat4& refreshModelMatrix(); // up model matrixAW
+	void submit(CRenderQueue& queue); // eiøsCANIs draw()
+	DrawPacket getDrawPacket(); // submit() eXeA]ΩRAXɤ
+	// H instances C@Ue@Ainstance x}b model matrix 
+	void drawInstanced(CInstanceSet& instances);
+	void submitInstanced(CRenderQueue& queue, CInstanceSet& instances);
 	glm::vec3 getPos(); // oҫm
     glm::vec3 getScale();
     glm::vec3 getColor();
 	glm::mat4 getModelMatrix();
 	glm::mat4 getTransMatrix();
 	GLuint getShaderProgram();
+	// IơGCӳI _vtxAttrCount  float (mBCBkVqBKϮy)
+	const GLfloat* getVertexData() const { return _points; }
+	int getVertexCount() const { return _vtxCount; }
+	int getVertexAttrCount() const { return _vtxAttrCount; }
+	const GLuint* getIndexData() const { return _idx; }
+	int getIndexCount() const { return _idxCount; }
+	// ϰyЪ AABBA setupVertexAttributes ɥѳImp
+	void getLocalBounds(glm::vec3& bmin, glm::vec3& bmax) const { bmin = _boundsMin; bmax = _boundsMax; }
+	// Hثe model matrix ഫ᪺@ɮy AABBAѵ@簣ϥ
+	void getWorldBounds(glm::vec3& bmin, glm::vec3& bmax);
+
+	// FIݩʤ~At~OdumK buffer P VAO (CӳI 12 bytes)A
+	// `׹wøsPvݭnӪ pass ŪIƬT@Fb setupVertexAttributes e]wAw]}
+	static void setPositionStreamEnabled(bool enabled) { _bPositionStream = enabled; }
+	static bool isPositionStreamEnabled() { return _bPositionStream; }
+	GLuint getPositionVAO() const { return _posVao; }
+
+	// ʺA (|ʩܧ) ѻPRAX
+	void setDynamic(bool bDynamic) { _bDynamic = bDynamic; }
+	bool isDynamic() const { return _bDynamic; }
+
+	// W transform graph `IA TRS `I local matrixAmodel matrix `I world matrix
+	void setTransformNode(int node) { _transformNode = node; }
+	int getTransformNode() const { return _transformNode; }
 
 	// ޲z
 	void setMaterial(const CMaterial& material);
@@ -36,17 +70,23 @@ protected:
 	GLfloat* _points;
 	GLuint* _idx;
 	GLuint _vao, _vbo, _ebo;
+	GLuint _posVao, _posVbo; // um streamAP _vao @ _ebo
 	GLuint _shaderProg;
 	GLint _modelMxLoc;
 	GLint _shadingModeLoc, _uShadingMode; //WҦiJI, WҦ
 	GLint _colorLoc; // WҦiJI
+	GLint _instancedLoc; // uInstanced iJI
 	bool _bRotation, _bScale, _bPos, _bObjColor;
+	bool _bMaterial; // true Ng]wL
+	bool _bDynamic;  // true NC frame iಾʡAw] false
+	int _transformNode; // transform graph `IATRANSFORM_NULL_NODE Nb graph 
 	bool _bTransform, _bOnTransform;	
 	// _bTransform : true N]wsഫx}
 	// _bOnTransform : true Ng]wLഫx}AΩP_O_ݭns model matrix
 	glm::vec4 _color; // ϥ RGBA
 	glm::vec3 _scale; // ҫY
 	glm::vec3 _pos;  // ҫm
+	glm::vec3 _boundsMin, _boundsMax; // ϰyЪ AABB
 
 	// ]wҫlPBʤUѼ
 	GLfloat   _rotAngle; // ҫਤ
@@ -57,4 +97,12 @@ protected:
 
 	// 
 	CMaterial _material;
+	CMaterialUniforms _materialUniforms; //  setShaderID ɸѪR uMaterial handle
+
+	static bool _bPositionStream;
+
+	// ѪR _shaderProg  uniform mFCShaderPool Ƨܮ refreshUniforms sѪR
+	void resolveUniforms();
+	void refreshUniforms();
+	int _uniformReloadCount;
 };
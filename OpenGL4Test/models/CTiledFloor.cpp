@@ -0,0 +1,108 @@
+#include <GL/glew.h>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "CTiledFloor.h"
+
+CTiledFloor::CTiledFloor(int rows, int cols, float tileSize) : CQuad()
+{
+	_rows = rows; _cols = cols;
+	_mxCulled = glm::mat4(1.0f);
+	_bCulled = false;
+	_bBoundsDirty = _bTilesDirty = true;
+
+	// 預設排列與原本的 CQuad 陣列相同：四邊形轉到 XZ 平面，整片地板中心在原點
+	_tiles.reserve(_rows * _cols);
+	_tileTransforms.reserve(_rows * _cols);
+	glm::quat rotation = glm::angleAxis(glm::radians(-90.0f), glm::vec3(1.0f, 0.0f, 0.0f));
+	for (int i = 0; i < _rows; i++)
+		for (int j = 0; j < _cols; j++) {
+			glm::vec3 pos((_rows * 0.5f - 0.5f - (float)i) * tileSize, 0.0f, ((float)j - _cols * 0.5f + 0.5f) * tileSize);
+			_tileTransforms.add(pos, rotation, glm::vec3(tileSize));
+			_tiles.add(glm::mat4(1.0f));
+		}
+	updateTileTransforms();
+}
+
+CTiledFloor::~CTiledFloor()
+{
+	// 四邊形的 VAO/VBO/EBO 由 CQuad 釋放，instance buffer 由 CInstanceSet 釋放
+}
+
+void CTiledFloor::setCheckerMaterials(CMaterial& matA, CMaterial& matB)
+{
+	int indexA = matA.getTableIndex(), indexB = matB.getTableIndex();
+	for (int i = 0; i < _rows; i++)
+		for (int j = 0; j < _cols; j++)
+			_tiles.setMaterial(i * _cols + j, ((i + j) % 2 == 0) ? indexA : indexB);
+	_bTilesDirty = true;
+}
+
+void CTiledFloor::setTileMaterial(int row, int col, CMaterial& material)
+{
+	_tiles.setMaterial(row * _cols + col, material.getTableIndex());
+	_bTilesDirty = true;
+}
+
+void CTiledFloor::setTileTransform(int row, int col, const glm::vec3& position, const glm::quat& rotation, const glm::vec3& scale)
+{
+	_tileTransforms.set(row * _cols + col, position, rotation, scale);
+}
+
+void CTiledFloor::setTilePosition(int row, int col, const glm::vec3& position)
+{
+	_tileTransforms.setPosition(row * _cols + col, position);
+}
+
+void CTiledFloor::updateTileTransforms()
+{
+	// 只有修改過的範圍會重新組合；寫入 _tiles 時整段標記為 dirty，磁磚很少移動
+	if (_tileTransforms.update() == 0) return;
+	_tiles.setTransforms(0, _tileTransforms.size(), _tileTransforms.getWorldRows(0));
+	_bBoundsDirty = _bTilesDirty = true;
+}
+
+void CTiledFloor::cull(const CFrustum& frustum)
+{
+	// 地板本身或磁磚移動後重新計算每個磁磚的世界座標邊界
+	updateTileTransforms();
+	const glm::mat4& mxModel = refreshModelMatrix();
+	if (_bBoundsDirty || mxModel != _mxCulled) {
+		_tileCuller.clear();
+		for (int i = 0; i < _tiles.size(); i++) {
+			glm::vec3 bmin, bmax;
+			CCuller::transformBounds(mxModel * _tiles.get(i).mxModel, _boundsMin, _boundsMax, bmin, bmax);
+			_tileCuller.add(bmin, bmax);
+		}
+		_mxCulled = mxModel;
+		_bBoundsDirty = false;
+		_bTilesDirty = true;
+	}
+	if (_tileCuller.cull(frustum) || _bTilesDirty) {
+		_visibleTiles.clear();
+		for (int i = 0; i < _tiles.size(); i++) {
+			if (!_tileCuller.isVisible(i)) continue;
+			const InstanceData& tile = _tiles.get(i);
+			_visibleTiles.add(tile.mxModel, tile.color, tile.materialIndex);
+		}
+		_bTilesDirty = false;
+	}
+	_bCulled = true;
+}
+
+void CTiledFloor::draw()
+{
+	updateTileTransforms();
+	drawInstanced(activeTiles());
+}
+
+void CTiledFloor::drawRaw()
+{
+	updateTileTransforms();
+	drawInstanced(activeTiles());
+}
+
+void CTiledFloor::submit(CRenderQueue& queue)
+{
+	updateTileTransforms();
+	submitInstanced(queue, activeTiles());
+}
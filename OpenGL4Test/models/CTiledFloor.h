@@ -0,0 +1,46 @@
+#pragma once
+#include "CQuad.h"
+#include "../common/CCuller.h"
+#include "../common/CTransformStore.h"
+
+// rows x cols 個磁磚組成的地板 (XZ 平面，中心在原點)
+// 只保存一份四邊形網格，每個磁磚的轉換矩陣與材質索引放在 CInstanceSet，
+// 整片地板一次 glDrawElementsInstanced 畫完；原本 30x30 的 CQuad 陣列每個 frame 要 900 次 draw call
+// 磁磚的位置、旋轉與縮放存放在 CTransformStore，修改後在下一次 cull / draw 時一次組合並寫入 CInstanceSet
+class CTiledFloor : public CQuad
+{
+public:
+	CTiledFloor(int rows, int cols, float tileSize = 1.0f);
+	virtual ~CTiledFloor();
+	virtual void draw() override;
+	virtual void drawRaw() override;
+	void submit(CRenderQueue& queue);
+	// 剔除視錐外的磁磚，之後的 draw / submit 只畫可見的磁磚 (可見集合改變時才重新上傳)
+	void cull(const CFrustum& frustum);
+
+	// 以棋盤格方式交錯使用兩種材質，(0,0) 使用 matA
+	void setCheckerMaterials(CMaterial& matA, CMaterial& matB);
+	void setTileMaterial(int row, int col, CMaterial& material);
+	// 相對於地板本身的位置、旋轉與縮放
+	void setTileTransform(int row, int col, const glm::vec3& position, const glm::quat& rotation, const glm::vec3& scale);
+	void setTilePosition(int row, int col, const glm::vec3& position);
+	glm::vec3 getTilePosition(int row, int col) const { return _tileTransforms.getPosition(row * _cols + col); }
+
+	int getTileCount() const { return _rows * _cols; }
+	int getDrawCallCount() const { return 1; } // 以 CQuad 個別繪製時為 getTileCount()
+	int getCulledCount() const { return _bCulled ? _tileCuller.getCulledCount() : 0; }
+
+private:
+	CInstanceSet& activeTiles() { return _bCulled ? _visibleTiles : _tiles; }
+	// 組合修改過的磁磚 transform 並寫入 _tiles
+	void updateTileTransforms();
+
+	int _rows, _cols;
+	CInstanceSet _tiles; // 第 row * cols + col 筆為 (row, col) 的磁磚
+	CTransformStore _tileTransforms; // 與 _tiles 一一對應
+	CInstanceSet _visibleTiles; // cull() 後可見的磁磚
+	CCuller _tileCuller; // 與 _tiles 一一對應的世界座標邊界
+	glm::mat4 _mxCulled; // 建立 _tileCuller 時的 model matrix
+	bool _bCulled; // true 代表使用 _visibleTiles 繪製
+	bool _bBoundsDirty, _bTilesDirty; // 磁磚的轉換矩陣 / 任何內容在上次 cull() 後有修改
+};
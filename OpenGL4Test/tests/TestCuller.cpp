@@ -0,0 +1,169 @@
+//  TestCuller.cpp
+//  CFrustum 的平面取出與 CCuller 的 SIMD 剔除結果，以 CFrustum 的純量測試為準
+
+#include <random>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include "UnitTest.h"
+#include "../common/CFrustum.h"
+#include "../common/CCuller.h"
+
+namespace {
+
+const glm::vec3 kEye(0.0f, 2.0f, 8.0f);
+const glm::vec3 kTarget(0.0f, 0.0f, 0.0f);
+const float kNear = 0.1f, kFar = 50.0f;
+
+glm::mat4 testViewProj() {
+	glm::mat4 mxProj = glm::perspective(glm::radians(60.0f), 4.0f / 3.0f, kNear, kFar);
+	glm::mat4 mxView = glm::lookAt(kEye, kTarget, glm::vec3(0.0f, 1.0f, 0.0f));
+	return mxProj * mxView;
+}
+
+float planeDistance(const glm::vec4& plane, const glm::vec3& p) {
+	return glm::dot(glm::vec3(plane), p) + plane.w;
+}
+
+// 在 [-range, range] 內產生隨機 AABB，部分在視錐內、部分在外、部分與平面相交
+void randomBox(std::mt19937& rng, float range, glm::vec3& bmin, glm::vec3& bmax) {
+	std::uniform_real_distribution<float> pos(-range, range), size(0.05f, 4.0f);
+	glm::vec3 c(pos(rng), pos(rng), pos(rng));
+	glm::vec3 h(size(rng), size(rng), size(rng));
+	bmin = c - h; bmax = c + h;
+}
+
+}
+
+TEST(FrustumPlanesAreNormalized) {
+	CFrustum frustum;
+	frustum.extract(testViewProj());
+	for (int i = 0; i < CFrustum::PLANE_COUNT; i++)
+		CHECK_NEAR(glm::length(glm::vec3(frustum.getPlane(i))), 1.0, 1e-5);
+}
+
+TEST(FrustumCornersLieOnPlanes) {
+	glm::mat4 mxViewProj = testViewProj();
+	glm::mat4 mxInv = glm::inverse(mxViewProj);
+	CFrustum frustum;
+	frustum.extract(mxViewProj);
+
+	// NDC 的八個角落轉回世界座標後，應該落在對應的三個平面上、其餘平面的內側
+	for (int c = 0; c < 8; c++) {
+		glm::vec4 ndc((c & 1) ? 1.0f : -1.0f, (c & 2) ? 1.0f : -1.0f, (c & 4) ? 1.0f : -1.0f, 1.0f);
+		glm::vec4 world = mxInv * ndc;
+		glm::vec3 p = glm::vec3(world) / world.w;
+		int onPlane[3] = {
+			(c & 1) ? CFrustum::PLANE_RIGHT : CFrustum::PLANE_LEFT,
+			(c & 2) ? CFrustum::PLANE_TOP : CFrustum::PLANE_BOTTOM,
+			(c & 4) ? CFrustum::PLANE_FAR : CFrustum::PLANE_NEAR
+		};
+		float tolerance = (c & 4) ? 1e-2f : 1e-4f;	// 遠平面的角落距離較遠，浮點誤差較大
+		for (int i = 0; i < CFrustum::PLANE_COUNT; i++) {
+			float d = planeDistance(frustum.getPlane(i), p);
+			bool expectOn = i == onPlane[0] || i == onPlane[1] || i == onPlane[2];
+			if (expectOn) CHECK_NEAR(d, 0.0, tolerance);
+			else CHECK(d > -tolerance);
+		}
+	}
+}
+
+TEST(FrustumNearPlaneFacesViewDirection) {
+	CFrustum frustum;
+	frustum.extract(testViewProj());
+	glm::vec3 forward = glm::normalize(kTarget - kEye);
+	CHECK_NEAR(glm::dot(glm::vec3(frustum.getPlane(CFrustum::PLANE_NEAR)), forward), 1.0, 1e-4);
+	CHECK_NEAR(glm::dot(glm::vec3(frustum.getPlane(CFrustum::PLANE_FAR)), forward), -1.0, 1e-4);
+	// 眼睛到近平面的距離為 near
+	CHECK_NEAR(planeDistance(frustum.getPlane(CFrustum::PLANE_NEAR), kEye), -kNear, 1e-4);
+	CHECK(frustum.testSphere(kTarget, 0.1f));
+	CHECK(!frustum.testSphere(kEye - forward * 2.0f, 0.5f));
+}
+
+TEST(CullerMatchesScalarPath) {
+	CFrustum frustum;
+	frustum.extract(testViewProj());
+
+	// 數量不是 4 的倍數，確認 SIMD 核心的尾端補齊不影響結果
+	const int count = 1003;
+	std::mt19937 rng(1234);
+	CCuller culler;
+	std::vector<glm::vec3> mins(count), maxs(count);
+	for (int i = 0; i < count; i++) {
+		randomBox(rng, 30.0f, mins[i], maxs[i]);
+		CHECK_EQUAL(culler.add(mins[i], maxs[i]), i);
+	}
+	CHECK_EQUAL(culler.size(), count);
+	culler.cull(frustum);
+
+	int culled = 0, mismatches = 0;
+	for (int i = 0; i < count; i++) {
+		bool expected = frustum.testAABB(mins[i], maxs[i]);
+		if (culler.isVisible(i) != expected) mismatches++;
+		if (!expected) culled++;
+		// 包圍球完全在外的物件一定被剔除
+		glm::vec3 center = (mins[i] + maxs[i]) * 0.5f;
+		if (!frustum.testSphere(center, glm::length(maxs[i] - center))) CHECK(!culler.isVisible(i));
+	}
+	CHECK_EQUAL(mismatches, 0);
+	CHECK_EQUAL(culler.getCulledCount(), culled);
+	CHECK_EQUAL(culler.getVisibleCount(), count - culled);
+	// 隨機分佈應該同時有可見與剔除的物件，否則這個測試沒有意義
+	CHECK(culled > 0 && culled < count);
+}
+
+TEST(CullerReportsVisibilityChanges) {
+	CFrustum frustum;
+	frustum.extract(testViewProj());
+
+	CCuller culler;
+	int inside = culler.add(glm::vec3(-1.0f), glm::vec3(1.0f));
+	int behind = culler.add(glm::vec3(-1.0f, -1.0f, 20.0f), glm::vec3(1.0f, 1.0f, 22.0f));
+	int side = culler.add(glm::vec3(60.0f, 0.0f, 0.0f), glm::vec3(61.0f, 1.0f, 1.0f));
+	int beyondFar = culler.add(glm::vec3(-1.0f, -1.0f, -200.0f), glm::vec3(1.0f, 1.0f, -150.0f));
+	// 包圍球與平面相交但 AABB 在外：只有 AABB 細測能剔除
+	int corner = culler.add(glm::vec3(6.3f, 6.3f, -1.0f), glm::vec3(9.0f, 9.0f, 1.0f));
+	CHECK(!frustum.testAABB(glm::vec3(6.3f, 6.3f, -1.0f), glm::vec3(9.0f, 9.0f, 1.0f)));
+
+	CHECK(culler.cull(frustum));
+	CHECK(culler.isVisible(inside));
+	CHECK(!culler.isVisible(behind));
+	CHECK(!culler.isVisible(side));
+	CHECK(!culler.isVisible(beyondFar));
+	CHECK(!culler.isVisible(corner));
+	CHECK_EQUAL(culler.getCulledCount(), 4);
+
+	// 沒有改變時回傳 false
+	CHECK(!culler.cull(frustum));
+
+	culler.setBounds(side, glm::vec3(2.0f, 0.0f, 0.0f), glm::vec3(3.0f, 1.0f, 1.0f));
+	CHECK(culler.cull(frustum));
+	CHECK(culler.isVisible(side));
+	CHECK_EQUAL(culler.getCulledCount(), 3);
+	CHECK_EQUAL(culler.getVisibleCount(), 2);
+
+	culler.clear();
+	CHECK_EQUAL(culler.size(), 0);
+	CHECK_EQUAL(culler.getCulledCount(), 0);
+}
+
+TEST(TransformBoundsMatchesCorners) {
+	glm::mat4 mxModel = glm::translate(glm::mat4(1.0f), glm::vec3(3.0f, -1.0f, 2.0f));
+	mxModel = glm::rotate(mxModel, glm::radians(37.0f), glm::normalize(glm::vec3(1.0f, 2.0f, 0.5f)));
+	mxModel = glm::scale(mxModel, glm::vec3(0.5f, 2.0f, 1.5f));
+	glm::vec3 bmin(-1.0f, -0.5f, -2.0f), bmax(2.0f, 1.5f, 0.25f);
+
+	glm::vec3 outMin, outMax;
+	CCuller::transformBounds(mxModel, bmin, bmax, outMin, outMax);
+
+	glm::vec3 expectMin(1e30f), expectMax(-1e30f);
+	for (int c = 0; c < 8; c++) {
+		glm::vec3 corner((c & 1) ? bmax.x : bmin.x, (c & 2) ? bmax.y : bmin.y, (c & 4) ? bmax.z : bmin.z);
+		glm::vec3 p = glm::vec3(mxModel * glm::vec4(corner, 1.0f));
+		expectMin = glm::min(expectMin, p);
+		expectMax = glm::max(expectMax, p);
+	}
+	for (int k = 0; k < 3; k++) {
+		CHECK_NEAR(outMin[k], expectMin[k], 1e-4);
+		CHECK_NEAR(outMax[k], expectMax[k], 1e-4);
+	}
+}
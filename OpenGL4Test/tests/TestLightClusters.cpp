@@ -0,0 +1,162 @@
+//  TestLightClusters.cpp
+//  CLightClusters::findCluster 與 shader 的算法一致，build 後光源照得到的每個點所屬的 cluster 都包含該光源
+
+#include <cmath>
+#include <random>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include "UnitTest.h"
+#include "../common/CLightClusters.h"
+
+namespace {
+
+const float kNear = 0.5f, kFar = 100.0f;
+
+glm::mat4 testProjection() {
+	return glm::perspective(glm::radians(45.0f), 16.0f / 9.0f, kNear, kFar);
+}
+
+glm::mat4 testView() {
+	return glm::lookAt(glm::vec3(3.0f, 4.0f, 10.0f), glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+}
+
+bool clusterContains(const CLightClusters& clusters, int cluster, int light) {
+	const std::vector<uint32_t>& table = clusters.getClusterTable();
+	const std::vector<uint16_t>& indices = clusters.getLightIndices();
+	for (uint32_t k = 0; k < table[cluster * 2 + 1]; k++)
+		if (indices[table[cluster * 2] + k] == light) return true;
+	return false;
+}
+
+// 世界座標的點投影後所屬的 cluster，在視錐外時回傳 -1
+int clusterOfPoint(const CLightClusters& clusters, const glm::mat4& mxView, const glm::mat4& mxProj, const glm::vec3& p) {
+	glm::vec4 viewPos = mxView * glm::vec4(p, 1.0f);
+	glm::vec4 clip = mxProj * viewPos;
+	if (clip.w <= 0.0f) return -1;
+	glm::vec3 ndc = glm::vec3(clip) / clip.w;
+	if (std::fabs(ndc.x) > 1.0f || std::fabs(ndc.y) > 1.0f || std::fabs(ndc.z) > 1.0f) return -1;
+	return clusters.findCluster(ndc.x, ndc.y, -viewPos.z);
+}
+
+}
+
+TEST(ClusterFindMatchesGrid) {
+	CLightClusters clusters;
+	clusters.setProjection(testProjection());
+	CHECK_NEAR(clusters.getNear(), kNear, 1e-3);
+	CHECK_NEAR(clusters.getFar(), kFar, 1e-1);
+
+	// 左下角、最近的 slice 為 0；右上角、最遠的 slice 為最後一個
+	CHECK_EQUAL(clusters.findCluster(-0.999f, -0.999f, kNear * 1.001f), 0);
+	CHECK_EQUAL(clusters.findCluster(0.999f, 0.999f, kFar * 0.999f), clusters.getClusterCount() - 1);
+	CHECK_EQUAL(clusters.findCluster(0.999f, -0.999f, kNear * 1.001f), clusters.getClusterIndex(clusters.getGridX() - 1, 0, 0));
+
+	// shader 的 slice = log(depth) * scale + bias，每個 cluster 的 view space 邊界必須涵蓋落在其中的點
+	int outside = 0;
+	for (int z = 0; z < clusters.getGridZ(); z++) {
+		int cluster = clusters.getClusterIndex(clusters.getGridX() / 2, clusters.getGridY() / 2, z);
+		glm::vec3 bmin, bmax;
+		clusters.getClusterBounds(cluster, bmin, bmax);
+		float depth = -(bmin.z + bmax.z) * 0.5f;
+		int slice = static_cast<int>(std::log(depth) * clusters.getDepthScale() + clusters.getDepthBias());
+		CHECK_EQUAL(slice, z);
+		if (clusters.findCluster(0.01f, 0.01f, depth) != cluster) outside++;
+	}
+	CHECK_EQUAL(outside, 0);
+}
+
+TEST(ClusterPointLightAtKnownPosition) {
+	glm::mat4 mxView = testView(), mxProj = testProjection();
+	CLightClusters clusters;
+	clusters.setProjection(mxProj);
+
+	std::vector<ClusterLight> lights(2);
+	lights[0].position = glm::vec3(0.0f);
+	lights[0].range = 1.5f;
+	lights[1].position = glm::vec3(0.0f, 0.0f, 60.0f);   // 在鏡頭後方
+	lights[1].range = 2.0f;
+	clusters.build(mxView, lights);
+
+	// 光源位置所屬的 cluster 包含光源，遠離影響範圍的 cluster 不包含
+	int center = clusterOfPoint(clusters, mxView, mxProj, lights[0].position);
+	CHECK(center >= 0);
+	CHECK(clusterContains(clusters, center, 0));
+	int far = clusterOfPoint(clusters, mxView, mxProj, glm::vec3(6.0f, 0.0f, -6.0f));
+	CHECK(far >= 0);
+	CHECK(!clusterContains(clusters, far, 0));
+
+	// 鏡頭後方的光源不會出現在任何 cluster
+	int behind = 0;
+	for (int c = 0; c < clusters.getClusterCount(); c++)
+		if (clusterContains(clusters, c, 1)) behind++;
+	CHECK_EQUAL(behind, 0);
+
+	// 關閉的光源也不加入
+	lights[0].enabled = false;
+	CHECK_EQUAL(clusters.build(mxView, lights), 0);
+}
+
+TEST(ClusterBuildCoversLitPoints) {
+	glm::mat4 mxView = testView();
+	std::mt19937 rng(1);
+	std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+	std::vector<ClusterLight> lights;
+	for (int i = 0; i < 200; i++) {
+		ClusterLight light;
+		light.position = glm::vec3(unit(rng) * 20.0f, unit(rng) * 5.0f, unit(rng) * 20.0f);
+		light.range = 2.0f + (unit(rng) + 1.0f) * 3.0f;
+		if (i % 3 == 0) {
+			light.direction = glm::normalize(glm::vec3(unit(rng), -1.0f, unit(rng)));
+			light.cosOuterCutOff = std::cos(glm::radians(10.0f + (unit(rng) + 1.0f) * 35.0f));
+		}
+		lights.push_back(light);
+	}
+
+	// 透視與正交投影都要涵蓋
+	for (int mode = 0; mode < 2; mode++) {
+		glm::mat4 mxProj = mode == 0 ? testProjection() : glm::ortho(-10.0f, 10.0f, -6.0f, 6.0f, 1.0f, 100.0f);
+		CLightClusters clusters;
+		clusters.setProjection(mxProj);
+		int indexCount = clusters.build(mxView, lights);
+		CHECK(indexCount > 0);
+		CHECK_EQUAL(static_cast<int>(clusters.getLightIndices().size()), indexCount);
+		CHECK_EQUAL(clusters.getDroppedCount(), 0);
+
+		// 在每個光源照得到的範圍內取樣，所屬的 cluster 都必須包含該光源
+		int tested = 0, missed = 0;
+		for (int i = 0; i < static_cast<int>(lights.size()); i++) {
+			const ClusterLight& light = lights[i];
+			for (int s = 0; s < 500; s++) {
+				glm::vec3 d(unit(rng), unit(rng), unit(rng));
+				if (glm::length(d) > 1.0f) continue;
+				glm::vec3 p = light.position + d * light.range;
+				if (light.cosOuterCutOff > 0.0f && glm::dot(glm::normalize(p - light.position), light.direction) < light.cosOuterCutOff)
+					continue;
+				int cluster = clusterOfPoint(clusters, mxView, mxProj, p);
+				if (cluster < 0) continue;
+				tested++;
+				if (!clusterContains(clusters, cluster, i)) missed++;
+			}
+		}
+		CHECK(tested > 1000);
+		CHECK_EQUAL(missed, 0);
+	}
+}
+
+TEST(ClusterIndexLimitDropsLights) {
+	CLightClusters clusters;
+	clusters.setProjection(testProjection());
+	std::vector<ClusterLight> lights(4);   // 不會衰減，每個 cluster 都有
+	clusters.setMaxIndexCount(clusters.getClusterCount());
+	CHECK_EQUAL(clusters.build(testView(), lights), clusters.getClusterCount());
+	// 每個 cluster 只放得下第一個光源
+	CHECK_EQUAL(clusters.getDroppedCount(), 3 * clusters.getClusterCount());
+	CHECK_EQUAL(clusters.getMaxLightsPerCluster(), 1);
+}
+
+TEST(ClusterAttenuationRange) {
+	// 1 / (1 + 0.09 d + 0.032 d^2) = 1 / 256 時 d 約為 88
+	float range = CLightClusters::attenuationRange(1.0f, 0.09f, 0.032f, 1.0f);
+	CHECK_NEAR(1.0 / (1.0 + 0.09 * range + 0.032 * range * range), CLUSTER_LIGHT_THRESHOLD, 1e-5);
+	CHECK_EQUAL(CLightClusters::attenuationRange(1.0f, 0.0f, 0.0f, 1.0f), CLUSTER_INFINITE_RANGE);
+}
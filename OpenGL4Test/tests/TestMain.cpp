@@ -0,0 +1,25 @@
+//  TestMain.cpp
+//  執行所有登記的測試；argv[1] 可指定名稱中包含的字串，只執行符合的測試
+//  全部通過時回傳 0
+
+#include <cstring>
+#include <iostream>
+#include "UnitTest.h"
+
+int main(int argc, char** argv) {
+	const char* filter = argc > 1 ? argv[1] : nullptr;
+	int run = 0, failed = 0;
+	for (const auto& test : unitTests()) {
+		if (filter && std::strstr(test.name, filter) == nullptr) continue;
+		unitTestFailures() = 0;
+		test.func();
+		run++;
+		if (unitTestFailures() > 0) {
+			failed++;
+			std::cout << "[FAIL] " << test.name << std::endl;
+		}
+		else std::cout << "[ OK ] " << test.name << std::endl;
+	}
+	std::cout << (run - failed) << "/" << run << " tests passed" << std::endl;
+	return failed == 0 ? 0 : 1;
+}
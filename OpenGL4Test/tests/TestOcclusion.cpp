@@ -0,0 +1,110 @@
+//  TestOcclusion.cpp
+//  COcclusionCuller 的光柵化、Hi-Z 與可見性判斷；worker thread 的結果必須與單執行緒相同
+
+#include <algorithm>
+#include <cstring>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include "UnitTest.h"
+#include "../common/COcclusionCuller.h"
+
+namespace {
+
+const glm::vec3 kEye(0.0f, 0.0f, 10.0f);
+
+glm::mat4 testViewProj() {
+	glm::mat4 mxProj = glm::perspective(glm::radians(60.0f), 2.0f, 0.1f, 100.0f);
+	glm::mat4 mxView = glm::lookAt(kEye, glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+	return mxProj * mxView;
+}
+
+// 原點前方 6x6 的板子，正面在 z = 0.5
+void addWall(COcclusionCuller& culler) {
+	culler.addOccluderBox(glm::vec3(-3.0f, -3.0f, -0.5f), glm::vec3(3.0f, 3.0f, 0.5f));
+}
+
+}
+
+TEST(OcclusionDepthMatchesProjection) {
+	COcclusionCuller culler;
+	addWall(culler);
+	glm::mat4 mxViewProj = testViewProj();
+	culler.render(mxViewProj);
+	CHECK_EQUAL(culler.getTriangleCount(), 12);
+
+	// 畫面中央是板子的正面，角落沒有遮蔽物
+	glm::vec4 clip = mxViewProj * glm::vec4(0.0f, 0.0f, 0.5f, 1.0f);
+	float expected = clip.z / clip.w * 0.5f + 0.5f;
+	const float* depth = culler.getDepth();
+	int w = culler.getWidth(), h = culler.getHeight();
+	CHECK_NEAR(depth[(h / 2) * w + w / 2], expected, 1e-4);
+	CHECK_EQUAL(depth[0], 1.0f);
+	CHECK_EQUAL(depth[h * w - 1], 1.0f);
+}
+
+TEST(OcclusionHiZIsConservative) {
+	COcclusionCuller culler;
+	addWall(culler);
+	culler.addOccluderBox(glm::vec3(4.0f, 1.0f, -6.0f), glm::vec3(7.0f, 4.0f, -5.0f));
+	culler.render(testViewProj());
+
+	// 每一層的 texel 必須是下一層 2x2 中最遠的深度，否則會誤判為被遮蔽
+	int mismatches = 0;
+	for (int level = 1; level < culler.getLevelCount(); level++) {
+		const float* fine = culler.getDepth(level - 1);
+		const float* coarse = culler.getDepth(level);
+		int fineW = culler.getWidth() >> (level - 1);
+		int w = culler.getWidth() >> level, h = culler.getHeight() >> level;
+		for (int y = 0; y < h; y++)
+			for (int x = 0; x < w; x++) {
+				float farthest = std::max(std::max(fine[(2 * y) * fineW + 2 * x], fine[(2 * y) * fineW + 2 * x + 1]),
+										  std::max(fine[(2 * y + 1) * fineW + 2 * x], fine[(2 * y + 1) * fineW + 2 * x + 1]));
+				if (coarse[y * w + x] != farthest) mismatches++;
+			}
+	}
+	CHECK_EQUAL(mismatches, 0);
+}
+
+TEST(OcclusionVisibility) {
+	COcclusionCuller culler;
+	addWall(culler);
+	culler.render(testViewProj());
+
+	CHECK(!culler.isVisible(glm::vec3(-1.0f, -1.0f, -5.0f), glm::vec3(1.0f, 1.0f, -3.0f)));   // 板子正後方
+	CHECK(culler.isVisible(glm::vec3(-1.0f, -1.0f, 2.0f), glm::vec3(1.0f, 1.0f, 3.0f)));      // 板子前方
+	CHECK(culler.isVisible(glm::vec3(8.0f, -1.0f, -5.0f), glm::vec3(9.0f, 1.0f, -3.0f)));     // 旁邊
+	CHECK(culler.isVisible(glm::vec3(2.0f, -1.0f, -5.0f), glm::vec3(6.0f, 1.0f, -3.0f)));     // 部分露出
+	CHECK(culler.isVisible(glm::vec3(-1.0f, -1.0f, 9.0f), glm::vec3(1.0f, 1.0f, 11.0f)));     // 跨過近平面
+	CHECK_EQUAL(culler.getTestedCount(), 5);
+	CHECK_EQUAL(culler.getOccludedCount(), 1);
+
+	// 沒有遮蔽物時全部可見
+	culler.clearOccluders();
+	culler.render(testViewProj());
+	CHECK(culler.isVisible(glm::vec3(-1.0f, -1.0f, -5.0f), glm::vec3(1.0f, 1.0f, -3.0f)));
+	CHECK_EQUAL(culler.getOccludedCount(), 0);
+}
+
+TEST(OcclusionWorkersMatchSingleThread) {
+	COcclusionCuller single, threaded;
+	threaded.startWorkers();
+	threaded.startWorkers();	// 重複呼叫沒有作用
+	for (COcclusionCuller* culler : { &single, &threaded }) {
+		addWall(*culler);
+		for (int i = 0; i < 16; i++) {
+			float x = -12.0f + 1.5f * i;
+			culler->addOccluderBox(glm::vec3(x, -4.0f + 0.3f * i, -20.0f + i), glm::vec3(x + 1.0f, 4.0f, -19.0f + i));
+		}
+	}
+	// 換幾個視角，確認 worker 每一輪都完整處理所有 tile
+	for (int frame = 0; frame < 4; frame++) {
+		glm::mat4 mxView = glm::lookAt(kEye + glm::vec3(frame * 2.0f, 0.0f, 0.0f), glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+		glm::mat4 mxViewProj = glm::perspective(glm::radians(60.0f), 2.0f, 0.1f, 100.0f) * mxView;
+		single.render(mxViewProj);
+		threaded.render(mxViewProj);
+		for (int level = 0; level < single.getLevelCount(); level++) {
+			size_t size = static_cast<size_t>(single.getWidth() >> level) * (single.getHeight() >> level);
+			CHECK(std::memcmp(single.getDepth(level), threaded.getDepth(level), size * sizeof(float)) == 0);
+		}
+	}
+}
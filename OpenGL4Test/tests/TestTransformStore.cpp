@@ -0,0 +1,99 @@
+//  TestTransformStore.cpp
+//  CTransformStore 以 SIMD 組合的 world matrix 與 glm 的 translate * mat4_cast * scale 相同
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include "UnitTest.h"
+#include "../common/CTransformStore.h"
+
+namespace {
+
+struct TRS {
+	glm::vec3 position;
+	glm::quat rotation;
+	glm::vec3 scale;
+};
+
+glm::mat4 referenceMatrix(const TRS& t) {
+	return glm::translate(glm::mat4(1.0f), t.position) * glm::mat4_cast(glm::normalize(t.rotation)) *
+		   glm::scale(glm::mat4(1.0f), t.scale);
+}
+
+TRS randomTRS(std::mt19937& rng) {
+	std::uniform_real_distribution<float> unit(-1.0f, 1.0f), positive(0.1f, 3.0f);
+	TRS t;
+	t.position = glm::vec3(unit(rng), unit(rng), unit(rng)) * 50.0f;
+	t.rotation = glm::quat(unit(rng), unit(rng), unit(rng), unit(rng));   // 未正規化，store 會先正規化
+	if (glm::length(glm::vec4(t.rotation.x, t.rotation.y, t.rotation.z, t.rotation.w)) < 1e-3f)
+		t.rotation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f);
+	t.scale = glm::vec3(positive(rng), positive(rng), positive(rng));
+	return t;
+}
+
+float maxError(const CTransformStore& store, const std::vector<TRS>& expected) {
+	float error = 0.0f;
+	for (int i = 0; i < static_cast<int>(expected.size()); i++) {
+		glm::mat4 reference = referenceMatrix(expected[i]);
+		glm::mat4 m = store.getWorldMatrix(i);
+		for (int c = 0; c < 4; c++)
+			for (int r = 0; r < 4; r++) error = std::max(error, std::fabs(reference[c][r] - m[c][r]));
+	}
+	return error;
+}
+
+}
+
+TEST(TransformStoreMatchesGlm) {
+	// 數量不是 4 的倍數，確認 SIMD 核心的尾端補齊不影響結果
+	const int count = 1027;
+	std::mt19937 rng(42);
+	std::vector<TRS> expected;
+	CTransformStore store;
+	store.reserve(count);
+	for (int i = 0; i < count; i++) {
+		expected.push_back(randomTRS(rng));
+		CHECK_EQUAL(store.add(expected[i].position, expected[i].rotation, expected[i].scale), i);
+	}
+	CHECK_EQUAL(store.size(), count);
+	CHECK_EQUAL(store.update(), count);
+	CHECK_EQUAL(store.update(), 0);	// 沒有修改時不重新組合
+	CHECK_NEAR(maxError(store, expected), 0.0, 1e-4);
+
+	// 3x4 的 row 與 getWorldMatrix 一致：row i 的第四個分量為位移
+	const glm::vec4* rows = store.getWorldRows(7);
+	glm::mat4 m = store.getWorldMatrix(7);
+	for (int r = 0; r < 3; r++)
+		for (int c = 0; c < 4; c++) CHECK_EQUAL(rows[r][c], m[c][r]);
+}
+
+TEST(TransformStoreUpdatesDirtyRange) {
+	std::mt19937 rng(7);
+	std::vector<TRS> expected;
+	CTransformStore store;
+	for (int i = 0; i < 10; i++) {
+		expected.push_back(randomTRS(rng));
+		store.add(expected[i].position, expected[i].rotation, expected[i].scale);
+	}
+	store.update();
+
+	// 只修改中間兩筆，回傳修改過的範圍筆數
+	expected[3].position = glm::vec3(1.0f, 2.0f, 3.0f);
+	store.setPosition(3, expected[3].position);
+	expected[5].scale = glm::vec3(4.0f);
+	store.setScale(5, expected[5].scale);
+	CHECK_EQUAL(store.update(), 3);
+	CHECK(store.getPosition(3) == expected[3].position);
+
+	expected[9].rotation = glm::angleAxis(glm::radians(30.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+	store.setRotation(9, expected[9].rotation);
+	CHECK_EQUAL(store.update(), 1);
+	CHECK_NEAR(maxError(store, expected), 0.0, 1e-4);
+
+	store.clear();
+	CHECK_EQUAL(store.size(), 0);
+	CHECK_EQUAL(store.update(), 0);
+}
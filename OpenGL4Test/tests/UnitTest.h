@@ -0,0 +1,62 @@
+//  UnitTest.h
+//  不需要 GL context 的 CPU 端單元測試：TEST(name) 宣告的函式在靜態初始化時登記，
+//  由 TestMain.cpp 依序執行；CHECK 失敗時輸出檔名與行號並繼續執行同一個測試
+
+#pragma once
+
+#include <vector>
+#include <cmath>
+#include <iostream>
+
+struct UnitTest {
+	const char* name;
+	void (*func)();
+};
+
+inline std::vector<UnitTest>& unitTests() {
+	static std::vector<UnitTest> tests;
+	return tests;
+}
+
+// 目前測試中失敗的 CHECK 數量
+inline int& unitTestFailures() {
+	static int failures = 0;
+	return failures;
+}
+
+struct UnitTestRegistrar {
+	UnitTestRegistrar(const char* name, void (*func)()) { unitTests().push_back({ name, func }); }
+};
+
+#define TEST(name) \
+	static void test_##name(); \
+	static UnitTestRegistrar registrar_##name(#name, test_##name); \
+	static void test_##name()
+
+#define CHECK(cond) \
+	do { \
+		if (!(cond)) { \
+			std::cerr << __FILE__ << ":" << __LINE__ << ": CHECK(" #cond ") failed" << std::endl; \
+			unitTestFailures()++; \
+		} \
+	} while (0)
+
+#define CHECK_EQUAL(a, b) \
+	do { \
+		auto va_ = (a); auto vb_ = (b); \
+		if (!(va_ == vb_)) { \
+			std::cerr << __FILE__ << ":" << __LINE__ << ": CHECK_EQUAL(" #a ", " #b ") failed: " \
+					  << va_ << " != " << vb_ << std::endl; \
+			unitTestFailures()++; \
+		} \
+	} while (0)
+
+#define CHECK_NEAR(a, b, eps) \
+	do { \
+		double va_ = (a), vb_ = (b); \
+		if (!(std::fabs(va_ - vb_) <= (eps))) { \
+			std::cerr << __FILE__ << ":" << __LINE__ << ": CHECK_NEAR(" #a ", " #b ") failed: " \
+					  << va_ << " vs " << vb_ << std::endl; \
+			unitTestFailures()++; \
+		} \
+	} while (0)
@@ -0,0 +1,28 @@
+// v_depth.glsl
+// Depth pre-pass: position only. gl_Position must be computed exactly as in v_phong.glsl
+// (same expression, both invariant) so the main pass can use GL_EQUAL depth testing.
+#version 330 core
+layout(location=0) in vec3 aPos;
+
+// Per-instance model matrix (CInstanceSet), only read when uInstanced is set
+layout(location=4) in mat4 aInstanceModel;     // locations 4-7
+
+uniform mat4 mxModel;
+uniform bool uInstanced;
+
+// Per-frame constants, written once per frame by CCamera::uploadFrameBlock
+layout(std140) uniform FrameBlock {
+    mat4 mxView;
+    mat4 mxProj;
+    mat4 mxViewProj;
+    vec3 viewPos;
+    float uTime;
+};
+
+invariant gl_Position;
+
+void main() {
+    mat4 model = uInstanced ? mxModel * aInstanceModel : mxModel;
+    vec4 worldPos = model * vec4(aPos, 1.0);
+    gl_Position = mxViewProj * worldPos;
+}
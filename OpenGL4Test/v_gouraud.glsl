@@ -3,14 +3,25 @@ layout (location = 0) in vec3 aPos;    // Pos
 layout (location = 1) in vec3 aColor;  // Color
 layout (location = 2) in vec3 aNormal; // Normal
 layout (location = 3) in vec2 aTex;    // Texture Coordinates
+// Per-instance attributes (CInstanceSet), only read when uInstanced is set
+layout (location = 4) in mat4 aInstanceModel;  // locations 4-7
+layout (location = 8) in int  aInstanceMaterial; // -1 keeps uMaterialIndex
+layout (location = 9) in vec4 aInstanceColor;
 out vec4 vColor;
 
 uniform mat4 mxModel;
-uniform mat4 mxView;
-uniform mat4 mxProj;
+uniform bool uInstanced;
 uniform vec4 ui4Color;     // ����Τ@�C��
 uniform int  uShadingMode;   // 1 = ���I��, 2 = �����, 3 = Gouraud(���I����)
-uniform vec3 viewPos;   // �ө��p�⥲�������Y��m 
+
+// Per-frame constants, written once per frame by CCamera::uploadFrameBlock
+layout(std140) uniform FrameBlock {
+    mat4 mxView;
+    mat4 mxProj;
+    mat4 mxViewProj;
+    vec3 viewPos;
+    float uTime;
+};
 
 struct LightSource {
     vec3 position;
@@ -28,26 +39,39 @@ struct LightSource {
 };
 uniform LightSource uLight;
 
-struct Material {
-    vec4 ambient;
-    vec4 diffuse;
-    vec4 specular;
+#define MAX_MATERIALS 256
+
+// std140 layout, must match MaterialBlockEntry in CMaterialTable.h
+struct MaterialData {
+    vec4 ambient;   // ka
+    vec4 diffuse;   // kd
+    vec4 specular;  // ks
     float shininess;
+    float alpha;
+    int textureFlags; // 1 = diffuse, 2 = normal, 4 = specular, 8 = alpha
+    int pad;
+};
+
+// Every material lives in one table; a draw only selects an index
+layout(std140) uniform MaterialBlock {
+    MaterialData uMaterials[MAX_MATERIALS];
 };
-uniform Material uMaterial;
+uniform int uMaterialIndex;
 uniform int lightType; // 0 = Point, 1 = Spot
 
 void main() {
+    mat4 model = uInstanced ? mxModel * aInstanceModel : mxModel;
+    vec4 instanceColor = uInstanced ? aInstanceColor : vec4(1.0);
     if( uShadingMode == 1 ) { // �䴩 vertex color �� per vertex lighting�Aobject color �ۤv�W�[
-        vColor = vec4(aColor, 1.0);
-        gl_Position = mxProj * mxView * mxModel*vec4(aPos, 1.0);
+        vColor = vec4(aColor, 1.0) * instanceColor;
+        gl_Position = mxViewProj * model * vec4(aPos, 1.0);
         return;
     }
 
      // 1. �p��y�лP�k�u
-     vec4 worldPos4 = mxModel * vec4(aPos, 1.0);
+     vec4 worldPos4 = model * vec4(aPos, 1.0);
      vec3 v3Pos  = worldPos4.xyz;
-     vec3 N = normalize((mat3(mxModel) * aNormal));
+     vec3 N = normalize((mat3(model) * aNormal));
  //  vec3 N = normalize(mat3(transpose(inverse(mxModel))) * aNormal);
 
      // 2. ���ӦV�q
@@ -55,17 +79,20 @@ void main() {
      vec3 V = normalize(viewPos - v3Pos);
      vec3 R = reflect(-L, N);
 
+     int materialIndex = (uInstanced && aInstanceMaterial >= 0) ? aInstanceMaterial : uMaterialIndex;
+     MaterialData material = uMaterials[max(materialIndex, 0)];
+
      // 3. ��¦ Ambient
-     vec4 ambient = uLight.ambient * uMaterial.ambient;
+     vec4 ambient = uLight.ambient * material.ambient;
 
      // 4. ���Ϯg
      float diff = max(dot(N, L), 0.0);
-     vec4 diffuse = uLight.diffuse * diff * uMaterial.diffuse;
+     vec4 diffuse = uLight.diffuse * diff * material.diffuse;
 
      // 5. �譱�Ϯg
      float RdotV = dot(R, V);
-     float spec = pow(max(RdotV, 0.0), uMaterial.shininess);
-     vec4 specular = uLight.specular * spec * uMaterial.specular;
+     float spec = pow(max(RdotV, 0.0), material.shininess);
+     vec4 specular = uLight.specular * spec * material.specular;
 
      // 6. �I��
      float distance = length(uLight.position - v3Pos);
@@ -91,8 +118,8 @@ void main() {
      // 8. �X���C��ÿ�X
      vec4 result = (ambient + diffuse + specular) * atten;  
      result.w = 1.0f;  // �ثe���B�z�b�z����
-     vColor = result;
+     vColor = result * instanceColor;
 
      // �̫��v
-     gl_Position = mxProj * mxView * worldPos4;
+     gl_Position = mxViewProj * worldPos4;
 }
@@ -6,10 +6,16 @@ layout(location=2) in vec3 aNormal;
 layout(location=3) in vec2 aTex;    // Texture Coordinates
 
 uniform mat4 mxModel;
-uniform mat4 mxView;
-uniform mat4 mxProj;
 
-uniform vec3 viewPos;   // өp⥲Ym 
+// Per-frame constants, written once per frame by CCamera::uploadFrameBlock
+layout(std140) uniform FrameBlock {
+    mat4 mxView;
+    mat4 mxProj;
+    mat4 mxViewProj;
+    vec3 viewPos;
+    float uTime;
+};
+
 uniform vec3 lightPos;  // өp⥲m 
 
 out vec3 vNormal;      // IkVq (N)
@@ -25,5 +31,5 @@ void main() {
     vLight  = normalize(lightPos - v3Pos);
     vView   = normalize(viewPos - v3Pos);
     vColor   = aColor;
-    gl_Position = mxProj * mxView * worldPos;
+    gl_Position = mxViewProj * worldPos;
 }
\ No newline at end of file
@@ -5,11 +5,24 @@ layout(location=0) in vec3 aPos;
 layout(location=2) in vec3 aNormal;
 layout(location=3) in vec2 aTex;    // Texture Coordinates
 
+// Per-instance attributes (CInstanceSet), only read when uInstanced is set
+layout(location=4) in mat4 aInstanceModel;     // locations 4-7
+layout(location=8) in int  aInstanceMaterial;  // -1 keeps uMaterialIndex
+layout(location=9) in vec4 aInstanceColor;
+
 uniform mat4 mxModel;
-uniform mat4 mxView;
-uniform mat4 mxProj;
+uniform bool uInstanced;
+uniform int  uMaterialIndex;
+
+// Per-frame constants, written once per frame by CCamera::uploadFrameBlock
+layout(std140) uniform FrameBlock {
+    mat4 mxView;
+    mat4 mxProj;
+    mat4 mxViewProj;
+    vec3 viewPos;
+    float uTime;
+};
 
-uniform vec3 viewPos;
 uniform vec3 lightPos;
 
 out vec3 vNormal;
@@ -18,34 +31,42 @@ out vec3 vView;
 out vec3 vColor;
 out vec3 v3Pos;
 out vec2 vTexCoord;
+flat out int vMaterialIndex;
+flat out vec4 vInstanceColor;
 
 // Tangent and Bitangent (out variables)
 out vec3 vTangent;
 out vec3 vBitangent;
 
+// Must match v_depth.glsl exactly, the main pass uses GL_EQUAL after the depth pre-pass
+invariant gl_Position;
+
 void main() {
-    vec4 worldPos = mxModel * vec4(aPos, 1.0);
+    mat4 model = uInstanced ? mxModel * aInstanceModel : mxModel;
+    vMaterialIndex = (uInstanced && aInstanceMaterial >= 0) ? aInstanceMaterial : uMaterialIndex;
+    vInstanceColor = uInstanced ? aInstanceColor : vec4(1.0);
+    vec4 worldPos = model * vec4(aPos, 1.0);
     v3Pos   = worldPos.xyz;
-    vNormal = normalize((mat3(mxModel) * aNormal));
+    vNormal = normalize((mat3(model) * aNormal));
     vLight  = normalize(lightPos - v3Pos);
     vView   = normalize(viewPos - v3Pos);
 //    vColor   = aColor;
     vColor = vec3(1.0, 1.0, 1.0);
     vTexCoord = aTex;
-    gl_Position = mxProj * mxView * worldPos;
+    gl_Position = mxViewProj * worldPos;
     
     // Calculate Tangent and Bitangent (Simple Method - Requires UVs)
-    vec3 edge1 = vec3(mxModel * vec4(aPos, 1.0) - mxModel * vec4(aPos - vec3(0.1, 0.0, 0.0), 1.0)); // Approximate
-    vec3 edge2 = vec3(mxModel * vec4(aPos, 1.0) - mxModel * vec4(aPos - vec3(0.0, 0.1, 0.0), 1.0)); // Approximate
+    vec3 edge1 = vec3(model * vec4(aPos, 1.0) - model * vec4(aPos - vec3(0.1, 0.0, 0.0), 1.0)); // Approximate
+    vec3 edge2 = vec3(model * vec4(aPos, 1.0) - model * vec4(aPos - vec3(0.0, 0.1, 0.0), 1.0)); // Approximate
     vec2 deltaUV1 = vec2(aTex.x - (aTex.x - 0.1), aTex.y - aTex.y); // Approximate
     vec2 deltaUV2 = vec2(aTex.x - aTex.x, aTex.y - (aTex.y - 0.1)); // Approximate
 
     float f = 1.0f / (deltaUV1.x * deltaUV2.y - deltaUV2.x * deltaUV1.y);
 
-    vTangent = normalize(vec3(mxModel * vec4(f * (deltaUV2.y * edge1.x - deltaUV1.y * edge2.x), 0.0, 0.0, 0.0)));
-    vBitangent = normalize(vec3(mxModel * vec4(f * (deltaUV1.x * edge2.x - deltaUV2.x * edge1.x), 0.0, 0.0, 0.0)));
+    vTangent = normalize(vec3(model * vec4(f * (deltaUV2.y * edge1.x - deltaUV1.y * edge2.x), 0.0, 0.0, 0.0)));
+    vBitangent = normalize(vec3(model * vec4(f * (deltaUV1.x * edge2.x - deltaUV2.x * edge1.x), 0.0, 0.0, 0.0)));
 
-    vNormal = normalize(mat3(transpose(inverse(mxModel))) * aNormal); // Correct Normal Transformation
+    vNormal = normalize(mat3(transpose(inverse(model))) * aNormal); // Correct Normal Transformation
 }
 
 
@@ -0,0 +1,17 @@
+// v_shadow.glsl
+// Shadow map pass: position only, transformed by the light's view-projection instead of the camera's.
+// Used with f_depth.glsl by CShadowMaps.
+#version 330 core
+layout(location=0) in vec3 aPos;
+
+// Per-instance model matrix (CInstanceSet), only read when uInstanced is set
+layout(location=4) in mat4 aInstanceModel;     // locations 4-7
+
+uniform mat4 mxModel;
+uniform bool uInstanced;
+uniform mat4 uLightViewProj;
+
+void main() {
+    mat4 model = uInstanced ? mxModel * aInstanceModel : mxModel;
+    gl_Position = uLightViewProj * model * vec4(aPos, 1.0);
+}